@@ -14,8 +14,8 @@ from neuroproof import Agglomeration
 seg = numpy.array(h5py.File(segh5)['stack'], numpy.uint32)
 pred = numpy.array(h5py.File(predh5)['volume/predictions'], numpy.float32)
 
-pred = pred.transpose((2,1,0,3))
-pred = pred.copy()
+# store each channel contiguously so that the predictions are not copied again
+pred = Agglomeration.channel_major_predictions(pred.transpose((2,1,0,3)))
 
 res = Agglomeration.agglomerate(seg, pred, classifier, threshold)
 
@@ -47,4 +47,15 @@ rag = create_rag_from_jsonfile(sys.argv[1])
 if rag.get_num_regions() != 2:
     exit(1)
 
+# binary graph format is selected by extension
+binary_name = sys.argv[1] + ".npgraph"
+if not create_graphfile_from_rag(rag, binary_name):
+    exit(1)
+rag = create_rag_from_graphfile(binary_name)
+if rag.get_num_regions() != 2:
+    exit(1)
+for edge in rag.get_edges():
+    if edge.get_weight() != 3.6:
+        exit(1)
+
 print("SUCCESS")
@@ -1,66 +1,327 @@
 #include <Stack/Stack.h>
 #include <boost/python.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cstring>
 
 using namespace NeuroProof;
 using namespace boost::python;
 using std::unordered_map;
+using std::vector;
+
+//! overlap count of a (label, label) pair
+typedef std::pair<std::pair<unsigned long long, unsigned long long>, unsigned long long> OverlapCount;
+
+/*!
+ * Sorts the overlap counts and combines the counts of repeated pairs.
+ * \param overlaps overlap counts
+*/
+static void reduce_overlaps(vector<OverlapCount>& overlaps)
+{
+    if (overlaps.empty()) {
+        return;
+    }
+    std::sort(overlaps.begin(), overlaps.end());
+    size_t num_unique = 0;
+    for (size_t i = 1; i < overlaps.size(); ++i) {
+        if (overlaps[i].first == overlaps[num_unique].first) {
+            overlaps[num_unique].second += overlaps[i].second;
+        } else {
+            overlaps[++num_unique] = overlaps[i];
+        }
+    }
+    overlaps.resize(num_unique + 1);
+}
+
+/*!
+ * Counts the overlap of nonzero labels in voxels [start, end) of two
+ * volumes stored in the same order.  Runs of the same pair are counted
+ * together and the list is reduced whenever it grows large so that
+ * memory follows the number of distinct pairs rather than voxels.
+ * \param labels1 first label volume
+ * \param labels2 second label volume
+ * \param start first voxel examined
+ * \param end one past the last voxel examined
+ * \param overlaps sorted overlap counts with one entry per pair
+*/
+template <typename T1, typename T2>
+static void count_overlaps(const T1* labels1, const T2* labels2, size_t start, size_t end,
+        vector<OverlapCount>& overlaps)
+{
+    size_t reduce_size = 1 << 20;
+    std::pair<unsigned long long, unsigned long long> curr_pair(0, 0);
+    unsigned long long curr_count = 0;
+
+    for (size_t i = start; i < end; ++i) {
+        unsigned long long label1 = labels1[i];
+        unsigned long long label2 = labels2[i];
+        if (!label1 || !label2) {
+            continue;
+        }
+
+        if (curr_count && (label1 == curr_pair.first) && (label2 == curr_pair.second)) {
+            ++curr_count;
+            continue;
+        }
+        if (curr_count) {
+            overlaps.push_back(OverlapCount(curr_pair, curr_count));
+            if (overlaps.size() >= reduce_size) {
+                reduce_overlaps(overlaps);
+                // grow the limit if most pairs are distinct
+                if (overlaps.size() * 2 > reduce_size) {
+                    reduce_size *= 2;
+                }
+            }
+        }
+        curr_pair = std::make_pair(label1, label2);
+        curr_count = 1;
+    }
+    if (curr_count) {
+        overlaps.push_back(OverlapCount(curr_pair, curr_count));
+    }
+    reduce_overlaps(overlaps);
+}
+
+/*!
+ * Releases the python global interpreter lock while in scope.
+*/
+class ScopedReleaseGIL {
+  public:
+    ScopedReleaseGIL() : state(PyEval_SaveThread()) {}
+    ~ScopedReleaseGIL()
+    {
+        PyEval_RestoreThread(state);
+    }
+  private:
+    PyThreadState* state;
+};
+
+static void release_buffer(Py_buffer* buffer)
+{
+    PyBuffer_Release(buffer);
+    delete buffer;
+}
 
 // ?! inherit properly from Stack (reuse some implementation, etC)
 class StackPython {
   public:
-    StackPython(object stack_labels, int padding_radius)
+    /*!
+     * Wraps a (z,y,x) label array.  A C-contiguous array of 32 or 64-bit
+     * integers is read in place without a copy when no padding is
+     * requested.  Other arrays are copied into a 32-bit label volume.
+     * \param stack_labels numpy label array
+     * \param padding_radius radius of the dilation of label boundaries
+    */
+    StackPython(object stack_labels, int padding_radius) : label_data(0), label_bytes(0)
     {
         boost::python::tuple labels_shape(stack_labels.attr("shape"));
 
-        unsigned int width = boost::python::extract<unsigned int>(labels_shape[2]);
-        unsigned int height = boost::python::extract<unsigned int>(labels_shape[1]);
-        unsigned int depth = boost::python::extract<unsigned int>(labels_shape[0]);
+        width = boost::python::extract<unsigned int>(labels_shape[2]);
+        height = boost::python::extract<unsigned int>(labels_shape[1]);
+        depth = boost::python::extract<unsigned int>(labels_shape[0]);
+
+        bool found_buffer = get_label_buffer(stack_labels);
+        if (found_buffer && (padding_radius <= 0)) {
+            return;
+        }
 
         labels = VolumeLabelData::create_volume();
         labels->reshape(vigra::MultiArrayShape<3>::type(width, height, depth));
 
-        volume_forXYZ(*labels,x,y,z) {
-            labels->set(x,y,z,
-                    boost::python::extract<double>(stack_labels[boost::python::make_tuple(z,y,x)]));
+        if (found_buffer) {
+            // the (z,y,x) buffer has the same layout as the (x,y,z) volume
+            Label_t* voxel_data = labels->data();
+            size_t num_voxels = size_t(width) * height * depth;
+            if (label_bytes == sizeof(unsigned int)) {
+                const unsigned int* buffer_data = (const unsigned int*) label_data;
+                std::copy(buffer_data, buffer_data + num_voxels, voxel_data);
+            } else {
+                const unsigned long long* buffer_data = (const unsigned long long*) label_data;
+                for (size_t i = 0; i < num_voxels; ++i) {
+                    voxel_data[i] = buffer_data[i];
+                }
+            }
+            buffer.reset();
+        } else {
+            volume_forXYZ(*labels,x,y,z) {
+                labels->set(x,y,z,
+                        boost::python::extract<double>(stack_labels[boost::python::make_tuple(z,y,x)]));
+            }
         }
 
         Stack stack(labels);
         if (padding_radius > 0) stack.dilate_labelvol(padding_radius);
         labels = stack.get_labelvol();
+        labels->rebase_labels();
+
+        label_data = (const char*) labels->data();
+        label_bytes = sizeof(Label_t);
     }
 
     boost::python::list find_overlaps(StackPython* stack2)
     {
-        unordered_map<Label_t, unordered_map<Label_t, unsigned int> > labelcounts;
+        vector<OverlapCount> overlap_counts;
+        compute_overlaps(stack2, 0, overlap_counts);
 
-        volume_forXYZ(*labels,x,y,z) {
-            Label_t label1 = (*labels)(x,y,z);
-            Label_t label2 = (*(stack2->labels))(x,y,z);
+        boost::python::list overlaps;
+        for (size_t i = 0; i < overlap_counts.size(); ++i) {
+            overlaps.append(boost::python::make_tuple(overlap_counts[i].first.first,
+                        overlap_counts[i].first.second, overlap_counts[i].second));
+        }
 
-            if (!label1 || !label2) {
-                continue;
-            }
+        return overlaps;
+    }
 
-            labelcounts[label1][label2]++;
+    /*!
+     * Finds the number of voxels shared by each pair of nonzero labels
+     * in this stack and another stack of the same shape.
+     * \param stack2 stack compared against
+     * \param num_threads number of threads used (0 uses all cores)
+     * \return numpy uint64 array with a (label, label2, count) row per pair
+    */
+    object find_overlaps_array(StackPython* stack2, unsigned int num_threads)
+    {
+        vector<OverlapCount> overlap_counts;
+        compute_overlaps(stack2, num_threads, overlap_counts);
+
+        object numpy = import("numpy");
+        object overlaps = numpy.attr("zeros")(boost::python::make_tuple(
+                    overlap_counts.size(), 3), "uint64");
+
+        Py_buffer overlaps_buffer;
+        if (PyObject_GetBuffer(overlaps.ptr(), &overlaps_buffer,
+                    PyBUF_C_CONTIGUOUS | PyBUF_WRITABLE) != 0) {
+            throw_error_already_set();
         }
-       
-        // ?! write overlaps 
-        boost::python::list overlaps;
-        for (unordered_map<Label_t, unordered_map<Label_t, unsigned int> >::iterator iter =
-                labelcounts.begin(); iter != labelcounts.end(); ++iter) {
-       
-            for (unordered_map<Label_t, unsigned int>::iterator iter2 = iter->second.begin();
-                    iter2 != iter->second.end(); ++iter2) {
-                overlaps.append(boost::python::make_tuple(iter->first, iter2->first, iter2->second));
-            }
-            
+        unsigned long long* overlap_data = (unsigned long long*) overlaps_buffer.buf;
+        for (size_t i = 0; i < overlap_counts.size(); ++i) {
+            *overlap_data++ = overlap_counts[i].first.first;
+            *overlap_data++ = overlap_counts[i].first.second;
+            *overlap_data++ = overlap_counts[i].second;
         }
+        PyBuffer_Release(&overlaps_buffer);
 
         return overlaps;
     }
 
   private:
+    /*!
+     * Points the stack at the memory of the given array if it is a
+     * C-contiguous 3D array of 32 or 64-bit integers.
+     * \param stack_labels numpy label array
+     * \return true if the array memory is used
+    */
+    bool get_label_buffer(object stack_labels)
+    {
+        Py_buffer* label_buffer = new Py_buffer;
+        if (PyObject_GetBuffer(stack_labels.ptr(), label_buffer,
+                    PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0) {
+            PyErr_Clear();
+            delete label_buffer;
+            return false;
+        }
+        buffer.reset(label_buffer, release_buffer);
+
+        // skip the byte order prefix
+        const char* format = label_buffer->format ? label_buffer->format : "B";
+        if (std::strchr("@=<>!", *format)) {
+            ++format;
+        }
+        bool is_int = (std::strlen(format) == 1) && std::strchr("iIlLqQ", *format);
+
+        if ((label_buffer->ndim != 3) || !is_int || ((label_buffer->itemsize != 4) &&
+                    (label_buffer->itemsize != 8))) {
+            buffer.reset();
+            return false;
+        }
+
+        label_data = (const char*) label_buffer->buf;
+        label_bytes = label_buffer->itemsize;
+        return true;
+    }
+
+    template <typename T1, typename T2>
+    void compute_overlaps(const T1* labels1, const T2* labels2, unsigned int num_threads,
+            vector<OverlapCount>& overlaps)
+    {
+        size_t num_voxels = size_t(width) * height * depth;
+        vector<vector<OverlapCount> > chunk_overlaps(num_threads);
+
+        // the labels are only read so the interpreter can run meanwhile
+        ScopedReleaseGIL release_gil;
+        if (num_threads > 1) {
+            boost::thread_group threads;
+            size_t start = 0;
+            for (unsigned int i = 0; i < num_threads; ++i) {
+                size_t end = start + num_voxels / num_threads + ((i < (num_voxels % num_threads)) ? 1 : 0);
+                threads.create_thread(boost::bind(&count_overlaps<T1, T2>, labels1, labels2,
+                            start, end, boost::ref(chunk_overlaps[i])));
+                start = end;
+            }
+            threads.join_all();
+        } else {
+            count_overlaps(labels1, labels2, 0, num_voxels, chunk_overlaps[0]);
+        }
+
+        overlaps.swap(chunk_overlaps[0]);
+        for (unsigned int i = 1; i < num_threads; ++i) {
+            overlaps.insert(overlaps.end(), chunk_overlaps[i].begin(), chunk_overlaps[i].end());
+            vector<OverlapCount>().swap(chunk_overlaps[i]);
+        }
+        if (num_threads > 1) {
+            reduce_overlaps(overlaps);
+        }
+    }
+
+    template <typename T1>
+    void compute_overlaps(const T1* labels1, StackPython* stack2, unsigned int num_threads,
+            vector<OverlapCount>& overlaps)
+    {
+        if (stack2->label_bytes == sizeof(unsigned int)) {
+            compute_overlaps(labels1, (const unsigned int*) stack2->label_data,
+                    num_threads, overlaps);
+        } else {
+            compute_overlaps(labels1, (const unsigned long long*) stack2->label_data,
+                    num_threads, overlaps);
+        }
+    }
+
+    void compute_overlaps(StackPython* stack2, unsigned int num_threads,
+            vector<OverlapCount>& overlaps)
+    {
+        if ((width != stack2->width) || (height != stack2->height) || (depth != stack2->depth)) {
+            throw ErrMsg("Stacks have different dimensions");
+        }
+        if (!num_threads) {
+            num_threads = boost::thread::hardware_concurrency();
+        }
+        num_threads = std::max(num_threads, 1U);
+
+        if (label_bytes == sizeof(unsigned int)) {
+            compute_overlaps((const unsigned int*) label_data, stack2, num_threads, overlaps);
+        } else {
+            compute_overlaps((const unsigned long long*) label_data, stack2, num_threads, overlaps);
+        }
+    }
+
+    //! label volume when the labels are copied
     VolumeLabelPtr labels;
+
+    //! view of the numpy array when the labels are not copied
+    boost::shared_ptr<Py_buffer> buffer;
+
+    //! labels in (z,y,x) C-order
+    const char* label_data;
+
+    //! bytes used by each label (4 or 8)
+    unsigned int label_bytes;
+
+    unsigned int width, height, depth;
 };
 
 //    class_<StackPython>("Stack", "Contains segmentation labels", init<object>(args("labels"), "Provide numpy labels to init Stack")[])
@@ -68,5 +329,8 @@ BOOST_PYTHON_MODULE(libNeuroProofMetrics)
 {
     class_<StackPython>("Stack", "Contains segmentation labels", init<object, int>())
         .def("find_overlaps", &StackPython::find_overlaps)
+        .def("find_overlaps_array", &StackPython::find_overlaps_array,
+                (arg("stack2"), arg("num_threads")=0),
+                "Returns a uint64 array with a (label1, label2, count) row for each overlapping pair")
         ;
 }
@@ -3,10 +3,15 @@
 #include <Utilities/ScopeTime.h>
 #include <Utilities/OptionParser.h>
 #include <IO/RagIO.h>
+#include <IO/DVIDPropertyExchange.h>
+#include <Utilities/AffinityPair.h>
 
 #include <libdvid/DVIDNodeService.h>
 
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
 #include <iostream>
 #include <fstream>
 
@@ -20,15 +25,124 @@ using std::string;
 using std::vector;
 using namespace boost::algorithm;
 using std::unordered_set;
+using std::unordered_map;
 using std::ifstream;
 
 
 static const char * PROPERTY_KEY = "np-features";
 static const char * PROB_KEY = "np-prob";
 
+/*!
+ * Converts a DVID id to a rag node id.
+ * \param id DVID vertex id
+ * \return rag node id
+*/
+static Node_t dvid_node_id(unsigned long long id)
+{
+    // 64-bit labels need NEUROPROOF_64BIT_LABELS
+    if (Node_t(id) != id) {
+        throw ErrMsg("DVID label does not fit in the label type (build with NEUROPROOF_64BIT_LABELS)");
+    }
+    return Node_t(id);
+}
+
+/*!
+ * Worker that retrieves the neighborhood subgraph of bodies until none
+ * remain.  Each worker uses its own DVID connection.
+ * \param dvid_node DVID connection used only by this worker
+ * \param graph_name name of the DVID graph
+ * \param bodies bodies whose neighbors are retrieved
+ * \param subgraphs neighborhood subgraph for each body
+ * \param state progress shared by the workers
+*/
+static void fetch_neighbor_subgraphs(libdvid::DVIDNodeService* dvid_node,
+        const string& graph_name, const vector<Node_t>& bodies,
+        vector<libdvid::Graph>& subgraphs, DVIDExchangeState* state)
+{
+    const size_t BATCH_SIZE = 64;
+    try {
+        while (1) {
+            size_t start;
+            {
+                boost::mutex::scoped_lock lock(state->mutex);
+                if (state->failed || (state->next_batch >= bodies.size())) {
+                    return;
+                }
+                start = state->next_batch;
+                state->next_batch += BATCH_SIZE;
+            }
+            size_t end = std::min(start + BATCH_SIZE, bodies.size());
+            for (size_t i = start; i < end; ++i) {
+                dvid_node->get_vertex_neighbors(graph_name, libdvid::Vertex(bodies[i]), subgraphs[i]);
+            }
+        }
+    } catch (std::exception& e) {
+        boost::mutex::scoped_lock lock(state->mutex);
+        if (!state->failed) {
+            state->error = e.what();
+        }
+        state->failed = true;
+    }
+}
+
+/*!
+ * Deserializes the features of rag elements [start, end).  Feature
+ * caches must already exist for the elements so that no caches are
+ * created concurrently.
+ * \param feature_manager feature manager holding the caches
+ * \param elements rag nodes or edges
+ * \param properties serialized features for each element
+ * \param start first element deserialized
+ * \param end one past the last element deserialized
+*/
+template <typename Element>
+static void deserialize_feature_range(FeatureMgrPtr feature_manager,
+        const vector<Element*>& elements, const vector<libdvid::BinaryDataPtr>& properties,
+        size_t start, size_t end)
+{
+    for (size_t i = start; i < end; ++i) {
+        assert((properties[i]->get_data().length() > 0));
+        feature_manager->deserialize_features((char*) properties[i]->get_raw(), elements[i]);
+    }
+}
+
+/*!
+ * Deserializes the features of new rag elements over several threads.
+ * \param feature_manager feature manager holding the caches
+ * \param elements rag nodes or edges
+ * \param properties serialized features for each element
+ * \param num_threads number of threads used
+*/
+template <typename Element>
+static void deserialize_features(FeatureMgrPtr feature_manager,
+        const vector<Element*>& elements, const vector<libdvid::BinaryDataPtr>& properties,
+        unsigned int num_threads)
+{
+    // the elements are new so there are no features to reset
+    for (size_t i = 0; i < elements.size(); ++i) {
+        feature_manager->create_cache(elements[i]);
+    }
+
+    num_threads = std::min(size_t(std::max(num_threads, 1U)), std::max(elements.size(), size_t(1)));
+    if (num_threads > 1) {
+        boost::thread_group threads;
+        size_t start = 0;
+        for (unsigned int i = 0; i < num_threads; ++i) {
+            size_t end = start + elements.size() / num_threads +
+                ((i < (elements.size() % num_threads)) ? 1 : 0);
+            threads.create_thread(boost::bind(&deserialize_feature_range<Element>, feature_manager,
+                        boost::cref(elements), boost::cref(properties), start, end));
+            start = end;
+        }
+        threads.join_all();
+    } else {
+        deserialize_feature_range(feature_manager, elements, properties, 0, elements.size());
+    }
+}
+
 struct BuildOptions
 {
-    BuildOptions(int argc, char** argv) : dumpgraph(false)
+    BuildOptions(int argc, char** argv) : dumpgraph(false), dvid_workers(4), num_threads(1)
     {
         OptionParser parser("Program that builds graph over defined region");
 
@@ -46,6 +160,11 @@ struct BuildOptions
         parser.add_option(classifier_filename, "classifier-file",
                 "opencv or vigra agglomeration classifier (should end in h5)", false, true); 
 
+        parser.add_option(dvid_workers, "dvid-workers",
+                "Number of concurrent connections used to retrieve body neighbors from DVID");
+        parser.add_option(num_threads, "num-threads",
+                "Number of threads used to deserialize features");
+
         // dump simple graph (no locations or synapse information) -- for debugging purposes
         parser.add_option(dumpgraph, "dumpfile", "Dump graph prob file");
 
@@ -61,6 +180,8 @@ struct BuildOptions
     int num_channels;
 
     bool dumpgraph;
+    int dvid_workers;
+    int num_threads;
 };
 
 
@@ -83,35 +204,64 @@ void run_graph_prob(BuildOptions& options)
         fin.close();
         
         Json::Value body_list = json_data["body-list"];
-        
-        Rag_t* rag = new Rag_t;
 
-        // build RAG from body list (get neighbors) -- put in RAG IO??
+        // ignore duplicate bodies
+        vector<Node_t> bodies;
+        unordered_set<Node_t> body_set;
         for (unsigned int i = 0; i < body_list.size(); ++i) {
-            Node_t node = body_list[i].asUInt();    
+            Node_t node = dvid_node_id(body_list[i].asLargestUInt());
+            if (body_set.insert(node).second) {
+                bodies.push_back(node);
+            }
+        }
+
+        // retrieve the neighbors of all bodies over concurrent connections
+        vector<libdvid::Graph> subgraphs(bodies.size());
+        {
+            vector<boost::shared_ptr<libdvid::DVIDNodeService> > services;
+            for (int i = 0; i < std::max(options.dvid_workers, 1); ++i) {
+                services.push_back(boost::shared_ptr<libdvid::DVIDNodeService>(
+                    new libdvid::DVIDNodeService(options.dvid_servername, options.uuid)));
+            }
+            DVIDExchangeState state;
+            boost::thread_group threads;
+            for (size_t i = 0; i < services.size(); ++i) {
+                threads.create_thread(boost::bind(&fetch_neighbor_subgraphs, services[i].get(),
+                            boost::cref(options.graph_name), boost::cref(bodies),
+                            boost::ref(subgraphs), &state));
+            }
+            threads.join_all();
+            if (state.failed) {
+                throw ErrMsg("Retrieving body neighbors failed: " + state.error);
+            }
+        }
         
-            // get vertex and edge weight 
-            libdvid::Graph subgraph;
-            dvid_node.get_vertex_neighbors(options.graph_name, libdvid::Vertex(node), subgraph);
-            
+        Rag_t* rag = new Rag_t;
+
+        // build RAG from body neighbors -- put in RAG IO??
+        for (size_t i = 0; i < subgraphs.size(); ++i) {
+            libdvid::Graph& subgraph = subgraphs[i];
+
             // load graph and weight
             for (int j = 0; j < subgraph.vertices.size(); ++j) {
-                RagNode_t* rag_node = rag->find_rag_node(Node_t(subgraph.vertices[j].id));
-                if (!(rag->find_rag_node(subgraph.vertices[j].id))) {
-                    rag_node = rag->insert_rag_node(subgraph.vertices[j].id);
+                Node_t node = dvid_node_id(subgraph.vertices[j].id);
+                if (!(rag->find_rag_node(node))) {
+                    RagNode_t* rag_node = rag->insert_rag_node(node);
                     rag_node->set_size((unsigned long long)(subgraph.vertices[j].weight));
                 }
             }
             for (int j = 0; j < subgraph.edges.size(); ++j) {
-                if (!(rag->find_rag_edge(subgraph.edges[j].id1,
-                        subgraph.edges[j].id2))) {
-                    RagNode_t* rag_node1 = rag->find_rag_node(Node_t(subgraph.edges[j].id1));
-                    RagNode_t* rag_node2 = rag->find_rag_node(Node_t(subgraph.edges[j].id2));
+                Node_t node1 = dvid_node_id(subgraph.edges[j].id1);
+                Node_t node2 = dvid_node_id(subgraph.edges[j].id2);
+                if (!(rag->find_rag_edge(node1, node2))) {
+                    RagNode_t* rag_node1 = rag->find_rag_node(node1);
+                    RagNode_t* rag_node2 = rag->find_rag_node(node2);
                     RagEdge_t* rag_edge = rag->insert_rag_edge(rag_node1, rag_node2);
                     rag_edge->set_size((unsigned long long)(subgraph.edges[j].weight));
                 }
             }
         }
+        vector<libdvid::Graph>().swap(subgraphs);
 
         // how to dynamically read the number of channels? 
         FeatureMgrPtr feature_manager(new FeatureMgr(options.num_channels));
@@ -131,15 +281,19 @@ void run_graph_prob(BuildOptions& options)
        
         // create vertex list
         vector<libdvid::Vertex> vertices;
+        vector<RagNode_t*> rag_nodes;
         for (Rag_t::nodes_iterator iter = rag->nodes_begin(); iter != rag->nodes_end(); ++iter) {
             vertices.push_back(libdvid::Vertex((*iter)->get_node_id(), (*iter)->get_size()));
+            rag_nodes.push_back(*iter);
         }
 
         // create edge list
         vector<libdvid::Edge> edges;
+        vector<RagEdge_t*> rag_edges;
         for (Rag_t::edges_iterator iter = rag->edges_begin(); iter != rag->edges_end(); ++iter) {
             edges.push_back(libdvid::Edge((*iter)->get_node1()->get_node_id(),
                         (*iter)->get_node2()->get_node_id(), (*iter)->get_size()));
+            rag_edges.push_back(*iter);
         }
 
         // get vertex features 
@@ -148,42 +302,35 @@ void run_graph_prob(BuildOptions& options)
 
         // retrieve vertex properties
         dvid_node.get_properties(options.graph_name, vertices, PROPERTY_KEY, properties, transaction_ids);
-
-        // update properties
-        for (int i = 0; i < vertices.size(); ++i) {
-            RagNode_t* node = rag->find_rag_node(vertices[i].id);
-            assert((properties[i]->get_data().length() > 0));
-            
-            feature_manager->deserialize_features((char*) properties[i]->get_raw(), node);
-        } 
+        deserialize_features(feature_manager, rag_nodes, properties, options.num_threads);
         properties.clear();
         transaction_ids.clear();    
 
-        // retrieve vertex properties
+        // retrieve edge properties
         dvid_node.get_properties(options.graph_name, edges, PROPERTY_KEY, properties, transaction_ids);
-
-        // update properties
-        for (int i = 0; i < edges.size(); ++i) {
-            RagEdge_t* edge = rag->find_rag_edge(edges[i].id1, edges[i].id2);
-            assert((properties[i]->get_data().length() > 0));
-
-            feature_manager->deserialize_features((char*) properties[i]->get_raw(), edge);
-        } 
+        deserialize_features(feature_manager, rag_edges, properties, options.num_threads);
+
+        // score all edges with batched classifier calls; the features do
+        // not change between retries so edges are only scored once
+        vector<double> probs;
+        feature_manager->get_probs(rag_edges, probs);
+        unordered_map<OrderedPair, double, OrderedPair> edge_probs;
+        for (size_t i = 0; i < rag_edges.size(); ++i) {
+            rag_edges[i]->set_weight(probs[i]);
+            edge_probs[OrderedPair(Node_t(edges[i].id1), Node_t(edges[i].id2))] = probs[i];
+        }
 
         // can reuse transaction ids from before
         do {
             properties.clear();
-            // get / put probability for each edge
+            // put probability for each edge
             for (int i = 0; i < edges.size(); ++i) {
-                // calc prob
-                RagEdge_t* edge = rag->find_rag_edge(edges[i].id1, edges[i].id2);
-                double prob = feature_manager->get_prob(edge); 
-                edge->set_weight(prob);
+                double prob = edge_probs[OrderedPair(Node_t(edges[i].id1), Node_t(edges[i].id2))];
                 properties.push_back( 
                         libdvid::BinaryData::create_binary_data((char*)(&prob), sizeof(double))); 
             }
 
-            // set vertex properties
+            // set edge properties
             vector<libdvid::Edge> leftover_edges;
             dvid_node.set_properties(options.graph_name, edges, PROB_KEY, properties,
                     transaction_ids, leftover_edges); 
@@ -191,6 +338,7 @@ void run_graph_prob(BuildOptions& options)
 
             transaction_ids.clear();
             if (!edges.empty()) {
+                properties.clear();
                 dvid_node.get_properties(options.graph_name, edges, PROB_KEY, properties, transaction_ids);
             }
         } while(!edges.empty());
@@ -0,0 +1,452 @@
+/*!
+ * Measures the throughput of the main stages of the segmentation
+ * pipeline (graph construction, feature computation, agglomeration,
+ * inclusion removal, and VI computation) on a synthetic supervoxel
+ * volume.  The volume is a jittered Voronoi partition whose boundary
+ * prediction is high where two supervoxels meet, so no input data is
+ * needed and runs with the same options are directly comparable.
+ * Results are written as json.
+ *
+ * \author Stephen Plaza (plaza.stephen@gmail.com)
+*/
+
+#include <FeatureManager/FeatureMgr.h>
+#include <BioPriors/BioStack.h>
+#include <BioPriors/StackAgglomAlgs.h>
+#include <Classifier/vigraRFclassifier.h>
+#include <Classifier/opencvRFclassifier.h>
+
+#include <Utilities/OptionParser.h>
+#include <Utilities/ErrMsg.h>
+
+#include <json/json.h>
+#include <json/value.h>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <sys/resource.h>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+using namespace NeuroProof;
+
+using std::cout; using std::endl;
+using std::string;
+using std::vector;
+using namespace boost::algorithm;
+
+struct BenchmarkOptions
+{
+    BenchmarkOptions(int argc, char** argv) : output_filename("benchmark.json"),
+        xsize(256), ysize(256), zsize(64), supervoxel_size(1000), num_channels(3),
+        gt_scale(3), classifier_filename(""), threshold(0.2), num_threads(1),
+        repeat(1), seed(1)
+    {
+        OptionParser parser("Program that times graph construction, feature computation, agglomeration, and VI computation on a synthetic supervoxel volume");
+
+        // optional arguments
+        parser.add_option(output_filename, "output-file",
+                "json file that will contain the timing results");
+        parser.add_option(xsize, "xsize", "x dimension of the synthetic volume");
+        parser.add_option(ysize, "ysize", "y dimension of the synthetic volume");
+        parser.add_option(zsize, "zsize", "z dimension of the synthetic volume");
+        parser.add_option(supervoxel_size, "supervoxel-size",
+                "average number of voxels in each synthetic supervoxel");
+        parser.add_option(num_channels, "num-channels",
+                "number of prediction channels (the first is the boundary channel)");
+        parser.add_option(gt_scale, "gt-scale",
+                "number of supervoxels along each dimension combined into one ground truth body");
+        parser.add_option(classifier_filename, "classifier-file",
+                "opencv or vigra agglomeration classifier trained on num-channels channels (the overlap function is used if not specified)");
+        parser.add_option(threshold, "threshold",
+                "agglomeration threshold");
+        parser.add_option(num_threads, "num-threads",
+                "number of threads used by the stack");
+        parser.add_option(repeat, "repeat",
+                "number of times each stage is run (the fastest run is reported)");
+        parser.add_option(seed, "seed",
+                "seed for the synthetic volume");
+
+        parser.parse_options(argc, argv);
+    }
+
+    string output_filename;
+    int xsize;
+    int ysize;
+    int zsize;
+    int supervoxel_size;
+    int num_channels;
+    int gt_scale;
+    string classifier_filename;
+    double threshold;
+    int num_threads;
+    int repeat;
+    int seed;
+};
+
+//! synthetic supervoxels, ground truth and predictions
+struct SyntheticVolume
+{
+    VolumeLabelPtr labels;
+    VolumeLabelPtr gt_labels;
+    vector<VolumeProbPtr> prob_list;
+};
+
+/*!
+ * Creates a jittered Voronoi partition of the volume with one seed per
+ * grid cell.  Ground truth bodies are blocks of gt_scale^3 cells.
+ * \param options benchmark options
+ * \param volume synthetic volume to be filled
+*/
+void create_synthetic_volume(BenchmarkOptions& options, SyntheticVolume& volume)
+{
+    int cell = std::max(int(std::cbrt(double(options.supervoxel_size)) + 0.5), 1);
+    int ncx = (options.xsize + cell - 1) / cell;
+    int ncy = (options.ysize + cell - 1) / cell;
+    int ncz = (options.zsize + cell - 1) / cell;
+    int gt_scale = std::max(options.gt_scale, 1);
+    int ngx = (ncx + gt_scale - 1) / gt_scale;
+    int ngy = (ncy + gt_scale - 1) / gt_scale;
+
+    std::mt19937 rng(options.seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    // one seed per cell
+    vector<double> seeds(size_t(ncx) * ncy * ncz * 3);
+    for (int cz = 0; cz < ncz; ++cz) {
+        for (int cy = 0; cy < ncy; ++cy) {
+            for (int cx = 0; cx < ncx; ++cx) {
+                size_t pos = (size_t(cz) * ncy * ncx + cy * ncx + cx) * 3;
+                seeds[pos] = (cx + uniform(rng)) * cell;
+                seeds[pos+1] = (cy + uniform(rng)) * cell;
+                seeds[pos+2] = (cz + uniform(rng)) * cell;
+            }
+        }
+    }
+
+    // fixed per-supervoxel value for each non-boundary channel
+    vector<double> label_vals(size_t(ncx) * ncy * ncz * options.num_channels);
+    for (size_t i = 0; i < label_vals.size(); ++i) {
+        label_vals[i] = uniform(rng);
+    }
+
+    volume.labels = VolumeLabelData::create_volume(options.xsize, options.ysize, options.zsize);
+    volume.gt_labels = VolumeLabelData::create_volume(options.xsize, options.ysize, options.zsize);
+    volume.prob_list.clear();
+    for (int ch = 0; ch < options.num_channels; ++ch) {
+        VolumeProbPtr prob = VolumeProb::create_volume();
+        prob->reshape(vigra::MultiArrayShape<3>::type(options.xsize,
+                    options.ysize, options.zsize));
+        volume.prob_list.push_back(prob);
+    }
+
+    volume_forXYZ(*(volume.labels), x, y, z) {
+        int cx = x / cell, cy = y / cell, cz = z / cell;
+
+        // find the closest and second closest seed in the neighboring cells
+        double best_dist = 1e30, second_dist = 1e30;
+        int best_cx = cx, best_cy = cy, best_cz = cz;
+        for (int nz = std::max(cz-1, 0); nz <= std::min(cz+1, ncz-1); ++nz) {
+            for (int ny = std::max(cy-1, 0); ny <= std::min(cy+1, ncy-1); ++ny) {
+                for (int nx = std::max(cx-1, 0); nx <= std::min(cx+1, ncx-1); ++nx) {
+                    size_t pos = (size_t(nz) * ncy * ncx + ny * ncx + nx) * 3;
+                    double dx = x + 0.5 - seeds[pos];
+                    double dy = y + 0.5 - seeds[pos+1];
+                    double dz = z + 0.5 - seeds[pos+2];
+                    double dist = dx*dx + dy*dy + dz*dz;
+                    if (dist < best_dist) {
+                        second_dist = best_dist;
+                        best_dist = dist;
+                        best_cx = nx; best_cy = ny; best_cz = nz;
+                    } else if (dist < second_dist) {
+                        second_dist = dist;
+                    }
+                }
+            }
+        }
+
+        size_t cell_id = size_t(best_cz) * ncy * ncx + best_cy * ncx + best_cx;
+        volume.labels->set(x, y, z, Label_t(cell_id + 1));
+        volume.gt_labels->set(x, y, z, Label_t((best_cz / gt_scale) * ngy * ngx +
+            (best_cy / gt_scale) * ngx + (best_cx / gt_scale) + 1));
+
+        // boundary probability decays away from the supervoxel border
+        double margin = std::sqrt(second_dist) - std::sqrt(best_dist);
+        double noise = 0.1 * (uniform(rng) - 0.5);
+        double boundary = std::exp(-margin) + noise;
+        (*(volume.prob_list[0]))(x,y,z) = Prob_t(std::min(std::max(boundary, 0.0), 1.0));
+
+        for (int ch = 1; ch < options.num_channels; ++ch) {
+            double val = 0.8 * label_vals[cell_id * options.num_channels + ch] +
+                0.2 * uniform(rng);
+            (*(volume.prob_list[ch]))(x,y,z) = Prob_t(val);
+        }
+    }
+}
+
+/*!
+ * Copies a label volume so that every run starts from the unmerged
+ * supervoxels.
+ * \param labels label volume
+ * \return new label volume with the same labels
+*/
+VolumeLabelPtr copy_labels(VolumeLabelPtr labels)
+{
+    VolumeLabelPtr labels_copy = VolumeLabelData::create_volume(labels->shape(0),
+            labels->shape(1), labels->shape(2));
+    volume_forXYZ(*labels, x, y, z) {
+        labels_copy->set(x, y, z, (*labels)(x,y,z));
+    }
+    return labels_copy;
+}
+
+/*!
+ * Creates a stack over a fresh copy of the synthetic volume with
+ * the basic features and optional classifier.
+ * \param volume synthetic volume
+ * \param options benchmark options
+ * \param eclfr classifier used for edge probabilities (overlap if null)
+ * \return new stack
+*/
+boost::shared_ptr<BioStack> create_stack(SyntheticVolume& volume,
+        BenchmarkOptions& options, EdgeClassifier* eclfr)
+{
+    FeatureMgrPtr feature_manager(new FeatureMgr(volume.prob_list.size()));
+    feature_manager->set_basic_features();
+    if (eclfr) {
+        feature_manager->set_classifier(eclfr);
+    } else {
+        feature_manager->set_overlap_function();
+    }
+
+    boost::shared_ptr<BioStack> stack(new BioStack(copy_labels(volume.labels)));
+    stack->set_feature_manager(feature_manager);
+    stack->set_prob_list(volume.prob_list);
+    stack->set_gt_labelvol(volume.gt_labels);
+    stack->set_num_threads(options.num_threads);
+    return stack;
+}
+
+//! wall clock time in seconds (clock() would sum all threads)
+double wall_time()
+{
+    return std::chrono::duration<double>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//! peak resident set size of the process so far in kilobytes
+long peak_rss_kb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+/*!
+ * Adds the timing for one stage to the results.  Rates are only
+ * reported for the quantities that apply to the stage.
+ * \param results json array of results
+ * \param name stage name
+ * \param seconds fastest run time of the stage
+ * \param num_voxels voxels processed (0 if not applicable)
+ * \param num_edges edges processed (0 if not applicable)
+ * \param num_merges merges performed (0 if not applicable)
+*/
+void add_result(Json::Value& results, string name, double seconds,
+        unsigned long long num_voxels, unsigned long long num_edges,
+        unsigned long long num_merges)
+{
+    Json::Value result;
+    result["stage"] = name;
+    result["seconds"] = seconds;
+    if (num_voxels) {
+        result["voxels"] = Json::UInt64(num_voxels);
+        result["voxels_per_sec"] = num_voxels / seconds;
+    }
+    if (num_edges) {
+        result["edges"] = Json::UInt64(num_edges);
+        result["edges_per_sec"] = num_edges / seconds;
+    }
+    if (num_merges) {
+        result["merges"] = Json::UInt64(num_merges);
+        result["merges_per_sec"] = num_merges / seconds;
+    }
+    results.append(result);
+
+    cout << name << ": " << seconds << " seconds" << endl;
+}
+
+/*!
+ * Runs one agglomeration mode.
+ * \param stack stack with a built graph
+ * \param mode agglomeration mode (same numbering as neuroproof_graph_predict)
+ * \param threshold agglomeration threshold
+*/
+void run_agglomeration(Stack& stack, int mode, double threshold)
+{
+    switch (mode) {
+        case 0: agglomerate_stack_flat(stack, threshold, false); break;
+        case 1: agglomerate_stack(stack, threshold, false); break;
+        case 2: agglomerate_stack_mrf(stack, threshold, false); break;
+        case 3: agglomerate_stack_queue(stack, threshold, false); break;
+        case 5: agglomerate_stack_indexed(stack, threshold, false); break;
+        default: throw ErrMsg("Illegal agglomeration type specified");
+    }
+}
+
+void run_benchmark(BenchmarkOptions& options)
+{
+    if ((options.xsize <= 0) || (options.ysize <= 0) || (options.zsize <= 0) ||
+            (options.num_channels <= 0) || (options.supervoxel_size <= 0)) {
+        throw ErrMsg("Volume dimensions, channels, and supervoxel size must be positive");
+    }
+    int repeat = std::max(options.repeat, 1);
+    unsigned long long num_voxels = (unsigned long long)(options.xsize) *
+        options.ysize * options.zsize;
+
+    Json::Value json_writer;
+    Json::Value config;
+    config["xsize"] = options.xsize;
+    config["ysize"] = options.ysize;
+    config["zsize"] = options.zsize;
+    config["supervoxel_size"] = options.supervoxel_size;
+    config["num_channels"] = options.num_channels;
+    config["gt_scale"] = options.gt_scale;
+    config["classifier_file"] = options.classifier_filename;
+    config["threshold"] = options.threshold;
+    config["num_threads"] = options.num_threads;
+    config["repeat"] = repeat;
+    config["seed"] = options.seed;
+    json_writer["config"] = config;
+    Json::Value& results = json_writer["results"];
+
+    EdgeClassifier* eclfr = 0;
+    if (ends_with(options.classifier_filename, ".h5")) {
+        eclfr = new VigraRFclassifier(options.classifier_filename.c_str());
+    } else if (ends_with(options.classifier_filename, ".xml")) {
+        eclfr = new OpencvRFclassifier(options.classifier_filename.c_str());
+    }
+
+    cout << "Creating synthetic volume ..." << endl;
+    SyntheticVolume volume;
+    double start = wall_time();
+    create_synthetic_volume(options, volume);
+    add_result(results, "create_volume", wall_time() - start, num_voxels, 0, 0);
+
+    // graph construction
+    double best_time = 0.0;
+    unsigned long long num_edges = 0;
+    unsigned long long num_labels = 0;
+    boost::shared_ptr<BioStack> stack;
+    for (int i = 0; i < repeat; ++i) {
+        stack = create_stack(volume, options, eclfr);
+        start = wall_time();
+        stack->build_rag();
+        double elapsed = wall_time() - start;
+        if (!i || (elapsed < best_time)) {
+            best_time = elapsed;
+        }
+    }
+    num_edges = stack->get_rag()->get_num_edges();
+    num_labels = stack->get_num_labels();
+    add_result(results, "build_rag", best_time, num_voxels, num_edges, 0);
+    json_writer["num_supervoxels"] = Json::UInt64(num_labels);
+    json_writer["num_edges"] = Json::UInt64(num_edges);
+
+    // edge feature computation on the graph just built
+    RagPtr rag = stack->get_rag();
+    FeatureMgrPtr feature_manager = stack->get_feature_manager();
+    vector<double> features;
+    for (int i = 0; i < repeat; ++i) {
+        start = wall_time();
+        for (Rag_t::edges_iterator iter = rag->edges_begin(); iter != rag->edges_end(); ++iter) {
+            features.clear();
+            feature_manager->compute_all_features(*iter, features);
+        }
+        double elapsed = wall_time() - start;
+        if (!i || (elapsed < best_time)) {
+            best_time = elapsed;
+        }
+    }
+    add_result(results, "compute_all_features", best_time, 0, num_edges, 0);
+
+    // vi between the supervoxels and the ground truth
+    double merge = 0.0, split = 0.0;
+    for (int i = 0; i < repeat; ++i) {
+        start = wall_time();
+        stack->compute_vi(merge, split);
+        double elapsed = wall_time() - start;
+        if (!i || (elapsed < best_time)) {
+            best_time = elapsed;
+        }
+    }
+    add_result(results, "compute_vi", best_time, num_voxels, 0, 0);
+
+    // inclusion removal on the initial graph
+    unsigned long long num_merges = 0;
+    for (int i = 0; i < repeat; ++i) {
+        stack = create_stack(volume, options, eclfr);
+        stack->build_rag();
+        start = wall_time();
+        stack->remove_inclusions();
+        double elapsed = wall_time() - start;
+        if (!i || (elapsed < best_time)) {
+            best_time = elapsed;
+        }
+        num_merges = num_labels - stack->get_num_labels();
+    }
+    add_result(results, "remove_inclusions", best_time, 0, 0, num_merges);
+
+    // every agglomeration mode starts from the same graph
+    const int num_modes = 5;
+    const int modes[num_modes] = {0, 1, 2, 3, 5};
+    const char* mode_names[num_modes] = {"agglomerate_stack_flat", "agglomerate_stack",
+        "agglomerate_stack_mrf", "agglomerate_stack_queue", "agglomerate_stack_indexed"};
+    for (int m = 0; m < num_modes; ++m) {
+        for (int i = 0; i < repeat; ++i) {
+            stack = create_stack(volume, options, eclfr);
+            stack->build_rag();
+            start = wall_time();
+            run_agglomeration(*stack, modes[m], options.threshold);
+            double elapsed = wall_time() - start;
+            if (!i || (elapsed < best_time)) {
+                best_time = elapsed;
+            }
+            num_merges = num_labels - stack->get_num_labels();
+        }
+        add_result(results, mode_names[m], best_time, 0, num_edges, num_merges);
+    }
+    stack.reset();
+
+    // the peak only grows, so it is reported once for the whole run
+    json_writer["peak_rss_kb"] = Json::Int64(peak_rss_kb());
+
+    std::ofstream fout(options.output_filename.c_str());
+    if (!fout) {
+        throw ErrMsg("Error: output file could not be opened");
+    }
+    fout << json_writer;
+    fout.close();
+
+    delete eclfr;
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options(argc, argv);
+
+    try {
+        run_benchmark(options);
+    } catch (ErrMsg& err) {
+        cout << err.str << endl;
+        return -1;
+    }
+
+    return 0;
+}
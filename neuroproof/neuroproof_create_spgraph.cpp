@@ -19,6 +19,7 @@
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <iostream>
+#include <limits>
 
 using namespace NeuroProof;
 
@@ -32,6 +33,14 @@ using std::ofstream;
 static const char * SEG_DATASET_NAME = "stack";
 static const char * PRED_DATASET_NAME = "volume/predictions";
 
+// superpixel ids are offset by the plane times the stride (Raveler uses
+// 200,000 which is kept for 32-bit labels)
+#ifdef NEUROPROOF_64BIT_LABELS
+static const Label_t PLANE_STRIDE = Label_t(1) << 32;
+#else
+static const Label_t PLANE_STRIDE = 200000;
+#endif
+
 /*!
  * Options for creating a graph for use in the Raveler tool
 */
@@ -91,12 +100,16 @@ void generate_sp_graph(SpOptions& options)
     FeatureMgrPtr feature_manager2(new FeatureMgr(prob_list.size()));
     feature_manager2->add_median_feature(); 
 
-    // map supervoxel ids to superpixel ids
-    // maximum allowable plane ID 200,000; maxium number of planes, 10,000!!
+    // map supervoxel ids to superpixel ids (zpos*PLANE_STRIDE + label)
+    Label_t max_zpos = std::numeric_limits<Label_t>::max() / PLANE_STRIDE - 1;
     volume_forXYZ((*raveler_labels), x, y, z) {
-        if ((*raveler_labels)(x,y,z) != 0) {
-            unsigned int zpos = z + options.start_plane;
-            raveler_labels->set(x, y, z, (zpos*200000) + (*raveler_labels)(x,y,z));
+        Label_t label = (*raveler_labels)(x,y,z);
+        if (label != 0) {
+            Label_t zpos = z + options.start_plane;
+            if ((label >= PLANE_STRIDE) || (zpos > max_zpos)) {
+                throw ErrMsg("Superpixel ids do not fit in the label type (build with NEUROPROOF_64BIT_LABELS)");
+            }
+            raveler_labels->set(x, y, z, (zpos*PLANE_STRIDE) + label);
         } 
     }
 
@@ -111,17 +124,21 @@ void generate_sp_graph(SpOptions& options)
   
     RagPtr rag = stack2.get_rag();
     
+    vector<RagEdge_t*> edges(rag->edges_begin(), rag->edges_end());
+    vector<double> probs;
+    feature_manager2->get_probs(edges, probs);
+    for (unsigned int i = 0; i < edges.size(); ++i) {
+        edges[i]->set_weight(probs[i]);
+    }
+
     // set the weight to edges within the superpixel set to -1 
     for (Rag_t::edges_iterator iter = rag->edges_begin();
             iter != rag->edges_end(); ++iter) {
-        double val = feature_manager2->get_prob((*iter));
-        (*iter)->set_weight(val);
-
         Node_t node1 = (*iter)->get_node1()->get_node_id();
         Node_t node2 = (*iter)->get_node2()->get_node_id();
 
-        node1 = node1 % 200000; 
-        node2 = node2 % 200000;
+        node1 = node1 % PLANE_STRIDE; 
+        node2 = node2 % PLANE_STRIDE;
         if (node1 == node2) {
             (*iter)->set_weight(-1.0);
         } 
@@ -152,7 +169,12 @@ int main(int argc, char** argv)
     SpOptions options(argc, argv);
     ScopeTime timer;
 
-    generate_sp_graph(options);
+    try {
+        generate_sp_graph(options);
+    } catch (ErrMsg& err) {
+        cerr << err.str << endl;
+        return 1;
+    }
 
     return 0;
 }
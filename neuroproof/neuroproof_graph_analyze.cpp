@@ -61,7 +61,7 @@ using std::exception;
  * \param num_threads reference to number of threads to run GPR
  * \param node_threshold reference to threshold of node size uncertainty below which is ignored
  * \param synapse_threshold reference to threshold of synapse size uncertainty below which is ignored
- * \param graph_file reference to graph file in json format
+ * \param graph_file reference to graph file in json or binary format
  * \param random_seed random seed
  * \param calc_gpr enable gpr calculation (default false)
  * \param est_edit_distance enable edit distance calculation (default false) 
@@ -83,26 +83,19 @@ void parse_options(int argc, char** argv, int& num_threads,
             "Size threshold below which errors are considered insignificant"); 
     parser.add_option(node_threshold, "synapse-size-threshold",
             "Size threshold based on the number of synapse in the node below which are considered insignificant");
-    parser.add_positional(graph_file, "graph-file", "graph file"); 
+    parser.add_positional(graph_file, "graph-file", "graph file (json or binary .npgraph)"); 
     parser.add_option(random_seed, "random-seed", "Set seed for random computation", true, false, true);
     parser.parse_options(argc, argv);
 }
 
 /*!
  * Helper function to create RAG from graph json (should be a constructor)
- * \param graph_file file in json format that contains graph
+ * \param graph_file file in json or binary format that contains graph
  * \return a pointer to a RAG
 */ 
 Rag_t* read_graph(string graph_file, Json::Value& json_vals)
 {
-    ifstream fin(graph_file.c_str());
-    Json::Reader json_reader;
-    if (!json_reader.parse(fin, json_vals)) {
-        throw ErrMsg("Error: Json incorrectly formatted");
-    }
-    fin.close();
-
-    Rag_t* rag = create_rag_from_json(json_vals);
+    Rag_t* rag = create_rag_from_graphfile(graph_file.c_str(), json_vals);
     if (!rag) {
         throw ErrMsg("Rag could not be created");
     }
@@ -99,7 +99,7 @@ struct AnalyzeGTOptions
     dump_split_merge_bodies(false), dump_orphans(false), vi_threshold(0.02), synapse_filename(""),
     clear_synapse_exclusions(false), body_error_size(25000), synapse_error_size(1),
     graph_filename(""), callback_uri(""), exclusions_filename(""), recipe_filename(""),
-    min_filter_size(0), random_seed(1) 
+    min_filter_size(0), num_threads(1), random_seed(1) 
     {
         OptionParser parser("Program analyzes a segmentation graph with respect to ground truth");
 
@@ -129,7 +129,7 @@ struct AnalyzeGTOptions
         parser.add_option(synapse_error_size, "synapse-error-size",
                 "Threshold above which synapse errors are analyzed"); 
         parser.add_option(graph_filename, "graph-file",
-                "json file that sets edge probabilities (default is optimal) and synapse constraints"); 
+                "json or binary (.npgraph) graph file that sets edge probabilities (default is optimal) and synapse constraints"); 
         parser.add_option(exclusions_filename, "exclusions-file",
                 "json file that specifies bodies to ignore during VI"); 
         parser.add_option(recipe_filename, "recipe-file",
@@ -138,6 +138,8 @@ struct AnalyzeGTOptions
                 "body size filter below which bodies are ignored in VI computation -- should not run with synapse VI"); 
         parser.add_option(callback_uri, "callback-uri",
                 "URI to post JSON results"); 
+        parser.add_option(num_threads, "num-threads",
+                "number of threads used to compute region overlaps with ground truth"); 
     
         // invisible arguments
         parser.add_option(random_seed, "random-seed",
@@ -201,6 +203,9 @@ struct AnalyzeGTOptions
    
     //! body size below which is ignored
     unsigned long long min_filter_size;
+
+    //! number of threads used to build the contingency table
+    int num_threads;
     
     // hidden option (with default value)
     int random_seed;
@@ -533,22 +538,17 @@ void dump_differences(BioStack& stack, Stack& synapse_stack,
     }
 
     // find pairs of large bodies that are not merged together but should be
-    int num_unmerged = 0;
-    Json::Value json_vals;
-    //EdgeEditor<Label_t> temp_scheduler(*seg_rag, 0.1, 0.9, 0.1, json_vals);
+    // (bodies assigned to the same ground truth body form such pairs
+    // with every large body assigned to it before them)
+    unsigned long long num_unmerged = 0;
+    unordered_map<Label_t, unsigned long long> gt_body_counts;
     for (int i = 0; i < large_bodies.size(); ++i) {
-        for (int j = (i+1); j < large_bodies.size(); ++j) {
-            int val = stack.find_edge_label(large_bodies[i]->get_node_id(),
-                    large_bodies[j]->get_node_id());
-
-            if (val == -1) {
-                ++num_unmerged;
-                /*double pathprob = temp_scheduler.find_path(large_bodies[i], large_bodies[j]);
-                cout << "prob: " << pathprob << " between " <<
-                    large_bodies[i]->get_size() << " and " <<
-                    large_bodies[j]->get_size() << endl; */
-            }
+        Label_t label = large_bodies[i]->get_node_id();
+        Label_t label_gt = stack.get_groundtruth_assignment(label);
+        if (!label_gt) {
+            cerr << "no grountruth node " << label << endl;
         }
+        num_unmerged += gt_body_counts[label_gt]++;
     }
    
     // TODO: should really print distribution of bodies unmerged at different
@@ -561,50 +561,11 @@ void dump_differences(BioStack& stack, Stack& synapse_stack,
 
     std::unordered_map<Label_t, unsigned long long> body_changes;
     Rag_t opt_rag_copy(*opt_rag);
-
-    bool change = true;
     LowWeightCombine join_alg;
 
-    // optimally merge rag and keep track of biggest change
-    while (change) {
-        change = false;
-        for (Rag_t::edges_iterator iter = opt_rag_copy.edges_begin();
-                iter != opt_rag_copy.edges_end(); ++iter) {
-            double weight = (*iter)->get_weight();
-            if (weight < 0.0001) {
-                RagNode_t* node1 = (*iter)->get_node1();
-                RagNode_t* node2 = (*iter)->get_node2();
-
-                unsigned long long large1 = node1->get_size();
-                unsigned long long large2 = node2->get_size();
-                if (body_changes.find(node1->get_node_id()) != body_changes.end()) {
-                    large1 = body_changes[node1->get_node_id()];
-                }
-                if (body_changes.find(node2->get_node_id()) != body_changes.end()) {
-                    large2 = body_changes[node2->get_node_id()];
-                }
-                RagNode_t* node_keep;
-                RagNode_t* node_remove;
-                if (large1 > large2) {
-                    body_changes[node1->get_node_id()] = large1;
-                    node_keep = node1;
-                    node_remove = node2;
-                    body_changes.erase(node2->get_node_id());
-                } else {
-                    body_changes[node2->get_node_id()] = large2;
-                    node_keep = node2;
-                    node_remove = node1;
-                    body_changes.erase(node1->get_node_id());
-                }
-
-                vector<string> property_names;
-                rag_join_nodes(opt_rag_copy, node_keep, node_remove, &join_alg); 
-
-                change = true;
-                break;
-            }
-        }
-    }
+    // optimally merge rag and keep track of the largest original body
+    // of each merged body
+    rag_merge_low_weight_edges(opt_rag_copy, 0.0001, &join_alg, body_changes);
 
     // determine bodies whose total body size is much greater than its
     // largest original component
@@ -1089,6 +1050,7 @@ void run_analyze_gt(AnalyzeGTOptions& options)
     // create seg stack
     BioStack stack(seg_labels);
     stack.set_gt_labelvol(gt_labels);
+    stack.set_num_threads(options.num_threads);
     stack.Stack::build_rag();
     cout << "Built seg RAG" << endl;
     stack.compute_groundtruth_assignment();
@@ -1099,7 +1061,7 @@ void run_analyze_gt(AnalyzeGTOptions& options)
     if (options.graph_filename != "") {
         // TODO: rag utility that implements prob load from file
         // use previously generated probs
-        RagPtr seg_rag_probs = RagPtr(create_rag_from_jsonfile(options.graph_filename.c_str())); 
+        RagPtr seg_rag_probs = RagPtr(create_rag_from_graphfile(options.graph_filename.c_str())); 
         if (!seg_rag_probs) {
             throw ErrMsg("Problem processing graph file");
         }
@@ -1296,6 +1258,7 @@ void run_analyze_gt(AnalyzeGTOptions& options)
     // set synapse exclusions and create synapse stack for VI comparisons 
     VolumeLabelPtr tptr;
     Stack synapse_stack(tptr);
+    synapse_stack.set_num_threads(options.num_threads);
     if (options.synapse_filename != "") {
         stack.set_synapse_exclusions(options.synapse_filename.c_str());
         gt_stack.set_synapse_exclusions(options.synapse_filename.c_str());
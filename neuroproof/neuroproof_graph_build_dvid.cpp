@@ -4,12 +4,16 @@
 #include <Utilities/OptionParser.h>
 #include <IO/RagIO.h>
 #include <IO/StackIO.h>
+#include <IO/DVIDPropertyExchange.h>
+#include <Utilities/AffinityPair.h>
 
 #include <libdvid/DVIDNodeService.h>
 #include <Classifier/vigraRFclassifier.h>
 #include <Classifier/opencvRFclassifier.h>
 
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/bind.hpp>
 #include <iostream>
 
 using namespace NeuroProof;
@@ -116,11 +120,29 @@ void set_synapse_exclusions(BioStack& stack, const char* synapse_json,
     stack.set_synapse_exclusions(synapse_locations);
 }
 
+// merge features stored in DVID for a vertex with its local features
+static void merge_vertex_features(FeatureMgrPtr feature_manager,
+        const unordered_map<Node_t, RagNode_t*>& nodes, const libdvid::Vertex& vertex,
+        char* current_features, string& buffer)
+{
+    RagNode_t* node = nodes.find(Node_t(vertex.id))->second;
+    feature_manager->serialize_features(current_features, node, buffer);
+}
+
+// merge features stored in DVID for an edge with its local features
+static void merge_edge_features(FeatureMgrPtr feature_manager,
+        const unordered_map<OrderedPair, RagEdge_t*, OrderedPair>& rag_edges,
+        const libdvid::Edge& edge, char* current_features, string& buffer)
+{
+    RagEdge_t* rag_edge = rag_edges.find(OrderedPair(Node_t(edge.id1), Node_t(edge.id2)))->second;
+    feature_manager->serialize_features(current_features, rag_edge, buffer);
+}
 
 struct BuildOptions
 {
     BuildOptions(int argc, char** argv) : x(0), y(0), z(0), xsize(0), ysize(0),
-        zsize(0), dvidgraph_load_saved(false), dvidgraph_update(true), dumpgraph(false)
+        zsize(0), dvidgraph_load_saved(false), dvidgraph_update(true), dumpgraph(false),
+        dvid_workers(4), dvid_batch_size(1000)
     {
         OptionParser parser("Program that builds graph over defined region");
 
@@ -153,6 +175,10 @@ struct BuildOptions
         parser.add_option(dvidgraph_load_saved, "dvidgraph-load-saved",
                 "This option will load graph probabilities and sizes saved (synapse file, predictions, and classifier should not be specified and dvigraph-update will be set false");
         parser.add_option(dvidgraph_update, "dvidgraph-update", "Enable the writing of features and graph information to DVID");
+        parser.add_option(dvid_workers, "dvid-workers",
+                "Number of concurrent connections used to exchange features with DVID");
+        parser.add_option(dvid_batch_size, "dvid-batch-size",
+                "Number of vertices or edges whose features are exchanged with DVID together");
 
         parser.add_option(synapse_filename, "synapse-file",
                 "Synapse file in JSON format should be based on global DVID coordinates.  Synapses outside of the segmentation ROI will be ignored.  Synapses are not loaded into DVID.  Synapses cannot have negative coordinates even though that is possible in DVID in general.");
@@ -185,6 +211,9 @@ struct BuildOptions
     bool dumpgraph;
     bool dvidgraph_load_saved;
     bool dvidgraph_update;
+
+    int dvid_workers;
+    int dvid_batch_size;
 };
 
 
@@ -220,9 +249,12 @@ void run_graph_build(BuildOptions& options)
         VolumeLabelPtr initial_labels = VolumeLabelData::create_volume(options.xsize+2,
                 options.ysize+2, options.zsize+2);
         unsigned long long iter = 0;
-        // 64 bit numbers not currently supported!!
         volume_forXYZ(*initial_labels, x, y, z) {
-            initial_labels->set(x,y,z, (unsigned int)(ptr[iter]));
+            // 64-bit labels need NEUROPROOF_64BIT_LABELS
+            if (Label_t(ptr[iter]) != ptr[iter]) {
+                throw ErrMsg("DVID label does not fit in the label type (build with NEUROPROOF_64BIT_LABELS)");
+            }
+            initial_labels->set(x,y,z, Label_t(ptr[iter]));
             ++iter;
         }
         cout << "Read watershed" << endl;
@@ -277,67 +309,40 @@ void run_graph_build(BuildOptions& options)
 
             // update node features to the DVID graph
             if ((options.prediction_filename != "")) {
-                do {
-                    vector<libdvid::BinaryDataPtr> properties;
-                    libdvid::VertexTransactions transaction_ids; 
-
-                    // retrieve vertex properties
-                    dvid_node.get_properties(options.graph_name, vertices, PROPERTY_KEY, properties, transaction_ids);
-
-                    // update properties
-                    for (int i = 0; i < vertices.size(); ++i) {
-                        RagNode_t* node = rag->find_rag_node(vertices[i].id);
-
-                        if (node->get_size() == 0) {
-                            stack.get_feature_manager()->create_cache(node);
-                        } 
-
-                        char* curr_data = 0; 
-                        if ((properties[i]->get_data().length() > 0)) {
-                            curr_data = (char*) properties[i]->get_raw();
-                        }
-                        string modified_feature = 
-                            stack.get_feature_manager()->serialize_features(curr_data, node);
-                        properties[i] = 
-                            libdvid::BinaryData::create_binary_data(modified_feature.c_str(), modified_feature.length());
-                    } 
+                FeatureMgrPtr feature_manager = stack.get_feature_manager();
+
+                // look up rag elements before the exchange since the
+                // rag lookups are not safe to call concurrently
+                unordered_map<Node_t, RagNode_t*> nodes;
+                for (Rag_t::nodes_iterator iter = rag->nodes_begin(); iter != rag->nodes_end(); ++iter) {
+                    if ((*iter)->get_size() == 0) {
+                        feature_manager->create_cache(*iter);
+                    }
+                    nodes[(*iter)->get_node_id()] = *iter;
+                }
+                unordered_map<OrderedPair, RagEdge_t*, OrderedPair> rag_edges;
+                for (Rag_t::edges_iterator iter = rag->edges_begin(); iter != rag->edges_end(); ++iter) {
+                    rag_edges[OrderedPair((*iter)->get_node1()->get_node_id(),
+                            (*iter)->get_node2()->get_node_id())] = *iter;
+                }
 
-                    // set vertex properties
-                    vector<libdvid::Vertex> leftover_vertices;
-                    dvid_node.set_properties(options.graph_name, vertices, PROPERTY_KEY, properties,
-                            transaction_ids, leftover_vertices); 
+                // each worker needs its own connection
+                vector<boost::shared_ptr<libdvid::DVIDNodeService> > services;
+                for (int i = 0; i < std::max(options.dvid_workers, 1); ++i) {
+                    services.push_back(boost::shared_ptr<libdvid::DVIDNodeService>(
+                        new libdvid::DVIDNodeService(options.dvid_servername, options.uuid)));
+                }
 
-                    vertices = leftover_vertices; 
-                } while(!vertices.empty());
+                exchange_dvid_properties(services, options.graph_name, PROPERTY_KEY, vertices,
+                        DVIDPropertyMerge<libdvid::Vertex>::type(boost::bind(&merge_vertex_features,
+                                feature_manager, boost::cref(nodes), _1, _2, _3)),
+                        options.dvid_batch_size);
 
                 // update edge features to the DVID graph
-                do {
-                    vector<libdvid::BinaryDataPtr> properties;
-                    libdvid::VertexTransactions transaction_ids; 
-
-                    // retrieve vertex properties
-                    dvid_node.get_properties(options.graph_name, edges, PROPERTY_KEY, properties, transaction_ids);
-
-                    // update properties
-                    for (int i = 0; i < edges.size(); ++i) {
-                        RagEdge_t* edge = rag->find_rag_edge(edges[i].id1, edges[i].id2);
-
-                        char* curr_data = 0; 
-                        if ((properties[i]->get_data().length() > 0)) {
-                            curr_data = (char*) properties[i]->get_raw();
-                        }
-                        string modified_feature = 
-                            stack.get_feature_manager()->serialize_features(curr_data, edge);
-                        properties[i] = 
-                            libdvid::BinaryData::create_binary_data(modified_feature.c_str(), modified_feature.length()); 
-                    } 
-
-                    // set vertex properties
-                    vector<libdvid::Edge> leftover_edges;
-                    dvid_node.set_properties(options.graph_name, edges, PROPERTY_KEY, properties,
-                            transaction_ids, leftover_edges); 
-                    edges = leftover_edges; 
-                } while(!edges.empty());
+                exchange_dvid_properties(services, options.graph_name, PROPERTY_KEY, edges,
+                        DVIDPropertyMerge<libdvid::Edge>::type(boost::bind(&merge_edge_features,
+                                feature_manager, boost::cref(rag_edges), _1, _2, _3)),
+                        options.dvid_batch_size);
             }
         }
 
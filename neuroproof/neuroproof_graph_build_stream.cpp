@@ -1,9 +1,12 @@
 #include <BioPriors/BioStack.h>
 #include <FeatureManager/FeatureMgr.h>
 #include <IO/RagIO.h>
+#include <IO/LabelStreamIO.h>
 #include <Utilities/OptionParser.h>
 
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
 #include <iostream>
 
 //#include <fstream>
@@ -60,32 +63,35 @@ struct BuildOptions
 void run_graph_build(BuildOptions& options)
 {
     try {
-        // retrieve coordinates from stream
-        unsigned long long xsize,ysize,zsize;
-        char buffer[8];
-        cin.read(buffer, 8);
-        xsize = *((unsigned long long*) buffer);
-        cin.read(buffer, 8);
-        ysize = *((unsigned long long*) buffer);
-        cin.read(buffer, 8);
-        zsize = *((unsigned long long*) buffer);
-
-        // create buffer
-        VolumeLabelPtr initial_labels = VolumeLabelData::create_volume(xsize, ysize, zsize);
-        
-        // set value from stream (only 32 bit for now)
-        volume_forXYZ(*initial_labels, x, y, z) {
-            cin.read(buffer, 8);
-            unsigned long long temp_vert = *((unsigned long long*) buffer);
-            initial_labels->set(x,y,z, (unsigned int)(temp_vert));
-        }
+        // labels are read from the stream (chunked or not) in a separate
+        // thread while the RAG is built over the z-planes already read
+        LabelStreamReader reader(cin);
+        VolumeLabelPtr initial_labels = reader.get_labelvol();
+        unsigned int zsize = initial_labels->shape(2);
 
         // create stack to hold segmentation state
         BioStack stack(initial_labels); 
 
-        // make new build_rag for stack (ignore 0s, add edge on greater than,
-        // ignore 1 pixel border for vertex accum
-        stack.build_rag_batch();
+        boost::thread read_thread(boost::bind(&LabelStreamReader::read_volume, &reader));
+        try {
+            // make new build_rag for stack (ignore 0s, add edge on greater than,
+            // ignore 1 pixel border for vertex accum); a plane is added once
+            // the plane after it is read
+            unsigned int zdone = 0;
+            while (zdone < zsize) {
+                unsigned int planes_read = reader.wait_for_planes(std::min(zdone + 2, zsize));
+                unsigned int zend = (planes_read == zsize) ? zsize : (planes_read - 1);
+                stack.build_rag_batch(zdone, zend);
+                zdone = zend;
+            }
+        } catch (...) {
+            read_thread.join();
+            throw;
+        }
+        read_thread.join();
+        if (!stack.get_rag()) {
+            stack.build_rag_batch();
+        }
             
         RagPtr rag = stack.get_rag();
        
@@ -102,7 +108,7 @@ void run_graph_build(BuildOptions& options)
         *ptr = (unsigned long long)(num_vertices);
         ++ptr;
         for (Rag_t::nodes_iterator iter = rag->nodes_begin(); iter != rag->nodes_end(); ++iter) {
-            *ptr = (unsigned long long)((*iter)->get_node_id());
+            *ptr = reader.get_label((*iter)->get_node_id());
             ++ptr;
             double *temp = (double*) ptr;
             *temp = ((*iter)->get_size());
@@ -115,9 +121,9 @@ void run_graph_build(BuildOptions& options)
         *ptr = (unsigned long long)(num_edges);
         ptr++;
         for (Rag_t::edges_iterator iter = rag->edges_begin(); iter != rag->edges_end(); ++iter) {
-            *ptr = (unsigned long long)((*iter)->get_node1()->get_node_id());
+            *ptr = reader.get_label((*iter)->get_node1()->get_node_id());
             ++ptr;
-            *ptr = (unsigned long long)((*iter)->get_node2()->get_node_id());
+            *ptr = reader.get_label((*iter)->get_node2()->get_node_id());
             ++ptr;
             double *temp = (double*) ptr;
             //fout << (*iter)->get_node1()->get_node_id() << " " << (*iter)->get_node2()->get_node_id() << " " << (*iter)->get_size() << endl;
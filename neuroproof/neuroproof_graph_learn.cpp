@@ -21,7 +21,8 @@ static const char * PRED_DATASET_NAME = "volume/predictions";
 struct LearnOptions
 {
     LearnOptions(int argc, char** argv) : classifier_filename("classifier.xml"),
-                strategy_type(2), num_iterations(1), prune_feature(false), use_mito(true)
+                strategy_type(2), num_iterations(1), prune_feature(false), use_mito(true),
+                num_threads(1)
     {
         OptionParser parser("Program that learns agglomeration classifier from an initial segmentation");
 
@@ -43,6 +44,8 @@ struct LearnOptions
                 "automatically prune useless features (now deprecated and disabled within code)");
         parser.add_option(use_mito, "use_mito",
                 "set delayed mito agglomeration");
+        parser.add_option(num_threads, "num-threads",
+                "number of threads used to build the graph");
 
         parser.parse_options(argc, argv);
     }
@@ -58,6 +61,7 @@ struct LearnOptions
     int num_iterations;
     bool prune_feature;
     bool use_mito;
+    int num_threads;
 };
 
 bool endswith(string filename, string extn){
@@ -92,6 +96,7 @@ void run_learning(LearnOptions& options)
 	eclfr = new OpencvRFclassifier();	
 
     BioStack stack(watershed_data); 
+    stack.set_num_threads(options.num_threads);
 
     FeatureMgrPtr feature_manager(new FeatureMgr(prob_list.size()));
     stack.set_prob_list(prob_list);
@@ -36,9 +36,9 @@ void remove_inclusions(Stack& stack)
 struct PredictOptions
 {
     PredictOptions(int argc, char** argv) : synapse_filename(""), output_filename("segmentation.h5"),
-        graph_filename("graph.json"), threshold(0.2), watershed_threshold(0), post_synapse_threshold(0.0),
+        graph_filename("graph.json"), threshold(0.2), watershed_threshold(0), watershed_margin(0), post_synapse_threshold(0.0),
         merge_mito(true), agglo_type(1), enable_transforms(true), postseg_classifier_filename(""),
-        location_prob(true)
+        location_prob(true), num_threads(1), stream_chunk(0)
     {
         OptionParser parser("Program that predicts edge confidence for a graph and merges confident edges");
 
@@ -56,21 +56,27 @@ struct PredictOptions
         parser.add_option(output_filename, "output-file",
                 "h5 file that will contain the output segmentation (z,y,x) and body mappings"); 
         parser.add_option(graph_filename, "graph-file",
-                "json file that will contain the output graph"); 
+                "json file that will contain the output graph (written in the binary graph format if the name ends with .npgraph)"); 
         parser.add_option(threshold, "threshold",
                 "segmentation threshold"); 
         parser.add_option(watershed_threshold, "watershed-threshold",
                 "threshold used for removing small bodies as a post-process step"); 
+        parser.add_option(watershed_margin, "watershed-margin",
+                "if greater than 0, small bodies are absorbed by growing neighboring bodies only within this many voxels of each removed body, using num-threads threads (0 voxels outside of removed bodies are not filled)"); 
         parser.add_option(postseg_classifier_filename, "postseg-classifier-file",
                 "opencv or vigra agglomeration classifier to be used after agglomeration to assign confidence to the graph edges -- classifier-file used if not specified"); 
         parser.add_option(post_synapse_threshold, "post-synapse-threshold",
                 "Merge synapses indepedent of constraints"); 
+        parser.add_option(num_threads, "num-threads",
+                "number of threads used to build the graph (also within each chunk when streaming)");
+        parser.add_option(stream_chunk, "stream-chunk",
+                "build the graph reading this many z-planes of the watershed and prediction files at a time (0 disables streaming) -- this avoids loading the whole prediction array but does not support volumes larger than memory: the watershed, and the boundary channel when it is needed for edge locations or small body removal, are still loaded entirely afterwards"); 
 
         // invisible arguments
         parser.add_option(merge_mito, "merge-mito",
                 "perform separate mitochondrion merge phase", true, false, true); 
         parser.add_option(agglo_type, "agglo-type",
-                "merge mode used", true, false, true); 
+                "merge mode used (0=flat, 1=agglo, 2=mrf, 3=queue, 5=indexed heap)", true, false, true); 
         parser.add_option(enable_transforms, "transforms",
                 "enables using the transforms table when reading the segmentation", true, false, true); 
         parser.add_option(location_prob, "location_prob",
@@ -91,8 +97,11 @@ struct PredictOptions
 
     double threshold;
     int watershed_threshold; // might be able to increase default to 500
+    int watershed_margin;
     string postseg_classifier_filename;
     double post_synapse_threshold;
+    int num_threads;
+    int stream_chunk;
 
     // hidden options (with default values)
     bool merge_mito;
@@ -104,21 +113,35 @@ struct PredictOptions
 
 void run_prediction(PredictOptions& options)
 {
-    // create prediction array
-    vector<VolumeProbPtr> prob_list = import_3Dh5vol_array<Prob_t>(
-        options.prediction_filename.c_str(), PRED_DATASET_NAME);
-    VolumeProbPtr boundary_channel = prob_list[0];
-    cout << "Read prediction array" << endl;
-
-    // create watershed volume
-    VolumeLabelPtr initial_labels = import_h5labels(
-            options.watershed_filename.c_str(), SEG_DATASET_NAME);
-    cout << "Read watershed" << endl;
-
+    vector<VolumeProbPtr> prob_list;
+    VolumeProbPtr boundary_channel;
+    VolumeLabelPtr initial_labels;
+    unsigned int num_channels = 0;
+
+    // when streaming, the volumes are read in z-chunks while building the graph
+    boost::shared_ptr<H5ChunkReader> chunk_reader;
+    if (options.stream_chunk > 0) {
+        chunk_reader = boost::shared_ptr<H5ChunkReader>(new H5ChunkReader(
+                    options.watershed_filename, SEG_DATASET_NAME,
+                    options.prediction_filename, PRED_DATASET_NAME));
+        num_channels = chunk_reader->get_num_channels();
+    } else {
+        // create prediction array
+        prob_list = import_3Dh5vol_array<Prob_t>(
+            options.prediction_filename.c_str(), PRED_DATASET_NAME);
+        boundary_channel = prob_list[0];
+        num_channels = prob_list.size();
+        cout << "Read prediction array" << endl;
+
+        // create watershed volume
+        initial_labels = import_h5labels(
+                options.watershed_filename.c_str(), SEG_DATASET_NAME);
+        cout << "Read watershed" << endl;
+    }
     
     // TODO: move feature handling to stack (load classifier if file provided)
     // create feature manager and load classifier
-    FeatureMgrPtr feature_manager(new FeatureMgr(prob_list.size()));
+    FeatureMgrPtr feature_manager(new FeatureMgr(num_channels));
     feature_manager->set_basic_features(); 
 
     EdgeClassifier* eclfr;
@@ -133,9 +156,20 @@ void run_prediction(PredictOptions& options)
     BioStack stack(initial_labels); 
     stack.set_feature_manager(feature_manager);
     stack.set_prob_list(prob_list);
+    stack.set_num_threads(options.num_threads);
 
     cout<<"Building RAG ..."; 	
-    stack.build_rag();
+    if (chunk_reader) {
+        stack.build_rag_stream(*chunk_reader, options.stream_chunk);
+
+        // streaming only bounds the memory of the graph build: merging,
+        // small body removal, and the output still need the whole label
+        // volume, which must fit in memory
+        stack.set_labelvol(import_h5labels(
+                options.watershed_filename.c_str(), SEG_DATASET_NAME));
+    } else {
+        stack.build_rag();
+    }
     cout<<"done with "<< stack.get_num_labels()<< " nodes\n";	
    
     // add synapse constraints (send json to stack function)
@@ -166,6 +200,10 @@ void run_prediction(PredictOptions& options)
             cout<<"Agglomerating (flat) upto threshold "<< options.threshold<< " ..."; 
             agglomerate_stack_flat(stack, options.threshold, options.merge_mito);
             break;
+        case 5:
+            cout<<"Agglomerating (indexed) upto threshold "<< options.threshold<< " ..."; 
+            agglomerate_stack_indexed(stack, options.threshold, options.merge_mito);
+            break;
         default: throw ErrMsg("Illegal agglomeration type specified");
     }
     cout << "Done with "<< stack.get_num_labels()<< " regions\n";
@@ -194,8 +232,18 @@ void run_prediction(PredictOptions& options)
 
         unordered_set<Label_t> synapse_labels;
         stack.load_synapse_labels(synapse_labels);
-        int num_removed = stack.absorb_small_regions(boundary_channel,
+        if (!boundary_channel) {
+            boundary_channel = chunk_reader->read_channel(0);
+        }
+        int num_removed = 0;
+        if (options.watershed_margin > 0) {
+            num_removed = stack.absorb_small_regions_local(boundary_channel,
+                        options.watershed_threshold, synapse_labels,
+                        options.watershed_margin);
+        } else {
+            num_removed = stack.absorb_small_regions(boundary_channel,
                         options.watershed_threshold, synapse_labels);
+        }
         cout << num_removed << " removed" << endl;	
     }
 
@@ -211,7 +259,19 @@ void run_prediction(PredictOptions& options)
     
     feature_manager->clear_features();
     feature_manager->set_classifier(eclfr);   	 
-    stack.Stack::build_rag();
+    if (chunk_reader) {
+        // only the boundary channel is kept for choosing edge locations
+        if (options.location_prob) {
+            if (!boundary_channel) {
+                boundary_channel = chunk_reader->read_channel(0);
+            }
+            prob_list.assign(1, boundary_channel);
+            stack.set_prob_list(prob_list);
+        }
+        stack.Stack::build_rag_stream(*chunk_reader, options.stream_chunk);
+    } else {
+        stack.Stack::build_rag();
+    }
     
 
     // add synapse constraints (send json to stack function)
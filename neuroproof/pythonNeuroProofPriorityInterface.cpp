@@ -17,7 +17,7 @@ using namespace boost::python;
 using std::ifstream; using std::ofstream; using std::cout; using std::endl;
 using std::vector;
 
-typedef unsigned int Label;
+typedef Node_t Label;
 
 static EdgeEditor* priority_scheduler = 0;
 Rag_t* rag = 0;
@@ -33,15 +33,9 @@ bool initialize_priority_scheduler(const char * json_file, double min_val, doubl
         delete priority_scheduler;
     }
    
-    ifstream fin(json_file);
-    Json::Reader json_reader;
+    // json or binary graph depending on the extension
     Json::Value json_vals;
-    if (!json_reader.parse(fin, json_vals)) {
-        throw ErrMsg("Error: Json incorrectly formatted");
-    }
-    fin.close();
-
-    rag = create_rag_from_json(json_vals);
+    rag = create_rag_from_graphfile(json_file, json_vals);
     if (!rag) {
         return false;
     }
@@ -59,28 +53,11 @@ bool export_priority_scheduler(const char * json_file)
         throw ErrMsg("Scheduler not initialized");
     }
     
-    try {
-        Json::Value json_writer;
-        ofstream fout(json_file);
-        if (!fout) {
-            throw ErrMsg("Error: output file could not be opened");
-        }
-
-        bool status = create_json_from_rag(rag, json_writer);
-        if (!status) {
-            throw ErrMsg("Error in rag export");
-        }
-
-        priority_scheduler->export_json(json_writer); 
-
-        fout << json_writer; 
-        fout.close();
-    } catch (ErrMsg& msg) {
-        cout << msg.str << endl;
-        return false;
-    }
+    Json::Value json_writer;
+    priority_scheduler->export_json(json_writer); 
 
-    return true;
+    // json or binary graph depending on the extension
+    return create_graphfile_from_rag(rag, json_file, json_writer);
 }
 
 double get_average_prediction_error()
@@ -128,6 +105,14 @@ void set_orphan_mode(double ignore_size, double threshold, bool synapse_orphan)
     priority_scheduler->set_orphan_mode(ignore_size);
 }
 
+void set_incremental_mode(bool incremental)
+{
+    if (!priority_scheduler) {
+        throw ErrMsg("Scheduler not initialized");
+    }
+    priority_scheduler->set_incremental_mode(incremental);
+}
+
 void set_edge_mode(double lower, double upper, double start)
 {
     if (!priority_scheduler) {
@@ -146,6 +131,18 @@ void estimate_work()
     priority_scheduler->estimateWork();
 }
 
+// (mean number of edges, 95% confidence interval half-width)
+tuple estimate_work_trials(unsigned int num_trials, unsigned int num_threads)
+{
+    if (!priority_scheduler) {
+        throw ErrMsg("Scheduler not initialized");
+    }
+
+    priority_scheduler->estimateWork(num_trials, num_threads);
+    return make_tuple(priority_scheduler->get_est_mean(),
+            priority_scheduler->get_est_conf_interval());
+}
+
 // empty PriorityInfo if no more edges
 PriorityInfo get_next_edge()
 {
@@ -240,8 +237,10 @@ BOOST_PYTHON_MODULE(libNeuroProofPriority)
     def("set_body_mode", set_body_mode);
     def("set_orphan_mode", set_orphan_mode);
     def("set_edge_mode", set_edge_mode);
+    def("set_incremental_mode", set_incremental_mode);
     def("get_edge_val", get_edge_val);
     def("estimate_work", estimate_work);
+    def("estimate_work_trials", estimate_work_trials);
 
     class_<PriorityInfo>("PriorityInfo")
         .def_readwrite("body_pair", &PriorityInfo::body_pair)
@@ -1,6 +1,7 @@
 #include <FeatureManager/FeatureMgr.h>
 #include <Rag/Rag.h>
 #include <IO/RagIO.h>
+#include <IO/BufferVolumeIO.h>
 #include <Utilities/ErrMsg.h>
 #include <Stack/Stack.h>
 #include <BioPriors/StackAgglomAlgs.h>
@@ -468,6 +469,12 @@ StackPython* init_stack()
 
 VolumeLabelPtr init_watershed(object watershed)
 {
+    // arrays exposing their memory are copied in one pass
+    VolumeLabelPtr buffer_labels = create_label_volume_from_buffer(watershed.ptr());
+    if (buffer_labels) {
+        return buffer_labels;
+    }
+
     boost::python::tuple watershed_shape(watershed.attr("shape"));
 
     unsigned int width = boost::python::extract<unsigned int>(watershed_shape[2]);
@@ -534,6 +541,15 @@ void reinit_stack2(StackPython* stack, object watershed)
 
 VolumeProbPtr create_prediction(object prediction)
 {
+    // float32 arrays stored without gaps are used without a copy
+    vector<VolumeProbPtr> buffer_probs;
+    if (create_prob_volumes_from_buffer(prediction.ptr(), buffer_probs)) {
+        if (buffer_probs.size() != 1) {
+            throw ErrMsg("Prediction channel is not 3D");
+        }
+        return buffer_probs[0];
+    }
+
     unsigned width, height, depth; 
     boost::python::tuple prediction_shape(prediction.attr("shape"));
     width = boost::python::extract<unsigned>(prediction_shape[2]);
@@ -570,6 +586,16 @@ BOOST_PYTHON_MODULE(libNeuroProofRag)
     def("create_rag_from_jsonfile", create_rag_from_jsonfile, return_value_policy<manage_new_object>());
     // (return true/false, params: rag, file_name)
     def("create_jsonfile_from_rag", create_jsonfile_from_rag);
+    // (return: Rag, params: file_name)
+    def("create_rag_from_binaryfile", (Rag_t* (*)(const char*)) create_rag_from_binaryfile,
+            return_value_policy<manage_new_object>());
+    // (return true/false, params: rag, file_name)
+    def("create_binaryfile_from_rag", (bool (*)(Rag_t*, const char*)) create_binaryfile_from_rag);
+    // json or binary chosen by extension (return: Rag, params: file_name)
+    def("create_rag_from_graphfile", (Rag_t* (*)(const char*)) create_rag_from_graphfile,
+            return_value_policy<manage_new_object>());
+    // json or binary chosen by extension (return true/false, params: rag, file_name)
+    def("create_graphfile_from_rag", (bool (*)(Rag_t*, const char*)) create_graphfile_from_rag);
 
     def("reinit_stack", reinit_stack);
     def("reinit_stack2", reinit_stack2);
@@ -1 +1,14 @@
 from ._agglomeration_python import *
+
+import numpy
+
+def channel_major_predictions(pred):
+    """
+    Returns predictions indexed (z,y,x,channel) that are stored as a
+    C-order (channel,z,y,x) array.  This is the layout that agglomerate
+    uses without copying; predictions in any other layout (such as a
+    C-order (z,y,x,channel) array) are copied channel by channel.
+    Predictions already in this layout are returned without a copy.
+    """
+    pred = numpy.ascontiguousarray(pred.transpose((3,0,1,2)), numpy.float32)
+    return pred.transpose((1,2,3,0))
@@ -71,7 +71,10 @@ BOOST_PYTHON_MODULE(_agglomeration_python)
     ndarray_to_segmentation();
     ndarray_to_predictionarray(); 
  
-    def("agglomerate" , agglomerate);
+    def("agglomerate" , agglomerate,
+        "Agglomerates a (z,y,x) label array using (z,y,x,channel) float32 predictions.\n"
+        "The predictions are only used without a copy if they are stored as a C-order\n"
+        "(channel,z,y,x) array (see channel_major_predictions).");
 }
 
 
@@ -9,6 +9,7 @@
 #include <BioPriors/StackAgglomAlgs.h>
 #include <IO/RagIO.h>
 #include <Rag/RagUtils.h>
+#include <Rag/AffinityPathSearch.h>
 
 #include <json/json.h>
 #include <sstream>
@@ -50,22 +51,18 @@ class Graph {
   private:
     RagPtr rag;
 
+    //! path search reused between queries
+    AffinityPathSearch path_search;
+
 };
 
 
 Graph::Graph(string filename)
 {
-    ifstream fin(filename.c_str());
-    Json::Reader json_reader;
-    Json::Value json_vals;
-    if (!json_reader.parse(fin, json_vals)) {
-        throw ErrMsg("Error: Json incorrectly formatted");
-    }
-    fin.close();
-
-    rag = RagPtr(create_rag_from_json(json_vals));
+    // json or binary graph depending on the extension
+    rag = RagPtr(create_rag_from_graphfile(filename.c_str()));
     if (!rag) {
-        throw ErrMsg("Error: Json incorrectly formatted");
+        throw ErrMsg("Error: graph " + filename + " could not be read");
     }
 }
 
@@ -77,44 +74,35 @@ Json::Value Graph::find_close_bodies(unsigned long long id, int path_cutoff, dou
         throw ErrMsg("Error: head node not found");
     }
 
-    AffinityPair::Hash affinity_pairs;
-    grab_affinity_pairs(*rag.get(), node1, path_cutoff, prob_cutoff, false, affinity_pairs, true);
+    path_search.search(node1, path_cutoff, prob_cutoff, false, true);
 
     Json::Value data;
     int i = 0;
 
-    for (AffinityPair::Hash::iterator iter = affinity_pairs.begin();
-            iter != affinity_pairs.end(); ++iter) {
-        Node_t region;
-        
-        region = iter->region1;
-        if (region == id) {
-            region = iter->region2;
-        }
-
+    for (size_t pos = 0; pos < path_search.num_reached(); ++pos) {
+        const AffinityPathSearch::PathNode& path_node = path_search.get_reached(pos);
+        Node_t region = path_node.node->get_node_id();
     
         data[i][0] = region;
         unsigned int count = 1;
 
-        // extract entire path
-        Node_t temp_id = iter->size;
-        Node_t r1 = iter->region1;
-        Node_t r2 = iter->region2;
-        while ((temp_id != r1) && (temp_id != r2)) {
+        // extract entire path (nodes next to the head node end the path)
+        Node_t temp_id = path_node.second_node;
+        Node_t curr_id = region;
+        while (temp_id != curr_id) {
             // add node 
             data[i][count] = temp_id;
 
             // find next node
-            AffinityPair temp_pair(id, temp_id);
-            AffinityPair::Hash::iterator iter_temp = affinity_pairs.find(temp_pair); 
-            assert(iter_temp != affinity_pairs.end());
-            temp_id = iter_temp->size;
-            r1 = iter_temp->region1;
-            r2 = iter_temp->region2;
+            const AffinityPathSearch::PathNode* path_temp =
+                path_search.find_reached(rag->find_rag_node(temp_id));
+            assert(path_temp);
+            curr_id = temp_id;
+            temp_id = path_temp->second_node;
             ++count;
         }
         
-        data[i][count] = iter->weight;
+        data[i][count] = path_node.weight;
         ++i;
     }
 
@@ -11,6 +11,7 @@
 // #include <numpy/arrayobject.h>
 
 #include <Stack/Stack.h>
+#include <IO/BufferVolumeIO.h>
 
 namespace NeuroProof { namespace python {
 
@@ -18,7 +19,7 @@ namespace NeuroProof { namespace python {
 /*!
  * Converts between 3D numpy ndarray,  C++ 3D arrays objects.
  * The data is currently copied back and forth.  The ndarray
- * is spec'd to be numpy.uint32.
+ * can have any integer dtype; numpy.uint32 is returned.
 */
 struct ndarray_to_segmentation
 {
@@ -47,66 +48,24 @@ struct ndarray_to_segmentation
     }
 
     //! Converts the given numpy ndarray object into a VolumeLabelPtr object.
-    //! NOTE: The data from the ndarray is *copied* into the new VolumeLabelPtr object.
+    //! NOTE: The labels are *copied* (in one pass) since they are modified
+    //! in place.  Any integer dtype and memory order is accepted.
     static void construct( PyObject* obj_ptr, 
             boost::python::converter::rvalue_from_python_stage1_data* data)
     {
         using namespace boost::python;
         assert(PyArray_Check(obj_ptr));
-        object ndarray = object(handle<>(borrowed(obj_ptr)));
 
-        // Verify ndarray.dtype
-        std::string dtype = extract<std::string>(str(ndarray.attr("dtype")));
-        if (dtype != "uint32")
-        {
-            std::ostringstream ssMsg;
-            ssMsg << "Volume has wrong dtype.  Expected " << "uint32" << ", got " << dtype;
-            throw ErrMsg(ssMsg.str());
-        }
-
-        // Verify ndarray dimensionality.
-        int ndarray_ndim = extract<int>(ndarray.attr("ndim"));
-        if (ndarray_ndim != 3)
-        {
-            std::string shape = extract<std::string>(str(ndarray.attr("shape")));
-            std::ostringstream ssMsg;
-            ssMsg << "Volume is not exactly 3D.  Shape is " << shape;
-            throw ErrMsg( ssMsg.str() );
-        }
-
-        // Verify ndarray memory order
-        if (!ndarray.attr("flags")["C_CONTIGUOUS"])
-        {
-            throw ErrMsg("Volume is not C_CONTIGUOUS");
+        VolumeLabelPtr labels = create_label_volume_from_buffer(obj_ptr);
+        if (!labels) {
+            throw ErrMsg("Volume does not provide a buffer");
         }
 
-        // Extract dims from ndarray.shape (which is already in C-order)
-        object shape = ndarray.attr("shape");
-        typedef stl_input_iterator<unsigned int> shape_iter_t;
-        std::vector<unsigned int> dims;
-        dims.assign( shape_iter_t(shape), shape_iter_t() );
-
-        // Obtain a pointer to the array's data
-        PyArrayObject * array_object = reinterpret_cast<PyArrayObject *>( ndarray.ptr() );
-        Label_t const * voxel_data = static_cast<Label_t const *>( PyArray_DATA(array_object) );
-
-        // Grab pointer to memory into which to construct the DVIDVoxels
+        // Grab pointer to memory into which to construct the VolumeLabelPtr
         void* storage = ((converter::rvalue_from_python_storage<VolumeLabelPtr>*) data)->storage.bytes;
-        // point VolumeLabelData to boost.python chunk pointer
         
-        // Create smart pointer from ndarray data using "in-place" new().
-        // (memory reclaimed)
-        VolumeLabelPtr * volumeptr = new (storage) VolumeLabelPtr; 
-
-        *volumeptr = VolumeLabelData::create_volume();
-        // coordinate system in vigra in fortran order
-        (*volumeptr)->reshape(vigra::MultiArrayShape<3>::type(dims[2], dims[1], dims[0]));
-
-        // do not reuse memory since data will be modified 
-        volume_forXYZ(**volumeptr,x,y,z) {
-            (*volumeptr)->set(x,y,z, *voxel_data);
-            voxel_data++;
-        }
+        // Create smart pointer using "in-place" new().
+        new (storage) VolumeLabelPtr(labels); 
 
         // Stash the memory chunk pointer for later use by boost.python
         data->convertible = storage;
@@ -129,7 +88,7 @@ struct ndarray_to_segmentation
         // create new array managed by the python object
         PyObject * array_object = PyArray_SimpleNew( numpy_dims.size(),
                                                              &numpy_dims[0],
-                                                             NPY_UINT32);
+                                                             (sizeof(Label_t) == 8) ? NPY_UINT64 : NPY_UINT32);
         if (!array_object)
         {
             throw ErrMsg("Failed to create array!");
@@ -153,7 +112,8 @@ struct ndarray_to_segmentation
 /*!
  * Converts from a 4D numpy array consisting several channels
  * of 3D volume predictions to a C++ vector of vigra arrays.
- * The ndarray is spec'd to be numpy.float32.
+ * The ndarray is spec'd to be numpy.float32 (numpy.float64 is
+ * copied).
 */
 struct ndarray_to_predictionarray 
 {
@@ -179,68 +139,30 @@ struct ndarray_to_predictionarray
     }
 
     //! Converts the given numpy ndarray object into a vector<VolumeProbPtr>.
-    //! NOTE: The data from the ndarray is *copied* into the new VolumePropPtr object.
+    //! NOTE: The channels of a C-order (ch,z,y,x) float32 array passed as a
+    //! (z,y,x,ch) view use the ndarray memory directly, which is kept alive by
+    //! the volume.  This is the required layout to avoid a copy: other layouts
+    //! (including a C-order (z,y,x,ch) array) are *copied* channel by channel.
     static void construct( PyObject* obj_ptr, 
             boost::python::converter::rvalue_from_python_stage1_data* data)
     {
         using namespace boost::python;
         assert(PyArray_Check(obj_ptr));
-        object ndarray = object(handle<>(borrowed(obj_ptr)));
-
-        // Verify ndarray.dtype
-        std::string dtype = extract<std::string>(str(ndarray.attr("dtype")));
-        if (dtype != "float32") {
-            std::ostringstream ssMsg;
-            ssMsg << "Volume has wrong dtype.  Expected " << "float32" << ", got " << dtype;
-            throw ErrMsg(ssMsg.str());
+        
+        if (PyArray_NDIM(reinterpret_cast<PyArrayObject *>(obj_ptr)) != 4) {
+            throw ErrMsg("Volume is not exactly 4D");
         }
-
-        // Verify ndarray dimensionality.
-        int ndarray_ndim = extract<int>(ndarray.attr("ndim"));
-        if (ndarray_ndim != 4) {
-            std::string shape = extract<std::string>(str(ndarray.attr("shape")));
-            std::ostringstream ssMsg;
-            ssMsg << "Volume is not exactly 4D.  Shape is " << shape;
-            throw ErrMsg( ssMsg.str() );
+        std::vector<VolumeProbPtr> prob_list;
+        if (!create_prob_volumes_from_buffer(obj_ptr, prob_list)) {
+            throw ErrMsg("Volume does not provide a buffer");
         }
 
-        // Verify ndarray memory order
-        if (!ndarray.attr("flags")["C_CONTIGUOUS"]) {
-            throw ErrMsg("Volume is not C_CONTIGUOUS");
-        }
+        // Grab pointer to memory into which to construct the vector
+        void* storage = ((converter::rvalue_from_python_storage<std::vector<VolumeProbPtr> >*) data)->storage.bytes;
 
-        // Extract dims from ndarray.shape (which is in C-order)
-        object shape = ndarray.attr("shape");
-        typedef stl_input_iterator<unsigned int> shape_iter_t;
-        std::vector<unsigned int> dims;
-        dims.assign( shape_iter_t(shape), shape_iter_t() );
-
-        // Obtain a pointer to the array's data
-        PyArrayObject * array_object = reinterpret_cast<PyArrayObject *>( ndarray.ptr() );
-        Prob_t const * prob_data = static_cast<Prob_t const *>( PyArray_DATA(array_object) );
-
-        // Grab pointer to memory into which to construct the DVIDVoxels
-        void* storage = ((converter::rvalue_from_python_storage<VolumeLabelPtr>*) data)->storage.bytes;
-        // point VolumeLabelData to boost.python chunk pointer
-        
-        // Create smart pointer from ndarray data using "in-place" new().
+        // Create vector using "in-place" new().
         std::vector<VolumeProbPtr> * probarray = new (storage) std::vector<VolumeProbPtr>; 
-
-        for (int i = 0; i < dims[3]; ++i) {
-            boost::shared_ptr<VolumeProb> probdata = VolumeProb::create_volume();
-
-            probdata->reshape(vigra::MultiArrayShape<3>::type(dims[2], dims[1], dims[0]));
-            (*probarray).push_back(probdata);
-
-        }
-
-        // could potentially reuse this memory if I change the interface ??
-        volume_forXYZ(*((*probarray)[0]),x,y,z) {
-            for (int i = 0; i < dims[3]; ++i) {
-                (*(*probarray)[i])(x,y,z) = *prob_data;
-                prob_data++;
-            }
-        }
+        probarray->swap(prob_list);
 
         // Stash the memory chunk pointer for later use by boost.python
         data->convertible = storage;
@@ -1,5 +1,6 @@
 #include "BatchMergeMRFh.h"
 #include <BioPriors/MitoTypeProperty.h>
+#include "MergePriorityQueue.h"
 
 #include <ctime>
 #include <cstdlib>
@@ -91,7 +92,7 @@ double BatchMergeMRFh::compute_merge_prob( int iterCount, std::vector< std::pair
         
         if (*iter) {
             try {
-                MitoTypeProperty& mtype = (*iter)->get_property<MitoTypeProperty>("mito-type");
+                MitoTypeProperty& mtype = (*iter)->get_property<MitoTypeProperty>(mito_type_key());
                 if (mtype.get_node_type() != 2) {
                     generate_subsets(*iter);
                 }
@@ -253,7 +254,7 @@ void BatchMergeMRFh::generate_subsets(RagNode_t* pnode)
 	RagNode_t* other_node = (*iter)->get_other_node(pnode);
 
         try {
-            MitoTypeProperty& mtype = other_node->get_property<MitoTypeProperty>("mito-type");
+            MitoTypeProperty& mtype = other_node->get_property<MitoTypeProperty>(mito_type_key());
             if (mtype.get_node_type()!=2) {
                 nbr_set.insert(other_node->get_node_id());
             }
@@ -365,9 +366,8 @@ void BatchMergeMRFh::compute_subset_cost(RagNode_t* pnode, set<Node_t>& subset)
 	RagEdge_t* edge1 = _rag->find_rag_edge(pnode->get_node_id(),(*it));
 	
         int qloc = -1;
-        try {
-            qloc = edge1->get_property<int>("qloc");
-        } catch (ErrMsg& msg) {
+        if (edge1->has_property(qloc_key())) {
+            qloc = edge1->get_property<int>(qloc_key());
         }
 
         edge_idx.push_back(qloc);
@@ -431,9 +431,8 @@ void BatchMergeMRFh::compute_subset_cost(RagNode_t* pnode, set<Node_t>& subset)
 	    RagEdge_t* edge1 = _rag->find_rag_edge(pnode->get_node_id(),(*it));
 	    
             int qloc = -1;
-            try {
-                qloc = edge1->get_property<int>("qloc");
-            } catch (ErrMsg& msg) {
+            if (edge1->has_property(qloc_key())) {
+                qloc = edge1->get_property<int>(qloc_key());
             }
 	    
             if (subset_to_edge[qloc].size()==0)
@@ -449,9 +448,8 @@ void BatchMergeMRFh::compute_subset_cost(RagNode_t* pnode, set<Node_t>& subset)
 	RagEdge_t* edge1 = _rag->find_rag_edge(pnode->get_node_id(),(*it));
 	
         int qloc = -1;
-        try {
-            qloc = edge1->get_property<int>("qloc");
-        } catch (ErrMsg& msg) {
+        if (edge1->has_property(qloc_key())) {
+            qloc = edge1->get_property<int>(qloc_key());
         }
 	
         if (_edgeBlf[qloc].size()==0){
@@ -590,11 +588,8 @@ void BatchMergeMRFh::build_srag(RagNode_t* pnode, set<Node_t>& subset)
 	if (*iter)
 	    _srag->remove_rag_node((*iter));
 
-    NodeCaches &rag_node_cache= _feature_mgr->get_node_cache();  	
-    EdgeCaches &rag_edge_cache= _feature_mgr->get_edge_cache();  	
-    	
     RagNode_t* srag_common_node = _srag->insert_rag_node(pnode->get_node_id());
-    _sfeature_mgr->copy_cache(rag_node_cache[pnode], srag_common_node);
+    _sfeature_mgr->copy_cache(_feature_mgr, pnode, srag_common_node);
     srag_common_node->set_boundary_size(pnode->get_boundary_size());	
     srag_common_node->set_size(pnode->get_size());
 
@@ -603,7 +598,7 @@ void BatchMergeMRFh::build_srag(RagNode_t* pnode, set<Node_t>& subset)
 	RagNode_t* rag_nbr1= _rag->find_rag_node(nbr1);
 
     	RagNode_t* srag_node1 = _srag->insert_rag_node(rag_nbr1->get_node_id());
-    	_sfeature_mgr->copy_cache(rag_node_cache[rag_nbr1], srag_node1);
+    	_sfeature_mgr->copy_cache(_feature_mgr, rag_nbr1, srag_node1);
     	srag_node1->set_boundary_size(rag_nbr1->get_boundary_size());	
     	srag_node1->set_size(rag_nbr1->get_size());
 	
@@ -634,7 +629,7 @@ void BatchMergeMRFh::build_srag(RagNode_t* pnode, set<Node_t>& subset)
 	    if (srag_edge1){
     		srag_edge1->set_weight( (*eit)->get_weight());	
 		srag_edge1->set_size((*eit)->get_size());	
-    		_sfeature_mgr->copy_cache(rag_edge_cache[(*eit)],srag_edge1);
+    		_sfeature_mgr->copy_cache(_feature_mgr, (*eit), srag_edge1);
                 if(++edge_count >= (_subsetSz) )
 		    break;	  
 	    }	
@@ -5,6 +5,7 @@
 #include "MergePriorityFunction.h"
 #include "MergePriorityQueue.h"
 #include <Rag/RagNodeCombineAlg.h>
+#include <unordered_set>
 
 namespace NeuroProof {
 
@@ -13,16 +14,16 @@ class FeatureCombine : public RagNodeCombineAlg {
     FeatureCombine(FeatureMgr* feature_mgr_, Rag_t* rag_) :
         feature_mgr(feature_mgr_), rag(rag_) {}
     
-    virtual void post_edge_move(RagEdge<unsigned int>* edge_new,
-            RagEdge<unsigned int>* edge_remove)
+    virtual void post_edge_move(RagEdge_t* edge_new,
+            RagEdge_t* edge_remove)
     {
         if (feature_mgr) {
             feature_mgr->mv_features(edge_remove, edge_new);
         } 
     }
 
-    virtual void post_edge_join(RagEdge<unsigned int>* edge_keep,
-            RagEdge<unsigned int>* edge_remove)
+    virtual void post_edge_join(RagEdge_t* edge_keep,
+            RagEdge_t* edge_remove)
     {
         if (feature_mgr) {
             if (edge_keep->is_false_edge()) {
@@ -35,8 +36,8 @@ class FeatureCombine : public RagNodeCombineAlg {
         }
     }
 
-    virtual void post_node_join(RagNode<unsigned int>* node_keep,
-            RagNode<unsigned int>* node_remove)
+    virtual void post_node_join(RagNode_t* node_keep,
+            RagNode_t* node_remove)
     {
         if (feature_mgr) {
             RagEdge_t* edge = rag->find_rag_edge(node_keep, node_remove);
@@ -46,6 +47,15 @@ class FeatureCombine : public RagNodeCombineAlg {
         }
     }
 
+    virtual void post_node_collapse(RagNode_t* node_keep,
+            std::vector<RagNode_t*>& nodes_remove,
+            std::vector<RagEdge_t*>& internal_edges)
+    {
+        if (feature_mgr) {
+            feature_mgr->collapse_features(node_keep, nodes_remove, internal_edges);
+        }
+    }
+
   protected:
     FeatureMgr* feature_mgr;
     Rag_t* rag;
@@ -58,8 +68,8 @@ class DelayedPriorityCombine : public FeatureCombine {
     DelayedPriorityCombine(FeatureMgr* feature_mgr_, Rag_t* rag_, MergePriority* priority_) :
         FeatureCombine(feature_mgr_, rag_), priority(priority_) {}
 
-    void post_node_join(RagNode<unsigned int>* node_keep,
-            RagNode<unsigned int>* node_remove)
+    void post_node_join(RagNode_t* node_keep,
+            RagNode_t* node_remove)
     {
         FeatureCombine::post_node_join(node_keep, node_remove);
         
@@ -79,6 +89,72 @@ class DelayedPriorityCombine : public FeatureCombine {
 
 };
 
+/*!
+ * Keeps an IndexedProbPriority current during merges.  Edges that are
+ * deleted by the merge are taken out of the heap and the edges within
+ * two hops of the merged node, which DelayedPriorityCombine would mark
+ * dirty, are re-keyed in place.
+*/
+class IndexedPriorityCombine : public FeatureCombine {
+  public:
+    IndexedPriorityCombine(FeatureMgr* feature_mgr_, Rag_t* rag_,
+            IndexedProbPriority* priority_) :
+        FeatureCombine(feature_mgr_, rag_), priority(priority_) {}
+
+    virtual void post_edge_move(RagEdge_t* edge_new,
+            RagEdge_t* edge_remove)
+    {
+        FeatureCombine::post_edge_move(edge_new, edge_remove); 
+        priority->remove_edge(edge_remove);
+    }
+
+    virtual void post_edge_join(RagEdge_t* edge_keep,
+            RagEdge_t* edge_remove)
+    {
+        FeatureCombine::post_edge_join(edge_keep, edge_remove); 
+        priority->remove_edge(edge_remove);
+    }
+
+    void post_node_join(RagNode_t* node_keep,
+            RagNode_t* node_remove)
+    {
+        priority->remove_edge(rag->find_rag_edge(node_keep, node_remove));
+        FeatureCombine::post_node_join(node_keep, node_remove);
+
+        // as in DelayedPriorityCombine, edges of the neighbors are also
+        // re-keyed since some probabilities (e.g., in overlap mode) depend
+        // on all of the edges of both nodes; edges still attached to
+        // node_remove are about to be deleted and were already removed
+        updated_edges.clear();
+        for(RagNode_t::edge_iterator iter = node_keep->edge_begin();
+                iter != node_keep->edge_end(); ++iter) {
+            RagNode_t* node = (*iter)->get_other_node(node_keep);
+            if (node == node_remove) {
+                continue;
+            }
+            if (updated_edges.insert(*iter).second) {
+                priority->update_edge(*iter);
+            }
+
+            for(RagNode_t::edge_iterator iter2 = node->edge_begin();
+                    iter2 != node->edge_end(); ++iter2) {
+                if ((*iter2)->get_other_node(node) == node_remove) {
+                    continue;
+                }
+                if (updated_edges.insert(*iter2).second) {
+                    priority->update_edge(*iter2);
+                }
+            }
+        }
+    }
+  private:
+    IndexedProbPriority* priority;
+
+    //! edges re-keyed for the current merge (reused across merges)
+    std::unordered_set<RagEdge_t*> updated_edges;
+
+};
+
 class PriorityQCombine : public FeatureCombine {
   public:
     PriorityQCombine(FeatureMgr* feature_mgr_, Rag_t* rag_,
@@ -86,15 +162,14 @@ class PriorityQCombine : public FeatureCombine {
         FeatureCombine(feature_mgr_, rag_), priority(priority_) {}
 
 
-    virtual void post_edge_move(RagEdge<unsigned int>* edge_new,
-            RagEdge<unsigned int>* edge_remove)
+    virtual void post_edge_move(RagEdge_t* edge_new,
+            RagEdge_t* edge_remove)
     {
         FeatureCombine::post_edge_move(edge_new, edge_remove); 
   
         int qloc = -1;
-        try {
-            qloc = edge_remove->get_property<int>("qloc");
-        } catch (ErrMsg& msg) {
+        if (edge_remove->has_property(qloc_key())) {
+            qloc = edge_remove->get_property<int>(qloc_key());
         }
 
         if (qloc>=0) {
@@ -102,23 +177,22 @@ class PriorityQCombine : public FeatureCombine {
         }
     }
 
-    virtual void post_edge_join(RagEdge<unsigned int>* edge_keep,
-            RagEdge<unsigned int>* edge_remove)
+    virtual void post_edge_join(RagEdge_t* edge_keep,
+            RagEdge_t* edge_remove)
     {
         FeatureCombine::post_edge_join(edge_keep, edge_remove); 
         
         int qloc = -1;
-        try {
-            qloc = edge_remove->get_property<int>("qloc");
-        } catch (ErrMsg& msg) {
+        if (edge_remove->has_property(qloc_key())) {
+            qloc = edge_remove->get_property<int>(qloc_key());
         }
         if (qloc>=0) {
             priority->invalidate(qloc+1);
         }
     }
 
-    void post_node_join(RagNode<unsigned int>* node_keep,
-            RagNode<unsigned int>* node_remove)
+    void post_node_join(RagNode_t* node_keep,
+            RagNode_t* node_remove)
     {
         FeatureCombine::post_node_join(node_keep, node_remove);
 
@@ -133,9 +207,8 @@ class PriorityQCombine : public FeatureCombine {
             QE tmpelem(val, std::make_pair(node1,node2));	
 
             int qloc = -1;
-            try {
-                qloc = (*iter)->get_property<int>("qloc");
-            } catch (ErrMsg& msg) {
+            if ((*iter)->has_property(qloc_key())) {
+                qloc = (*iter)->get_property<int>(qloc_key());
             }
 
             if (qloc>=0){
@@ -162,17 +235,16 @@ class FlatCombine : public FeatureCombine {
         FeatureCombine(feature_mgr_, rag_), priority(priority_) {}
 
 
-    virtual void post_edge_move(RagEdge<unsigned int>* edge_new,
-            RagEdge<unsigned int>* edge_remove)
+    virtual void post_edge_move(RagEdge_t* edge_new,
+            RagEdge_t* edge_remove)
     {
         FeatureCombine::post_edge_move(edge_new, edge_remove); 
    
         edge_new->set_weight(edge_remove->get_weight());	
         
         int qloc = -1;
-        try {
-            qloc = edge_remove->get_property<int>("qloc");
-        } catch (ErrMsg& msg) {
+        if (edge_remove->has_property(qloc_key())) {
+            qloc = edge_remove->get_property<int>(qloc_key());
         }
 
         if (qloc>=0){
@@ -184,8 +256,8 @@ class FlatCombine : public FeatureCombine {
         }
     }
 
-    virtual void post_edge_join(RagEdge<unsigned int>* edge_keep,
-            RagEdge<unsigned int>* edge_remove)
+    virtual void post_edge_join(RagEdge_t* edge_keep,
+            RagEdge_t* edge_remove)
     {
         FeatureCombine::post_edge_join(edge_keep, edge_remove); 
 
@@ -194,9 +266,8 @@ class FlatCombine : public FeatureCombine {
         edge_keep->set_weight(prob);	
 
         int qloc = -1;
-        try {
-            qloc = edge_remove->get_property<int>("qloc");
-        } catch (ErrMsg& msg) {
+        if (edge_remove->has_property(qloc_key())) {
+            qloc = edge_remove->get_property<int>(qloc_key());
         }
         
         if (qloc>=0) {
@@ -0,0 +1,227 @@
+/*!
+ * Defines an indexed d-ary min-heap.  Every entry is identified by a
+ * handle (such as a rag edge pointer) and the heap tracks where each
+ * handle is stored so that its key can be decreased, increased, or the
+ * entry removed in logarithmic time without leaving stale entries
+ * behind.
+ *
+ * \author Stephen Plaza (plaza.stephen@gmail.com)
+*/
+
+#ifndef INDEXEDHEAP_H
+#define INDEXEDHEAP_H
+
+#include <Utilities/ErrMsg.h>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <algorithm>
+
+namespace NeuroProof {
+
+template <typename Handle, unsigned int D = 4>
+class IndexedHeap {
+  public:
+    /*!
+     * Number of entries in the heap.
+     * \return heap size
+    */
+    size_t size() const
+    {
+        return entries.size();
+    }
+
+    /*!
+     * Determine whether the heap has no entries.
+     * \return true if empty
+    */
+    bool empty() const
+    {
+        return entries.empty();
+    }
+
+    /*!
+     * Determine whether a handle is stored in the heap.
+     * \param handle entry handle
+     * \return true if the handle is in the heap
+    */
+    bool contains(Handle handle) const
+    {
+        return positions.find(handle) != positions.end();
+    }
+
+    /*!
+     * Get the key currently associated with a handle.
+     * \param handle entry handle
+     * \return key of the entry
+    */
+    double get_key(Handle handle) const
+    {
+        typename Positions_t::const_iterator iter = positions.find(handle);
+        if (iter == positions.end()) {
+            throw ErrMsg("Handle not found in heap");
+        }
+        return entries[iter->second].first;
+    }
+
+    /*!
+     * Get the entry with the smallest key.
+     * \return handle of the top entry
+    */
+    Handle top() const
+    {
+        return entries[0].second;
+    }
+
+    /*!
+     * Get the smallest key in the heap.
+     * \return key of the top entry
+    */
+    double top_key() const
+    {
+        return entries[0].first;
+    }
+
+    /*!
+     * Remove the entry with the smallest key.
+     * \return handle of the removed entry
+    */
+    Handle pop()
+    {
+        Handle handle = entries[0].second;
+        erase_at(0);
+        return handle;
+    }
+
+    /*!
+     * Set the key of a handle, inserting the handle if it is not
+     * already in the heap.  The entry moves up or down depending
+     * on whether the key decreased or increased.
+     * \param handle entry handle
+     * \param key new key for the entry
+    */
+    void update(Handle handle, double key)
+    {
+        typename Positions_t::iterator iter = positions.find(handle);
+        if (iter == positions.end()) {
+            size_t pos = entries.size();
+            entries.push_back(Entry_t(key, handle));
+            positions[handle] = pos;
+            sift_up(pos);
+            return;
+        }
+
+        size_t pos = iter->second;
+        double old_key = entries[pos].first;
+        entries[pos].first = key;
+        if (key < old_key) {
+            sift_up(pos);
+        } else if (key > old_key) {
+            sift_down(pos);
+        }
+    }
+
+    /*!
+     * Remove a handle from the heap.  Nothing is done if the handle
+     * is not in the heap.
+     * \param handle entry handle
+     * \return true if the handle was removed
+    */
+    bool remove(Handle handle)
+    {
+        typename Positions_t::iterator iter = positions.find(handle);
+        if (iter == positions.end()) {
+            return false;
+        }
+        erase_at(iter->second);
+        return true;
+    }
+
+    /*!
+     * Remove all entries.
+    */
+    void clear()
+    {
+        entries.clear();
+        positions.clear();
+    }
+
+  private:
+    typedef std::pair<double, Handle> Entry_t;
+    typedef std::unordered_map<Handle, size_t> Positions_t;
+
+    void erase_at(size_t pos)
+    {
+        positions.erase(entries[pos].second);
+        size_t last = entries.size() - 1;
+        if (pos != last) {
+            double old_key = entries[pos].first;
+            entries[pos] = entries[last];
+            positions[entries[pos].second] = pos;
+            entries.pop_back();
+            if (entries[pos].first < old_key) {
+                sift_up(pos);
+            } else {
+                sift_down(pos);
+            }
+        } else {
+            entries.pop_back();
+        }
+    }
+
+    void sift_up(size_t pos)
+    {
+        Entry_t entry = entries[pos];
+        while (pos > 0) {
+            size_t parent = (pos - 1) / D;
+            if (!(entry.first < entries[parent].first)) {
+                break;
+            }
+            entries[pos] = entries[parent];
+            positions[entries[pos].second] = pos;
+            pos = parent;
+        }
+        entries[pos] = entry;
+        positions[entry.second] = pos;
+    }
+
+    void sift_down(size_t pos)
+    {
+        Entry_t entry = entries[pos];
+        size_t num_entries = entries.size();
+        while (true) {
+            size_t child = pos * D + 1;
+            if (child >= num_entries) {
+                break;
+            }
+
+            // find the smallest child
+            size_t last_child = std::min(child + D, num_entries);
+            size_t best = child;
+            for (++child; child < last_child; ++child) {
+                if (entries[child].first < entries[best].first) {
+                    best = child;
+                }
+            }
+
+            if (!(entries[best].first < entry.first)) {
+                break;
+            }
+            entries[pos] = entries[best];
+            positions[entries[pos].second] = pos;
+            pos = best;
+        }
+        entries[pos] = entry;
+        positions[entry.second] = pos;
+    }
+
+    //! heap ordered (key, handle) entries
+    std::vector<Entry_t> entries;
+
+    //! location of each handle in entries
+    Positions_t positions;
+};
+
+}
+
+#endif
@@ -12,8 +12,8 @@ double mito_boundary_ratio(RagEdge_t* edge)
     double ratio = 0.0;
 
     try {
-        MitoTypeProperty& type1_mito = node1->get_property<MitoTypeProperty>("mito-type");
-        MitoTypeProperty& type2_mito = node2->get_property<MitoTypeProperty>("mito-type");
+        MitoTypeProperty& type1_mito = node1->get_property<MitoTypeProperty>(mito_type_key());
+        MitoTypeProperty& type2_mito = node2->get_property<MitoTypeProperty>(mito_type_key());
         int type1 = type1_mito.get_node_type(); 
         int type2 = type2_mito.get_node_type(); 
 
@@ -55,18 +55,28 @@ double mito_boundary_ratio(RagEdge_t* edge)
 void ProbPriority::initialize_priority(double threshold_, bool use_edge_weight)
 {
     threshold = threshold_;
+    std::vector<RagEdge_t*> edges;
     for (Rag_t::edges_iterator iter = rag->edges_begin(); iter != rag->edges_end(); ++iter) {
 	if (valid_edge(*iter)) {
-	    double val;
-	    if (use_edge_weight)
-		val = (*iter)->get_weight();
-	    else
-		val = feature_mgr->get_prob(*iter);
-	    (*iter)->set_weight(val);
+	    edges.push_back(*iter);
+	}
+    }
 
-	    if (val <= threshold) {
-		ranking.insert(std::make_pair(val, std::make_pair((*iter)->get_node1()->get_node_id(), (*iter)->get_node2()->get_node_id())));
-	    }
+    std::vector<double> probs;
+    if (!use_edge_weight) {
+	feature_mgr->get_probs(edges, probs);
+    }
+
+    for (size_t i = 0; i < edges.size(); ++i) {
+	double val;
+	if (use_edge_weight)
+	    val = edges[i]->get_weight();
+	else
+	    val = probs[i];
+	edges[i]->set_weight(val);
+
+	if (val <= threshold) {
+	    ranking.insert(std::make_pair(val, std::make_pair(edges[i]->get_node1()->get_node_id(), edges[i]->get_node2()->get_node_id())));
 	}
     }
 }
@@ -76,19 +86,26 @@ void ProbPriority::initialize_priority(double threshold_, bool use_edge_weight)
 void ProbPriority::initialize_random(double pthreshold){
 
     threshold = pthreshold;
+    std::vector<RagEdge_t*> edges;
     for (Rag_t::edges_iterator iter = rag->edges_begin(); iter != rag->edges_end(); ++iter) {
 	if (valid_edge(*iter)) {
+	    edges.push_back(*iter);
+	}
+    }
 
-	    double val1 = feature_mgr->get_prob(*iter);
-	    (*iter)->set_weight(val1);
+    std::vector<double> probs;
+    feature_mgr->get_probs(edges, probs);
 
-	    if (val1 <= threshold){ 
-		srand ( time(NULL) );
-		double val= rand()*(threshold/ RAND_MAX);
+    for (size_t i = 0; i < edges.size(); ++i) {
+	double val1 = probs[i];
+	edges[i]->set_weight(val1);
 
-		(*iter)->set_weight(val);
-		ranking.insert(std::make_pair(val, std::make_pair((*iter)->get_node1()->get_node_id(), (*iter)->get_node2()->get_node_id())));
-	    }
+	if (val1 <= threshold){ 
+	    srand ( time(NULL) );
+	    double val= rand()*(threshold/ RAND_MAX);
+
+	    edges[i]->set_weight(val);
+	    ranking.insert(std::make_pair(val, std::make_pair(edges[i]->get_node1()->get_node_id(), edges[i]->get_node2()->get_node_id())));
 	}
     }
 }
@@ -217,6 +234,87 @@ void ProbPriority::add_dirty_edge(RagEdge_t* edge)
 
 
 
+void IndexedProbPriority::initialize_priority(double threshold_, bool use_edge_weight)
+{
+    threshold = threshold_;
+    ranking.clear();
+    std::vector<RagEdge_t*> edges;
+    for (Rag_t::edges_iterator iter = rag->edges_begin(); iter != rag->edges_end(); ++iter) {
+        if (valid_edge(*iter)) {
+            edges.push_back(*iter);
+        }
+    }
+
+    std::vector<double> probs;
+    if (!use_edge_weight) {
+        feature_mgr->get_probs(edges, probs);
+    }
+
+    for (size_t i = 0; i < edges.size(); ++i) {
+        double val;
+        if (use_edge_weight) {
+            val = edges[i]->get_weight();
+        } else {
+            val = probs[i];
+        }
+        edges[i]->set_weight(val);
+
+        if (val <= threshold) {
+            ranking.update(edges[i], val);
+        }
+    }
+}
+
+bool IndexedProbPriority::empty()
+{
+    return ranking.empty();
+}
+
+RagEdge_t* IndexedProbPriority::get_top_edge()
+{
+    if (ranking.top_key() > threshold) {
+        ranking.clear();
+        return 0;
+    }
+
+    return ranking.pop();
+}
+
+void IndexedProbPriority::add_dirty_edge(RagEdge_t* edge)
+{
+    update_edge(edge);
+}
+
+void IndexedProbPriority::update_edge(RagEdge_t* edge)
+{
+    if (!valid_edge(edge)) {
+        ranking.remove(edge);
+        return;
+    }
+
+    double val = feature_mgr->get_prob(edge);
+    edge->set_weight(val);
+
+    if (val <= threshold) {
+        ranking.update(edge, val);
+    } else if (ranking.remove(edge)) {
+        kicked_out++;
+    }
+}
+
+void IndexedProbPriority::remove_edge(RagEdge_t* edge)
+{
+    ranking.remove(edge);
+}
+
+
+
+
+
+
+
+
+
 //*******************************************************************************************************************
 
 
@@ -5,6 +5,7 @@
 #include <Rag/Rag.h>
 #include <unordered_set>
 #include <Utilities/AffinityPair.h>
+#include "IndexedHeap.h"
 
 namespace NeuroProof {
 
@@ -96,6 +97,48 @@ class ProbPriority : public MergePriority {
 
 };
 
+/*!
+ * Ranks edges by boundary probability in an indexed heap.  Unlike
+ * ProbPriority, edges are not invalidated and re-queued lazily: an
+ * edge whose probability changes after a merge is re-keyed in place
+ * (see update_edge), so the heap never holds more than one entry per
+ * edge and the top of the heap is always current.
+*/
+class IndexedProbPriority : public MergePriority {
+  public:
+    IndexedProbPriority(FeatureMgr* feature_mgr_, Rag_t* rag_, bool synapse_mode_=false) :
+                    MergePriority(feature_mgr_, rag_, synapse_mode_), threshold(0.0) {}
+
+    void initialize_priority(double threshold_, bool use_edge_weight=false);
+    bool empty();
+    RagEdge_t* get_top_edge();
+
+    //! re-keys the edge immediately (see update_edge)
+    void add_dirty_edge(RagEdge_t* edge);
+    
+    /*!
+     * Recompute the probability of an edge and move it to its new
+     * position in the heap, dropping it if it is no longer a merge
+     * candidate.
+     * \param edge rag edge
+    */
+    void update_edge(RagEdge_t* edge);
+
+    /*!
+     * Remove an edge from the heap, e.g., before it is deleted.
+     * \param edge rag edge
+    */
+    void remove_edge(RagEdge_t* edge);
+
+    int qlen(){ return ranking.size();}	
+
+    int get_kout(){return kicked_out;};	
+
+  private:
+    double threshold;
+    IndexedHeap<RagEdge_t*> ranking;
+};
+
 class MitoPriority : public MergePriority {
   public:
     MitoPriority(FeatureMgr* feature_mgr_, Rag_t* rag_) :
@@ -15,6 +15,17 @@
 using namespace NeuroProof;
 using namespace std;
 
+/*!
+ * Interned key of the edge property holding the edge's location in
+ * the merge priority queue
+ * \return property key
+*/
+inline PropertyKey qloc_key()
+{
+    static const PropertyKey key = PropertyKeys::get_key("qloc");
+    return key;
+}
+
 
 template<class K, class V>
 class QueueElement{
@@ -36,7 +47,7 @@ public:
 	if(!rag_edge)
 	    return;
 
-        rag_edge->set_property("qloc", ploc);
+        rag_edge->set_property(qloc_key(), ploc);
     };
     //QueueElement<K,T>& operator=(const QueueElement<K,T>& another);
 };
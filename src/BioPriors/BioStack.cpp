@@ -19,7 +19,7 @@ using std::ifstream;
 
 namespace NeuroProof {
 
-BioStack::BioStack(std::string stack_name) : Stack(VolumeLabelPtr())
+BioStack::BioStack(std::string stack_name) : Stack(VolumeLabelPtr()), track_mito(false)
 {
     if (ends_with(stack_name, ".json")) {
 	Stack stack = import_dvidstack(stack_name);
@@ -102,9 +102,8 @@ bool BioStack::is_mito(Label_t label)
     RagNode_t* rag_node = rag->find_rag_node(label);
 
     MitoTypeProperty mtype;
-    try {
-        mtype = rag_node->get_property<MitoTypeProperty>("mito-type");
-    } catch (ErrMsg& msg) {
+    if (rag_node->has_property(mito_type_key())) {
+        mtype = rag_node->get_property<MitoTypeProperty>(mito_type_key());
     }
 
     if ((mtype.get_node_type()==2)) {	
@@ -144,11 +143,66 @@ void BioStack::build_rag()
     }
     
     //printf("Building bioStack rag\n");
-    if (!labelvol) {
-        throw ErrMsg("No label volume defined for stack");
+    track_mito = true;
+    try {
+        Stack::build_rag();
+    } catch (...) {
+        track_mito = false;
+        throw;
+    }
+    track_mito = false;
+    
+    set_mito_types();
+}
+
+void BioStack::build_rag_stream(StackChunkReader& reader, unsigned int chunk_depth)
+{
+    if (reader.get_num_channels() == 0) {
+        Stack::build_rag_stream(reader, chunk_depth);
+        return;
+    }
+    if (!feature_manager) {
+        FeatureMgrPtr feature_manager_(new FeatureMgr(reader.get_num_channels()));
+        set_feature_manager(feature_manager_);
+        feature_manager->set_basic_features(); 
+    }
+
+    track_mito = true;
+    try {
+        Stack::build_rag_stream(reader, chunk_depth);
+    } catch (...) {
+        track_mito = false;
+        throw;
+    }
+    track_mito = false;
+
+    set_mito_types();
+}
+
+void BioStack::set_mito_types()
+{
+    Label_t largest_id = 0;
+    for (Rag_t::nodes_iterator iter = rag->nodes_begin(); iter != rag->nodes_end(); ++iter) {
+        Label_t id = (*iter)->get_node_id();
+	largest_id = (id>largest_id)? id : largest_id;
+	
+        MitoTypeProperty mtype;
+        if ((*iter)->has_property(mito_type_key())) {
+            mtype = (*iter)->get_property<MitoTypeProperty>(mito_type_key());
+        }
+        mtype.set_type(); 
+        (*iter)->set_property(mito_type_key(), mtype);
     }
+    //printf("Done Biostack rag, largest: %u\n", largest_id);
+}
 
-    rag = RagPtr(new Rag_t);
+void BioStack::build_rag_slab(Rag_t& rag_slab, FeatureMgr* feature_mgr_slab,
+        unsigned int zstart, unsigned int zend)
+{
+    if (!track_mito) {
+        Stack::build_rag_slab(rag_slab, feature_mgr_slab, zstart, zend);
+        return;
+    }
 
     vector<double> predictions(prob_list.size(), 0.0);
     unordered_set<Label_t> labels;
@@ -158,76 +212,89 @@ void BioStack::build_rag()
     unsigned int maxz = get_zsize() - 1; 
     unordered_map<Label_t, MitoTypeProperty> mito_probs;
  
-    volume_forXYZ(*labelvol, x, y, z) {
-        Label_t label = (*labelvol)(x,y,z); 
-        
-        if (!label) {
-            continue;
-        }
-
-        RagNode_t * node = rag->find_rag_node(label);
-
-        if (!node) {
-            node =  rag->insert_rag_node(label); 
-        }
-        node->incr_size();
+    for (unsigned int z = zstart; z < zend; ++z) {
+        for (unsigned int y = 0; y < get_ysize(); ++y) {
+            for (unsigned int x = 0; x < get_xsize(); ++x) {
+                Label_t label = (*labelvol)(x,y,z); 
                 
-        for (unsigned int i = 0; i < prob_list.size(); ++i) {
-            predictions[i] = (*(prob_list[i]))(x,y,z);
-        }
-        if (feature_manager) {
-            feature_manager->add_val(predictions, node);
-        }
-        mito_probs[label].update(predictions); 
-
-        Label_t label2 = 0, label3 = 0, label4 = 0, label5 = 0, label6 = 0, label7 = 0;
-        if (x > 0) label2 = (*labelvol)(x-1,y,z);
-        if (x < maxx) label3 = (*labelvol)(x+1,y,z);
-        if (y > 0) label4 = (*labelvol)(x,y-1,z);
-        if (y < maxy) label5 = (*labelvol)(x,y+1,z);
-        if (z > 0) label6 = (*labelvol)(x,y,z-1);
-        if (z < maxz) label7 = (*labelvol)(x,y,z+1);
-
-        if (label2 && (label != label2)) {
-            rag_add_edge(label, label2, predictions);
-            labels.insert(label2);
-        }
-        if (label3 && (label != label3) && (labels.find(label3) == labels.end())) {
-            rag_add_edge(label, label3, predictions);
-            labels.insert(label3);
-        }
-        if (label4 && (label != label4) && (labels.find(label4) == labels.end())) {
-            rag_add_edge(label, label4, predictions);
-            labels.insert(label4);
-        }
-        if (label5 && (label != label5) && (labels.find(label5) == labels.end())) {
-            rag_add_edge(label, label5, predictions);
-            labels.insert(label5);
-        }
-        if (label6 && (label != label6) && (labels.find(label6) == labels.end())) {
-            rag_add_edge(label, label6, predictions);
-            labels.insert(label6);
-        }
-        if (label7 && (label != label7) && (labels.find(label7) == labels.end())) {
-            rag_add_edge(label, label7, predictions);
+                if (!label) {
+                    continue;
+                }
+
+                RagNode_t * node = rag_slab.find_rag_node(label);
+
+                if (!node) {
+                    node =  rag_slab.insert_rag_node(label); 
+                }
+                node->incr_size();
+                        
+                for (unsigned int i = 0; i < prob_list.size(); ++i) {
+                    predictions[i] = (*(prob_list[i]))(x,y,z);
+                }
+                if (feature_mgr_slab) {
+                    feature_mgr_slab->add_val(predictions, node);
+                }
+                mito_probs[label].update(predictions); 
+
+                Label_t label2 = 0, label3 = 0, label4 = 0, label5 = 0, label6 = 0, label7 = 0;
+                if (x > 0) label2 = (*labelvol)(x-1,y,z);
+                if (x < maxx) label3 = (*labelvol)(x+1,y,z);
+                if (y > 0) label4 = (*labelvol)(x,y-1,z);
+                if (y < maxy) label5 = (*labelvol)(x,y+1,z);
+                if (z > 0) label6 = (*labelvol)(x,y,z-1);
+                if (z < maxz) label7 = (*labelvol)(x,y,z+1);
+
+                if (label2 && (label != label2)) {
+                    rag_add_edge(rag_slab, feature_mgr_slab, label, label2, predictions);
+                    labels.insert(label2);
+                }
+                if (label3 && (label != label3) && (labels.find(label3) == labels.end())) {
+                    rag_add_edge(rag_slab, feature_mgr_slab, label, label3, predictions);
+                    labels.insert(label3);
+                }
+                if (label4 && (label != label4) && (labels.find(label4) == labels.end())) {
+                    rag_add_edge(rag_slab, feature_mgr_slab, label, label4, predictions);
+                    labels.insert(label4);
+                }
+                if (label5 && (label != label5) && (labels.find(label5) == labels.end())) {
+                    rag_add_edge(rag_slab, feature_mgr_slab, label, label5, predictions);
+                    labels.insert(label5);
+                }
+                if (label6 && (label != label6) && (labels.find(label6) == labels.end())) {
+                    rag_add_edge(rag_slab, feature_mgr_slab, label, label6, predictions);
+                    labels.insert(label6);
+                }
+                if (label7 && (label != label7) && (labels.find(label7) == labels.end())) {
+                    rag_add_edge(rag_slab, feature_mgr_slab, label, label7, predictions);
+                }
+
+                if (!label2 || !label3 || !label4 || !label5 || !label6 || !label7) {
+                    node->incr_boundary_size();
+                }
+                labels.clear();
+            }
         }
+    }
 
-        if (!label2 || !label3 || !label4 || !label5 || !label6 || !label7) {
-            node->incr_boundary_size();
-        }
-        labels.clear();
+    // store the mito statistics for the slab (type is set after all slabs are combined)
+    for (unordered_map<Label_t, MitoTypeProperty>::iterator iter = mito_probs.begin();
+            iter != mito_probs.end(); ++iter) {
+        rag_slab.find_rag_node(iter->first)->set_property(mito_type_key(), iter->second);
     }
-    
-    Label_t largest_id = 0;
-    for (Rag_t::nodes_iterator iter = rag->nodes_begin(); iter != rag->nodes_end(); ++iter) {
-        Label_t id = (*iter)->get_node_id();
-	largest_id = (id>largest_id)? id : largest_id;
-	
-        MitoTypeProperty mtype = mito_probs[id];
-        mtype.set_type(); 
-        (*iter)->set_property("mito-type", mtype);
+}
+
+void BioStack::merge_slab_node(RagNode_t* node, RagNode_t* slab_node)
+{
+    Stack::merge_slab_node(node, slab_node);
+
+    if (track_mito && slab_node->has_property(mito_type_key())) {
+        MitoTypeProperty& slab_mtype = slab_node->get_property<MitoTypeProperty>(mito_type_key());
+        if (node->has_property(mito_type_key())) {
+            node->get_property<MitoTypeProperty>(mito_type_key()).merge(slab_mtype);
+        } else {
+            node->set_property(mito_type_key(), slab_mtype);
+        }
     }
-    //printf("Done Biostack rag, largest: %u\n", largest_id);
 }
 
 
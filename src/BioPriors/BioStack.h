@@ -10,7 +10,7 @@ namespace NeuroProof {
 
 class BioStack : public Stack {
   public:
-    BioStack(VolumeLabelPtr labels_) : Stack(labels_) {}
+    BioStack(VolumeLabelPtr labels_) : Stack(labels_), track_mito(false) {}
     BioStack(std::string stack_name) ;
     
     void read_prob_list(std::string prob_filename, std::string dataset_name);
@@ -30,13 +30,25 @@ class BioStack : public Stack {
     void set_edge_locations();
 
     virtual void build_rag();
+    virtual void build_rag_stream(StackChunkReader& reader, unsigned int chunk_depth);
+
+  protected:
+    virtual void build_rag_slab(Rag_t& rag_slab, FeatureMgr* feature_mgr_slab,
+            unsigned int zstart, unsigned int zend);
+    virtual void merge_slab_node(RagNode_t* node, RagNode_t* slab_node);
 
   private:
+    //! classify nodes as mito from the statistics gathered during the build 
+    void set_mito_types();
+
     void add_edge_constraint(RagPtr rag, VolumeLabelPtr labelvol, unsigned int x1,
             unsigned int y1, unsigned int z1, unsigned int x2, unsigned int y2, unsigned int z2);
     VolumeLabelPtr create_syn_volume(VolumeLabelPtr labelvol);
 
     std::vector<std::vector<unsigned int> > synapse_locations; 
+
+    //! accumulate mito statistics while building the rag 
+    bool track_mito;
 };
 
 
@@ -1,10 +1,21 @@
 #ifndef MITOTYPEPROPERTY_H
 #define MITOTYPEPROPERTY_H
 
+#include <Rag/Property.h>
 #include <vector>
 
 namespace NeuroProof {
 
+/*!
+ * Interned key of the node property holding the MitoTypeProperty
+ * \return property key
+*/
+inline PropertyKey mito_type_key()
+{
+    static const PropertyKey key = PropertyKeys::get_key("mito-type");
+    return key;
+}
+
 class MitoTypeProperty {
   public:
     MitoTypeProperty() : node_type(0), sum_mitop(0), npixels(0), mito_channel(2) { }
@@ -18,6 +29,11 @@ class MitoTypeProperty {
         sum_mitop += mitop; 
         npixels++;
     }        
+    void merge(const MitoTypeProperty& mtype2)
+    {
+        sum_mitop += mtype2.sum_mitop;
+        npixels += mtype2.npixels;
+    }
     void set_type()
     {
         double mito_pct = sum_mitop/npixels;	
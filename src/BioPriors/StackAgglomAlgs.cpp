@@ -14,9 +14,8 @@ namespace NeuroProof {
 bool is_mito(RagNode_t* rag_node)
 {
     MitoTypeProperty mtype;
-    try {
-        mtype = rag_node->get_property<MitoTypeProperty>("mito-type");
-    } catch (ErrMsg& msg) {
+    if (rag_node->has_property(mito_type_key())) {
+        mtype = rag_node->get_property<MitoTypeProperty>(mito_type_key());
     }
 
     if ((mtype.get_node_type()==2)) {	
@@ -67,6 +66,46 @@ void agglomerate_stack(Stack& stack, double threshold,
     delete priority;
 }
 
+void agglomerate_stack_indexed(Stack& stack, double threshold,
+                        bool use_mito, bool use_edge_weight, bool synapse_mode)
+{
+    if (threshold == 0.0) {
+        return;
+    }
+
+    RagPtr rag = stack.get_rag();
+    FeatureMgrPtr feature_mgr = stack.get_feature_manager();
+
+    // edges are re-keyed in place after every merge, so the top of the
+    // heap is always a current merge candidate
+    IndexedProbPriority priority(feature_mgr.get(), rag.get(), synapse_mode);
+    priority.initialize_priority(threshold, use_edge_weight);
+    IndexedPriorityCombine node_combine_alg(feature_mgr.get(), rag.get(), &priority); 
+    
+    while (!(priority.empty())) {
+        RagEdge_t* rag_edge = priority.get_top_edge();
+
+        if (!rag_edge) {
+            continue;
+        }
+
+        RagNode_t* rag_node1 = rag_edge->get_node1();
+        RagNode_t* rag_node2 = rag_edge->get_node2();
+
+        if (use_mito) {
+            if (is_mito(rag_node1) || is_mito(rag_node2)) {
+                continue;
+            }
+        }
+
+        Node_t node1 = rag_node1->get_node_id(); 
+        Node_t node2 = rag_node2->get_node_id();
+        
+        // retain node1 
+        stack.merge_labels(node2, node1, &node_combine_alg);
+    }
+}
+
 void agglomerate_stack_mrf(Stack& stack, double threshold, bool use_mito)
 {
     if (threshold == 0.0) {
@@ -82,19 +121,19 @@ void agglomerate_stack_mrf(Stack& stack, double threshold, bool use_mito)
 
     unsigned int edgeCount=0;	
 
+    vector<RagEdge_t*> edges;
     for (Rag_t::edges_iterator iter = rag->edges_begin(); iter != rag->edges_end(); ++iter) {
         if ( (!(*iter)->is_preserve()) && (!(*iter)->is_false_edge()) ) {
-	    double prev_val = (*iter)->get_weight();	
-            double val = feature_mgr->get_prob(*iter);
-            (*iter)->set_weight(val);
-
-            (*iter)->set_property("qloc", edgeCount);
-
-	    Node_t node1 = (*iter)->get_node1()->get_node_id();	
-	    Node_t node2 = (*iter)->get_node2()->get_node_id();	
+            edges.push_back(*iter);
+        }
+    }
+    vector<double> probs;
+    feature_mgr->get_probs(edges, probs);
 
-	    edgeCount++;
-	}
+    for (unsigned int i = 0; i < edges.size(); ++i) {
+        edges[i]->set_weight(probs[i]);
+        edges[i]->set_property(qloc_key(), edgeCount);
+        edgeCount++;
     }
 
     agglomerate_stack(stack, threshold, use_mito, true);
@@ -110,32 +149,39 @@ void agglomerate_stack_queue(Stack& stack, double threshold,
     RagPtr rag = stack.get_rag();
     FeatureMgrPtr feature_mgr = stack.get_feature_manager();
 
-    vector<QE> all_edges;	    	
-    int count=0; 	
+    vector<RagEdge_t*> edges;
     for (Rag_t::edges_iterator iter = rag->edges_begin(); iter != rag->edges_end(); ++iter) {
         if ( (!(*iter)->is_preserve()) && (!(*iter)->is_false_edge()) ) {
+            edges.push_back(*iter);
+        }
+    }
+    vector<double> probs;
+    if (!use_edge_weight) {
+        feature_mgr->get_probs(edges, probs);
+    }
 
+    vector<QE> all_edges;	    	
+    int count=0; 	
+    for (unsigned int i = 0; i < edges.size(); ++i) {
+        RagNode_t* rag_node1 = edges[i]->get_node1();
+        RagNode_t* rag_node2 = edges[i]->get_node2();
 
-            RagNode_t* rag_node1 = (*iter)->get_node1();
-            RagNode_t* rag_node2 = (*iter)->get_node2();
-
-            Node_t node1 = rag_node1->get_node_id(); 
-            Node_t node2 = rag_node2->get_node_id(); 
+        Node_t node1 = rag_node1->get_node_id(); 
+        Node_t node2 = rag_node2->get_node_id(); 
 
-            double val;
-            if(use_edge_weight)
-                val = (*iter)->get_weight();
-            else	
-                val = feature_mgr->get_prob(*iter);    
+        double val;
+        if(use_edge_weight)
+            val = edges[i]->get_weight();
+        else	
+            val = probs[i];    
 
-            (*iter)->set_weight(val);
-            (*iter)->set_property("qloc", count);
+        edges[i]->set_weight(val);
+        edges[i]->set_property(qloc_key(), count);
 
-            QE tmpelem(val, make_pair(node1,node2));	
-            all_edges.push_back(tmpelem); 
+        QE tmpelem(val, make_pair(node1,node2));	
+        all_edges.push_back(tmpelem); 
 
-            count++;
-        }
+        count++;
     }
 
     double error=0;  	
@@ -242,15 +288,11 @@ void agglomerate_stack_mito(Stack& stack, double threshold)
         RagNode_t* rag_node2 = rag_edge->get_node2();
 
         MitoTypeProperty mtype1, mtype2;
-	try {    
-            mtype1 = rag_node1->get_property<MitoTypeProperty>("mito-type");
-        } catch (ErrMsg& msg) {
-        
+        if (rag_node1->has_property(mito_type_key())) {
+            mtype1 = rag_node1->get_property<MitoTypeProperty>(mito_type_key());
         }
-        try {    
-            mtype2 = rag_node2->get_property<MitoTypeProperty>("mito-type");
-        } catch (ErrMsg& msg) {
-        
+        if (rag_node2->has_property(mito_type_key())) {
+            mtype2 = rag_node2->get_property<MitoTypeProperty>(mito_type_key());
         }
         if ((mtype1.get_node_type()==2) && (mtype2.get_node_type()==1))	{
             RagNode_t* tmp = rag_node1;
@@ -8,6 +8,9 @@ class Stack;
 void agglomerate_stack(Stack& stack, double threshold,
                         bool use_mito, bool use_edge_weight = false, bool synapse_mode=false);
 
+void agglomerate_stack_indexed(Stack& stack, double threshold,
+                        bool use_mito, bool use_edge_weight = false, bool synapse_mode=false);
+
 void agglomerate_stack_mrf(Stack& stack, double threshold, bool use_mito);
 
 void agglomerate_stack_queue(Stack& stack, double threshold, 
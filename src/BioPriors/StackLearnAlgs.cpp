@@ -100,20 +100,27 @@ void learn_edge_classifier_queue(BioStack& stack, double threshold,
    
     vector<QE> all_edges;	    	
     int count = 0; 	
+    vector<RagEdge_t*> edges;
     for (Rag_t::edges_iterator iter = rag->edges_begin(); iter != rag->edges_end(); ++iter) {
         if ( (!(*iter)->is_preserve()) && (!(*iter)->is_false_edge()) ) {
-            double val = feature_mgr->get_prob(*iter);
-            (*iter)->set_weight(val);
-	    (*iter)->set_property("qloc", count);
-	    Node_t node1 = (*iter)->get_node1()->get_node_id();	
-	    Node_t node2 = (*iter)->get_node2()->get_node_id();	
-
-            QE tmpelem(val, make_pair(node1, node2));	
-	    all_edges.push_back(tmpelem); 
-	
-  	    count++;
+            edges.push_back(*iter);
         }
     }
+    vector<double> probs;
+    feature_mgr->get_probs(edges, probs);
+
+    for (unsigned int i = 0; i < edges.size(); ++i) {
+        double val = probs[i];
+        edges[i]->set_weight(val);
+        edges[i]->set_property(qloc_key(), count);
+        Node_t node1 = edges[i]->get_node1()->get_node_id();	
+        Node_t node2 = edges[i]->get_node2()->get_node_id();	
+
+        QE tmpelem(val, make_pair(node1, node2));	
+        all_edges.push_back(tmpelem); 
+
+        count++;
+    }
 
     MergePriorityQueue<QE> *Q = new MergePriorityQueue<QE>(rag.get());
     Q->set_storage(&all_edges);	
@@ -207,20 +214,26 @@ void learn_edge_classifier_lash(BioStack& stack, double threshold,
     vector<QE> all_edges;	    	
 
     int count=0; 	
+    vector<RagEdge_t*> edges;
     for (Rag_t::edges_iterator iter = rag->edges_begin(); iter != rag->edges_end(); ++iter) {
         if ( (!(*iter)->is_preserve()) && (!(*iter)->is_false_edge()) ) {
-            double val = feature_mgr->get_prob(*iter);
-            (*iter)->set_weight(val);
-	    (*iter)->set_property("qloc", count);
+            edges.push_back(*iter);
+        }
+    }
+    vector<double> probs;
+    feature_mgr->get_probs(edges, probs);
 
-	    Node_t node1 = (*iter)->get_node1()->get_node_id();	
-	    Node_t node2 = (*iter)->get_node2()->get_node_id();	
+    for (unsigned int i = 0; i < edges.size(); ++i) {
+        double val = probs[i];
+        edges[i]->set_weight(val);
+        edges[i]->set_property(qloc_key(), count);
+        Node_t node1 = edges[i]->get_node1()->get_node_id();	
+        Node_t node2 = edges[i]->get_node2()->get_node_id();	
 
-            QE tmpelem(val, make_pair(node1, node2));	
-	    all_edges.push_back(tmpelem); 
-	
-  	    count++;
-        }
+        QE tmpelem(val, make_pair(node1, node2));	
+        all_edges.push_back(tmpelem); 
+
+        count++;
     }
 
     MergePriorityQueue<QE> *Q = new MergePriorityQueue<QE>(rag.get());
@@ -2,6 +2,9 @@
 #ifndef _edge_classifier
 #define _edge_classifier
 
+#include <vector>
+#include <algorithm>
+
 class EdgeClassifier{
 
 
@@ -15,6 +18,21 @@ public:
 	    return val;	
 	    
 	}
+	// predict many samples stored row by row in pfeatures
+	virtual void predict(std::vector<double>& pfeatures, unsigned int num_samples,
+                std::vector<double>& probs){
+	    probs.resize(num_samples);
+	    if (num_samples == 0) {
+	        return;
+	    }
+	    unsigned int nfeatures = pfeatures.size() / num_samples;
+	    std::vector<double> features(nfeatures);
+	    for (unsigned int i = 0; i < num_samples; ++i) {
+	        std::copy(pfeatures.begin() + i*nfeatures,
+                        pfeatures.begin() + (i+1)*nfeatures, features.begin());
+	        probs[i] = predict(features);
+	    }
+	}
 	virtual void learn(std::vector< std::vector<double> >& pfeatures, std::vector<int>& plabels)=0;
 	virtual void save_classifier(const char* rf_filename)=0;
 	virtual bool is_trained()=0;
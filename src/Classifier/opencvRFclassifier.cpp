@@ -81,6 +81,43 @@ double OpencvRFclassifier::predict(std::vector<double>& pfeatures){
 }	
 
 
+void OpencvRFclassifier::predict(std::vector<double>& pfeatures, unsigned int num_samples,
+        std::vector<double>& probs){
+    if(!_rf){
+        EdgeClassifier::predict(pfeatures, num_samples, probs);
+        return;
+    }
+    probs.resize(num_samples);
+    if (num_samples == 0) {
+        return;
+    }
+
+    // one matrix for the whole batch; rows are viewed without copying
+    int nfeatures = pfeatures.size() / num_samples;
+    CvMat* features = cvCreateMat(num_samples, nfeatures, CV_32F);
+    float* datap = features->data.fl; 	
+    for(size_t i=0;i< pfeatures.size();i++)
+        datap[i] = pfeatures[i];
+
+    int ntrees = _rf->get_tree_count();
+    CvMat sample;
+    for(unsigned int s=0; s < num_samples; s++){
+        cvGetRow(features, &sample, s);
+
+        double prob = 0;
+        for(int i=0; i < ntrees; i++){
+            int class_idx = _trees[i]->predict(&sample)->class_idx;
+            double resp = (class_idx > 0) ? 1 : 0 ; 	
+            resp *= _tree_weights[i];
+            prob += resp;
+        }
+        probs[s] = prob;
+    }
+
+    cvReleaseMat( &features );
+}
+
+
 void OpencvRFclassifier::learn(std::vector< std::vector<double> >& pfeatures, std::vector<int>& plabels){
 
      if (_rf){
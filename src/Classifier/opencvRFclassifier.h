@@ -36,6 +36,8 @@ public:
      }	
      void  load_classifier(const char* rf_filename);
      double predict(std::vector<double>& features);
+     void predict(std::vector<double>& pfeatures, unsigned int num_samples,
+             std::vector<double>& probs);
      void learn(std::vector< std::vector<double> >& pfeatures, std::vector<int>& plabels);
      void save_classifier(const char* rf_filename);
 
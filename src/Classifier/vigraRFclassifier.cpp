@@ -67,6 +67,32 @@ double VigraRFclassifier::predict(std::vector<double>& features){
 }	
 
 
+void VigraRFclassifier::predict(std::vector<double>& pfeatures, unsigned int num_samples,
+        std::vector<double>& probs){
+    if(!_rf){
+        EdgeClassifier::predict(pfeatures, num_samples, probs);
+        return;
+    }
+    probs.resize(num_samples);
+    if (num_samples == 0) {
+        return;
+    }
+    assert(pfeatures.size() == (size_t)num_samples*_nfeatures);
+
+    // score all samples with a single forest traversal call
+    MultiArray<2, float> vfeatures(Shape(num_samples,_nfeatures));
+    MultiArray<2, float> prob(Shape(num_samples, _nclass));
+    for(unsigned int s=0;s<num_samples;s++)
+        for(int i=0;i<_nfeatures;i++)
+            vfeatures(s,i)= (float)pfeatures[s*_nfeatures+i];
+
+    _rf->predictProbabilities(vfeatures, prob);    
+
+    for(unsigned int s=0;s<num_samples;s++)
+        probs[s] = (double) prob(s,1);
+}
+
+
 void VigraRFclassifier::learn(std::vector< std::vector<double> >& pfeatures, std::vector<int>& plabels){
 
      if (_rf)
@@ -2,8 +2,12 @@
 
 #include "EdgeEditor.h"
 
+#include <boost/thread/thread.hpp>
+#include <boost/shared_ptr.hpp>
 #include <iostream>
 #include <map>
+#include <random>
+#include <cmath>
 
 using std::vector; using std::set;
 using std::unordered_set; using std::unordered_map;
@@ -21,7 +25,7 @@ vector<Node_t> EdgeEditor::getQAViolators(unsigned int threshold)
             iter != rag.nodes_end(); ++iter) {
         unsigned long long synapse_weight = 0;
         try {   
-            synapse_weight = (*iter)->get_property<unsigned long long>(SynapseStr);
+            synapse_weight = (*iter)->get_property<unsigned long long>(SynapseKey);
         } catch(...) {
             //
         }
@@ -40,6 +44,7 @@ void EdgeEditor::set_synapse_mode(double ignore_size_, double upper)
     reinitialize_scheduler();
 
     ignore_size = ignore_size_;
+    mode_upper = upper;
     synapse_edge_mode->initialize(ignore_size_, upper);
     edge_mode = synapse_edge_mode;
 }
@@ -49,6 +54,8 @@ void EdgeEditor::set_body_mode(double ignore_size_, int depth, double upper)
     reinitialize_scheduler();
     
     ignore_size = ignore_size_;
+    mode_depth = depth;
+    mode_upper = upper;
     body_edge_mode->initialize(ignore_size_, depth, upper);
     edge_mode = body_edge_mode;
 }
@@ -62,6 +69,14 @@ void EdgeEditor::set_orphan_mode(double ignore_size_)
     edge_mode = orphan_edge_mode;
 }
 
+void EdgeEditor::set_incremental_mode(bool incremental)
+{
+    incremental_mode = incremental;
+    synapse_edge_mode->set_incremental(incremental);
+    body_edge_mode->set_incremental(incremental);
+    orphan_edge_mode->set_incremental(incremental);
+}
+
 void EdgeEditor::set_custom_mode(EdgeRank* edge_mode_)
 {
     //reinitialize_scheduler(); -- should be enabled but untested
@@ -75,6 +90,9 @@ void EdgeEditor::set_edge_mode(double lower, double upper, double start,
     reinitialize_scheduler();
     
     ignore_size = ignore_size_;
+    mode_lower = lower;
+    mode_upper = upper;
+    mode_start = start;
     prob_edge_mode->initialize(lower, upper, start, ignore_size);
     edge_mode = prob_edge_mode;
 }
@@ -112,6 +130,166 @@ void EdgeEditor::estimateWork()
     num_est_remaining = num_edges;
 }
 
+void EdgeEditor::estimateWork(unsigned int num_trials, unsigned int num_threads,
+        unsigned int seed)
+{
+    if (num_trials < 1) {
+        throw ErrMsg("At least one trial is needed to estimate work");
+    }
+
+    // trials can only restart the builtin modes
+    if ((edge_mode != synapse_edge_mode) && (edge_mode != body_edge_mode) &&
+            (edge_mode != orphan_edge_mode) && (edge_mode != prob_edge_mode)) {
+        estimateWork();
+        est_mean = num_est_remaining;
+        est_conf_interval = 0.0;
+        return;
+    }
+
+    if (num_threads < 1) {
+        num_threads = boost::thread::hardware_concurrency();
+    }
+    if (num_threads > num_trials) {
+        num_threads = num_trials;
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+
+    vector<unsigned int> trial_edits(num_trials, 0);
+    size_t next_trial = 0;
+    boost::mutex mutex;
+    string error;
+
+    boost::thread_group threads;
+    for (unsigned int i = 0; i < num_threads; ++i) {
+        threads.create_thread(ThreadEstimate(*this, seed, trial_edits,
+                    next_trial, mutex, error));
+    }
+    threads.join_all();
+
+    if (!error.empty()) {
+        throw ErrMsg(error);
+    }
+
+    double sum = 0.0;
+    for (size_t i = 0; i < trial_edits.size(); ++i) {
+        sum += trial_edits[i];
+    }
+    est_mean = sum / num_trials;
+
+    // 95% confidence interval of the mean from the sample variance
+    est_conf_interval = 0.0;
+    if (num_trials > 1) {
+        double diff_sum = 0.0;
+        for (size_t i = 0; i < trial_edits.size(); ++i) {
+            diff_sum += (trial_edits[i] - est_mean) * (trial_edits[i] - est_mean);
+        }
+        est_conf_interval = 1.96 * std::sqrt(diff_sum / (num_trials - 1) / num_trials);
+    }
+
+    num_est_remaining = (unsigned int)(est_mean + 0.5);
+}
+
+void EdgeEditor::ThreadEstimate::operator()()
+{
+    while (1) {
+        size_t trial;
+        {
+            boost::mutex::scoped_lock scoped_lock(mutex);
+            if (!error.empty() || (next_trial == trial_edits.size())) {
+                return;
+            }
+            trial = next_trial++;
+        }
+
+        try {
+            // each trial owns its slot so no lock is needed
+            trial_edits[trial] = editor.run_estimate_trial(seed + (unsigned int)(trial));
+        } catch (std::exception& e) {
+            // errors are rethrown by the calling thread
+            boost::mutex::scoped_lock scoped_lock(mutex);
+            if (error.empty()) {
+                error = e.what();
+            }
+        } catch (...) {
+            boost::mutex::scoped_lock scoped_lock(mutex);
+            if (error.empty()) {
+                error = "Unknown error in estimate trial";
+            }
+        }
+    }
+}
+
+unsigned int EdgeEditor::run_estimate_trial(unsigned int seed) const
+{
+    // the snapshot shares node and edge properties with the RAG; the trial
+    // only replaces properties with 'set_property' (never writes through
+    // 'get_property'), so nothing in the original RAG is modified
+    Rag_t trial_rag(rag, true);
+    LowWeightCombine trial_join_alg;
+
+    boost::shared_ptr<EdgeRank> trial_mode;
+    if (edge_mode == synapse_edge_mode) {
+        SynapseRank* synapse_mode = new SynapseRank(&trial_rag);
+        trial_mode = boost::shared_ptr<EdgeRank>(synapse_mode);
+        synapse_mode->set_incremental(incremental_mode);
+        synapse_mode->initialize(ignore_size, mode_upper);
+    } else if (edge_mode == body_edge_mode) {
+        NodeSizeRank* body_mode = new NodeSizeRank(&trial_rag);
+        trial_mode = boost::shared_ptr<EdgeRank>(body_mode);
+        body_mode->set_incremental(incremental_mode);
+        body_mode->initialize(ignore_size, mode_depth, mode_upper);
+    } else if (edge_mode == orphan_edge_mode) {
+        OrphanRank* orphan_mode = new OrphanRank(&trial_rag);
+        trial_mode = boost::shared_ptr<EdgeRank>(orphan_mode);
+        orphan_mode->set_incremental(incremental_mode);
+        orphan_mode->initialize(ignore_size);
+    } else {
+        ProbEdgeRank* prob_mode = new ProbEdgeRank(&trial_rag);
+        trial_mode = boost::shared_ptr<EdgeRank>(prob_mode);
+        prob_mode->initialize(mode_lower, mode_upper, mode_start, ignore_size);
+    }
+
+    // same decisions as 'estimateWork()' with a random generator per trial
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> distribution(0, 99);
+    unsigned int num_edges = 0;
+
+    while (!(trial_mode->is_finished())) {
+        NodePair pair;
+        trial_mode->get_top_edge(pair);
+
+        Node_t node1 = boost::get<0>(pair);
+        Node_t node2 = boost::get<1>(pair);
+        RagNode_t* node_keep = trial_rag.find_rag_node(node1);
+        RagNode_t* node_remove = trial_rag.find_rag_node(node2);
+        RagEdge_t* temp_edge = trial_rag.find_rag_edge(node_keep, node_remove);
+
+        int weightint = int(100 * temp_edge->get_weight());
+        bool remove = (distribution(generator) > weightint);
+        if (remove) {
+            unsigned long long synapse_weight = 0;
+            if (node_keep->has_property(SynapseKey)) {
+                synapse_weight += node_keep->get_property<unsigned long long>(SynapseKey);
+            }
+            if (node_remove->has_property(SynapseKey)) {
+                synapse_weight += node_remove->get_property<unsigned long long>(SynapseKey);
+            }
+
+            rag_join_nodes(trial_rag, node_keep, node_remove, &trial_join_alg);
+            node_keep->set_property(SynapseKey, synapse_weight);
+        } else {
+            temp_edge->set_weight(1.2);
+        }
+
+        trial_mode->examined_edge(pair, remove);
+        ++num_edges;
+    }
+
+    return num_edges;
+}
+
 
 void EdgeEditor::reinitialize_scheduler()
 {
@@ -122,7 +300,10 @@ void EdgeEditor::reinitialize_scheduler()
 EdgeEditor::EdgeEditor(Rag_t& rag_, double min_val_,
         double max_val_, double start_val_, Json::Value& json_vals) : 
     rag(rag_), min_val(min_val_), max_val(max_val_),
-    start_val(start_val_), SynapseStr("synapse_weight")
+    start_val(start_val_), mode_lower(0.0), mode_upper(0.0), mode_start(0.0),
+    mode_depth(0), incremental_mode(false), est_mean(0.0),
+    est_conf_interval(0.0), SynapseStr("synapse_weight"),
+    SynapseKey(PropertyKeys::get_key(SynapseStr))
 // EdgeEditor::EdgeEditor(Rag_t& rag_, double min_val_,
 //         double max_val_, double start_val_, Json::Value& json_vals) : 
 //     rag(rag_), min_val(min_val_), max_val(max_val_),
@@ -167,9 +348,9 @@ EdgeEditor::EdgeEditor(Rag_t& rag_, double min_val_,
     // load synapse info
     Json::Value json_synapse_weights = json_vals["synapse_bodies"];
     for (unsigned int i = 0; i < json_synapse_weights.size(); ++i) {
-        Node_t node_syn = (json_synapse_weights[i])[(unsigned int)(0)].asUInt();
+        Node_t node_syn = (json_synapse_weights[i])[(unsigned int)(0)].asLargestUInt();
         RagNode_t* rag_node = rag.find_rag_node(node_syn);
-        rag_node->set_property(SynapseStr,
+        rag_node->set_property(SynapseKey,
                 (unsigned long long)((json_synapse_weights[i])[(unsigned int)(1)].asUInt()));
     }
 
@@ -179,7 +360,7 @@ EdgeEditor::EdgeEditor(Rag_t& rag_, double min_val_,
     Json::Value json_orphan = json_vals["orphan_bodies"];
     unordered_set<Node_t> orphan_set;
     for (unsigned int i = 0; i < json_orphan.size(); ++i) {
-        RagNode_t* rag_node = rag.find_rag_node(json_orphan[i].asUInt());
+        RagNode_t* rag_node = rag.find_rag_node(json_orphan[i].asLargestUInt());
         rag_node->set_boundary_size(0);
         orphan_set.insert(rag_node->get_node_id());
     }
@@ -253,7 +434,7 @@ void EdgeEditor::export_json(Json::Value& json_writer)
         bool is_orphan = !((*iter)->is_boundary());
         unsigned long long synapse_weight = 0;
         try {
-            synapse_weight = (*iter)->get_property<unsigned long long>(SynapseStr);
+            synapse_weight = (*iter)->get_property<unsigned long long>(SynapseKey);
         } catch(...) {
             //
         }
@@ -342,7 +523,7 @@ boost::tuple<Node_t, Node_t> EdgeEditor::getTopEdge(Location& location)
         /*if (!edge){
 	  printf("selected edge not found\n");
 	}*/
-        location = edge->get_property<Location>("location");
+        location = edge->get_property<Location>(location_key());
     } catch(ErrMsg& msg) {
         cerr << msg.str << endl;
         throw ErrMsg("Priority scheduler crashed");
@@ -377,19 +558,19 @@ void EdgeEditor::removeEdge(NodePair node_pair, bool remove)
         unsigned long long  synapse_weight2 = 0;
 
         try {
-            synapse_weight1 = node_keep->get_property<unsigned long long>(SynapseStr);
+            synapse_weight1 = node_keep->get_property<unsigned long long>(SynapseKey);
         } catch(...) {
             //
         }
         try {
-            synapse_weight2 = node_remove->get_property<unsigned long long>(SynapseStr);
+            synapse_weight2 = node_remove->get_property<unsigned long long>(SynapseKey);
         } catch(...) {
             //
         }
 
         // modifies rag
         removeEdge2(node_pair, true, node_properties);
-        node_keep->set_property(SynapseStr, synapse_weight1+synapse_weight2);
+        node_keep->set_property(SynapseKey, synapse_weight1+synapse_weight2);
 
     } else {
         setEdge(node_pair, 1.2);
@@ -411,8 +592,8 @@ void EdgeEditor::removeEdge2(NodePair node_pair, bool remove,
     history.weight = edge->get_weight();
     history.preserve_edge = edge->is_preserve();
     history.false_edge = edge->is_false_edge();
-    history.property_list_curr.push_back(edge->get_property_ptr("location"));
-    history.property_list_curr.push_back(edge->get_property_ptr("edge_size")); 
+    history.property_list_curr.push_back(edge->get_property_ptr(location_key()));
+    history.property_list_curr.push_back(edge->get_property_ptr(edge_size_key())); 
 
     // node id that is kept
     history.remove = true;
@@ -449,8 +630,8 @@ void EdgeEditor::removeEdge2(NodePair node_pair, bool remove,
             history.false_edge1.push_back((*iter)->is_false_edge());
 
             vector<boost::shared_ptr<Property> > property_list;
-            property_list.push_back((*iter)->get_property_ptr("location"));  
-            property_list.push_back((*iter)->get_property_ptr("edge_size"));  
+            property_list.push_back((*iter)->get_property_ptr(location_key()));  
+            property_list.push_back((*iter)->get_property_ptr(edge_size_key()));  
             history.property_list1.push_back(property_list);
         }
     } 
@@ -465,8 +646,8 @@ void EdgeEditor::removeEdge2(NodePair node_pair, bool remove,
             history.false_edge2.push_back((*iter)->is_false_edge());
 
             vector<boost::shared_ptr<Property> > property_list;
-            property_list.push_back((*iter)->get_property_ptr("location"));  
-            property_list.push_back((*iter)->get_property_ptr("edge_size"));  
+            property_list.push_back((*iter)->get_property_ptr(location_key()));  
+            property_list.push_back((*iter)->get_property_ptr(edge_size_key()));  
             history.property_list2.push_back(property_list);
         }
     }
@@ -499,8 +680,8 @@ bool EdgeEditor::undo2()
             temp_edge->set_preserve(history.preserve_edge1[i]);
             temp_edge->set_false_edge(history.false_edge1[i]);
 
-            temp_edge->set_property_ptr("location", history.property_list1[i][0]);
-            temp_edge->set_property_ptr("edge_size", history.property_list1[i][1]);
+            temp_edge->set_property_ptr(location_key(), history.property_list1[i][0]);
+            temp_edge->set_property_ptr(edge_size_key(), history.property_list1[i][1]);
         } 
         for (int i = 0; i < history.node_list2.size(); ++i) {
             RagEdge_t* temp_edge = rag.insert_rag_edge(temp_node2,
@@ -509,8 +690,8 @@ bool EdgeEditor::undo2()
             temp_edge->set_preserve(history.preserve_edge2[i]);
             temp_edge->set_false_edge(history.false_edge2[i]);
 
-            temp_edge->set_property_ptr("location", history.property_list2[i][0]);
-            temp_edge->set_property_ptr("edge_size", history.property_list2[i][1]);
+            temp_edge->set_property_ptr(location_key(), history.property_list2[i][0]);
+            temp_edge->set_property_ptr(edge_size_key(), history.property_list2[i][1]);
         }
 
         RagEdge_t* temp_edge = rag.insert_rag_edge(temp_node1, temp_node2);
@@ -518,8 +699,8 @@ bool EdgeEditor::undo2()
         temp_edge->set_preserve(history.preserve_edge); 
         temp_edge->set_false_edge(history.false_edge); 
 
-        temp_edge->set_property_ptr("location", history.property_list_curr[0]);
-        temp_edge->set_property_ptr("edge_size", history.property_list_curr[1]);
+        temp_edge->set_property_ptr(location_key(), history.property_list_curr[0]);
+        temp_edge->set_property_ptr(edge_size_key(), history.property_list_curr[1]);
 
         for (NodePropertyMap::iterator iter = history.node_properties1.begin(); 
                 iter != history.node_properties1.end();
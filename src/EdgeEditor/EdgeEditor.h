@@ -26,9 +26,30 @@
 #include <set>
 #include <map>
 #include <boost/tuple/tuple.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace NeuroProof {
 
+/*!
+ * Interned key of the edge property holding the location of an edge
+ * \return property key
+*/
+inline PropertyKey location_key()
+{
+    static const PropertyKey key = PropertyKeys::get_key("location");
+    return key;
+}
+
+/*!
+ * Interned key of the edge property holding the size saved with an edge
+ * \return property key
+*/
+inline PropertyKey edge_size_key()
+{
+    static const PropertyKey key = PropertyKeys::get_key("edge_size");
+    return key;
+}
+
 /*!
  * Implements strategy for merging two nodes.  For now, the
  * the edge editor does not recompute uncertainties after merging
@@ -39,15 +60,15 @@ namespace NeuroProof {
 */
 class LowWeightCombine : public RagNodeCombineAlg {
   public:
-    void post_edge_move(RagEdge<unsigned int>* edge_new,
-            RagEdge<unsigned int>* edge_remove)
+    void post_edge_move(RagEdge_t* edge_new,
+            RagEdge_t* edge_remove)
     {
         double weight = edge_remove->get_weight();
         edge_new->set_weight(weight);
     }
 
-    void post_edge_join(RagEdge<unsigned int>* edge_keep,
-            RagEdge<unsigned int>* edge_remove)
+    void post_edge_join(RagEdge_t* edge_keep,
+            RagEdge_t* edge_remove)
     {
         double weight = edge_remove->get_weight();
         // take the smaller weight except if it is marked with a value
@@ -56,8 +77,8 @@ class LowWeightCombine : public RagNodeCombineAlg {
                 || (weight > 1.0) ) { 
             edge_keep->set_weight(weight);
             try {
-                Location location = edge_remove->get_property<Location>("location");
-                edge_keep->set_property("location", location);
+                Location location = edge_remove->get_property<Location>(location_key());
+                edge_keep->set_property(location_key(), location);
             } catch (...) {
                 //
             }
@@ -65,16 +86,16 @@ class LowWeightCombine : public RagNodeCombineAlg {
 
 	if (edge_keep->is_false_edge()) {
             try {
-                Location location = edge_remove->get_property<Location>("location");
-                edge_keep->set_property("location", location);
+                Location location = edge_remove->get_property<Location>(location_key());
+                edge_keep->set_property(location_key(), location);
             } catch (...) {
                 //
             }
 	}
     }
 
-    void post_node_join(RagNode<unsigned int>* node_keep,
-            RagNode<unsigned int>* node_remove) {}
+    void post_node_join(RagNode_t* node_keep,
+            RagNode_t* node_remove) {}
 };
 
 class BodyRankList;
@@ -149,6 +170,15 @@ class EdgeEditor {
     */
     void set_synapse_mode(double ignore_size_, double upper=0.9);
 
+    /*!
+     * Enable caching of the uncertain node found for each body in the
+     * synapse, body, and orphan modes so that a decision only updates
+     * the bodies with affinity paths through the examined edge.  Should
+     * be called before the mode is set.
+     * \param incremental true to enable caching
+    */
+    void set_incremental_mode(bool incremental);
+
     /*!
      * Find the number of edges that need to be examined (or an estimate).
      * \return number of edges remaining
@@ -178,6 +208,47 @@ class EdgeEditor {
     std::vector<Node_t> getQAViolators(unsigned int threshold);
     void estimateWork();
 
+    /*!
+     * Estimate the number of edges that need to be examined by running
+     * independent randomized sessions of the current mode in parallel.
+     * Each trial restarts the mode on its own snapshot of the RAG (nodes
+     * and edges are copied, their properties are shared copy-on-write)
+     * and decides each edge randomly, weighted by its confidence, so the
+     * RAG and the current session are never modified and nothing needs
+     * to be undone.  Unlike 'estimateWork()', which continues from the
+     * state of the current mode, a trial re-initializes the mode from
+     * the current RAG with the parameters the mode was set with: the
+     * progress of the mode in this session (e.g., its position in the
+     * edge queue) is not carried over, so the two estimates are only
+     * comparable right after the mode is set.  Trial i uses seed + i, so for the same seed the
+     * estimate does not depend on the number of threads.  A custom mode
+     * falls back to a single run of 'estimateWork()'.
+     * \param num_trials number of randomized sessions
+     * \param num_threads number of threads (0 = number of cores)
+     * \param seed seed for the random decisions of the trials
+    */
+    void estimateWork(unsigned int num_trials, unsigned int num_threads = 0,
+            unsigned int seed = 0);
+
+    /*!
+     * Mean number of edges examined in the trials of the last estimate.
+     * \return mean number of edges
+    */
+    double get_est_mean()
+    {
+        return est_mean;
+    }
+
+    /*!
+     * Half-width of the 95% confidence interval of the mean number of
+     * edges examined in the trials of the last estimate.
+     * \return confidence interval half-width (0 for a single trial)
+    */
+    double get_est_conf_interval()
+    {
+        return est_conf_interval;
+    }
+
     /*!
      * Produce the most uncertain edge and its location.
      * \param location 3D location estimate for the edge
@@ -244,6 +315,43 @@ class EdgeEditor {
      * \return true if successful
     */
     bool undo2();
+
+    /*!
+     * Runs one randomized session of the current mode on a copy of the
+     * RAG (called concurrently by the estimate threads).
+     * \param seed seed for the random decisions of the trial
+     * \return number of edges examined
+    */
+    unsigned int run_estimate_trial(unsigned int seed) const;
+
+    /*!
+     * Runs estimate trials until none are left (one per thread).
+    */
+    class ThreadEstimate {
+      public:
+        ThreadEstimate(const EdgeEditor& editor_, unsigned int seed_,
+                std::vector<unsigned int>& trial_edits_, size_t& next_trial_,
+                boost::mutex& mutex_, std::string& error_) : editor(editor_),
+            seed(seed_), trial_edits(trial_edits_), next_trial(next_trial_),
+            mutex(mutex_), error(error_) {}
+
+        void operator()();
+
+      private:
+        //! Editor with the RAG and the mode to estimate
+        const EdgeEditor& editor;
+
+        //! Seed shared by all trials
+        unsigned int seed;
+
+        //! Number of edges examined in each trial
+        std::vector<unsigned int>& trial_edits;
+
+        //! Next trial to run and the first error found
+        size_t& next_trial;
+        boost::mutex& mutex;
+        std::string& error;
+    };
     
     //! Rag that will be examined with a focused strategy
     Rag_t& rag;
@@ -350,12 +458,25 @@ class EdgeEditor {
     //! threshold used in different focused algorithsm
     double ignore_size;
 
+    //! edge bounds and path depth used by the current mode
+    double mode_lower, mode_upper, mode_start;
+    int mode_depth;
+
+    //! true if the node-centric modes cache their uncertain nodes
+    bool incremental_mode;
+
+    //! mean and 95% confidence interval of the last estimate
+    double est_mean, est_conf_interval;
+
     //! properties that need to be saved when modifying the RAG 
     std::vector<std::string> node_properties;
 
     //! constant string for accessing synapse property
     const std::string SynapseStr;
 
+    //! interned key of the synapse property
+    const PropertyKey SynapseKey;
+
     // ordering algorithms supported by builtin
     // import utility -- this can be extended easily
     // other rank algorithms can always be used
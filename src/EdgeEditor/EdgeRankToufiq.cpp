@@ -106,8 +106,8 @@ void EdgeRankToufiq::add_to_edgelist(std::vector< std::pair<Node_t, Node_t> > &p
 
   for (size_t i=0; i< pedgebuffer.size(); i++){
       std::pair<Node_t, Node_t> pair1 = pedgebuffer[i];
-      unsigned int node1 = pair1.first;
-      unsigned int node2 = pair1.second;
+      Node_t node1 = pair1.first;
+      Node_t node2 = pair1.second;
       
       int label1 = plabels[i];
       all_labeled_edges.push_back(boost::make_tuple(node1, node2, label1));
@@ -116,8 +116,9 @@ void EdgeRankToufiq::add_to_edgelist(std::vector< std::pair<Node_t, Node_t> > &p
   /*Debug*
   for (size_t i=0; i< all_labeled_edges.size(); i++){
   
-      boost::tuple<unsigned int, unsigned int, int> le1 = all_labeled_edges[i]; 
-      printf("%u  %u  %d\n",boost::get<0>(le1), boost::get<1>(le1), boost::get<2>(le1));
+      boost::tuple<Node_t, Node_t, int> le1 = all_labeled_edges[i]; 
+      printf("%llu  %llu  %d\n",(unsigned long long)(boost::get<0>(le1)),
+              (unsigned long long)(boost::get<1>(le1)), boost::get<2>(le1));
   
   }
   /**/
@@ -128,8 +129,9 @@ void EdgeRankToufiq::save_labeled_edges(std::string& session_name ){
     std::string savefilename = session_name + "/all_labeled_edges.txt";
     FILE* fp = fopen(savefilename.c_str(),"wt");
     for (size_t i=0; i< all_labeled_edges.size(); i++){
-	boost::tuple<unsigned int, unsigned int, int> le1 = all_labeled_edges[i]; 
-	fprintf(fp,"%u  %u  %d\n",boost::get<0>(le1), boost::get<1>(le1), boost::get<2>(le1));
+	boost::tuple<Node_t, Node_t, int> le1 = all_labeled_edges[i]; 
+	fprintf(fp,"%llu  %llu  %d\n",(unsigned long long)(boost::get<0>(le1)),
+                (unsigned long long)(boost::get<1>(le1)), boost::get<2>(le1));
     }
     fclose(fp);
   
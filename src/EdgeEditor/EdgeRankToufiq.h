@@ -31,7 +31,7 @@ class EdgeRankToufiq: public EdgeRank{
     
     boost::thread* threadp;
     
-    std::vector< boost::tuple<unsigned int, unsigned int, int> > all_labeled_edges;
+    std::vector< boost::tuple<Node_t, Node_t, int> > all_labeled_edges;
     
 public:
     EdgeRankToufiq(BioStack* pstack, Rag_t& prag, string session_name="");
@@ -1,11 +1,14 @@
 #include "GPR.h"
+#include <algorithm>
 
 using namespace NeuroProof;
 
 boost::mutex GPR::ThreadCompute::mutex;
+const size_t GPR::ThreadCompute::NODE_CHUNK;
 
 GPR::GPR(Rag_t& rag_, bool debug_) : rag(rag_), debug(debug_),
-    total_num_voxelpairs(0), max_rand_base(0)
+    total_num_voxelpairs(0), max_rand_base(0), affinity_weight_sum(0.0),
+    affinity_diff_sum(0.0)
 {
     // establish number of pixel pairs and baseline for a given RAG
     for (Rag_t::nodes_iterator iter = rag.nodes_begin(); 
@@ -20,15 +23,10 @@ GPR::GPR(Rag_t& rag_, bool debug_) : rag(rag_), debug(debug_),
 
 double GPR::calculateMaxExpectedRand()
 {
-    double max_rand = double(max_rand_base);
     // examing maximum possible correspondence given uncertainty -- similar
-    // to the adjusted rand max index
-    for (AffinityPair::Hash::iterator iter = affinity_pairs.begin(); 
-            iter != affinity_pairs.end(); ++iter) {
-        max_rand += ( (iter->size * (iter->weight) * (iter->weight)) + 
-                (iter->size * (1-iter->weight) * iter->weight));
-    }
-    return max_rand;
+    // to the adjusted rand max index (each affinity pair adds
+    // size * (weight^2 + (1-weight)*weight) = size * weight)
+    return double(max_rand_base) + affinity_weight_sum;
 }
 
 
@@ -46,12 +44,38 @@ double GPR::calculateGPR(int num_paths, int num_threads)
 double GPR::calculateGPR(int num_paths, int num_threads, 
         std::vector<RagNode_t* >& node_list)
 {
+    if (num_paths != 1) {
+        throw ErrMsg("Multi-path prob calculation not re-implemented");
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+
+    affinity_weight_sum = 0.0;
+    affinity_diff_sum = 0.0;
+    size_t nodes_done = 0;
+
+    // pairs between two listed nodes are found from both nodes
+    std::unordered_set<Node_t> node_ids;
+    for (size_t i = 0; i < node_list.size(); ++i) {
+        node_ids.insert(node_list[i]->get_node_id());
+    }
+
+    // give each thread a contiguous range of nodes to start with
+    std::vector<NodeRangePtr> node_ranges;
+    for (int i = 0; i < num_threads; ++i) {
+        size_t begin = node_list.size() * i / num_threads;
+        size_t end = node_list.size() * (i+1) / num_threads;
+        node_ranges.push_back(NodeRangePtr(new NodeRange(begin, end)));
+    }
+
     boost::thread_group threads;
 
     // launch path finding algorithms over all nodes for different threads
     for (int i = 0; i < num_threads; ++i) {
-        threads.create_thread(ThreadCompute(i, num_threads, num_paths, 
-                    rag, affinity_pairs, node_list, debug));
+        threads.create_thread(ThreadCompute(i, num_paths, rag, node_ranges,
+                    node_list, node_ids, affinity_weight_sum, affinity_diff_sum,
+                    nodes_done, debug));
     } 
 
     threads.join_all();
@@ -62,12 +86,7 @@ double GPR::calculateGPR(int num_paths, int num_threads,
 
 double GPR::calculateNormalizedGPR()
 {
-    double total_diffs = 0.0;
-    for (AffinityPair::Hash::iterator iter = affinity_pairs.begin(); 
-            iter != affinity_pairs.end(); ++iter) {
-        double prob = (1 - iter->weight) * iter->weight;
-        total_diffs += (prob * iter->size);
-    }
+    double total_diffs = affinity_diff_sum;
   
     // adjust the rand index using a maximum and expected value 
     double max_rand = calculateMaxExpectedRand();
@@ -77,6 +96,76 @@ double GPR::calculateNormalizedGPR()
     return adjusted_index;
 }
 
+void GPR::ThreadCompute::operator()()
+{
+    size_t num_nodes = node_list.size();
+    size_t increment = num_nodes / 100;
+    size_t begin, end;
+
+    while (getNodes(begin, end)) {
+        for (size_t i = begin; i < end; ++i) {
+            findBestPath(node_list[i]);
+        }
+
+        if (debug) {
+            boost::mutex::scoped_lock scoped_lock(mutex);
+            size_t prev_done = nodes_done;
+            nodes_done += (end - begin);
+            if (increment && ((prev_done / increment) != (nodes_done / increment))) {
+                std::cout << nodes_done / double(num_nodes) * 100 << 
+                    "% done" << std::endl;
+            }
+        }
+    }
+
+    boost::mutex::scoped_lock scoped_lock(mutex);
+    weight_sum += weight_sum_local;
+    diff_sum += diff_sum_local;
+}
+
+bool GPR::ThreadCompute::getNodes(size_t& begin, size_t& end)
+{
+    // take the next chunk from the front of this thread's range
+    {
+        NodeRange& own_range = *(node_ranges[id]);
+        boost::mutex::scoped_lock scoped_lock(own_range.mutex);
+        if (own_range.begin < own_range.end) {
+            begin = own_range.begin;
+            end = std::min(own_range.end, begin + NODE_CHUNK);
+            own_range.begin = end;
+            return true;
+        }
+    }
+
+    // steal the back half of the first non-empty range of another thread
+    int num_threads = int(node_ranges.size());
+    for (int i = 1; i < num_threads; ++i) {
+        NodeRange& victim = *(node_ranges[(id + i) % num_threads]);
+        size_t stolen_begin, stolen_end;
+        {
+            boost::mutex::scoped_lock scoped_lock(victim.mutex);
+            if (victim.begin >= victim.end) {
+                continue;
+            }
+            stolen_end = victim.end;
+            stolen_begin = victim.end - (victim.end - victim.begin + 1) / 2;
+            victim.end = stolen_begin;
+        }
+
+        // examine the first chunk now and leave the rest for stealing
+        begin = stolen_begin;
+        end = std::min(stolen_end, begin + NODE_CHUNK);
+
+        NodeRange& own_range = *(node_ranges[id]);
+        boost::mutex::scoped_lock scoped_lock(own_range.mutex);
+        own_range.begin = end;
+        own_range.end = stolen_end;
+        return true;
+    }
+
+    return false;
+}
+
 void GPR::ThreadCompute::findBestPath(RagNode_t* rag_node_head)
 {
     best_node_head.rag_node_curr = rag_node_head;
@@ -85,8 +174,6 @@ void GPR::ThreadCompute::findBestPath(RagNode_t* rag_node_head)
     Node_t node_head = rag_node_head->get_node_id();
     
     best_node_queue.push(best_node_head);
-    AffinityPair affinity_pair_head(node_head, node_head);
-    affinity_pair_head.weight = 1.0;
 
     // examine the shortest node paths first
     while (!best_node_queue.empty()) {
@@ -137,8 +224,18 @@ void GPR::ThreadCompute::findBestPath(RagNode_t* rag_node_head)
         best_node_queue.pop();
     }
     
-    temp_affinity_pairs.erase(affinity_pair_head);
-    affinity_pairs_local.insert(temp_affinity_pairs.begin(), temp_affinity_pairs.end());
+    // the affinity of a pair is the same from both nodes, so a pair whose
+    // other node is also examined is only counted from the smaller id
+    for (AffinityPair::Hash::iterator iter = temp_affinity_pairs.begin();
+            iter != temp_affinity_pairs.end(); ++iter) {
+        Node_t other_node = (iter->region1 == node_head) ? iter->region2 : iter->region1;
+        if ((other_node == node_head) ||
+                ((other_node < node_head) && node_ids.count(other_node))) {
+            continue;
+        }
+        weight_sum_local += (iter->size * iter->weight);
+        diff_sum_local += (iter->size * (1 - iter->weight) * iter->weight);
+    }
     temp_affinity_pairs.clear();
 }
 
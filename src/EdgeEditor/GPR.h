@@ -18,7 +18,10 @@
 #include <Utilities/AffinityPair.h>
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/shared_ptr.hpp>
 #include <queue>
+#include <vector>
+#include <unordered_set>
 #include <iostream>
 
 namespace NeuroProof {
@@ -55,7 +58,9 @@ class GPR {
 
   private:
     /*!
-     * Calculate the GPR for the RAG.
+     * Calculate the GPR for the RAG using the affinities found from the
+     * given nodes.  A pair of nodes is counted once, whether one or both
+     * of its nodes are in the list.
      * \param num_paths num paths to compute GPR [values not 1 unsupported]
      * \param num_threads num threads to compute GPR 
      * \param node_list nodes to be examined
@@ -89,82 +94,95 @@ class GPR {
     //! Debug mode flag
     bool debug;
 
-    //! Structure for holding pairs of nodes and the affinity weight
-    AffinityPair::Hash affinity_pairs;
+    //! Sum of the voxel pairs of each affinity pair scaled by the affinity
+    double affinity_weight_sum;
+
+    //! Sum of the expected voxel pair disagreements of each affinity pair
+    double affinity_diff_sum;
+
+    /*!
+     * Range of positions in the node list that remain to be examined
+     * by a worker.  The owner takes nodes from the front while idle
+     * workers steal from the back.
+    */
+    struct NodeRange {
+        NodeRange(size_t begin_, size_t end_) : begin(begin_), end(end_) {}
+
+        size_t begin, end;
+        boost::mutex mutex;
+    };
+
+    //! Shared pointer to a node range (ranges are not copyable)
+    typedef boost::shared_ptr<NodeRange> NodeRangePtr;
 
     /*!
      * Struct for assign the GPR calculation work to different worker
      * threads.  The GPR calculation cost is dominated by analyzing
-     * the paths for each node.  The algorithm can be trivially
-     * parallelized by assigning nodes to different threads.
+     * the paths for each node.  Each worker starts with a contiguous
+     * range of nodes and steals half of the nodes left to another
+     * worker when its range is exhausted, so that nodes with large
+     * neighborhoods do not leave other workers idle.  The affinities
+     * found for a node are folded into running sums immediately, so
+     * only the neighborhood of the current node is held in memory.
     */
     struct ThreadCompute {
         /*!
          * Constructor for an individual thread of computation
          * that assigns a thread id, the number of paths used (1 is only
-         * supported), and a shared affinity_pairs structure where
-         * results are written back.
+         * supported), and the shared sums where results are written back.
          * \param id_ thread id
-         * \param num_threads_ number of threads to use
          * \param num_paths_ number of paths to find affinty (1 supported)
          * \param rag_ reference to RAG
-         * \param affinity_pair_ set of node pairs with affinities
+         * \param node_ranges_ range of nodes left for each thread
          * \param node_list_ set of nodes that will be analyzed
+         * \param node_ids_ ids of the nodes in the node list
+         * \param weight_sum_ sum of affinity weighted voxel pairs
+         * \param diff_sum_ sum of expected voxel pair disagreements
+         * \param nodes_done_ number of nodes analyzed by all threads
+         * \param debug_ enables progress output
         */ 
-        ThreadCompute(int id_, int num_threads_, int num_paths_, Rag_t& rag_, 
-                AffinityPair::Hash& affinity_pairs_, 
-                std::vector<RagNode_t* >& node_list_, bool debug_) : 
-            id(id_), num_threads(num_threads_), num_paths(num_paths_), 
-            rag(rag_), affinity_pairs(affinity_pairs_), node_list(node_list_), 
-            debug(debug_), EPSILON(0.000001), CONNECTION_THRESHOLD(0.01) {}
+        ThreadCompute(int id_, int num_paths_, Rag_t& rag_, 
+                std::vector<NodeRangePtr>& node_ranges_,
+                std::vector<RagNode_t* >& node_list_,
+                const std::unordered_set<Node_t>& node_ids_, double& weight_sum_,
+                double& diff_sum_, size_t& nodes_done_, bool debug_) : 
+            id(id_), num_paths(num_paths_), rag(rag_), node_ranges(node_ranges_),
+            node_list(node_list_), node_ids(node_ids_), weight_sum(weight_sum_), diff_sum(diff_sum_),
+            nodes_done(nodes_done_), debug(debug_), EPSILON(0.000001),
+            CONNECTION_THRESHOLD(0.01), weight_sum_local(0.0), diff_sum_local(0.0) {}
 
         /*!
          * Function overloaded operation to be called by the boost
          * threading library and actually perform the path examination
          * algorithms to determine the node affinities.
         */
-        void operator()()
-        {
-            int num_regions = rag.get_num_regions() / num_threads;
-            int increment = num_regions/100;
-            int curr_num = 0;
-
-            for (int i = id; i < node_list.size();) {
-                if (num_paths == 1) {
-                    if (debug && (id == 0)) {
-                        if (increment && !(curr_num++ % increment)) {
-                            std::cout << curr_num/double(num_regions) * 100 << 
-                                "% done" << std::endl;
-                        }
-                    }
-                    findBestPath(node_list[i]);
-                } else {
-                    throw ErrMsg("Multi-path prob calculation not re-implemented");
-                }
-                i += num_threads;
-            }
-            boost::mutex::scoped_lock scoped_lock(mutex);
-            affinity_pairs.insert(affinity_pairs_local.begin(), affinity_pairs_local.end());
-        }
+        void operator()();
 
         //! Thread id
         int id;
 
-        //! Number of threads
-        int num_threads;
-
         //! Number of paths to calculate affinity (should be 1 for now)
         int num_paths;
 
         //! Reference to RAG
         Rag_t& rag;
 
-        //! Affinity between node pairs (not necessarily directly connected)
-        AffinityPair::Hash& affinity_pairs;
+        //! Nodes left to be examined by each thread
+        std::vector<NodeRangePtr>& node_ranges;
 
         //! List of nodes to be considered for affinity
         std::vector<RagNode_t* >& node_list;
 
+        //! Ids of the nodes in the node list
+        const std::unordered_set<Node_t>& node_ids;
+
+        //! Sums shared by all threads
+        double& weight_sum;
+        double& diff_sum;
+
+        //! Progress shared by all threads
+        size_t& nodes_done;
+
         //! Enables debug mode
         bool debug;
 
@@ -174,11 +192,15 @@ class GPR {
         //! Minimum affinity allowed between nodes before being ignored 
         const double CONNECTION_THRESHOLD;
 
-        //! Mutex for protecting affinity nodes structures
+        //! Number of nodes taken from the thread's own range at a time
+        static const size_t NODE_CHUNK = 16;
+
+        //! Mutex for protecting the shared sums and progress
         static boost::mutex mutex;
 
-        //! Thread memory for affinity pairs
-        AffinityPair::Hash affinity_pairs_local;
+        //! Thread memory for the sums
+        double weight_sum_local;
+        double diff_sum_local;
         
         /*!
          *  Element to rank highest affinity nodes.
@@ -216,10 +238,22 @@ class GPR {
         //! Temporary affinity pairs stored
         AffinityPair::Hash temp_affinity_pairs;
 
+        /*!
+         * Takes the next nodes to examine from the thread's own range
+         * or, if it is empty, steals half of another thread's range.
+         * \param begin first position in the node list to examine
+         * \param end position after the last node to examine
+         * \return false if no nodes are left
+        */
+        bool getNodes(size_t& begin, size_t& end);
+
         /*
          * Runs a version of Dijkstra's algorithm with multiplication
-         * where edges range in values from 0 to 1.  The result
-         * is a set of affinity pairs with the starting head node.
+         * where edges range in values from 0 to 1.  The affinity of
+         * each node reached is added to the thread sums unless the node
+         * is also in the node list and has a smaller id than the starting
+         * head node (the affinity of such a pair is found from both nodes
+         * but should only be counted once).
          * \param rag_node_head Starting node for path search
         */
         void findBestPath(RagNode_t* rag_node_head);
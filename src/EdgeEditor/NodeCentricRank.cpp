@@ -1,5 +1,6 @@
 #include "NodeCentricRank.h"
 #include <cmath>
+#include <algorithm>
 
 using std::vector;
 
@@ -62,6 +63,11 @@ void NodeRankList::remove(Node_t id)
     stored_ids.erase(id);
 }
 
+bool NodeRankList::contains(Node_t id)
+{
+    return (stored_ids.find(id) != stored_ids.end());
+}
+
 void NodeRankList::remove(NodeRank item)
 {
     if (checkpoint) {
@@ -123,8 +129,7 @@ void NodeCentricRank::update_priority()
         RagNode_t* head_node = rag->find_rag_node(head_id);
 
         // going Hollywood
-        RagNode_t* strongest_affinity_node =
-            find_most_uncertain_node(head_node);        
+        RagNode_t* strongest_affinity_node = get_uncertain_node(head_node);
 
         if (strongest_affinity_node) {
             if (strongest_affinity_node->get_size() >= head_node->get_size()) {
@@ -141,10 +146,111 @@ void NodeCentricRank::update_priority()
     }
 }
 
+RagNode_t* NodeCentricRank::get_uncertain_node(RagNode_t* head_node)
+{
+    if (!incremental) {
+        return find_most_uncertain_node(head_node);
+    }
+
+    Node_t head_id = head_node->get_node_id();
+    std::unordered_map<Node_t, CachedNode>::iterator iter = uncertain_cache.find(head_id);
+    if (iter != uncertain_cache.end()) {
+        if (!(iter->second.uncertain_id)) {
+            return 0;
+        }
+        RagNode_t* uncertain_node = rag->find_rag_node(iter->second.uncertain_id);
+        if (uncertain_node) {
+            return uncertain_node;
+        }
+    }
+
+    RagNode_t* uncertain_node = find_most_uncertain_node(head_node);
+
+    // the result depends on the edges of every node reached by the search
+    CachedNode cached_node;
+    cached_node.uncertain_id = uncertain_node ? uncertain_node->get_node_id() : 0;
+    cached_node.generation = ++cache_generation;
+    uncertain_cache[head_id] = cached_node;
+
+    cache_dependents[head_id].push_back(std::make_pair(head_id, cache_generation));
+    for (size_t i = 0; i < path_search.num_reached(); ++i) {
+        Node_t reached_id = path_search.get_reached(i).node->get_node_id();
+        cache_dependents[reached_id].push_back(std::make_pair(head_id, cache_generation));
+    }
+
+    return uncertain_node;
+}
+
+void NodeCentricRank::invalidate_cache(Node_t node_id, vector<Node_t>& heads)
+{
+    std::unordered_map<Node_t, vector<std::pair<Node_t, unsigned long long> > >::iterator
+        dependents = cache_dependents.find(node_id);
+    if (dependents == cache_dependents.end()) {
+        return;
+    }
+
+    for (size_t i = 0; i < dependents->second.size(); ++i) {
+        Node_t head_id = dependents->second[i].first;
+        std::unordered_map<Node_t, CachedNode>::iterator iter = uncertain_cache.find(head_id);
+        // ignore dependencies of results that were already replaced
+        if ((iter != uncertain_cache.end()) &&
+                (iter->second.generation == dependents->second[i].second)) {
+            uncertain_cache.erase(iter);
+            heads.push_back(head_id);
+        }
+    }
+    cache_dependents.erase(dependents);
+}
+
+void NodeCentricRank::refresh_cache(vector<Node_t>& heads)
+{
+    std::sort(heads.begin(), heads.end());
+    heads.erase(std::unique(heads.begin(), heads.end()), heads.end());
+
+    for (size_t i = 0; i < heads.size(); ++i) {
+        if (node_list.contains(heads[i]) ||
+                (uncertain_cache.find(heads[i]) != uncertain_cache.end())) {
+            continue;
+        }
+        RagNode_t* rag_node = rag->find_rag_node(heads[i]);
+        if (rag_node) {
+            get_uncertain_node(rag_node);
+        }
+    }
+}
+
+void NodeCentricRank::clear_cache()
+{
+    uncertain_cache.clear();
+    cache_dependents.clear();
+    examined_edges.clear();
+}
+
 void NodeCentricRank::undo()
 {
     --num_processed;
+
+    // results found after the decision may not hold without it
+    vector<Node_t> heads;
+    if (incremental && !examined_edges.empty()) {
+        ExaminedEdge& examined_edge = examined_edges.back();
+        invalidate_cache(boost::get<0>(examined_edge.node_pair), heads);
+        invalidate_cache(boost::get<1>(examined_edge.node_pair), heads);
+        for (size_t i = 0; i < examined_edge.heads.size(); ++i) {
+            std::unordered_map<Node_t, CachedNode>::iterator iter =
+                uncertain_cache.find(examined_edge.heads[i]);
+            if (iter != uncertain_cache.end()) {
+                uncertain_cache.erase(iter);
+            }
+            heads.push_back(examined_edge.heads[i]);
+        }
+        examined_edges.pop_back();
+    }
+
     node_list.undo_one();
+    if (incremental) {
+        refresh_cache(heads);
+    }
     update_priority();
 }
 
@@ -153,18 +259,49 @@ void NodeCentricRank::examined_edge(NodePair node_pair, bool remove)
 {
     ++num_processed;
     Node_t keep_node = boost::get<0>(node_pair);
+    Node_t remove_node = boost::get<1>(node_pair);
     node_list.start_checkpoint();
+
+    // only the results whose paths reached the examined edge change
+    vector<Node_t> heads;
+    if (incremental) {
+        invalidate_cache(keep_node, heads);
+        invalidate_cache(remove_node, heads);
+        std::sort(heads.begin(), heads.end());
+        heads.erase(std::unique(heads.begin(), heads.end()), heads.end());
+    }
     
     if (remove) {
-        node_list.remove(boost::get<1>(node_pair));
+        node_list.remove(remove_node);
         node_list.remove(keep_node);
         
         // virtual call to add node if it still qualifies
         insert_node(keep_node);
 
         // virtual call to potentially put neighboring
-        // nodes back in body list
-        update_neighboring_nodes(keep_node);
+        // nodes back in body list (nodes with paths to the
+        // kept node are the heads whose results were removed)
+        if (incremental) {
+            for (size_t i = 0; i < heads.size(); ++i) {
+                if ((heads[i] == keep_node) || (heads[i] == remove_node)) {
+                    continue;
+                }
+                RagNode_t* rag_node = rag->find_rag_node(heads[i]);
+                if (rag_node) {
+                    update_node(rag_node);
+                }
+            }
+        } else {
+            update_neighboring_nodes(keep_node);
+        }
+    }
+
+    if (incremental) {
+        ExaminedEdge examined_edge;
+        examined_edge.node_pair = node_pair;
+        examined_edge.heads = heads;
+        examined_edges.push_back(examined_edge);
+        refresh_cache(heads);
     }
     
     update_priority();
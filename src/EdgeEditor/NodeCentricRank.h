@@ -10,6 +10,7 @@
 #define NODECENTRICRANK_H
 
 #include "EdgeRank.h"
+#include <Rag/AffinityPathSearch.h>
 
 #include <set>
 #include <unordered_map>
@@ -98,6 +99,13 @@ class NodeRankList {
     */
     void pop();
     
+    /*!
+     * Determine whether a node is in the list.
+     * \param id rag node id
+     * \return true if the node is in the list
+    */
+    bool contains(Node_t id);
+
     /*!
      * Remove element by searching for a node with
      * the given id.
@@ -177,7 +185,28 @@ class NodeCentricRank : public EdgeRank {
      * Constructor that initializes the rag object and the node list.
      * \param rag_ pointer to RAG
     */
-    NodeCentricRank(Rag_t* rag_) : EdgeRank(rag_), node_list(rag_) {}
+    NodeCentricRank(Rag_t* rag_) : EdgeRank(rag_), node_list(rag_),
+        incremental(false), cache_generation(0) {}
+
+    /*!
+     * Enables the incremental mode where the uncertain node found for
+     * each node is cached.  After a decision, only the nodes whose
+     * affinity paths reached one of the nodes of the examined edge are
+     * searched again and reconsidered for the node list (instead of
+     * searching from the kept node).  Derived classes must search with
+     * 'path_search' in 'find_most_uncertain_node'.  The mode should be
+     * set before the node list is initialized.  Results are only kept
+     * valid if a merge gives each joined edge the weight of one of the
+     * edges it replaces, as 'LowWeightCombine' does by keeping the
+     * smaller weight: a search that reached neither merged node then
+     * cannot reach them afterwards either.
+     * \param incremental_ true to enable caching
+    */
+    void set_incremental(bool incremental_)
+    {
+        incremental = incremental_;
+        clear_cache();
+    }
    
     /*!
      * Handle whether the given edge (node pair) being examined
@@ -253,6 +282,20 @@ class NodeCentricRank : public EdgeRank {
     */
     virtual void update_neighboring_nodes(Node_t keep_node) = 0;
 
+    /*!
+     * Virtual function to be implemented by derived class.  The
+     * function determines whether a node near a modified node
+     * should be updated in (or added back to) the body rank list.
+     * \param rag_node pointer to rag node near the modified node
+    */
+    virtual void update_node(RagNode_t* rag_node) = 0;
+
+    /*!
+     * Clears the uncertain nodes cached in incremental mode (should be
+     * called whenever the node list is initialized).
+    */
+    void clear_cache();
+
     /*!
      * Determine the change in information in the rag between
      * combining and not combining two nodes given a certain
@@ -267,6 +310,9 @@ class NodeCentricRank : public EdgeRank {
     //! ranking for nodes (nodes with the largest 'size' are first)
     NodeRankList node_list;
 
+    //! path search reused to find the nodes connected to a node
+    AffinityPathSearch path_search;
+
   protected:
     /*!
      * Updates the edge priority ranking.
@@ -274,9 +320,65 @@ class NodeCentricRank : public EdgeRank {
     void update_priority();
 
   private:
-        
+    /*!
+     * Finds the uncertain node for a head node using the cached
+     * result in incremental mode if it is still valid.
+     * \param head_node pointer to rag node
+     * \return pointer to uncertain node (0 if none)
+    */
+    RagNode_t* get_uncertain_node(RagNode_t* head_node);
+
+    /*!
+     * Removes the cached results of all heads whose search reached
+     * the given node.
+     * \param node_id id of modified rag node
+     * \param heads ids of the heads whose results were removed
+    */
+    void invalidate_cache(Node_t node_id, std::vector<Node_t>& heads);
+
+    /*!
+     * Searches again from heads whose results were removed but that
+     * are not in the node list, so that later decisions can still find
+     * (and reinsert) them.
+     * \param heads ids of the heads whose results were removed
+    */
+    void refresh_cache(std::vector<Node_t>& heads);
+
     //! represents the current most uncertain edge 
     NodePair top_edge;    
+
+    //! enables caching of uncertain nodes
+    bool incremental;
+
+    /*!
+     * Uncertain node found for a head node and the search that found
+     * it (to recognize stale dependencies).
+    */
+    struct CachedNode {
+        Node_t uncertain_id;
+        unsigned long long generation;
+    };
+
+    //! cached uncertain node for each head node (0 if none)
+    std::unordered_map<Node_t, CachedNode> uncertain_cache;
+
+    //! heads (and their search) whose search reached each node
+    std::unordered_map<Node_t, std::vector<std::pair<Node_t, unsigned long long> > > cache_dependents;
+
+    //! number of searches cached
+    unsigned long long cache_generation;
+
+    /*!
+     * Edge examined in incremental mode and the heads whose results
+     * were removed by the decision (for undo).
+    */
+    struct ExaminedEdge {
+        NodePair node_pair;
+        std::vector<Node_t> heads;
+    };
+
+    //! edges examined in incremental mode
+    std::vector<ExaminedEdge> examined_edges;
 };
 
 }
@@ -1,6 +1,5 @@
 #include "NodeSizeRank.h"
 #include <Rag/RagUtils.h>
-#include <Utilities/AffinityPair.h>
 
 using namespace NeuroProof;
 
@@ -13,6 +12,7 @@ void NodeSizeRank::initialize(double ignore_size_, unsigned int depth_, double u
     connection_limit = upper;
     voi_change_thres = calc_voi_change(BIGBODY10NM, ignore_size, volume_size);
     node_list.clear(); 
+    clear_cache();
 
     // add bodies above the the threshold
     for (Rag_t::nodes_iterator iter = rag->nodes_begin();
@@ -29,29 +29,24 @@ void NodeSizeRank::initialize(double ignore_size_, unsigned int depth_, double u
 
 RagNode_t* NodeSizeRank::find_most_uncertain_node(RagNode_t* head_node)
 {
-    AffinityPair::Hash affinity_pairs;
-    grab_affinity_pairs(*rag, head_node, depth, 1.0-connection_limit, true, affinity_pairs);
+    path_search.search(head_node, depth, 1.0-connection_limit, true);
     double biggest_change = -1.0;
     double total_information_affinity = 0.0;
     RagNode_t* strongest_affinity_node = 0;
 
     // prioritize high affinity nodes that have large sizes
-    for (AffinityPair::Hash::iterator iter = affinity_pairs.begin();
-            iter != affinity_pairs.end(); ++iter) {
-        Node_t other_id = iter->region1;
-        if (head_node->get_node_id() == other_id) {
-            other_id = iter->region2;
-        }
-        RagNode_t* other_node = rag->find_rag_node(other_id);
+    for (size_t i = 0; i < path_search.num_reached(); ++i) {
+        const AffinityPathSearch::PathNode& path_node = path_search.get_reached(i);
+        RagNode_t* other_node = path_node.node;
 
-        double local_information_affinity = iter->weight *
+        double local_information_affinity = path_node.weight *
             calc_voi_change(head_node->get_size(), other_node->get_size(), volume_size);
         if (other_node->get_size() < 1000) {
             local_information_affinity = 0.0;
         }
 
         if (local_information_affinity >= biggest_change) {
-            strongest_affinity_node = rag->find_rag_node(Node_t(iter->size));
+            strongest_affinity_node = rag->find_rag_node(path_node.second_node);
             biggest_change = local_information_affinity;
         }
         total_information_affinity += local_information_affinity;
@@ -77,28 +72,27 @@ void NodeSizeRank::insert_node(Node_t node)
 void NodeSizeRank::update_neighboring_nodes(Node_t keep_node)
 {
     RagNode_t* head_node = rag->find_rag_node(keep_node);
-    AffinityPair::Hash affinity_pairs;
-    grab_affinity_pairs(*rag, head_node, depth, 1.0-connection_limit, true, affinity_pairs);
+    path_search.search(head_node, depth, 1.0-connection_limit, true);
 
     // reinsert all nodes that may have been affected
     // by a change in the RAG
-    for (AffinityPair::Hash::iterator iter = affinity_pairs.begin();
-            iter != affinity_pairs.end(); ++iter) {
-        Node_t other_id = iter->region1;
-        if (keep_node == other_id) {
-            other_id = iter->region2;
-        }
-        RagNode_t* rag_other_node2 = rag->find_rag_node(other_id);
+    for (size_t i = 0; i < path_search.num_reached(); ++i) {
+        update_node(path_search.get_reached(i).node);
+    }
+}
 
-        node_list.remove(other_id); 
-        NodeRank item;
-        item.id = other_id;
-        item.size = rag_other_node2->get_size();
+void NodeSizeRank::update_node(RagNode_t* rag_node)
+{
+    Node_t other_id = rag_node->get_node_id();
 
-        if (item.size < ignore_size) {
-            continue;
-        }
+    node_list.remove(other_id); 
+    NodeRank item;
+    item.id = other_id;
+    item.size = rag_node->get_size();
 
-        node_list.insert(item); 
+    if (item.size < ignore_size) {
+        return;
     }
+
+    node_list.insert(item); 
 }
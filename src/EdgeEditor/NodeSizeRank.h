@@ -77,6 +77,14 @@ class NodeSizeRank : public NodeCentricRank {
      * \param keep_node id of rag node that was just modified
     */
     void update_neighboring_nodes(Node_t keep_node);
+
+    /*!
+     * The function determines whether a node near a modified node
+     * should be updated in the body rank list.  This function is
+     * called by the NodeCentricRank class.
+     * \param rag_node pointer to rag node near the modified node
+    */
+    void update_node(RagNode_t* rag_node);
   
   private:
     //! size below which nodes are not examined
@@ -8,16 +8,15 @@ void OrphanRank::initialize(double ignore_size_)
 {
     ignore_size = ignore_size_;
     node_list.clear(); 
+    clear_cache();
 
     // grab all nodes that are orphan above the size threshold
     // or that have a synapse annotation
     for (Rag_t::nodes_iterator iter = rag->nodes_begin();
             iter != rag->nodes_end(); ++iter) {
         unsigned long long synapse_weight = 0;
-        try {   
-            synapse_weight = (*iter)->get_property<unsigned long long>(SynapseStr);
-        } catch(...) {
-            //
+        if ((*iter)->has_property(SynapseKey)) {
+            synapse_weight = (*iter)->get_property<unsigned long long>(SynapseKey);
         }
         bool is_orphan = !((*iter)->is_boundary());
 
@@ -38,19 +37,14 @@ void OrphanRank::initialize(double ignore_size_)
 
 RagNode_t* OrphanRank::find_most_uncertain_node(RagNode_t* head_node)
 {
-    AffinityPair::Hash affinity_pairs;
-    grab_affinity_pairs(*rag, head_node, 0, 0.01, false, affinity_pairs);
+    path_search.search(head_node, 0, 0.01, false);
     double biggest_change = 0;
     RagNode_t* strongest_affinity_node = 0;
 
     // look for the highest affinity path betwee node and non-orphan
-    for (AffinityPair::Hash::iterator iter = affinity_pairs.begin();
-            iter != affinity_pairs.end(); ++iter) {
-        Node_t other_id = iter->region1;
-        if (head_node->get_node_id() == other_id) {
-            other_id = iter->region2;
-        }
-        RagNode_t* other_node = rag->find_rag_node(other_id);
+    for (size_t i = 0; i < path_search.num_reached(); ++i) {
+        const AffinityPathSearch::PathNode& path_node = path_search.get_reached(i);
+        RagNode_t* other_node = path_node.node;
 
         double local_information_affinity = -1;
 
@@ -58,11 +52,11 @@ RagNode_t* OrphanRank::find_most_uncertain_node(RagNode_t* head_node)
         bool orphan2 = !(other_node->is_boundary());
 
         if (orphan1 && !orphan2) {
-            local_information_affinity = iter->weight;;
+            local_information_affinity = path_node.weight;;
         }
 
         if (local_information_affinity >= biggest_change) {
-            strongest_affinity_node = rag->find_rag_node(Node_t(iter->size));
+            strongest_affinity_node = rag->find_rag_node(path_node.second_node);
             biggest_change = local_information_affinity;
         }
     }
@@ -87,36 +81,33 @@ void OrphanRank::insert_node(Node_t node)
 void OrphanRank::update_neighboring_nodes(Node_t keep_node)
 {
     RagNode_t* head_node = rag->find_rag_node(keep_node);
-    AffinityPair::Hash affinity_pairs;
-    grab_affinity_pairs(*rag, head_node, 0, 0.01, false, affinity_pairs);
+    path_search.search(head_node, 0, 0.01, false);
 
     // reinsert nodes into the queue who may have been affected
     // by a change in the RAG
-    for (AffinityPair::Hash::iterator iter = affinity_pairs.begin();
-            iter != affinity_pairs.end(); ++iter) {
-        Node_t other_id = iter->region1;
-        if (keep_node == other_id) {
-            other_id = iter->region2;
-        }
-        RagNode_t* rag_other_node2 = rag->find_rag_node(other_id);
+    for (size_t i = 0; i < path_search.num_reached(); ++i) {
+        update_node(path_search.get_reached(i).node);
+    }
+}
 
-        node_list.remove(other_id); 
-        NodeRank item;
-        item.id = other_id;
-        item.size = rag_other_node2->get_size();
+void OrphanRank::update_node(RagNode_t* rag_node)
+{
+    Node_t other_id = rag_node->get_node_id();
 
-        unsigned long long synapse_weight = 0;
-        try {   
-            synapse_weight = rag_other_node2->get_property<unsigned long long>(SynapseStr);
-        } catch(...) {
-            //
-        }
+    node_list.remove(other_id); 
+    NodeRank item;
+    item.id = other_id;
+    item.size = rag_node->get_size();
 
-        if (rag_other_node2->is_boundary() || ((item.size < ignore_size) &&
-                    synapse_weight == 0)) {
-            continue;
-        }
+    unsigned long long synapse_weight = 0;
+    if (rag_node->has_property(SynapseKey)) {
+        synapse_weight = rag_node->get_property<unsigned long long>(SynapseKey);
+    }
 
-        node_list.insert(item); 
+    if (rag_node->is_boundary() || ((item.size < ignore_size) &&
+                synapse_weight == 0)) {
+        return;
     }
+
+    node_list.insert(item); 
 }
@@ -35,7 +35,7 @@ class OrphanRank : public NodeCentricRank {
      * \param rag_ pointer to RAG
     */
     OrphanRank(Rag_t* rag_) : NodeCentricRank(rag_),
-        SynapseStr("synapse_weight"), ignore_size(BIGBODY10NM) {}
+        SynapseKey(PropertyKeys::get_key("synapse_weight")), ignore_size(BIGBODY10NM) {}
   
     /*!
      * Initialize (or reinitialize) the body rank list by adding
@@ -81,10 +81,18 @@ class OrphanRank : public NodeCentricRank {
      * \param keep_node id of rag node that was just modified
     */
     void update_neighboring_nodes(Node_t keep_node);
+
+    /*!
+     * The function determines whether a node near a modified node
+     * should be updated in the body rank list.  This function is
+     * called by the NodeCentricRank class.
+     * \param rag_node pointer to rag node near the modified node
+    */
+    void update_node(RagNode_t* rag_node);
   
   private:
-    //! access string for synapse node property
-    const std::string SynapseStr;
+    //! interned key for synapse node property
+    const PropertyKey SynapseKey;
 
     //! size below which nodes are not examined (except if they have a synapse)
     double ignore_size;
@@ -10,15 +10,14 @@ void SynapseRank::initialize(double ignore_size_, double upper)
     connection_limit = upper;
 
     node_list.clear(); 
+    clear_cache();
 
     // designate the number of synapse annotations as being a node's size
     for (Rag_t::nodes_iterator iter = rag->nodes_begin();
             iter != rag->nodes_end(); ++iter) {
         unsigned long long synapse_weight = 0;
-        try {   
-            synapse_weight = (*iter)->get_property<unsigned long long>(SynapseStr);
-        } catch(...) {
-            //
+        if ((*iter)->has_property(SynapseKey)) {
+            synapse_weight = (*iter)->get_property<unsigned long long>(SynapseKey);
         }
         if (synapse_weight == 0) {
             continue;
@@ -39,43 +38,34 @@ void SynapseRank::initialize(double ignore_size_, double upper)
 
 RagNode_t* SynapseRank::find_most_uncertain_node(RagNode_t* head_node)
 {
-    AffinityPair::Hash affinity_pairs;
-    grab_affinity_pairs(*rag, head_node, 0, 1.0-connection_limit, true, affinity_pairs);
+    path_search.search(head_node, 0, 1.0-connection_limit, true);
     double biggest_change = -1.0;
     double total_information_affinity = 0.0;
     RagNode_t* strongest_affinity_node = 0;
 
     // find nodes with largest affinity that could affect the change
     // in synapses the most
-    for (AffinityPair::Hash::iterator iter = affinity_pairs.begin();
-            iter != affinity_pairs.end(); ++iter) {
-        Node_t other_id = iter->region1;
-        if (head_node->get_node_id() == other_id) {
-            other_id = iter->region2;
-        }
-        RagNode_t* other_node = rag->find_rag_node(other_id);
+    for (size_t i = 0; i < path_search.num_reached(); ++i) {
+        const AffinityPathSearch::PathNode& path_node = path_search.get_reached(i);
+        RagNode_t* other_node = path_node.node;
 
         unsigned long long synapse_weight1 = 0;
-        try {
-            synapse_weight1 = head_node->get_property<unsigned long long>(SynapseStr);
-        } catch(...) {
-            //
+        if (head_node->has_property(SynapseKey)) {
+            synapse_weight1 = head_node->get_property<unsigned long long>(SynapseKey);
         }
         unsigned long long synapse_weight2 = 0;
-        try {
-            synapse_weight2 = other_node->get_property<unsigned long long>(SynapseStr);
-        } catch(...) {
-            //
+        if (other_node->has_property(SynapseKey)) {
+            synapse_weight2 = other_node->get_property<unsigned long long>(SynapseKey);
         }
 
         double local_information_affinity = 0;
         if (synapse_weight1 > 0 && synapse_weight2 > 0) {
-            local_information_affinity = iter->weight *
+            local_information_affinity = path_node.weight *
                 calc_voi_change(synapse_weight1, synapse_weight2, volume_size);
         }
 
         if (local_information_affinity >= biggest_change) {
-            strongest_affinity_node = rag->find_rag_node(Node_t(iter->size));
+            strongest_affinity_node = rag->find_rag_node(path_node.second_node);
             biggest_change = local_information_affinity;
         }
         total_information_affinity += local_information_affinity;
@@ -95,10 +85,8 @@ void SynapseRank::insert_node(Node_t node)
     master_item.id = head_node->get_node_id();
     master_item.size = 0;
     
-    try {
-        master_item.size = head_node->get_property<unsigned long long>(SynapseStr); 
-    } catch(...) {
-
+    if (head_node->has_property(SynapseKey)) {
+        master_item.size = head_node->get_property<unsigned long long>(SynapseKey);
     }
 
     node_list.insert(master_item);
@@ -107,32 +95,29 @@ void SynapseRank::insert_node(Node_t node)
 void SynapseRank::update_neighboring_nodes(Node_t keep_node)
 {
     RagNode_t* head_node = rag->find_rag_node(keep_node);
-    AffinityPair::Hash affinity_pairs;
-    grab_affinity_pairs(*rag, head_node, 0, 1.0-connection_limit, true, affinity_pairs);
+    path_search.search(head_node, 0, 1.0-connection_limit, true);
 
     // reinsert all nodes with synapse annotations that could have
     // been affected by a change in the RAG
-    for (AffinityPair::Hash::iterator iter = affinity_pairs.begin();
-            iter != affinity_pairs.end(); ++iter) {
-        Node_t other_id = iter->region1;
-        if (keep_node == other_id) {
-            other_id = iter->region2;
-        }
-        RagNode_t* rag_other_node2 = rag->find_rag_node(other_id);
-
-        node_list.remove(other_id); 
-        NodeRank item;
-        item.id = other_id;
-        item.size = 0;
-        try { 
-            item.size = rag_other_node2->get_property<unsigned long long>(SynapseStr);
-        } catch(...) {
-            //
-        }
-        if (item.size == 0) {
-            continue;
-        }
+    for (size_t i = 0; i < path_search.num_reached(); ++i) {
+        update_node(path_search.get_reached(i).node);
+    }
+}
 
-        node_list.insert(item); 
+void SynapseRank::update_node(RagNode_t* rag_node)
+{
+    Node_t other_id = rag_node->get_node_id();
+
+    node_list.remove(other_id); 
+    NodeRank item;
+    item.id = other_id;
+    item.size = 0;
+    if (rag_node->has_property(SynapseKey)) {
+        item.size = rag_node->get_property<unsigned long long>(SynapseKey);
     }
+    if (item.size == 0) {
+        return;
+    }
+
+    node_list.insert(item); 
 }
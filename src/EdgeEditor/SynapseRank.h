@@ -31,7 +31,7 @@ class SynapseRank : public NodeCentricRank {
     */
     SynapseRank(Rag_t* rag_) : NodeCentricRank(rag_), ignore_size(0.1),
             voi_change_thres(0.0), volume_size(0),
-            SynapseStr("synapse_weight") {}
+            SynapseKey(PropertyKeys::get_key("synapse_weight")) {}
   
     /*!
      * Initialize (or reinitialize) the body rank list by adding
@@ -75,6 +75,14 @@ class SynapseRank : public NodeCentricRank {
      * \param keep_node id of rag node that was just modified
     */
     void update_neighboring_nodes(Node_t keep_node);
+
+    /*!
+     * The function determines whether a node near a modified node
+     * should be updated in the body rank list.  This function is
+     * called by the NodeCentricRank class.
+     * \param rag_node pointer to rag node near the modified node
+    */
+    void update_node(RagNode_t* rag_node);
   
   private:
     //! threshold used to determine whether a node is important
@@ -89,8 +97,8 @@ class SynapseRank : public NodeCentricRank {
     //! number of synapse annotations in the entire RAG
     unsigned long long volume_size;
     
-    //! access string for synapse node property
-    const std::string SynapseStr;
+    //! interned key for synapse node property
+    const PropertyKey SynapseKey;
 };
 
 }
@@ -7,46 +7,60 @@
 
 namespace NeuroProof {
 
-struct FeatureCache {
-    virtual unsigned int deserialize(char * bytes) = 0;
-    virtual void serialize(std::string& buffer) = 0;
-};
+// Feature caches live in flat, pool-allocated records (see FeatureStore.h).
+// Each cache below is a light-weight view over the bytes reserved for a
+// feature in a record; a zeroed region is a valid empty cache.
+
+struct CountCache {
+    CountCache(void* cache) : count(*((signed long long *) cache)) {}
 
-struct CountCache : public FeatureCache {
-    CountCache() : count(0) {}
-    signed long long count; 
+    static unsigned int cache_size()
+    {
+        return sizeof(signed long long);
+    }
 
-    virtual unsigned int deserialize(char * bytes)
+    unsigned int deserialize(char * bytes)
     {
         assert(sizeof(signed long long) == 8);
-        
+
         unsigned int bytes_read = 0;
         count = *((signed long long *) bytes);
-        
+
         bytes_read = sizeof(signed long long);
         bytes += sizeof(signed long long);
 
         return bytes_read;
     }
-    virtual void serialize(std::string& buffer)
+    void serialize(std::string& buffer)
     {
         assert(sizeof(signed long long) == 8);
 
         // write 64-bit count
         buffer += std::string((char*)(&count), sizeof(signed long long));
-    } 
+    }
+
+    signed long long& count;
 };
 
 
-struct MomentCache : public FeatureCache{
-    MomentCache(unsigned int num_moments) : count(0), vals(num_moments, 0) {}
+struct MomentCache {
+    MomentCache(void* cache, unsigned int num_moments_) :
+        count(*((unsigned long long *) cache)),
+        vals((double *)((char *) cache + sizeof(unsigned long long))),
+        num_moments(num_moments_) {}
+
+    static unsigned int cache_size(unsigned int num_moments)
+    {
+        return sizeof(unsigned long long) + num_moments * sizeof(double);
+    }
+
     // will overwrite previous cache
-    virtual unsigned int deserialize(char * bytes)
+    unsigned int deserialize(char * bytes)
     {
         assert(sizeof(unsigned long long) == 8);
         assert(sizeof(unsigned int) == 4);
         assert(sizeof(double) == 8);
-        
+
         unsigned int bytes_read = 0;
         count = *((unsigned long long *) bytes);
 
@@ -54,13 +68,13 @@ struct MomentCache : public FeatureCache{
         bytes += sizeof(unsigned long long);
 
         // num_moments specified must correspond to what was stored in the buffer
-        unsigned int num_moments = *((unsigned int*) bytes);
-        assert(num_moments == vals.size());
+        unsigned int num_moments_stored = *((unsigned int*) bytes);
+        assert(num_moments_stored == num_moments);
 
         bytes_read += sizeof(unsigned int);
         bytes += sizeof(unsigned int);
 
-        for (unsigned int i = 0; i < num_moments; ++i) {
+        for (unsigned int i = 0; i < num_moments_stored; ++i) {
             double val = *((double*) bytes);
             bytes_read += sizeof(double);
             bytes += sizeof(double);
@@ -69,39 +83,45 @@ struct MomentCache : public FeatureCache{
 
         return bytes_read;
     }
-    virtual void serialize(std::string& buffer)
+    void serialize(std::string& buffer)
     {
         assert(sizeof(unsigned long long) == 8);
         assert(sizeof(unsigned int) == 4);
         assert(sizeof(double) == 8);
-        
+
         // write 64-bit count
         buffer += std::string((char*)(&count), sizeof(unsigned long long));
 
         // write number of moments (64 bit)
-        unsigned int num_moments = vals.size();
         buffer += std::string((char*)(&num_moments), sizeof(unsigned int));
-        
+
         // write all vals (double)
         for (unsigned int i = 0; i < num_moments; ++i) {
-            buffer += std::string((char*)&vals[i], sizeof(double)); 
+            buffer += std::string((char*)&vals[i], sizeof(double));
         }
     }
 
-    unsigned long long count; 
-    std::vector<double> vals;
+    unsigned long long& count;
+    double* vals;
+    unsigned int num_moments;
 };
 
-struct HistCache : public FeatureCache {
-    HistCache(unsigned num_bins) : count(0), hist(num_bins, 0) {}
-    unsigned long long count;
-    std::vector<unsigned long long> hist;
+struct HistCache {
+    HistCache(void* cache, unsigned int num_bins_) :
+        count(*((unsigned long long *) cache)),
+        hist((unsigned long long *)((char *) cache + sizeof(unsigned long long))),
+        num_bins(num_bins_) {}
+
+    static unsigned int cache_size(unsigned int num_bins)
+    {
+        return sizeof(unsigned long long) + num_bins * sizeof(unsigned long long);
+    }
 
-    virtual unsigned int deserialize(char * bytes)
+    unsigned int deserialize(char * bytes)
     {
         assert(sizeof(unsigned long long) == 8);
         assert(sizeof(unsigned int) == 4);
-        
+
         unsigned int bytes_read = 0;
         count = *((unsigned long long *) bytes);
 
@@ -109,13 +129,13 @@ struct HistCache : public FeatureCache {
         bytes += sizeof(unsigned long long);
 
         // num_bins specified must correspond to what was stored in the buffer
-        unsigned int num_bins = *((unsigned int*) bytes);
-        assert(num_bins == hist.size());
+        unsigned int num_bins_stored = *((unsigned int*) bytes);
+        assert(num_bins_stored == num_bins);
 
         bytes_read += sizeof(unsigned int);
         bytes += sizeof(unsigned int);
 
-        for (unsigned int i = 0; i < num_bins; ++i) {
+        for (unsigned int i = 0; i < num_bins_stored; ++i) {
             unsigned long long val = *((unsigned long long*) bytes);
             bytes_read += sizeof(unsigned long long);
             bytes += sizeof(unsigned long long);
@@ -124,28 +144,28 @@ struct HistCache : public FeatureCache {
 
         return bytes_read;
     }
-    virtual void serialize(std::string& buffer)
+    void serialize(std::string& buffer)
     {
         assert(sizeof(unsigned long long) == 8);
         assert(sizeof(unsigned int) == 4);
-        
+
         // write 64-bit count
         buffer += std::string((char*)(&count), sizeof(unsigned long long));
 
         // write number of bins (64 bit)
-        unsigned int num_bins = hist.size();
         buffer += std::string((char*)(&num_bins), sizeof(unsigned int));
-        
+
         // write all hist (unsigned long long)
         for (unsigned int i = 0; i < num_bins; ++i) {
-            buffer += std::string((char*)&hist[i], sizeof(unsigned long long)); 
+            buffer += std::string((char*)&hist[i], sizeof(unsigned long long));
         }
     }
 
+    unsigned long long& count;
+    unsigned long long* hist;
+    unsigned int num_bins;
 };
 
 }
 
 #endif
-
-
@@ -1,4 +1,6 @@
 #include "FeatureMgr.h"
+#include <Rag/RagUtils.h>
+#include <algorithm>
 
 using std::vector;
 using namespace NeuroProof;
@@ -25,26 +27,109 @@ void FeatureMgr::set_basic_features()
 void FeatureMgr::mv_features(RagEdge_t* edge2, RagEdge_t* edge1)
 {
     edge1->set_size(edge2->get_size());
-    if (edge_caches.find(edge2) != edge_caches.end()) {
-        edge_caches[edge1] = edge_caches[edge2];
-        edge_caches.erase(edge2);        
+    EdgeCaches::iterator iter = edge_caches.find(edge2);
+    if (iter != edge_caches.end()) {
+        unsigned int id = iter->second;
+        edge_caches.erase(iter);
+        edge_caches[edge1] = id;
     }
 } 
 
 void FeatureMgr::remove_edge(RagEdge_t* edge)
 {
-    if (edge_caches.find(edge) != edge_caches.end()) {
-        std::vector<void*>& edge_vec = edge_caches[edge];
-        assert(edge_vec.size() > 0);
-        unsigned int pos = 0;
-        for (int i = 0; i < num_channels; ++i) {
-            vector<FeatureCompute*>& features = channels_features[i];
-            for (int j = 0; j < features.size(); ++j) {
-                features[j]->delete_cache(edge_vec[pos]);
-                ++pos;
-            } 
+    EdgeCaches::iterator iter = edge_caches.find(edge);
+    if (iter != edge_caches.end()) {
+        feature_store.release(iter->second);
+        edge_caches.erase(iter);
+    }
+}
+
+char* FeatureMgr::create_cache(RagEdge_t* edge)
+{
+    EdgeCaches::iterator iter = edge_caches.find(edge);
+    if (iter != edge_caches.end()) {
+        feature_store.release(iter->second);
+        edge_caches.erase(iter);
+    }
+    unsigned int id = feature_store.allocate();
+    edge_caches[edge] = id;
+    return feature_store.get_record(id);
+}
+
+char* FeatureMgr::create_cache(RagNode_t* node)
+{
+    NodeCaches::iterator iter = node_caches.find(node);
+    if (iter != node_caches.end()) {
+        feature_store.release(iter->second);
+        node_caches.erase(iter);
+    }
+    unsigned int id = feature_store.allocate();
+    node_caches[node] = id;
+    return feature_store.get_record(id);
+}
+
+void FeatureMgr::set_feature_layout()
+{
+    // caches are laid out back-to-back in channel order
+    cache_offsets.clear();
+    unsigned int record_size = 0;
+    for (unsigned int i = 0; i < num_channels; ++i) {
+        vector<FeatureCompute*>& features = channels_features[i];
+        for (int j = 0; j < features.size(); ++j) {
+            cache_offsets.push_back(record_size);
+            // keep every cache 8-byte aligned
+            record_size += (features[j]->cache_size() + 7) / 8 * 8;
+        }
+    }
+    feature_store.set_record_size(record_size);
+}
+
+void FeatureMgr::merge_records(char* record1, char* record2)
+{
+    unsigned int pos = 0;
+    for (unsigned int i = 0; i < num_channels; ++i) {
+        vector<FeatureCompute*>& features = channels_features[i];
+        for (int j = 0; j < features.size(); ++j) {
+            features[j]->merge_cache(record1 + cache_offsets[pos],
+                    record2 + cache_offsets[pos]);
+            ++pos;
+        }
+    }
+}
+
+std::string FeatureMgr::serialize_features(char * current_features, char* record)
+{
+    std::string buffer;
+    serialize_features(current_features, record, buffer);
+    return buffer;
+}
+
+void FeatureMgr::serialize_features(char * current_features, char* record, std::string& buffer)
+{
+    buffer.clear();
+    int pos = 0;
+    for (int i = 0; i < num_channels; ++i) { 
+        std::vector<FeatureCompute*>& features = channels_features[i];
+        for (int j = 0; j < features.size(); ++j, ++pos) {
+            unsigned int bufsize = features[j]->serialize(current_features,
+                    get_cache(record, pos), buffer);
+            if (current_features) {
+                current_features += bufsize; 
+            }
+        }
+    }
+}
+
+void FeatureMgr::deserialize_features(char * current_features, char* record)
+{
+    int pos = 0;
+    for (int i = 0; i < num_channels; ++i) { 
+        std::vector<FeatureCompute*>& features = channels_features[i];
+        for (int j = 0; j < features.size(); ++j, ++pos) {
+            unsigned int bufsize = features[j]->deserialize(current_features,
+                    get_cache(record, pos));
+            current_features += bufsize; 
         }
-        edge_caches.erase(edge);
     }
 }
 
@@ -64,7 +149,7 @@ void FeatureMgr::add_channel()
     ++num_channels;
 }
 
-void FeatureMgr::compute_diff_features(std::vector<void*>* caches1, std::vector<void*>* caches2, std::vector<double>& feature_results, RagEdge_t* edge)
+void FeatureMgr::compute_diff_features(char* record1, char* record2, std::vector<double>& feature_results, RagEdge_t* edge)
 {
     vector<vector<bool> > examine_equal(num_channels);
     vector<vector<unsigned int> > spot_equal(num_channels);
@@ -93,40 +178,40 @@ void FeatureMgr::compute_diff_features(std::vector<void*>* caches1, std::vector<
         for (int j = 0; j < num_channels; ++j) {
             if (examine_equal[j][i]) {
                 unsigned int id = spot_equal[j][i];
-                channels_features_equal[j][i]->get_diff_feature_array((*caches2)[id], (*caches1)[id], feature_results, edge);
+                channels_features_equal[j][i]->get_diff_feature_array(get_cache(record2, id), get_cache(record1, id), feature_results, edge);
             }
         }
     }
 } 
 
-void FeatureMgr::compute_diff_features2(std::vector<void*>* caches1, std::vector<void*>* caches2, std::vector<double>& feature_results, RagEdge_t* edge)
+void FeatureMgr::compute_diff_features2(char* record1, char* record2, std::vector<double>& feature_results, RagEdge_t* edge)
 {
     unsigned int pos = 0;
     for (unsigned int i = 0; i < num_channels; i++) {
         std::vector<FeatureCompute*>& features = channels_features[i];
         for (int j = 0; j < features.size(); j++) {
-            features[j]->get_diff_feature_array((*caches2)[pos],(*caches1)[pos],feature_results, edge);
+            features[j]->get_diff_feature_array(get_cache(record2, pos), get_cache(record1, pos), feature_results, edge);
             pos++;
         } 
     }
 }
 
 
-void FeatureMgr::compute_features2(unsigned int prediction_type, std::vector<void*>* caches, std::vector<double>& feature_results, RagEdge_t* edge, unsigned int node_number)
+void FeatureMgr::compute_features2(unsigned int prediction_type, char* record, std::vector<double>& feature_results, RagEdge_t* edge, unsigned int node_number)
 {
 
     unsigned int pos = 0;
     for (unsigned int i = 0; i < num_channels; i++) {
         std::vector<FeatureCompute*>& features = channels_features[i];
         for (int j = 0; j < features.size(); j++) {
-            features[j]->get_feature_array((*caches)[pos],feature_results, edge, node_number);
+            features[j]->get_feature_array(get_cache(record, pos), feature_results, edge, node_number);
             pos++;
         } 
     }
 
 }
 
-void FeatureMgr::compute_features(unsigned int prediction_type, std::vector<void*>* caches, std::vector<double>& feature_results, RagEdge_t* edge, unsigned int node_number)
+void FeatureMgr::compute_features(unsigned int prediction_type, char* record, std::vector<double>& feature_results, RagEdge_t* edge, unsigned int node_number)
 {
     vector<vector<bool> > examine_equal(num_channels);
     vector<vector<unsigned int> > spot_equal(num_channels);
@@ -155,7 +240,7 @@ void FeatureMgr::compute_features(unsigned int prediction_type, std::vector<void
         for (int j = 0; j < num_channels; ++j) {
             if (examine_equal[j][i]) {
                 unsigned int id = spot_equal[j][i];
-                channels_features_equal[j][i]->get_feature_array((*caches)[id],
+                channels_features_equal[j][i]->get_feature_array(get_cache(record, id),
                         feature_results, edge, node_number);
             }
         }
@@ -252,6 +337,8 @@ void FeatureMgr::add_feature(unsigned int channel, FeatureCompute * feature, vec
 
     channels_features[channel].push_back(feature); 
     channels_features_modes[channel].push_back(feature_modes);
+
+    set_feature_layout();
 }
 
 #ifdef SETPYTHON
@@ -266,26 +353,13 @@ void FeatureMgr::set_python_rf_function(object pyfunc_)
 
 void FeatureMgr::compute_node_features(RagNode_t* node, vector<double>& feature_results){
 
-    std::vector<void*>* node1_caches = 0;
-
-
-    if (node_caches.find(node) != node_caches.end()) {
-        node1_caches = &(node_caches[node]);
-    }
-
-    compute_features2(0, node1_caches, feature_results, NULL, 1);
+    compute_features2(0, get_record(node), feature_results, NULL, 1);
 
 }
 
 void FeatureMgr::compute_all_features(RagEdge_t* edge, vector<double>& feature_results){
 
-    std::vector<void*>* edget_caches = 0;
-    std::vector<void*>* node1_caches = 0;
-    std::vector<void*>* node2_caches = 0;
-
-    if (edge_caches.find(edge) != edge_caches.end()) {
-        edget_caches = &(edge_caches[edge]);
-    }
+    char* edget_record = get_record(edge);
 
     RagNode_t* node1 = edge->get_node1();
     RagNode_t* node2 = edge->get_node2();
@@ -296,20 +370,16 @@ void FeatureMgr::compute_all_features(RagEdge_t* edge, vector<double>& feature_r
         node1 = temp_node;
     }
 
-    if (node_caches.find(node1) != node_caches.end()) {
-        node1_caches = &(node_caches[node1]);
-    }
-    if (node_caches.find(node2) != node_caches.end()) {
-        node2_caches = &(node_caches[node2]);
-    }
+    char* node1_record = get_record(node1);
+    char* node2_record = get_record(node2);
 
-    compute_features2(0, node1_caches, feature_results, edge, 1);
+    compute_features2(0, node1_record, feature_results, edge, 1);
 
-    compute_features2(0, node2_caches, feature_results, edge, 2);
+    compute_features2(0, node2_record, feature_results, edge, 2);
 
-    compute_features2(1, edget_caches, feature_results, edge, 0);
+    compute_features2(1, edget_record, feature_results, edge, 0);
 
-    compute_diff_features2(node1_caches, node2_caches, feature_results, edge);
+    compute_diff_features2(node1_record, node2_record, feature_results, edge);
 
 
 }
@@ -330,20 +400,12 @@ void FeatureMgr::set_overlap_function()
     overlap = true;
 }
 
-double FeatureMgr::get_prob(RagEdge_t* edge)
+void FeatureMgr::compute_edge_features(RagEdge_t* edge, vector<double>& feature_results)
 {
-    vector<double> feature_results;
+#ifdef SETPYTHON
     RagNode_t* node1 = edge->get_node1();
     RagNode_t* node2 = edge->get_node2();
-
-#ifdef SETPYTHON
-    std::vector<void*>* edget_caches = 0;
-    std::vector<void*>* node1_caches = 0;
-    std::vector<void*>* node2_caches = 0;
-
-    if (edge_caches.find(edge) != edge_caches.end()) {
-        edget_caches = &(edge_caches[edge]);
-    }
+    char* edget_record = get_record(edge);
 
     if (node2->get_size() < node1->get_size()) {
         RagNode_t* temp_node = node2;
@@ -351,20 +413,74 @@ double FeatureMgr::get_prob(RagEdge_t* edge)
         node1 = temp_node;
     }
 
-    if (node_caches.find(node1) != node_caches.end()) {
-        node1_caches = &(node_caches[node1]);
-    }
-    if (node_caches.find(node2) != node_caches.end()) {
-        node2_caches = &(node_caches[node2]);
-    }
+    char* node1_record = get_record(node1);
+    char* node2_record = get_record(node2);
     
-    compute_features(0, node1_caches, feature_results, edge, 1);
-    compute_features(0, node2_caches, feature_results, edge, 2);
-    compute_features(1, edget_caches, feature_results, edge, 0);
-    compute_diff_features(node1_caches, node2_caches, feature_results, edge);
+    compute_features(0, node1_record, feature_results, edge, 1);
+    compute_features(0, node2_record, feature_results, edge, 2);
+    compute_features(1, edget_record, feature_results, edge, 0);
+    compute_diff_features(node1_record, node2_record, feature_results, edge);
 #else
     compute_all_features(edge,feature_results);
 #endif
+}
+
+void FeatureMgr::remove_ignored_features(vector<double>& feature_results)
+{
+    if (ignore_set.empty()) {
+        return;
+    }
+    unsigned int pos = 0;
+    for (size_t ff = 0; ff < feature_results.size(); ++ff) {
+        if (ignore_set.find(ff) == ignore_set.end()) {
+            feature_results[pos++] = feature_results[ff];
+        }
+    }
+    feature_results.resize(pos);
+}
+
+void FeatureMgr::get_probs(vector<RagEdge_t*>& edges, vector<double>& probs)
+{
+    probs.resize(edges.size());
+    
+    // only classifier predictions benefit from batching
+    if (has_pyfunc || !eclfr) {
+        for (size_t i = 0; i < edges.size(); ++i) {
+            probs[i] = get_prob(edges[i]);
+        }
+        return;
+    }
+
+    // bound the size of the feature matrix
+    const size_t BATCH_SIZE = 4096;
+    vector<double> features;
+    vector<double> feature_results;
+    vector<double> batch_probs;
+
+    for (size_t start = 0; start < edges.size(); start += BATCH_SIZE) {
+        size_t end = std::min(start + BATCH_SIZE, edges.size());
+        features.clear();
+        
+        for (size_t i = start; i < end; ++i) {
+            feature_results.clear();
+            compute_edge_features(edges[i], feature_results);
+            remove_ignored_features(feature_results);
+            features.insert(features.end(), feature_results.begin(),
+                    feature_results.end());
+        }
+
+        eclfr->predict(features, end - start, batch_probs);
+        std::copy(batch_probs.begin(), batch_probs.end(), probs.begin() + start);
+    }
+}
+
+double FeatureMgr::get_prob(RagEdge_t* edge)
+{
+    vector<double> feature_results;
+    RagNode_t* node1 = edge->get_node1();
+    RagNode_t* node2 = edge->get_node2();
+
+    compute_edge_features(edge, feature_results);
 
     /*std::cout << node1->get_node_id() << " " << node2->get_node_id() << std::endl;
     for (int i = 0; i < feature_results.size(); ++i) {
@@ -385,16 +501,8 @@ double FeatureMgr::get_prob(RagEdge_t* edge)
         prob = extract<double>(pyfunc(pylist));
 #endif
     } else if (eclfr){
-	if (ignore_set.size()>0){
-	    vector<double> new_features;
-	    for(size_t ff=0; ff<feature_results.size(); ff++)
-		if (ignore_set.find(ff) == ignore_set.end())
-		    new_features.push_back(feature_results[ff]);
-	    prob = eclfr->predict(new_features);
-	}
-	/**/
-	else
-	    prob = eclfr->predict(feature_results);
+        remove_ignored_features(feature_results);
+        prob = eclfr->predict(feature_results);
     } else if (overlap) {
         unsigned long long edge_size = edge->get_size();
         unsigned long long total_edge_size1 = 0;
@@ -402,9 +510,9 @@ double FeatureMgr::get_prob(RagEdge_t* edge)
 
         unsigned long long total_edge_zero = 0;
 
-        if (edge->has_property("num-zeros")) {
+        if (edge->has_property(num_zeros_key())) {
             total_edge_zero += 
-                (edge->get_property<unsigned long long>("num-zeros"));
+                (edge->get_property<unsigned long long>(num_zeros_key()));
         }
         edge_size -= (unsigned long long)((total_edge_zero * border_weight)); 
     
@@ -436,8 +544,8 @@ double FeatureMgr::get_prob(RagEdge_t* edge)
             save_prob = 0.0;
         }
         save_prob = 1 - save_prob;
-        if (!(edge->has_property("save-prob"))) {
-            edge->set_property("save-prob", save_prob);
+        if (!(edge->has_property(save_prob_key()))) {
+            edge->set_property(save_prob_key(), save_prob);
         }
         
         double prob1 = edge_size / double(total_edge_size1);
@@ -464,10 +572,10 @@ double FeatureMgr::get_prob(RagEdge_t* edge)
 
         prob = 1-prob;
 
-        try {
-            prob = edge->get_property<double>("orig-prob");
-        } catch (ErrMsg& msg) {
-            edge->set_property("orig-prob", prob);
+        if (edge->has_property(orig_prob_key())) {
+            prob = edge->get_property<double>(orig_prob_key());
+        } else {
+            edge->set_property(orig_prob_key(), prob);
         }
 
     } else {
@@ -480,107 +588,124 @@ double FeatureMgr::get_prob(RagEdge_t* edge)
 
 void FeatureMgr::merge_features2(RagNode_t* node1, RagNode_t* node2, RagEdge_t* edgeb)
 {
-    std::vector<void*>* node1_caches = 0; 
-    std::vector<void*>* node2_caches = 0;
-    std::vector<void*>* edgeb_caches = 0;
-
-	
-    if (node_caches.find(node1) != node_caches.end()) {
-        node1_caches = &(node_caches[node1]);
-    }
-    if (node_caches.find(node2) != node_caches.end()) {
-        node2_caches = &(node_caches[node2]);
-    }
-    if (edge_caches.find(edgeb) != edge_caches.end()) {
-        edgeb_caches = &(edge_caches[edgeb]);
-    }
-    if (!node1_caches && !node2_caches) {
-        return;
-    }
-
-    unsigned int pos = 0;
-    vector<double> feature_results;
-    for (int i = 0; i < num_channels; ++i) {
-        vector<FeatureCompute*>& features = channels_features[i];
-        for (int j = 0; j < features.size(); ++j) {
-            if ((*node1_caches)[pos] && (*node2_caches)[pos]) {
-                features[j]->merge_cache((*node1_caches)[pos], (*node2_caches)[pos]);
-            }
-	    if (edgeb_caches && (*edgeb_caches)[pos] && (*node1_caches)[pos])
-                features[j]->merge_cache((*node1_caches)[pos], (*edgeb_caches)[pos]);
-	
-            ++pos;
+    merge_features(node1, node2);
+
+    // the features of the merged edge are absorbed by node1
+    EdgeCaches::iterator edge_iter = edge_caches.find(edgeb);
+    if (edge_iter != edge_caches.end()) {
+        char* node1_record = get_record(node1);
+        if (node1_record) {
+            merge_records(node1_record, feature_store.get_record(edge_iter->second));
         }
+        feature_store.release(edge_iter->second);
+        edge_caches.erase(edge_iter);
     }
-
-    if (node2_caches) {
-        node_caches.erase(node2);
-    }
-    if (edgeb_caches)
-	edge_caches.erase(edgeb);	
 }
 
 
 
 void FeatureMgr::merge_features(RagNode_t* node1, RagNode_t* node2)
 {
-    std::vector<void*>* node1_caches = 0; 
-    std::vector<void*>* node2_caches = 0;
-
-    if (node_caches.find(node1) != node_caches.end()) {
-        node1_caches = &(node_caches[node1]);
-    }
-    if (node_caches.find(node2) != node_caches.end()) {
-        node2_caches = &(node_caches[node2]);
+    NodeCaches::iterator iter2 = node_caches.find(node2);
+    if (iter2 == node_caches.end()) {
+        return;
     }
-    if (!node1_caches && !node2_caches) {
+    unsigned int id2 = iter2->second;
+    node_caches.erase(iter2);
+
+    NodeCaches::iterator iter1 = node_caches.find(node1);
+    if (iter1 == node_caches.end()) {
+        // node1 simply takes over the features of node2
+        node_caches[node1] = id2;
         return;
     }
 
-    unsigned int pos = 0;
-    vector<double> feature_results;
-    for (int i = 0; i < num_channels; ++i) {
-        vector<FeatureCompute*>& features = channels_features[i];
-        for (int j = 0; j < features.size(); ++j) {
-            if ((*node1_caches)[pos] && (*node2_caches)[pos]) {
-                features[j]->merge_cache((*node1_caches)[pos], (*node2_caches)[pos]);
-            }
-            ++pos;
+    merge_records(feature_store.get_record(iter1->second), feature_store.get_record(id2));
+    feature_store.release(id2);
+}
+
+void FeatureMgr::collapse_features(RagNode_t* node_keep, vector<RagNode_t*>& nodes_remove,
+        vector<RagEdge_t*>& internal_edges)
+{
+    NodeCaches::iterator iter_keep = node_caches.find(node_keep);
+    char* keep_record = (iter_keep != node_caches.end()) ?
+        feature_store.get_record(iter_keep->second) : 0;
+
+    for (unsigned int i = 0; i < nodes_remove.size(); ++i) {
+        NodeCaches::iterator iter = node_caches.find(nodes_remove[i]);
+        if (iter == node_caches.end()) {
+            continue;
+        }
+        unsigned int id = iter->second;
+        node_caches.erase(iter);
+
+        if (!keep_record) {
+            // node_keep simply takes over the first record
+            node_caches[node_keep] = id;
+            keep_record = feature_store.get_record(id);
+            continue;
         }
+        merge_records(keep_record, feature_store.get_record(id));
+        feature_store.release(id);
     }
 
-    if (node2_caches) {
-        node_caches.erase(node2);
+    for (unsigned int i = 0; i < internal_edges.size(); ++i) {
+        remove_edge(internal_edges[i]);
     }
 }
 
 void FeatureMgr::merge_features(RagEdge_t* edge1, RagEdge_t* edge2)
 {
-    std::vector<void*>* edge1_caches = 0; 
-    std::vector<void*>* edge2_caches = 0;
-    
-    if (edge_caches.find(edge1) != edge_caches.end()) {
-        edge1_caches = &(edge_caches[edge1]);
+    EdgeCaches::iterator iter2 = edge_caches.find(edge2);
+    if (iter2 == edge_caches.end()) {
+        return;
     }
-    if (edge_caches.find(edge2) != edge_caches.end()) {
-        edge2_caches = &(edge_caches[edge2]);
+    unsigned int id2 = iter2->second;
+    edge_caches.erase(iter2);
+
+    EdgeCaches::iterator iter1 = edge_caches.find(edge1);
+    if (iter1 == edge_caches.end()) {
+        // edge1 simply takes over the features of edge2
+        edge_caches[edge1] = id2;
+        return;
     }
 
-    unsigned int pos = 0;
-    vector<double> feature_results;
-    for (int i = 0; i < num_channels; ++i) {
-        vector<FeatureCompute*>& features = channels_features[i];
-        for (int j = 0; j < features.size(); ++j) {
-            if ((*edge1_caches)[pos] && (*edge2_caches)[pos]) {
-                features[j]->merge_cache((*edge1_caches)[pos], (*edge2_caches)[pos]);
-            }
-            ++pos;
-        }
+    merge_records(feature_store.get_record(iter1->second), feature_store.get_record(id2));
+    feature_store.release(id2);
+}
+
+void FeatureMgr::merge_features(RagNode_t* node1, FeatureMgr* feature_mgr2, RagNode_t* node2)
+{
+    char* record2 = feature_mgr2->get_record(node2);
+    if (!record2) {
+        return;
+    }
+    assert(feature_mgr2->feature_store.get_record_size() == feature_store.get_record_size());
+
+    char* record1 = get_record(node1);
+    if (!record1) {
+        // merging onto empty caches is a copy
+        record1 = create_cache(node1);
+    }
+    merge_records(record1, record2);
+    feature_mgr2->remove_node(node2);
+}
+
+void FeatureMgr::merge_features(RagEdge_t* edge1, FeatureMgr* feature_mgr2, RagEdge_t* edge2)
+{
+    char* record2 = feature_mgr2->get_record(edge2);
+    if (!record2) {
+        return;
     }
+    assert(feature_mgr2->feature_store.get_record_size() == feature_store.get_record_size());
 
-    if (edge2_caches) {
-        edge_caches.erase(edge2);
+    char* record1 = get_record(edge1);
+    if (!record1) {
+        // merging onto empty caches is a copy
+        record1 = create_cache(edge1);
     }
+    merge_records(record1, record2);
+    feature_mgr2->remove_edge(edge2);
 }
 
 void FeatureMgr::copy_channel_features(FeatureMgr *pfmgr){
@@ -588,6 +713,7 @@ void FeatureMgr::copy_channel_features(FeatureMgr *pfmgr){
     std::vector<std::vector<FeatureCompute*> >& pfmgr_channel_features = pfmgr->get_channel_features();
 
     num_channels = pfmgr->get_num_channels();		
+    shared_features = true;
 
     channels_features.resize(pfmgr_channel_features.size()); 	
     for (unsigned int i = 0; i < num_channels; ++i) {
@@ -597,81 +723,45 @@ void FeatureMgr::copy_channel_features(FeatureMgr *pfmgr){
         } 
     }
 
+    clear_features();
+    set_feature_layout();
 }
 
-void FeatureMgr::copy_cache(std::vector<void*>& src_edge_caches, RagEdge_t* edge){
+void FeatureMgr::copy_cache(FeatureMgr* src_mgr, RagEdge_t* src_edge, RagEdge_t* edge){
     
+    assert(src_mgr->feature_store.get_record_size() == feature_store.get_record_size());
 
-    bool cache_exists=false;	
-    if (edge_caches.find(edge) != edge_caches.end()) {
-        cache_exists=true;
+    char* dest_record = create_cache(edge);
+    char* src_record = src_mgr->get_record(src_edge);
+    if (src_record) {
+        std::copy(src_record, src_record + feature_store.get_record_size(), dest_record);
     }
-    else
-	edge_caches[edge] = std::vector<void*>();		
-
-    std::vector<void*>& dest_edge_caches = edge_caches[edge]; 
-
-    unsigned int pos = 0;
-    for (unsigned int i = 0; i < num_channels; ++i) {
-        std::vector<FeatureCompute*>& features = channels_features[i];
-        for (int j = 0; j < features.size(); ++j) {
-	    if (cache_exists){
-		features[j]->delete_cache(dest_edge_caches[pos]);
-		dest_edge_caches[pos] = features[j]->create_cache(); 
-	    }	
-	    else	
-                dest_edge_caches.push_back(features[j]->create_cache());
-
-	    features[j]->copy_cache(src_edge_caches[pos],dest_edge_caches[pos]);	
-            ++pos;
-        } 
-    }
-
 }	
 
-void FeatureMgr::copy_cache(std::vector<void*>& src_node_caches , RagNode_t* node1){
+void FeatureMgr::copy_cache(FeatureMgr* src_mgr, RagNode_t* src_node, RagNode_t* node1){
     
+    assert(src_mgr->feature_store.get_record_size() == feature_store.get_record_size());
 
-    bool cache_exists=false;	
-    if (node_caches.find(node1) != node_caches.end()) {
-        cache_exists=true;
+    char* dest_record = create_cache(node1);
+    char* src_record = src_mgr->get_record(src_node);
+    if (src_record) {
+        std::copy(src_record, src_record + feature_store.get_record_size(), dest_record);
     }
-    else	
-        node_caches[node1] = std::vector<void*>();
-
-    std::vector<void*>& dest_node_caches = node_caches[node1]; 
-		
-	
-
-    unsigned int pos = 0;
-    for (unsigned int i = 0; i < num_channels; ++i) {
-        std::vector<FeatureCompute*>& features = channels_features[i];
-        for (int j = 0; j < features.size(); ++j) {
-	    if (cache_exists){	
- 	        features[j]->delete_cache(dest_node_caches[pos]);
-		dest_node_caches[pos] = features[j]->create_cache();
-	    }	
-	    else	
- 	        dest_node_caches.push_back(features[j]->create_cache());
-
-	    features[j]->copy_cache(src_node_caches[pos],dest_node_caches[pos]);	
-            ++pos;
-        } 
-    }
-
 }	
 
 
 void FeatureMgr::print_cache(RagEdge_t* edge){
 
-    std::vector<void*>& dest_edge_caches = edge_caches[edge]; 
+    char* dest_record = get_record(edge); 
 
     unsigned int pos = 0;
     for (unsigned int i = 0; i < num_channels; ++i) {
         std::vector<FeatureCompute*>& features = channels_features[i];
         for (int j = 0; j < features.size(); ++j) {
 	    features[j]->print_name();		
-	    features[j]->print_cache(dest_edge_caches[pos]);	
+	    if (dest_record) {
+	        features[j]->print_cache(get_cache(dest_record, pos));	
+	    }
             ++pos;
         } 
     }
@@ -679,14 +769,16 @@ void FeatureMgr::print_cache(RagEdge_t* edge){
 }	
 void FeatureMgr::print_cache(RagNode_t* node){
 
-    std::vector<void*>& dest_node_caches = node_caches[node]; 
+    char* dest_record = get_record(node); 
 
     unsigned int pos = 0;
     for (unsigned int i = 0; i < num_channels; ++i) {
         std::vector<FeatureCompute*>& features = channels_features[i];
         for (int j = 0; j < features.size(); ++j) {
 	    features[j]->print_name();		
-	    features[j]->print_cache(dest_node_caches[pos]);	
+	    if (dest_record) {
+	        features[j]->print_cache(get_cache(dest_record, pos));	
+	    }
             ++pos;
         } 
     }
@@ -695,44 +787,16 @@ void FeatureMgr::print_cache(RagNode_t* node){
 
 void FeatureMgr::clear_features()
 {
-    for (EdgeCaches::iterator iter = edge_caches.begin(); iter != edge_caches.end(); ++iter) {
-        // creation of empty feature
-        if (iter->second.size() == 0) {
-            continue;
-        }
-        unsigned int pos = 0;
-        for (int i = 0; i < num_channels; ++i) {
-            vector<FeatureCompute*>& features = channels_features[i];
-            for (int j = 0; j < features.size(); ++j) {
-                features[j]->delete_cache(iter->second[pos]);
-                ++pos;
-            } 
-        }
-    }
     edge_caches.clear();
-
-    for (NodeCaches::iterator iter = node_caches.begin(); iter != node_caches.end(); ++iter) {
-        // creation of empty feature
-        if (iter->second.size() == 0) {
-            continue;
-        }
-        unsigned int pos = 0;
-        for (int i = 0; i < num_channels; ++i) {
-            vector<FeatureCompute*>& features = channels_features[i];
-            for (int j = 0; j < features.size(); ++j) {
-                features[j]->delete_cache(iter->second[pos]);
-                ++pos;
-            } 
-        }
-    }
     node_caches.clear();
+    feature_store.clear();
 }
 
 FeatureMgr::~FeatureMgr()
 {
     clear_features();
 
-    if (num_channels > 0) {
+    if ((num_channels > 0) && !shared_features) {
         vector<FeatureCompute*>& features = channels_features[0];
         for (int j = 0; j < features.size(); ++j) {
             delete features[j]; 
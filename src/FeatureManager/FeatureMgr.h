@@ -5,6 +5,7 @@
 
 #include <Rag/RagEdge.h>
 #include "Features.h"
+#include "FeatureStore.h"
 #include <unordered_map>
 
 
@@ -21,21 +22,24 @@ class shared_ptr;
 
 namespace NeuroProof {
     
-typedef std::unordered_map<RagEdge_t*, std::vector<void *>, RagEdgePtrHash<Node_t>, RagEdgePtrEq<Node_t> > EdgeCaches; 
-typedef std::unordered_map<RagNode_t*, std::vector<void *>, RagNodePtrHash<Node_t>, RagNodePtrEq<Node_t> > NodeCaches; 
+// map graph elements to the id of their record in the feature store
+typedef std::unordered_map<RagEdge_t*, unsigned int, RagEdgePtrHash<Node_t>, RagEdgePtrEq<Node_t> > EdgeCaches; 
+typedef std::unordered_map<RagNode_t*, unsigned int, RagNodePtrHash<Node_t>, RagNodePtrEq<Node_t> > NodeCaches; 
 
 class FeatureMgr {
   public:
     FeatureMgr() : num_channels(0), specified_features(false),
         has_pyfunc(false), overlap(false), num_features(0),
-        overlap_threshold(11), overlap_max(true), eclfr(0), border_weight(1.0) {}
+        overlap_threshold(11), overlap_max(true), eclfr(0), border_weight(1.0),
+        shared_features(false) {}
     
     FeatureMgr(int num_channels_) : num_channels(num_channels_), 
         specified_features(false), channels_features(num_channels_),
         channels_features_modes(num_channels_),
         channels_features_equal(num_channels_), has_pyfunc(false),
         overlap(false), num_features(0), overlap_threshold(11),
-        overlap_max(true), eclfr(0), border_weight(1.0) {}
+        overlap_max(true), eclfr(0), border_weight(1.0),
+        shared_features(false) {}
     
     void add_channel();
     unsigned int get_num_features()
@@ -76,102 +80,75 @@ class FeatureMgr {
 
     std::string serialize_features(char * current_features, RagNode_t* node)
     {
-        std::string buffer;
-        std::vector<void*>& feature_caches = node_caches[node];
-        int pos = 0;
-        for (int i = 0; i < num_channels; ++i) { 
-            std::vector<FeatureCompute*>& features = channels_features[i];
-            for (int j = 0; j < features.size(); ++j, ++pos) {
-                unsigned int bufsize = features[j]->serialize(current_features,
-                        feature_caches[pos], buffer);
-                if (current_features) {
-                    current_features += bufsize; 
-                }
-            }
-        }
-        return buffer;
+        return serialize_features(current_features, get_record(node));
     }
 
     std::string serialize_features(char * current_features, RagEdge_t* edge)
     {
-        std::string buffer;
-        std::vector<void*>& feature_caches = edge_caches[edge];
-        int pos = 0;
-        for (int i = 0; i < num_channels; ++i) { 
-            std::vector<FeatureCompute*>& features = channels_features[i];
-            for (int j = 0; j < features.size(); ++j, ++pos) {
-                unsigned int bufsize = features[j]->serialize(current_features,
-                        feature_caches[pos], buffer);
-                if (current_features) {
-                    current_features += bufsize; 
-                }
-            }
-        }
-        return buffer;
+        return serialize_features(current_features, get_record(edge));
+    }
+
+    /*!
+     * Serializes the features of a node merged with the given serialized
+     * features into a buffer that is overwritten (so that the buffer
+     * can be reused when serializing many nodes).
+     * \param current_features serialized features (0 if none)
+     * \param node rag node
+     * \param buffer serialized merged features
+    */
+    void serialize_features(char * current_features, RagNode_t* node, std::string& buffer)
+    {
+        serialize_features(current_features, get_record(node), buffer);
     }
 
+    /*!
+     * Serializes the features of an edge merged with the given serialized
+     * features into a buffer that is overwritten.
+     * \param current_features serialized features (0 if none)
+     * \param edge rag edge
+     * \param buffer serialized merged features
+    */
+    void serialize_features(char * current_features, RagEdge_t* edge, std::string& buffer)
+    {
+        serialize_features(current_features, get_record(edge), buffer);
+    }
 
     void deserialize_features(char * current_features, RagNode_t* node)
     {
-        std::string buffer;
-        int pos = 0;
-        if (node_caches.find(node) == node_caches.end()) {
-            std::vector<void*>& feature_caches = create_cache(node);
+        char* record = get_record(node);
+        if (!record) {
+            record = create_cache(node);
         }        
-        std::vector<void*>& feature_caches = node_caches[node];
-
-        for (int i = 0; i < num_channels; ++i) { 
-            std::vector<FeatureCompute*>& features = channels_features[i];
-            for (int j = 0; j < features.size(); ++j, ++pos) {
-                unsigned int bufsize = features[j]->deserialize(current_features,
-                        feature_caches[pos]);
-                current_features += bufsize; 
-            }
-        }
+        deserialize_features(current_features, record);
     }
 
-
     void deserialize_features(char * current_features, RagEdge_t* edge)
     {
-        std::string buffer;
-        int pos = 0;
-        if (edge_caches.find(edge) == edge_caches.end()) {
-            std::vector<void*>& feature_caches = create_cache(edge);
+        char* record = get_record(edge);
+        if (!record) {
+            record = create_cache(edge);
         }        
-        std::vector<void*>& feature_caches = edge_caches[edge];
-
-        for (int i = 0; i < num_channels; ++i) { 
-            std::vector<FeatureCompute*>& features = channels_features[i];
-            for (int j = 0; j < features.size(); ++j, ++pos) {
-                unsigned int bufsize = features[j]->deserialize(current_features,
-                        feature_caches[pos]);
-                current_features += bufsize; 
-            }
-        }
+        deserialize_features(current_features, record);
     }
 
-
-
     void add_val(double val, RagNode_t* node)
     {
         unsigned int starting_pos = 0;
-        if (node_caches.find(node) != node_caches.end()) {
-            add_val(val, 0, starting_pos, node_caches[node]);
-        } else {
-            std::vector<void*>& feature_caches = create_cache(node);
-            add_val(val, 0, starting_pos, feature_caches);
-        } 
+        char* record = get_record(node);
+        if (!record) {
+            record = create_cache(node);
+        }
+        add_val(val, 0, starting_pos, record);
     } 
    
     void add_val(double val, RagEdge_t* edge)
     {
         unsigned int starting_pos = 0;
-        if (edge_caches.find(edge) != edge_caches.end()) {
-            add_val(val, 0, starting_pos, edge_caches[edge]);
-        } else {
-            std::vector<void*>& feature_caches = create_cache(edge);
-            add_val(val, 0, starting_pos, feature_caches);
-        } 
+        char* record = get_record(edge);
+        if (!record) {
+            record = create_cache(edge);
+        }
+        add_val(val, 0, starting_pos, record);
     } 
 
     void add_val(std::vector<double>& vals, RagNode_t* node)
@@ -179,17 +156,13 @@ class FeatureMgr {
         //node->incr_size();
         assert(vals.size() == num_channels);
         unsigned starting_pos = 0;
-        if (node_caches.find(node) != node_caches.end()) {
-            std::vector<void*>& feature_caches = node_caches[node];
-            for (int i = 0; i < num_channels; ++i) { 
-                add_val(vals[i], i, starting_pos, feature_caches);
-            }              
-        } else {
-            std::vector<void*>& feature_caches = create_cache(node);
-            for (int i = 0; i < num_channels; ++i) { 
-                add_val(vals[i], i, starting_pos, feature_caches);
-            }
-        }        
+        char* record = get_record(node);
+        if (!record) {
+            record = create_cache(node);
+        }
+        for (int i = 0; i < num_channels; ++i) { 
+            add_val(vals[i], i, starting_pos, record);
+        }              
     }
 
     void add_val(std::vector<double>& vals, RagEdge_t* edge)
@@ -197,17 +170,13 @@ class FeatureMgr {
         //edge->incr_size();
         assert(vals.size() == num_channels);
         unsigned int starting_pos = 0;
-        if (edge_caches.find(edge) != edge_caches.end()) {
-            std::vector<void*>& feature_caches = edge_caches[edge];
-            for (int i = 0; i < num_channels; ++i) { 
-                add_val(vals[i], i, starting_pos, feature_caches);
-            }           
-        } else {
-            std::vector<void*>& feature_caches = create_cache(edge);
-            for (int i = 0; i < num_channels; ++i) { 
-                add_val(vals[i], i, starting_pos, feature_caches);
-            }        
-        } 
+        char* record = get_record(edge);
+        if (!record) {
+            record = create_cache(edge);
+        }
+        for (int i = 0; i < num_channels; ++i) { 
+            add_val(vals[i], i, starting_pos, record);
+        }           
     }
 
     void mv_features(RagEdge_t* edge2, RagEdge_t* edge1);
@@ -216,18 +185,10 @@ class FeatureMgr {
 
     void remove_node(RagNode_t* node)
     {
-        if (node_caches.find(node) != node_caches.end()) {
-            std::vector<void*>& node_vec = node_caches[node];
-            assert(node_vec.size() > 0);
-            unsigned int pos = 0;
-            for (int i = 0; i < num_channels; ++i) {
-                std::vector<FeatureCompute*>& features = channels_features[i];
-                for (int j = 0; j < features.size(); ++j) {
-                    features[j]->delete_cache(node_vec[pos]);
-                    ++pos;
-                } 
-            }
-            node_caches.erase(node);
+        NodeCaches::iterator iter = node_caches.find(node);
+        if (iter != node_caches.end()) {
+            feature_store.release(iter->second);
+            node_caches.erase(iter);
         }
     }
 
@@ -235,6 +196,17 @@ class FeatureMgr {
     void merge_features2(RagNode_t* node1, RagNode_t* node2, RagEdge_t* edge );
     void merge_features(RagEdge_t* edge1, RagEdge_t* edge2);
 
+    // merge the features of a set of nodes onto node_keep in one pass and
+    // drop the features of the edges internal to the set
+    void collapse_features(RagNode_t* node_keep, std::vector<RagNode_t*>& nodes_remove,
+            std::vector<RagEdge_t*>& internal_edges);
+
+    // merge features held by another feature manager sharing the same
+    // features (see copy_channel_features) onto node1/edge1 -- the features
+    // of node2/edge2 are removed from the other manager
+    void merge_features(RagNode_t* node1, FeatureMgr* feature_mgr2, RagNode_t* node2);
+    void merge_features(RagEdge_t* edge1, FeatureMgr* feature_mgr2, RagEdge_t* edge2);
+
     void set_classifier(EdgeClassifier* pclfr)
     {
         eclfr = pclfr;
@@ -273,6 +245,15 @@ class FeatureMgr {
 
     double get_prob(RagEdge_t* edge);
 
+    /*!
+     * Compute the probabilities of many edges at once.  When a classifier
+     * is used, features are gathered into dense matrices and passed to
+     * the classifier in batches instead of one edge at a time.
+     * \param edges edges to score
+     * \param probs probability for each edge (same order as edges)
+    */
+    void get_probs(std::vector<RagEdge_t*>& edges, std::vector<double>& probs);
+
     void clear_features();
 
     ~FeatureMgr();
@@ -284,8 +265,9 @@ class FeatureMgr {
 
     void copy_channel_features(FeatureMgr *pfmgr);   	
 
-    void copy_cache(std::vector<void*>& src_edge_cache, RagEdge_t* edge);	
-    void copy_cache(std::vector<void*>& src_node_cache, RagNode_t* node);	
+    // copy features from another feature manager sharing the same features
+    void copy_cache(FeatureMgr* src_mgr, RagEdge_t* src_edge, RagEdge_t* edge);	
+    void copy_cache(FeatureMgr* src_mgr, RagNode_t* src_node, RagNode_t* node);	
 
     void print_cache(RagEdge_t* edge);	
     void print_cache(RagNode_t* node);	
@@ -298,58 +280,68 @@ class FeatureMgr {
 
 
   private:
-    void compute_diff_features(std::vector<void*>* caches1, std::vector<void*>* caches2, std::vector<double>& feature_results, RagEdge_t* edge);
-    void compute_diff_features2(std::vector<void*>* caches1, std::vector<void*>* caches2, std::vector<double>& feature_results, RagEdge_t* edge);
+    void compute_edge_features(RagEdge_t* edge, std::vector<double>& feature_results);
+    void remove_ignored_features(std::vector<double>& feature_results);
+
+    void compute_diff_features(char* record1, char* record2, std::vector<double>& feature_results, RagEdge_t* edge);
+    void compute_diff_features2(char* record1, char* record2, std::vector<double>& feature_results, RagEdge_t* edge);
      
-    void compute_features(unsigned int prediction_type, std::vector<void*>* caches, std::vector<double>& feature_results, RagEdge_t* edge, unsigned int node_num);
-    void compute_features2(unsigned int prediction_type, std::vector<void*>* caches, std::vector<double>& feature_results, RagEdge_t* edge, unsigned int node_num);
+    void compute_features(unsigned int prediction_type, char* record, std::vector<double>& feature_results, RagEdge_t* edge, unsigned int node_num);
+    void compute_features2(unsigned int prediction_type, char* record, std::vector<double>& feature_results, RagEdge_t* edge, unsigned int node_num);
 
-    void add_val(double val, unsigned int channel, unsigned int& starting_pos, std::vector<void *>& feature_caches)
+    std::string serialize_features(char * current_features, char* record);
+    void serialize_features(char * current_features, char* record, std::string& buffer);
+    void deserialize_features(char * current_features, char* record);
+
+    void add_val(double val, unsigned int channel, unsigned int& starting_pos, char* record)
     {
         std::vector<FeatureCompute*>& features = channels_features[channel];
         for (int i = 0; i < features.size(); ++i) {
-            features[i]->add_point(val, feature_caches[starting_pos]); 
+            features[i]->add_point(val, record + cache_offsets[starting_pos]); 
             ++starting_pos;
         }
     }
-   
-  public: 
-    // !! assume all edge/node caches
-    std::vector<void*>& create_cache(RagEdge_t* edge)
+
+    // cache of the feature at position pos (in channel order) in a record
+    void* get_cache(char* record, unsigned int pos)
     {
-        edge_caches[edge] = std::vector<void*>();
-        std::vector<void*>& caches = edge_caches[edge];
-        unsigned int pos = 0;
-        for (unsigned int i = 0; i < num_channels; ++i) {
-            std::vector<FeatureCompute*>& features = channels_features[i];
-            for (int j = 0; j < features.size(); ++j) {
-                caches.push_back(features[j]->create_cache());
-                ++pos;
-            } 
-        }
-        return caches;
+        return record ? (void*)(record + cache_offsets[pos]) : 0;
     }
-    std::vector<void*>& create_cache(RagNode_t* node)
+
+    char* get_record(RagEdge_t* edge)
     {
-        node_caches[node] = std::vector<void*>();
-        std::vector<void*>& caches = node_caches[node];
-        unsigned int pos = 0;
-        for (unsigned int i = 0; i < num_channels; ++i) {
-            std::vector<FeatureCompute*>& features = channels_features[i];
-            for (int j = 0; j < features.size(); ++j) {
-                caches.push_back(features[j]->create_cache());
-                ++pos;
-            } 
-        }
-        return caches;
-    }   
+        EdgeCaches::iterator iter = edge_caches.find(edge);
+        return (iter != edge_caches.end()) ? feature_store.get_record(iter->second) : 0;
+    }
+    char* get_record(RagNode_t* node)
+    {
+        NodeCaches::iterator iter = node_caches.find(node);
+        return (iter != node_caches.end()) ? feature_store.get_record(iter->second) : 0;
+    }
+
+    // accumulate every feature cache of record2 onto record1
+    void merge_records(char* record1, char* record2);
+   
+  public: 
+    // creates empty features for the given edge/node (resets existing ones)
+    char* create_cache(RagEdge_t* edge);
+    char* create_cache(RagNode_t* node);
 
   private:
     void add_feature(unsigned int channel, FeatureCompute * feature, std::vector<bool>& feature_modes);
 
+    // compute the offset of each feature cache within a feature record
+    void set_feature_layout();
 
     EdgeCaches edge_caches;
     NodeCaches node_caches;
+
+    //! flat records holding the caches of every node/edge
+    FeatureStore feature_store;
+
+    //! offset of each feature cache in a record (in channel order)
+    std::vector<unsigned int> cache_offsets;
+
     unsigned int num_features;
 
     bool specified_features;
@@ -369,6 +361,9 @@ class FeatureMgr {
     EdgeClassifier* eclfr;	 
     double border_weight;
     std::set<unsigned int> ignore_set;
+
+    // features are owned by the feature manager they were copied from
+    bool shared_features;
 };
 
 typedef boost::shared_ptr<FeatureMgr> FeatureMgrPtr;
@@ -0,0 +1,128 @@
+/*!
+ * Defines a pool of fixed-size feature records.  Every node or edge
+ * with features owns one record that holds the caches of all features
+ * back-to-back at offsets fixed when the features are specified.
+ * Records are addressed by a dense id and are carved out of large
+ * blocks so that no per-element heap allocation is needed.
+ *
+ * \author Stephen Plaza (plaza.stephen@gmail.com)
+*/
+
+#ifndef FEATURESTORE_H
+#define FEATURESTORE_H
+
+#include <Utilities/ErrMsg.h>
+#include <vector>
+#include <algorithm>
+
+namespace NeuroProof {
+
+class FeatureStore {
+  public:
+    /*!
+     * Constructor for an empty store with 8-byte records.
+    */
+    FeatureStore() : record_words(1), num_records(0) {}
+
+    /*!
+     * Set the number of bytes used by each record.  This can only be
+     * changed while no records are allocated.
+     * \param num_bytes size of a record in bytes
+    */
+    void set_record_size(unsigned int num_bytes)
+    {
+        if (num_records != free_ids.size()) {
+            throw ErrMsg("Cannot change feature layout after features are computed");
+        }
+        clear();
+        // keep records 8-byte aligned and non-empty
+        record_words = std::max((num_bytes + 7) / 8, 1U);
+    }
+
+    /*!
+     * Get the number of bytes used by each record.
+     * \return size of a record in bytes
+    */
+    unsigned int get_record_size() const
+    {
+        return record_words * sizeof(unsigned long long);
+    }
+
+    /*!
+     * Allocate a zero-initialized record, reusing released ids first.
+     * \return id of the new record
+    */
+    unsigned int allocate()
+    {
+        unsigned int id;
+        if (!free_ids.empty()) {
+            id = free_ids.back();
+            free_ids.pop_back();
+        } else {
+            id = num_records++;
+            if ((id >> BLOCK_SHIFT) >= blocks.size()) {
+                blocks.push_back(std::vector<unsigned long long>(
+                            size_t(record_words) << BLOCK_SHIFT));
+            }
+        }
+        unsigned long long* words = get_words(id);
+        std::fill(words, words + record_words, 0ULL);
+        return id;
+    }
+
+    /*!
+     * Return a record to the pool.
+     * \param id record id
+    */
+    void release(unsigned int id)
+    {
+        free_ids.push_back(id);
+    }
+
+    /*!
+     * Get the bytes of a record.  The address is stable until the
+     * store is cleared.
+     * \param id record id
+     * \return pointer to the start of the record
+    */
+    char* get_record(unsigned int id)
+    {
+        return (char*) get_words(id);
+    }
+
+    /*!
+     * Release every record and the underlying memory.
+    */
+    void clear()
+    {
+        blocks.clear();
+        free_ids.clear();
+        num_records = 0;
+    }
+
+  private:
+    unsigned long long* get_words(unsigned int id)
+    {
+        return &(blocks[id >> BLOCK_SHIFT][size_t(id & BLOCK_MASK) * record_words]);
+    }
+
+    //! number of records allocated per block (as a power of 2)
+    static const unsigned int BLOCK_SHIFT = 12;
+    static const unsigned int BLOCK_MASK = (1 << BLOCK_SHIFT) - 1;
+
+    //! record storage; inner buffers never move once allocated
+    std::vector<std::vector<unsigned long long> > blocks;
+
+    //! ids released for reuse
+    std::vector<unsigned int> free_ids;
+
+    //! size of each record in 64-bit words
+    unsigned int record_words;
+
+    //! number of record ids handed out (including released ones)
+    unsigned int num_records;
+};
+
+}
+
+#endif
@@ -1,5 +1,7 @@
 #include "Features.h"
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 
 using namespace NeuroProof;
 using std::cout;
@@ -9,22 +11,23 @@ using std::string;
 size_t FeatureCompute::serialize(char * bytes, void * cache1, string& buffer)
 {
         size_t read_bytes = 0;
-        FeatureCache* serialize_cache = (FeatureCache*) create_cache();
+        unsigned int num_words = (cache_size() + 7) / 8;
 
         // create temporary cache
-        copy_cache(cache1, serialize_cache);
+        std::vector<unsigned long long> temp_cache(num_words + 1, 0);
+        std::copy((char*) cache1, (char*) cache1 + cache_size(),
+                (char*) &temp_cache[0]);
 
         // check if there is data in the buffer to combine with the current features
         if (bytes != 0) {
-            FeatureCache* cache2 = (FeatureCache*) create_cache();
+            std::vector<unsigned long long> cache2(num_words + 1, 0);
             // extract data for cache
-            read_bytes = cache2->deserialize(bytes);
+            read_bytes = deserialize_cache(bytes, (void*) &cache2[0]);
 
-            // merge cache2 onto temporary serialize_cache
-            merge_cache((void*) serialize_cache, (void*) cache2);
+            // merge cache2 onto temporary cache
+            merge_cache((void*) &temp_cache[0], (void*) &cache2[0]);
         }
-        serialize_cache->serialize(buffer); 
-        delete(serialize_cache);
+        serialize_cache((void*) &temp_cache[0], buffer); 
         
         return read_bytes;
 }
@@ -32,21 +35,22 @@ size_t FeatureCompute::serialize(char * bytes, void * cache1, string& buffer)
 // will overwrite other features
 size_t FeatureCompute::deserialize(char * bytes, void * cache1)
 {
-    return ((FeatureCache*)(cache1))->deserialize(bytes);
+    return deserialize_cache(bytes, cache1);
 }
 
-void* FeatureHist::create_cache(){
-        return (void*)(new HistCache(num_bins+1));
+unsigned int FeatureHist::cache_size()
+{
+    return HistCache::cache_size(num_bins+1);
 }
-    
-void FeatureHist::copy_cache(void * src, void* dest) {
 
-    HistCache* srcHist = (HistCache*) src;    
-    HistCache* destHist = (HistCache*) dest;    
-
-    destHist->count = srcHist->count;	
-    destHist->hist = srcHist->hist;	
+void FeatureHist::serialize_cache(void* cache, string& buffer)
+{
+    HistCache(cache, num_bins+1).serialize(buffer);
+}
 
+unsigned int FeatureHist::deserialize_cache(char * bytes, void* cache)
+{
+    return HistCache(cache, num_bins+1).deserialize(bytes);
 }
 
 void FeatureHist::print_name()
@@ -56,27 +60,23 @@ void FeatureHist::print_name()
 
 void FeatureHist::print_cache(void* pcache ){
 
-    HistCache* hc = (HistCache*) pcache	;
-    cout << "count : " << hc->count << endl;
+    HistCache hc(pcache, num_bins+1);
+    cout << "count : " << hc.count << endl;
     cout << "histogram: ";
-    for(int i=0; i< hc->hist.size(); i++)
-	cout << hc->hist[i] << ", ";
+    for(int i=0; i< hc.num_bins; i++)
+	cout << hc.hist[i] << ", ";
     cout << endl;
 }
 
-void FeatureHist::delete_cache(void * cache) {
-        delete (HistCache*)(cache);
-}
-
 void FeatureHist::add_point(double val, void * cache, unsigned int x , unsigned int y , unsigned int z ) {
-        HistCache * hist_cache = (HistCache*) cache;
-        ++(hist_cache->hist[val * num_bins]);
-        ++(hist_cache->count);
+        HistCache hist_cache(cache, num_bins+1);
+        ++(hist_cache.hist[int(val * num_bins)]);
+        ++(hist_cache.count);
 }
 
 
 void FeatureHist::get_feature_array(void* cache, std::vector<double>& feature_array, RagEdge_t* edge, unsigned int node_num) {
-        HistCache * hist_cache = (HistCache*) cache;
+        HistCache hist_cache(cache, num_bins+1);
         for (unsigned int i = 0; i < thresholds.size(); ++i) {
             feature_array.push_back(get_data(hist_cache, thresholds[i]));
         }
@@ -89,35 +89,34 @@ void  FeatureHist::get_diff_feature_array(void* cache2, void * cache1, std::vect
 
 
 void FeatureHist::merge_cache(void * cache1, void * cache2) {
-        HistCache * hist_cache1 = (HistCache*) cache1;
-        HistCache * hist_cache2 = (HistCache*) cache2;
+        HistCache hist_cache1(cache1, num_bins+1);
+        HistCache hist_cache2(cache2, num_bins+1);
 
-        hist_cache1->count += (hist_cache2->count);
+        hist_cache1.count += (hist_cache2.count);
         for (int i = 0; i <= num_bins; ++i) {
-            hist_cache1->hist[i] += hist_cache2->hist[i];
+            hist_cache1.hist[i] += hist_cache2.hist[i];
         }
-        delete hist_cache2;
 }
 
-double FeatureHist::get_data(HistCache * hist_cache, double threshold) {
-        double threshold_amount = hist_cache->count * (threshold);
+double FeatureHist::get_data(HistCache& hist_cache, double threshold) {
+        double threshold_amount = hist_cache.count * (threshold);
  
-        hist_cache->hist[num_bins-1] += (hist_cache->hist[num_bins]);
-        hist_cache->hist[num_bins] = 0;
+        hist_cache.hist[num_bins-1] += (hist_cache.hist[num_bins]);
+        hist_cache.hist[num_bins] = 0;
 
         unsigned long long curr_count = 0;
         int spot = 0;
         unsigned long long cumval = 0;
         for (int i = 0; i < num_bins; ++i) {
-            curr_count += hist_cache->hist[i];
+            curr_count += hist_cache.hist[i];
             if (curr_count >= threshold_amount) {
                 spot = i;
                 break;
             }
-            cumval += hist_cache->hist[i];
+            cumval += hist_cache.hist[i];
         }
 
-        unsigned long long val2 = hist_cache->hist[spot];
+        unsigned long long val2 = hist_cache.hist[spot];
         double slope = (curr_count - cumval);
         double median_spot = (threshold_amount - cumval)/slope;
         return ((median_spot + spot)/num_bins);
@@ -133,53 +132,51 @@ double FeatureHist::get_data(HistCache * hist_cache, double threshold) {
 
 
 
-void* FeatureMoment::create_cache(){
-        return (void*)(new MomentCache(num_moments));
+unsigned int FeatureMoment::cache_size()
+{
+    return MomentCache::cache_size(num_moments);
 }
-    
-void FeatureMoment::copy_cache(void * src, void * dest) {
-    MomentCache* srcMoments = (MomentCache*) src;
-    MomentCache* destMoments = (MomentCache*) dest;
 
-    destMoments->count = srcMoments->count;
-    destMoments->vals = srcMoments->vals;			
+void FeatureMoment::serialize_cache(void* cache, string& buffer)
+{
+    MomentCache(cache, num_moments).serialize(buffer);
+}
 
+unsigned int FeatureMoment::deserialize_cache(char * bytes, void* cache)
+{
+    return MomentCache(cache, num_moments).deserialize(bytes);
 }
 
 void FeatureMoment::print_cache(void* pcache ){
 
-    MomentCache* hc = (MomentCache*) pcache	;
+    MomentCache hc(pcache, num_moments);
 
-    cout << "count : " << hc->count << endl;
+    cout << "count : " << hc.count << endl;
     cout << "vals: ";
-    for(int i=0; i< hc->vals.size(); i++)
-        cout << hc->vals[i] << ", ";
+    for(int i=0; i< hc.num_moments; i++)
+        cout << hc.vals[i] << ", ";
     cout << endl;
 }
 
 
-void FeatureMoment::delete_cache(void * cache) {
-        delete (MomentCache*)(cache);
-}
-
 void FeatureMoment::add_point(double val, void * cache, unsigned int x, unsigned int y, unsigned int z){
-        MomentCache * moment_cache = (MomentCache*) cache;
-        moment_cache->count += 1;
+        MomentCache moment_cache(cache, num_moments);
+        moment_cache.count += 1;
         for (int i = 0; i < num_moments; ++i) {
-            moment_cache->vals[i] += std::pow(val, i+1);
+            moment_cache.vals[i] += std::pow(val, i+1);
         } 
 }
     
 void FeatureMoment::get_feature_array(void* cache, std::vector<double>& feature_array, RagEdge_t* edge, unsigned int node_num){
-        MomentCache * moment_cache = (MomentCache*) cache;
+        MomentCache moment_cache(cache, num_moments);
         get_data(moment_cache, feature_array);
 } 
 
 void  FeatureMoment::get_diff_feature_array(void* cache2, void * cache1, std::vector<double>& feature_array, RagEdge_t* edge){
         std::vector<double> vals1;
         std::vector<double> vals2;
-        MomentCache * moment_cache1 = (MomentCache*) cache1;
-        MomentCache * moment_cache2 = (MomentCache*) cache2;
+        MomentCache moment_cache1(cache1, num_moments);
+        MomentCache moment_cache2(cache2, num_moments);
         get_data(moment_cache1, vals1);
         get_data(moment_cache2, vals2);
 
@@ -189,33 +186,32 @@ void  FeatureMoment::get_diff_feature_array(void* cache2, void * cache1, std::ve
 } 
 
 void FeatureMoment::merge_cache(void * cache1, void * cache2){
-        MomentCache * moment_cache1 = (MomentCache*) cache1;
-        MomentCache * moment_cache2 = (MomentCache*) cache2;
+        MomentCache moment_cache1(cache1, num_moments);
+        MomentCache moment_cache2(cache2, num_moments);
 
-        moment_cache1->count += moment_cache2->count;
+        moment_cache1.count += moment_cache2.count;
         for (int i = 0; i < num_moments; ++i) {
-            moment_cache1->vals[i] += moment_cache2->vals[i];
+            moment_cache1.vals[i] += moment_cache2.vals[i];
         }
-        delete moment_cache2;
 }
 
 
 
-void FeatureMoment::get_data(MomentCache * moment_cache, std::vector<double>& feature_array){
-        double count = double(moment_cache->count);
+void FeatureMoment::get_data(MomentCache& moment_cache, std::vector<double>& feature_array){
+        double count = double(moment_cache.count);
         //feature_array.push_back(count);
       
         // mean 
         double mean;
         if (num_moments > 0) {
-            mean = moment_cache->vals[0] / count;
+            mean = moment_cache.vals[0] / count;
             feature_array.push_back(mean);
         }
 
         // variance
         double var;
         if (num_moments > 1) {
-            var = moment_cache->vals[1] / count;
+            var = moment_cache.vals[1] / count;
             double var_final = var - std::pow(mean, 2.0);
             feature_array.push_back(var_final);
         } 
@@ -223,14 +219,14 @@ void FeatureMoment::get_data(MomentCache * moment_cache, std::vector<double>& fe
         // skewness    
         double skew;
         if (num_moments > 2) {
-            skew = moment_cache->vals[2] / count;
+            skew = moment_cache.vals[2] / count;
             double skew_final = skew - 3*mean*var + 2*std::pow(mean, 3.0);
             feature_array.push_back(skew_final);
         } 
 
         // kurtosis
         if (num_moments > 3) {
-            double kurt = moment_cache->vals[3] / count;
+            double kurt = moment_cache.vals[3] / count;
             double kurt_final = kurt - 4*mean*skew + 6*std::pow(mean, 2.0)*var - 3*std::pow(mean, 4.0);
             feature_array.push_back(kurt_final);
         } 
@@ -349,31 +345,30 @@ void FeatureInclusiveness::print_name()
 
 void FeatureCount::add_point(double val, void * cache, unsigned int x, unsigned int y, unsigned int z)
 {
-    CountCache * count_cache = (CountCache*) cache;
-    count_cache->count += 1;
+    CountCache count_cache(cache);
+    count_cache.count += 1;
 }
 
 void FeatureCount::get_feature_array(void* cache, std::vector<double>& feature_array, RagEdge_t* edge, unsigned int node_num)
 {
-    CountCache * count_cache = (CountCache*) cache;
-    feature_array.push_back(count_cache->count);
+    CountCache count_cache(cache);
+    feature_array.push_back(count_cache.count);
 } 
 
 void FeatureCount::get_diff_feature_array(void* cache2, void * cache1, std::vector<double>& feature_array, RagEdge_t* edge)
 {
-    CountCache * count_cache1 = (CountCache*) cache1;
-    CountCache * count_cache2 = (CountCache*) cache2;
+    CountCache count_cache1(cache1);
+    CountCache count_cache2(cache2);
 
-    feature_array.push_back(std::abs(count_cache1->count - count_cache2->count));
+    feature_array.push_back(std::abs(count_cache1.count - count_cache2.count));
 } 
 
 void FeatureCount::merge_cache(void * cache1, void * cache2)
 {
-    CountCache * count_cache1 = (CountCache*) cache1;
-    CountCache * count_cache2 = (CountCache*) cache2;
+    CountCache count_cache1(cache1);
+    CountCache count_cache2(cache2);
 
-    count_cache1->count += count_cache2->count;
-    delete count_cache2;
+    count_cache1.count += count_cache2.count;
 }
 
 void FeatureCount::print_name()
@@ -11,13 +11,12 @@ namespace NeuroProof {
 
 class FeatureCompute {
   public:
-    virtual void * create_cache() = 0;
-    virtual void copy_cache(void* src, void* dest)=0;  	
-    virtual void delete_cache(void * cache) = 0;
+    // number of bytes used by the feature in a (zero-initialized) feature record
+    virtual unsigned int cache_size() = 0;
     virtual void add_point(double val, void * cache, unsigned int x = 0, unsigned int y = 0, unsigned int z = 0) = 0;
     virtual void  get_feature_array(void* cache, std::vector<double>& feature_array, RagEdge_t* edge, unsigned int node_num) = 0; 
     virtual void  get_diff_feature_array(void* cache2, void * cache1, std::vector<double>& feature_array, RagEdge_t* edge) = 0; 
-    // will delete second cache
+    // accumulates second cache onto the first
     virtual void merge_cache(void * cache1, void * cache2) = 0; 
     virtual void print_cache(void* pcache) = 0; 	
     virtual void print_name() = 0; 	
@@ -25,6 +24,10 @@ class FeatureCompute {
     size_t serialize(char * bytes, void* cache1, std::string& buffer);
     size_t deserialize(char * bytes, void * cache1);
     virtual ~FeatureCompute() {}
+
+  protected:
+    virtual void serialize_cache(void* cache, std::string& buffer) = 0;
+    virtual unsigned int deserialize_cache(char * bytes, void* cache) = 0;
 };
 
 
@@ -32,9 +35,7 @@ class FeatureHist : public FeatureCompute {
   public:
     FeatureHist(int num_bins_, const std::vector<double>& thresholds_) : num_bins(num_bins_), thresholds(thresholds_) {} 
   
-    void * create_cache();
-    void copy_cache(void* src, void* dest);  	
-    void delete_cache(void * cache);
+    unsigned int cache_size();
     void add_point(double val, void * cache, unsigned int x = 0, unsigned int y = 0, unsigned int z = 0);
     void get_feature_array(void* cache, std::vector<double>& feature_array, RagEdge_t* edge, unsigned int node_num);
     void  get_diff_feature_array(void* cache2, void * cache1, std::vector<double>& feature_array, RagEdge_t* edge);
@@ -42,8 +43,12 @@ class FeatureHist : public FeatureCompute {
     void print_name();	
     void print_cache(void* pcache);
 
+  protected:
+    void serialize_cache(void* cache, std::string& buffer);
+    unsigned int deserialize_cache(char * bytes, void* cache);
+
   private:
-    double get_data(HistCache * hist_cache, double threshold);
+    double get_data(HistCache& hist_cache, double threshold);
       
     int num_bins;
     std::vector<double> thresholds; 
@@ -57,9 +62,7 @@ class FeatureMoment : public FeatureCompute {
         assert((num_moments <= 4) && (num_moments > 0));
     } 
     
-    void * create_cache();
-    void copy_cache(void* src, void* dest);  	
-    void delete_cache(void * cache);
+    unsigned int cache_size();
     void add_point(double val, void * cache, unsigned int x = 0, unsigned int y = 0, unsigned int z = 0);
     void get_feature_array(void* cache, std::vector<double>& feature_array, RagEdge_t* edge, unsigned int node_num);
     void  get_diff_feature_array(void* cache2, void * cache1, std::vector<double>& feature_array, RagEdge_t* edge);
@@ -67,8 +70,12 @@ class FeatureMoment : public FeatureCompute {
     void print_name();
     void print_cache(void* pcache);
 
+  protected:
+    void serialize_cache(void* cache, std::string& buffer);
+    unsigned int deserialize_cache(char * bytes, void* cache);
+
   private:
-    void get_data(MomentCache * moment_cache, std::vector<double>& feature_array);
+    void get_data(MomentCache& moment_cache, std::vector<double>& feature_array);
           
     unsigned int num_moments;
 };
@@ -77,19 +84,15 @@ class FeatureMoment : public FeatureCompute {
 class FeatureInclusiveness : public FeatureCompute {
   public:
     FeatureInclusiveness() {} 
-    void * create_cache()
+    // computed from the graph, no cache needed
+    unsigned int cache_size()
     {
         return 0;
     }
-    void delete_cache(void * cache)
-    {
-        return;
-    }
     void add_point(double val, void * cache, unsigned int x = 0, unsigned int y = 0, unsigned int z = 0)
     {
         return;
     }
-    void copy_cache(void* src, void* dest) {};  	
    
     void get_feature_array(void* cache, std::vector<double>& feature_array, RagEdge_t* edge, unsigned int node_num);
     void  get_diff_feature_array(void* cache2, void * cache1, std::vector<double>& feature_array, RagEdge_t* edge);
@@ -102,6 +105,13 @@ class FeatureInclusiveness : public FeatureCompute {
     void print_name();
     void print_cache(void* pcache) {}
 
+  protected:
+    void serialize_cache(void* cache, std::string& buffer) {}
+    unsigned int deserialize_cache(char * bytes, void* cache)
+    {
+        return 0;
+    }
+
   private:
     void get_node_features(RagNode_t* node, std::vector<double>& features);
     unsigned long long get_lengths(RagNode_t* node, std::set<unsigned long long>& lengths);
@@ -112,17 +122,9 @@ class FeatureInclusiveness : public FeatureCompute {
 class FeatureCount : public FeatureCompute {
   public:
     FeatureCount() {} 
-    void * create_cache()
+    unsigned int cache_size()
     {
-        return (void*)(new CountCache());
-    }
-    void copy_cache(void* src, void* dest)
-    {
-        ((CountCache*)dest)->count = ((CountCache*)src)->count;
-    } 	
-    void delete_cache(void * cache)
-    {
-        delete (CountCache*)(cache);
+        return CountCache::cache_size();
     }
 
     void add_point(double val, void * cache, unsigned int x = 0, unsigned int y = 0, unsigned int z = 0);
@@ -135,6 +137,16 @@ class FeatureCount : public FeatureCompute {
     
     void print_name();
     void print_cache(void *pcache) {}	
+
+  protected:
+    void serialize_cache(void* cache, std::string& buffer)
+    {
+        CountCache(cache).serialize(buffer);
+    }
+    unsigned int deserialize_cache(char * bytes, void* cache)
+    {
+        return CountCache(cache).deserialize(bytes);
+    }
 };
 
 
@@ -0,0 +1,197 @@
+/*!
+ * Defines functions for creating volumes from python objects that
+ * expose their memory through the python buffer protocol (such as
+ * numpy arrays).  Arrays are indexed (z,y,x) or (z,y,x,channel) as
+ * in the rest of the python interface and may be in C or Fortran
+ * order or be strided views.  Only code that is compiled against
+ * python should include this file.
+ *
+ * \author Stephen Plaza (plaza.stephen@gmail.com)
+*/
+
+#ifndef BUFFERVOLUMEIO_H
+#define BUFFERVOLUMEIO_H
+
+#include <Python.h>
+#include <Stack/VolumeLabelData.h>
+#include <Utilities/ErrMsg.h>
+
+#include <boost/shared_ptr.hpp>
+#include <vector>
+#include <string>
+#include <cstring>
+
+namespace NeuroProof {
+
+/*!
+ * Releases a python buffer.  The interpreter lock is taken since the
+ * last volume using the buffer can be freed from any thread.
+ * \param buffer python buffer
+*/
+inline void release_python_buffer(Py_buffer* buffer)
+{
+    PyGILState_STATE state = PyGILState_Ensure();
+    PyBuffer_Release(buffer);
+    PyGILState_Release(state);
+    delete buffer;
+}
+
+/*!
+ * Gets the buffer of a python object with its strides.
+ * \param obj python object
+ * \return buffer (empty if the object does not expose a buffer)
+*/
+inline boost::shared_ptr<Py_buffer> get_python_buffer(PyObject* obj)
+{
+    Py_buffer* buffer = new Py_buffer;
+    if (PyObject_GetBuffer(obj, buffer, PyBUF_STRIDES | PyBUF_FORMAT) != 0) {
+        PyErr_Clear();
+        delete buffer;
+        return boost::shared_ptr<Py_buffer>();
+    }
+    return boost::shared_ptr<Py_buffer>(buffer, release_python_buffer);
+}
+
+/*!
+ * Gets the element type of a buffer without its byte order prefix.
+ * \param buffer python buffer
+ * \return struct module format character (0 if not a single element)
+*/
+inline char get_buffer_type(const Py_buffer& buffer)
+{
+    const char* format = buffer.format ? buffer.format : "B";
+    if (std::strchr("@=<>!", *format)) {
+        ++format;
+    }
+    return (std::strlen(format) == 1) ? *format : 0;
+}
+
+/*!
+ * Copies a strided (z,y,x) block of a buffer into a volume.
+ * \param data start of the block
+ * \param strides byte strides of the z, y, and x axes
+ * \param volume volume with the shape of the block
+*/
+template <typename SrcT, typename T>
+void copy_buffer_volume(const char* data, const Py_ssize_t* strides, VolumeData<T>& volume)
+{
+    T* voxel_data = volume.data();
+    for (int z = 0; z < (int)volume.shape(2); ++z) {
+        for (int y = 0; y < (int)volume.shape(1); ++y) {
+            const char* row = data + z * strides[0] + y * strides[1];
+            for (int x = 0; x < (int)volume.shape(0); ++x) {
+                *voxel_data++ = T(*((const SrcT*)(row + x * strides[2])));
+            }
+        }
+    }
+}
+
+/*!
+ * Creates a label volume from a 3D (z,y,x) integer array.  The labels
+ * are copied in one pass since label volumes are relabeled in place.
+ * \param obj python object with the labels
+ * \return label volume (empty if the object does not expose a buffer)
+*/
+inline VolumeLabelPtr create_label_volume_from_buffer(PyObject* obj)
+{
+    boost::shared_ptr<Py_buffer> buffer = get_python_buffer(obj);
+    if (!buffer) {
+        return VolumeLabelPtr();
+    }
+    if (buffer->ndim != 3) {
+        throw ErrMsg("Label volume is not exactly 3D");
+    }
+
+    char type = get_buffer_type(*buffer);
+    if (!type || !std::strchr("bBhHiIlLqQ", type)) {
+        throw ErrMsg("Label volume does not have an integer type");
+    }
+
+    VolumeLabelPtr labels = VolumeLabelData::create_volume(buffer->shape[2],
+            buffer->shape[1], buffer->shape[0]);
+    const char* data = (const char*) buffer->buf;
+
+    switch (buffer->itemsize) {
+      case 1:
+        copy_buffer_volume<unsigned char>(data, buffer->strides, *labels);
+        break;
+      case 2:
+        copy_buffer_volume<unsigned short>(data, buffer->strides, *labels);
+        break;
+      case 4:
+        copy_buffer_volume<unsigned int>(data, buffer->strides, *labels);
+        break;
+      case 8:
+        copy_buffer_volume<unsigned long long>(data, buffer->strides, *labels);
+        break;
+      default:
+        throw ErrMsg("Label volume has an unsupported integer size");
+    }
+
+    return labels;
+}
+
+/*!
+ * Creates a prediction volume for each channel of a 3D (z,y,x) or 4D
+ * (z,y,x,channel) array of floats.  A float32 channel whose x voxels
+ * are adjacent and whose rows and planes follow without gaps uses the
+ * array memory directly; other channels are copied.  Prediction
+ * volumes must be contiguous, so this requires 4D predictions to be
+ * stored as a C-order (channel,z,y,x) array seen through a
+ * (z,y,x,channel) view.  C-order (z,y,x,channel) and Fortran-order
+ * arrays interleave or reverse the axes and are copied.
+ * \param obj python object with the predictions
+ * \param prob_list prediction volume for each channel
+ * \return false if the object does not expose a buffer
+*/
+inline bool create_prob_volumes_from_buffer(PyObject* obj, std::vector<VolumeProbPtr>& prob_list)
+{
+    prob_list.clear();
+    boost::shared_ptr<Py_buffer> buffer = get_python_buffer(obj);
+    if (!buffer) {
+        return false;
+    }
+    if ((buffer->ndim != 3) && (buffer->ndim != 4)) {
+        throw ErrMsg("Prediction volume is not 3D or 4D");
+    }
+
+    char type = get_buffer_type(*buffer);
+    bool is_float = (type == 'f') && (buffer->itemsize == sizeof(float));
+    bool is_double = (type == 'd') && (buffer->itemsize == sizeof(double));
+    if (!is_float && !is_double) {
+        throw ErrMsg("Prediction volume is not float32 or float64");
+    }
+
+    unsigned int xsize = buffer->shape[2];
+    unsigned int ysize = buffer->shape[1];
+    unsigned int zsize = buffer->shape[0];
+    unsigned int num_channels = (buffer->ndim == 4) ? buffer->shape[3] : 1;
+    Py_ssize_t channel_stride = (buffer->ndim == 4) ? buffer->strides[3] : 0;
+
+    bool is_dense = is_float && (buffer->strides[2] == Py_ssize_t(sizeof(Prob_t))) &&
+        (buffer->strides[1] == Py_ssize_t(sizeof(Prob_t)) * xsize) &&
+        (buffer->strides[0] == Py_ssize_t(sizeof(Prob_t)) * xsize * ysize);
+
+    for (unsigned int i = 0; i < num_channels; ++i) {
+        char* data = (char*) buffer->buf + i * channel_stride;
+        VolumeProbPtr prob;
+        if (is_dense) {
+            prob = VolumeProb::create_volume((Prob_t*) data, xsize, ysize, zsize, buffer);
+        } else {
+            prob = VolumeProb::create_volume();
+            prob->reshape(vigra::MultiArrayShape<3>::type(xsize, ysize, zsize));
+            if (is_float) {
+                copy_buffer_volume<float>(data, buffer->strides, *prob);
+            } else {
+                copy_buffer_volume<double>(data, buffer->strides, *prob);
+            }
+        }
+        prob_list.push_back(prob);
+    }
+
+    return true;
+}
+
+}
+
+#endif
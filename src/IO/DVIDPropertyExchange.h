@@ -0,0 +1,185 @@
+/*!
+ * Defines a pipelined exchange of a property stored at the vertices
+ * or edges of a DVID graph.  Each property is read, merged with the
+ * local value, and written back under a DVID transaction; elements
+ * whose transaction fails are read and merged again.  The elements
+ * are split into batches that are processed by a bounded pool of
+ * workers, so that the reads, merges, and writes of different batches
+ * overlap.
+ *
+ * The exchange is templated on the node service so that anything with
+ * the get_properties/set_properties interface of libdvid's
+ * DVIDNodeService (such as the mock service in the unit tests) can be
+ * used.
+ *
+ * \author Stephen Plaza (plaza.stephen@gmail.com)
+*/
+
+#ifndef DVIDPROPERTYEXCHANGE_H
+#define DVIDPROPERTYEXCHANGE_H
+
+#include <libdvid/DVIDNodeService.h>
+#include <Utilities/ErrMsg.h>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/bind.hpp>
+#include <vector>
+#include <string>
+#include <exception>
+#include <algorithm>
+
+namespace NeuroProof {
+
+/*!
+ * Merges the property stored in DVID for an element with the local
+ * value of the element.  The merged property is written to the buffer
+ * (the buffer is reused between calls so it should be overwritten).
+ * The function is called concurrently by different workers.
+*/
+template <typename Element>
+struct DVIDPropertyMerge {
+    typedef boost::function<void (const Element& element, char* current_property,
+            std::string& buffer)> type;
+};
+
+/*!
+ * Shared progress of workers that split DVID requests into batches.
+*/
+struct DVIDExchangeState {
+    DVIDExchangeState() : next_batch(0), failed(false) {}
+
+    //! first element of the next batch to be processed
+    size_t next_batch;
+
+    //! set when a worker has failed so that the others stop
+    bool failed;
+
+    //! message of the first failure
+    std::string error;
+
+    boost::mutex mutex;
+};
+
+/*!
+ * Worker that processes batches of elements until none remain.
+ * \param service node service used only by this worker
+ * \param graph_name name of the DVID graph
+ * \param key name of the property
+ * \param elements vertices or edges exchanged
+ * \param merge merges the DVID and local properties
+ * \param batch_size number of elements in a batch
+ * \param state progress shared by the workers
+*/
+template <typename Service, typename Element>
+void exchange_dvid_property_batches(Service* service, const std::string& graph_name,
+        const std::string& key, const std::vector<Element>& elements,
+        typename DVIDPropertyMerge<Element>::type merge, size_t batch_size,
+        DVIDExchangeState* state)
+{
+    std::string buffer;
+    std::vector<libdvid::BinaryDataPtr> properties;
+    libdvid::VertexTransactions transaction_ids;
+    std::vector<Element> batch, leftover;
+
+    try {
+        while (1) {
+            size_t start;
+            {
+                boost::mutex::scoped_lock lock(state->mutex);
+                if (state->failed || (state->next_batch >= elements.size())) {
+                    return;
+                }
+                start = state->next_batch;
+                state->next_batch += batch_size;
+            }
+            size_t end = std::min(start + batch_size, elements.size());
+            batch.assign(elements.begin() + start, elements.begin() + end);
+
+            // retry elements whose transaction failed until all are written
+            while (!batch.empty()) {
+                properties.clear();
+                transaction_ids.clear();
+                service->get_properties(graph_name, batch, key, properties, transaction_ids);
+
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    char* curr_data = 0;
+                    if (properties[i]->get_data().length() > 0) {
+                        curr_data = (char*) properties[i]->get_raw();
+                    }
+                    merge(batch[i], curr_data, buffer);
+                    properties[i] = libdvid::BinaryData::create_binary_data(
+                            buffer.c_str(), buffer.length());
+                }
+
+                leftover.clear();
+                service->set_properties(graph_name, batch, key, properties,
+                        transaction_ids, leftover);
+                batch.swap(leftover);
+            }
+        }
+    } catch (ErrMsg& err) {
+        boost::mutex::scoped_lock lock(state->mutex);
+        if (!state->failed) {
+            state->error = err.str;
+        }
+        state->failed = true;
+    } catch (std::exception& e) {
+        boost::mutex::scoped_lock lock(state->mutex);
+        if (!state->failed) {
+            state->error = e.what();
+        }
+        state->failed = true;
+    }
+}
+
+/*!
+ * Reads, merges, and writes a property for each of the given vertices
+ * or edges of a DVID graph.  A worker is started for each service
+ * given (services should not be shared between workers since a node
+ * service holds a single connection).
+ * \param services node service for each worker
+ * \param graph_name name of the DVID graph
+ * \param key name of the property
+ * \param elements vertices or edges exchanged
+ * \param merge merges the DVID and local properties
+ * \param batch_size number of elements read and written together
+*/
+template <typename Service, typename Element>
+void exchange_dvid_properties(std::vector<boost::shared_ptr<Service> >& services,
+        const std::string& graph_name, const std::string& key,
+        const std::vector<Element>& elements,
+        typename DVIDPropertyMerge<Element>::type merge, size_t batch_size = 1000)
+{
+    if (services.empty()) {
+        throw ErrMsg("No DVID node service given for the property exchange");
+    }
+    batch_size = std::max(batch_size, size_t(1));
+
+    DVIDExchangeState state;
+    size_t num_batches = (elements.size() + batch_size - 1) / batch_size;
+    size_t num_workers = std::min(services.size(), num_batches);
+
+    if (num_workers > 1) {
+        boost::thread_group threads;
+        for (size_t i = 0; i < num_workers; ++i) {
+            threads.create_thread(boost::bind(&exchange_dvid_property_batches<Service, Element>,
+                        services[i].get(), boost::cref(graph_name), boost::cref(key),
+                        boost::cref(elements), merge, batch_size, &state));
+        }
+        threads.join_all();
+    } else {
+        exchange_dvid_property_batches(services[0].get(), graph_name, key, elements,
+                merge, batch_size, &state);
+    }
+
+    if (state.failed) {
+        throw ErrMsg("DVID property exchange failed: " + state.error);
+    }
+}
+
+}
+
+#endif
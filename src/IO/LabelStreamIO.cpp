@@ -0,0 +1,187 @@
+#include "LabelStreamIO.h"
+#include <Utilities/ErrMsg.h>
+
+#include <limits>
+#include <algorithm>
+
+using std::vector;
+using std::string;
+
+namespace NeuroProof {
+
+// number of labels read from the stream at a time
+static const size_t LABEL_BLOCK_SIZE = 1 << 16;
+
+LabelStreamReader::LabelStreamReader(std::istream& stream_) : stream(stream_),
+    chunked(false), remap(sizeof(Label_t) < sizeof(unsigned long long)), num_voxels(0), voxels_read(0), last_label(0), last_id(0),
+    planes_read(0), finished(false)
+{
+    unsigned long long header[3];
+    read_bytes((char*) header, sizeof(unsigned long long));
+    if (header[0] == LABEL_STREAM_MAGIC) {
+        chunked = true;
+        read_bytes((char*) header, 3 * sizeof(unsigned long long));
+    } else {
+        read_bytes((char*) (header + 1), 2 * sizeof(unsigned long long));
+    }
+
+    labelvol = VolumeLabelData::create_volume(header[0], header[1], header[2]);
+    num_voxels = size_t(header[0]) * header[1] * header[2];
+
+    // label 0 is kept as id 0
+    labels.push_back(0);
+    label_ids[0] = 0;
+}
+
+void LabelStreamReader::read_volume()
+{
+    try {
+        vector<unsigned long long> buffer;
+
+        if (!chunked) {
+            buffer.resize(LABEL_BLOCK_SIZE);
+            while (voxels_read < num_voxels) {
+                size_t num_labels = std::min(LABEL_BLOCK_SIZE, num_voxels - voxels_read);
+                read_bytes((char*) &buffer[0], num_labels * sizeof(unsigned long long));
+                add_labels(&buffer[0], num_labels);
+            }
+        }
+
+        while (voxels_read < num_voxels) {
+            unsigned long long frame[3];
+            read_bytes((char*) frame, 3 * sizeof(unsigned long long));
+            unsigned long long encoding = frame[0];
+            unsigned long long frame_voxels = frame[1];
+            unsigned long long payload_size = frame[2];
+
+            if (frame_voxels > (num_voxels - voxels_read)) {
+                throw ErrMsg("Label stream frame extends past the end of the volume");
+            }
+
+            if (encoding == LABEL_STREAM_RAW) {
+                if (payload_size != frame_voxels * sizeof(unsigned long long)) {
+                    throw ErrMsg("Label stream raw frame has the wrong payload size");
+                }
+                buffer.resize(std::min(size_t(frame_voxels), LABEL_BLOCK_SIZE));
+                while (frame_voxels > 0) {
+                    size_t num_labels = std::min(size_t(frame_voxels), LABEL_BLOCK_SIZE);
+                    read_bytes((char*) &buffer[0], num_labels * sizeof(unsigned long long));
+                    add_labels(&buffer[0], num_labels);
+                    frame_voxels -= num_labels;
+                }
+            } else if (encoding == LABEL_STREAM_RLE) {
+                if (payload_size % (2 * sizeof(unsigned long long))) {
+                    throw ErrMsg("Label stream RLE frame has the wrong payload size");
+                }
+                size_t num_runs = payload_size / (2 * sizeof(unsigned long long));
+                buffer.resize(2 * std::min(num_runs, LABEL_BLOCK_SIZE));
+                while (num_runs > 0) {
+                    size_t block_runs = std::min(num_runs, LABEL_BLOCK_SIZE);
+                    read_bytes((char*) &buffer[0], 2 * block_runs * sizeof(unsigned long long));
+                    for (size_t i = 0; i < block_runs; ++i) {
+                        if (buffer[2*i] > frame_voxels) {
+                            throw ErrMsg("Label stream RLE frame has more voxels than specified");
+                        }
+                        add_run(buffer[2*i+1], buffer[2*i]);
+                        frame_voxels -= buffer[2*i];
+                    }
+                    update_progress();
+                    num_runs -= block_runs;
+                }
+                if (frame_voxels != 0) {
+                    throw ErrMsg("Label stream RLE frame has fewer voxels than specified");
+                }
+            } else {
+                throw ErrMsg("Label stream frame has an unknown encoding");
+            }
+        }
+    } catch (ErrMsg& err) {
+        boost::mutex::scoped_lock lock(mutex);
+        error = err.str;
+    } catch (std::exception& e) {
+        boost::mutex::scoped_lock lock(mutex);
+        error = e.what();
+    }
+
+    boost::mutex::scoped_lock lock(mutex);
+    if (error.empty()) {
+        planes_read = labelvol->shape(2);
+    }
+    finished = true;
+    planes_read_cond.notify_all();
+}
+
+unsigned int LabelStreamReader::wait_for_planes(unsigned int num_planes)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    while ((planes_read < num_planes) && !finished) {
+        planes_read_cond.wait(lock);
+    }
+    if (!error.empty()) {
+        throw ErrMsg(error);
+    }
+    return planes_read;
+}
+
+void LabelStreamReader::read_bytes(char* buffer, size_t num_bytes)
+{
+    stream.read(buffer, num_bytes);
+    if (size_t(stream.gcount()) != num_bytes) {
+        throw ErrMsg("Label stream ended early");
+    }
+}
+
+void LabelStreamReader::add_labels(const unsigned long long* buffer, size_t num_labels)
+{
+    // the (x,y,z) volume is stored with x varying fastest like the stream
+    Label_t* voxel_data = labelvol->data() + voxels_read;
+    for (size_t i = 0; i < num_labels; ++i) {
+        voxel_data[i] = get_id(buffer[i]);
+    }
+    voxels_read += num_labels;
+    update_progress();
+}
+
+void LabelStreamReader::add_run(unsigned long long label, size_t run_length)
+{
+    Label_t id = get_id(label);
+    Label_t* voxel_data = labelvol->data() + voxels_read;
+    std::fill(voxel_data, voxel_data + run_length, id);
+    voxels_read += run_length;
+}
+
+Label_t LabelStreamReader::get_id(unsigned long long label)
+{
+    if (!remap) {
+        return Label_t(label);
+    }
+    if (label == last_label) {
+        return last_id;
+    }
+
+    std::unordered_map<unsigned long long, Label_t>::iterator iter = label_ids.find(label);
+    if (iter == label_ids.end()) {
+        if (labels.size() > std::numeric_limits<Label_t>::max()) {
+            throw ErrMsg("Label stream has too many distinct labels");
+        }
+        iter = label_ids.insert(std::make_pair(label, Label_t(labels.size()))).first;
+        labels.push_back(label);
+    }
+    last_label = label;
+    last_id = iter->second;
+    return last_id;
+}
+
+void LabelStreamReader::update_progress()
+{
+    size_t plane_size = labelvol->shape(0) * labelvol->shape(1);
+    unsigned int planes = plane_size ? (voxels_read / plane_size) : labelvol->shape(2);
+
+    boost::mutex::scoped_lock lock(mutex);
+    if (planes > planes_read) {
+        planes_read = planes;
+        planes_read_cond.notify_all();
+    }
+}
+
+}
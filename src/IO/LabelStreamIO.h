@@ -0,0 +1,144 @@
+/*!
+ * Defines a reader for label volumes streamed as 64-bit labels.  Two
+ * stream layouts are supported:
+ *
+ * 1. The original layout: the x, y, and z sizes as 64-bit integers
+ * followed by every label as a 64-bit integer (x varying fastest).
+ *
+ * 2. The chunked layout: LABEL_STREAM_MAGIC followed by the x, y, and
+ * z sizes and then a sequence of frames that fill the volume in the
+ * same order.  Each frame has a 64-bit header of the encoding, the
+ * number of voxels in the frame, and the number of payload bytes.
+ * Raw frames (LABEL_STREAM_RAW) hold a 64-bit label per voxel and
+ * run-length encoded frames (LABEL_STREAM_RLE) hold (run length,
+ * label) pairs of 64-bit integers.  Frames can end anywhere in the
+ * volume.
+ *
+ * With 32-bit labels, labels are assigned consecutive ids as they are
+ * read so that 64-bit label spaces are not truncated; the original
+ * label of an id can be retrieved after reading.  With 64-bit labels
+ * (NEUROPROOF_64BIT_LABELS) the ids are the labels.  The volume can be
+ * read in another thread while completed z-planes are being processed.
+ *
+ * \author Stephen Plaza (plaza.stephen@gmail.com)
+*/
+
+#ifndef LABELSTREAMIO_H
+#define LABELSTREAMIO_H
+
+#include <Stack/VolumeLabelData.h>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <istream>
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+namespace NeuroProof {
+
+//! first 64-bit word of a chunked label stream ("NPLABELS")
+static const unsigned long long LABEL_STREAM_MAGIC = 0x534c4542414c504eULL;
+
+//! frame of 64-bit labels
+static const unsigned long long LABEL_STREAM_RAW = 0;
+
+//! frame of (run length, label) pairs
+static const unsigned long long LABEL_STREAM_RLE = 1;
+
+class LabelStreamReader {
+  public:
+    /*!
+     * Reads the header of the stream and creates the label volume.
+     * \param stream_ binary input stream
+    */
+    LabelStreamReader(std::istream& stream_);
+
+    /*!
+     * Label volume filled by 'read_volume'.
+     * \return label volume with the ids of the labels
+    */
+    VolumeLabelPtr get_labelvol()
+    {
+        return labelvol;
+    }
+
+    /*!
+     * Determines whether the stream uses the chunked layout.
+     * \return true if the stream is chunked
+    */
+    bool is_chunked() const
+    {
+        return chunked;
+    }
+
+    /*!
+     * Reads all voxels of the volume from the stream.  Errors are
+     * reported through 'wait_for_planes' so that this can be run in
+     * its own thread.
+    */
+    void read_volume();
+
+    /*!
+     * Waits until at least the given number of z-planes are read.
+     * \param num_planes number of z-planes needed
+     * \return number of z-planes read
+    */
+    unsigned int wait_for_planes(unsigned int num_planes);
+
+    /*!
+     * Retrieves the original label for an id in the label volume.
+     * \param id label id
+     * \return 64-bit label from the stream
+    */
+    unsigned long long get_label(Label_t id) const
+    {
+        return remap ? labels[id] : id;
+    }
+
+  private:
+    //! read bytes from the stream or throw if the stream ends
+    void read_bytes(char* buffer, size_t num_bytes);
+
+    //! store the ids of labels in the buffer at the next voxels
+    void add_labels(const unsigned long long* buffer, size_t num_labels);
+
+    //! store the id of a label at the next voxels
+    void add_run(unsigned long long label, size_t run_length);
+
+    //! id for a label (assigns a new id to new labels)
+    Label_t get_id(unsigned long long label);
+
+    //! report the planes completed since the last update
+    void update_progress();
+
+    std::istream& stream;
+    bool chunked;
+
+    //! true if labels are wider than ids and must be mapped
+    bool remap;
+
+    VolumeLabelPtr labelvol;
+
+    //! number of voxels in the volume and read so far
+    size_t num_voxels, voxels_read;
+
+    //! original label for each id
+    std::vector<unsigned long long> labels;
+    std::unordered_map<unsigned long long, Label_t> label_ids;
+
+    //! last label and id looked up (labels repeat along x)
+    unsigned long long last_label;
+    Label_t last_id;
+
+    //! state shared with threads waiting for planes
+    boost::mutex mutex;
+    boost::condition_variable planes_read_cond;
+    unsigned int planes_read;
+    bool finished;
+    std::string error;
+};
+
+}
+
+#endif
@@ -8,10 +8,18 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <cstring>
+#include <unordered_map>
 #include <boost/tuple/tuple.hpp>
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 using std::cout; using std::endl; using std::ifstream; using std::ofstream;
-using std::string;
+using std::string; using std::vector;
+using std::unordered_map;
 
 namespace NeuroProof {
 
@@ -52,8 +60,8 @@ Rag_t* create_rag_from_json(Json::Value& json_reader_vals)
         // edge list must contain a node1 and node2 unique identifier
         // other properties are specied for the nodes and edge
         for (unsigned int i = 0; i < edge_list.size(); ++i) {
-            Node_t node1 = edge_list[i]["node1"].asUInt();
-            Node_t node2 = edge_list[i]["node2"].asUInt();
+            Node_t node1 = edge_list[i]["node1"].asLargestUInt();
+            Node_t node2 = edge_list[i]["node2"].asLargestUInt();
             unsigned int size1 = edge_list[i].get("size1", 1).asUInt();
             unsigned int size2 = edge_list[i].get("size2", 1).asUInt();
             double weight = edge_list[i].get("weight", 0.0).asDouble();
@@ -179,4 +187,436 @@ bool create_json_from_rag(Rag_t* rag, Json::Value& json_writer)
 
 
 
+const char* BINARY_GRAPH_EXTENSION = ".npgraph";
+
+//! identifies binary graph files
+static const char BINARY_GRAPH_MAGIC[8] = {'N', 'P', 'G', 'R', 'A', 'P', 'H', '\0'};
+static const unsigned int BINARY_GRAPH_VERSION = 1;
+
+/*!
+ * Header at the start of a binary graph file.  It is followed by the
+ * node columns (ids, sizes), the edge columns (node1, node2, weights,
+ * flags, locations, edge sizes, features) and the json text of the
+ * additional graph information.  Every column starts on an 8-byte
+ * boundary.
+*/
+struct BinaryGraphHeader {
+    char magic[8];
+    unsigned int version;
+    unsigned int num_edge_features;
+    unsigned long long num_nodes;
+    unsigned long long num_edges;
+    unsigned long long graph_info_size;
+};
+
+//! size of a column in bytes including the padding to 8 bytes
+static unsigned long long padded_size(unsigned long long num_bytes)
+{
+    return (num_bytes + 7) & ~7ULL;
+}
+
+/*!
+ * Buffers the values of one column and writes them in large blocks.
+*/
+template <typename T>
+class ColumnWriter {
+  public:
+    ColumnWriter(ofstream& fout_) : fout(fout_), num_bytes(0)
+    {
+        buffer.reserve(BUFFER_SIZE);
+    }
+
+    void add(T val)
+    {
+        buffer.push_back(val);
+        if (buffer.size() == BUFFER_SIZE) {
+            flush();
+        }
+    }
+
+    /*!
+     * Writes the remaining values and pads the column to 8 bytes.
+    */
+    void finish()
+    {
+        flush();
+        unsigned long long padding = padded_size(num_bytes) - num_bytes;
+        char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+        fout.write(zeros, padding);
+        num_bytes = 0;
+    }
+
+  private:
+    void flush()
+    {
+        if (!buffer.empty()) {
+            fout.write((const char*)(&buffer[0]), buffer.size() * sizeof(T));
+            num_bytes += buffer.size() * sizeof(T);
+            buffer.clear();
+        }
+    }
+
+    static const size_t BUFFER_SIZE = 1 << 16;
+
+    ofstream& fout;
+    vector<T> buffer;
+    unsigned long long num_bytes;
+};
+
+bool is_binary_graph_file(const char * file_name)
+{
+    size_t name_len = strlen(file_name);
+    size_t ext_len = strlen(BINARY_GRAPH_EXTENSION);
+    return (name_len >= ext_len) &&
+        (strcmp(file_name + name_len - ext_len, BINARY_GRAPH_EXTENSION) == 0);
+}
+
+bool create_binaryfile_from_rag(Rag_t* rag, const char * file_name,
+        const Json::Value& graph_info, const vector<double>& edge_features,
+        unsigned int num_edge_features)
+{
+    try {
+        BinaryGraphHeader header;
+        memcpy(header.magic, BINARY_GRAPH_MAGIC, sizeof(header.magic));
+        header.version = BINARY_GRAPH_VERSION;
+        header.num_edge_features = num_edge_features;
+        header.num_nodes = rag->get_num_regions();
+        header.num_edges = rag->get_num_edges();
+
+        if (edge_features.size() != header.num_edges * num_edge_features) {
+            throw ErrMsg("Error: number of edge features does not match the graph");
+        }
+
+        string info_text;
+        if (!graph_info.isNull()) {
+            Json::FastWriter json_writer;
+            info_text = json_writer.write(graph_info);
+        }
+        header.graph_info_size = info_text.size();
+
+        ofstream fout(file_name, std::ios::out | std::ios::binary);
+        if (!fout) {
+            throw ErrMsg("Error: output file could not be opened");
+        }
+        fout.write((const char*)(&header), sizeof(header));
+
+        // nodes are referenced by edges through their position
+        unordered_map<Node_t, unsigned int> node_positions;
+        ColumnWriter<unsigned long long> node_ids(fout);
+        unsigned int position = 0;
+        for (Rag_t::nodes_iterator iter = rag->nodes_begin();
+                iter != rag->nodes_end(); ++iter, ++position) {
+            node_positions[(*iter)->get_node_id()] = position;
+            node_ids.add((*iter)->get_node_id());
+        }
+        node_ids.finish();
+
+        ColumnWriter<unsigned long long> node_sizes(fout);
+        for (Rag_t::nodes_iterator iter = rag->nodes_begin();
+                iter != rag->nodes_end(); ++iter) {
+            node_sizes.add((*iter)->get_size());
+        }
+        node_sizes.finish();
+
+        ColumnWriter<unsigned int> edge_nodes(fout);
+        for (Rag_t::edges_iterator iter = rag->edges_begin();
+                iter != rag->edges_end(); ++iter) {
+            edge_nodes.add(node_positions[(*iter)->get_node1()->get_node_id()]);
+        }
+        edge_nodes.finish();
+        for (Rag_t::edges_iterator iter = rag->edges_begin();
+                iter != rag->edges_end(); ++iter) {
+            edge_nodes.add(node_positions[(*iter)->get_node2()->get_node_id()]);
+        }
+        edge_nodes.finish();
+
+        ColumnWriter<double> edge_weights(fout);
+        for (Rag_t::edges_iterator iter = rag->edges_begin();
+                iter != rag->edges_end(); ++iter) {
+            edge_weights.add((*iter)->get_weight());
+        }
+        edge_weights.finish();
+
+        ColumnWriter<unsigned char> edge_flags(fout);
+        for (Rag_t::edges_iterator iter = rag->edges_begin();
+                iter != rag->edges_end(); ++iter) {
+            unsigned char flags = 0;
+            if ((*iter)->is_preserve()) {
+                flags |= BinaryGraphView::PRESERVE;
+            }
+            if ((*iter)->is_false_edge()) {
+                flags |= BinaryGraphView::FALSE_EDGE;
+            }
+            if ((*iter)->has_property("location")) {
+                flags |= BinaryGraphView::HAS_LOCATION;
+            }
+            if ((*iter)->has_property("edge_size")) {
+                flags |= BinaryGraphView::HAS_EDGE_SIZE;
+            }
+            edge_flags.add(flags);
+        }
+        edge_flags.finish();
+
+        // missing locations and edge sizes are written as 0
+        ColumnWriter<unsigned int> edge_locations(fout);
+        for (Rag_t::edges_iterator iter = rag->edges_begin();
+                iter != rag->edges_end(); ++iter) {
+            Location location(0, 0, 0);
+            if ((*iter)->has_property("location")) {
+                location = (*iter)->get_property<Location>("location");
+            }
+            edge_locations.add(boost::get<0>(location));
+            edge_locations.add(boost::get<1>(location));
+            edge_locations.add(boost::get<2>(location));
+        }
+        edge_locations.finish();
+
+        ColumnWriter<unsigned int> edge_sizes(fout);
+        for (Rag_t::edges_iterator iter = rag->edges_begin();
+                iter != rag->edges_end(); ++iter) {
+            unsigned int edge_size = 0;
+            if ((*iter)->has_property("edge_size")) {
+                edge_size = (*iter)->get_property<unsigned int>("edge_size");
+            }
+            edge_sizes.add(edge_size);
+        }
+        edge_sizes.finish();
+
+        ColumnWriter<double> features(fout);
+        for (size_t i = 0; i < edge_features.size(); ++i) {
+            features.add(edge_features[i]);
+        }
+        features.finish();
+
+        fout.write(info_text.c_str(), info_text.size());
+        if (!fout) {
+            throw ErrMsg("Error: binary graph could not be written");
+        }
+        fout.close();
+    } catch (ErrMsg& msg) {
+        cout << msg.str << endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool create_binaryfile_from_rag(Rag_t* rag, const char * file_name)
+{
+    return create_binaryfile_from_rag(rag, file_name, Json::Value(),
+            vector<double>(), 0);
+}
+
+BinaryGraphView::BinaryGraphView(const char * file_name) : data(0), data_size(0)
+{
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0) {
+        throw ErrMsg("Error: input file: " + string(file_name) + " cannot be opened");
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0) {
+        close(fd);
+        throw ErrMsg("Error: input file: " + string(file_name) + " cannot be opened");
+    }
+    data_size = file_stat.st_size;
+    if (data_size < sizeof(BinaryGraphHeader)) {
+        close(fd);
+        throw ErrMsg("Error: " + string(file_name) + " is not a binary graph");
+    }
+
+    void* mapped = mmap(0, data_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        throw ErrMsg("Error: input file: " + string(file_name) + " cannot be mapped");
+    }
+    data = (char*) mapped;
+
+    const BinaryGraphHeader* header = (const BinaryGraphHeader*) data;
+    if ((memcmp(header->magic, BINARY_GRAPH_MAGIC, sizeof(header->magic)) != 0) ||
+            (header->version != BINARY_GRAPH_VERSION)) {
+        munmap(data, data_size);
+        throw ErrMsg("Error: " + string(file_name) + " is not a binary graph");
+    }
+    num_nodes = header->num_nodes;
+    num_edges = header->num_edges;
+    num_edge_features = header->num_edge_features;
+    graph_info_size = header->graph_info_size;
+
+    // locate each column
+    unsigned long long offset = sizeof(BinaryGraphHeader);
+    node_ids = (const unsigned long long*)(data + offset);
+    offset += padded_size(num_nodes * sizeof(unsigned long long));
+    node_sizes = (const unsigned long long*)(data + offset);
+    offset += padded_size(num_nodes * sizeof(unsigned long long));
+    edge_node1 = (const unsigned int*)(data + offset);
+    offset += padded_size(num_edges * sizeof(unsigned int));
+    edge_node2 = (const unsigned int*)(data + offset);
+    offset += padded_size(num_edges * sizeof(unsigned int));
+    edge_weights = (const double*)(data + offset);
+    offset += padded_size(num_edges * sizeof(double));
+    edge_flags = (const unsigned char*)(data + offset);
+    offset += padded_size(num_edges * sizeof(unsigned char));
+    edge_locations = (const unsigned int*)(data + offset);
+    offset += padded_size(3 * num_edges * sizeof(unsigned int));
+    edge_sizes = (const unsigned int*)(data + offset);
+    offset += padded_size(num_edges * sizeof(unsigned int));
+    edge_features = (const double*)(data + offset);
+    offset += padded_size(num_edges * num_edge_features * sizeof(double));
+    graph_info_text = data + offset;
+    offset += graph_info_size;
+
+    if (offset > data_size) {
+        munmap(data, data_size);
+        throw ErrMsg("Error: binary graph " + string(file_name) + " is truncated");
+    }
+}
+
+BinaryGraphView::~BinaryGraphView()
+{
+    munmap(data, data_size);
+}
+
+void BinaryGraphView::get_graph_info(Json::Value& graph_info) const
+{
+    if (!graph_info_size) {
+        return;
+    }
+    Json::Reader json_reader;
+    if (!json_reader.parse(graph_info_text, graph_info_text + graph_info_size,
+                graph_info)) {
+        throw ErrMsg("Error: Json incorrectly formatted");
+    }
+}
+
+Rag_t* create_rag_from_binaryfile(const char * file_name, Json::Value& graph_info)
+{
+    Rag_t* rag = 0;
+    try {
+        BinaryGraphView graph(file_name);
+        rag = new Rag_t;
+
+        const unsigned long long* node_ids = graph.get_node_ids();
+        const unsigned long long* node_sizes = graph.get_node_sizes();
+        vector<RagNode_t*> nodes(graph.get_num_nodes());
+        for (unsigned long long i = 0; i < graph.get_num_nodes(); ++i) {
+            if (Node_t(node_ids[i]) != node_ids[i]) {
+                throw ErrMsg("Graph node ids need NeuroProof built with NEUROPROOF_64BIT_LABELS");
+            }
+            nodes[i] = rag->insert_rag_node(Node_t(node_ids[i]));
+            nodes[i]->set_size(node_sizes[i]);
+        }
+
+        const unsigned int* edge_node1 = graph.get_edge_node1();
+        const unsigned int* edge_node2 = graph.get_edge_node2();
+        const double* edge_weights = graph.get_edge_weights();
+        const unsigned char* edge_flags = graph.get_edge_flags();
+        const unsigned int* edge_locations = graph.get_edge_locations();
+        const unsigned int* edge_sizes = graph.get_edge_sizes();
+        for (unsigned long long i = 0; i < graph.get_num_edges(); ++i) {
+            if ((edge_node1[i] >= nodes.size()) || (edge_node2[i] >= nodes.size())) {
+                throw ErrMsg("Error: binary graph edge refers to a missing node");
+            }
+            RagNode_t* rag_node1 = nodes[edge_node1[i]];
+            RagNode_t* rag_node2 = nodes[edge_node2[i]];
+            if (rag->find_rag_edge(rag_node1, rag_node2)) {
+                continue;
+            }
+
+            RagEdge_t* rag_edge = rag->insert_rag_edge(rag_node1, rag_node2);
+            rag_edge->set_weight(edge_weights[i]);
+            if (edge_flags[i] & BinaryGraphView::HAS_LOCATION) {
+                rag_edge->set_property("location", Location(edge_locations[3*i],
+                            edge_locations[3*i+1], edge_locations[3*i+2]));
+            }
+            rag_edge->set_preserve((edge_flags[i] & BinaryGraphView::PRESERVE) != 0);
+            rag_edge->set_false_edge((edge_flags[i] & BinaryGraphView::FALSE_EDGE) != 0);
+
+            // same default as the json reader
+            unsigned int edge_size = 5;
+            if (edge_flags[i] & BinaryGraphView::HAS_EDGE_SIZE) {
+                edge_size = edge_sizes[i];
+            }
+            rag_edge->set_property("edge_size", edge_size);
+        }
+
+        graph.get_graph_info(graph_info);
+    } catch (ErrMsg& msg) {
+        cout << msg.str << endl;
+        delete rag;
+        rag = 0;
+    }
+
+    return rag;
+}
+
+Rag_t* create_rag_from_binaryfile(const char * file_name)
+{
+    Json::Value graph_info;
+    return create_rag_from_binaryfile(file_name, graph_info);
+}
+
+Rag_t* create_rag_from_graphfile(const char * file_name, Json::Value& json_vals)
+{
+    if (is_binary_graph_file(file_name)) {
+        return create_rag_from_binaryfile(file_name, json_vals);
+    }
+
+    try {
+        Json::Reader json_reader;
+        ifstream fin(file_name);
+        if (!fin) {
+            throw ErrMsg("Error: input file: " + string(file_name) + " cannot be opened");
+        }
+        if (!json_reader.parse(fin, json_vals)) {
+            throw ErrMsg("Error: Json incorrectly formatted");
+        }
+        fin.close();
+    } catch (ErrMsg& msg) {
+        cout << msg.str << endl;
+        return 0;
+    }
+    return create_rag_from_json(json_vals);
+}
+
+Rag_t* create_rag_from_graphfile(const char * file_name)
+{
+    Json::Value json_vals;
+    return create_rag_from_graphfile(file_name, json_vals);
+}
+
+bool create_graphfile_from_rag(Rag_t* rag, const char * file_name,
+        const Json::Value& graph_info)
+{
+    if (is_binary_graph_file(file_name)) {
+        return create_binaryfile_from_rag(rag, file_name, graph_info,
+                vector<double>(), 0);
+    }
+
+    try {
+        Json::Value json_writer = graph_info;
+        ofstream fout(file_name);
+        if (!fout) {
+            throw ErrMsg("Error: output file could not be opened");
+        }
+
+        bool status = create_json_from_rag(rag, json_writer);
+        if (!status) {
+            throw ErrMsg("Error in rag export");
+        }
+
+        fout << json_writer;
+        fout.close();
+    } catch (ErrMsg& msg) {
+        cout << msg.str << endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool create_graphfile_from_rag(Rag_t* rag, const char * file_name)
+{
+    return create_graphfile_from_rag(rag, file_name, Json::Value());
+}
+
 }
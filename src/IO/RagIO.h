@@ -1,7 +1,10 @@
 /*!
  * \file
  * Interface for importing and exporting a Rag of type
- * Index_t (unsigned int) to the JSON format
+ * Index_t (unsigned int) to the JSON format or to a compact binary
+ * format.  The binary format stores the nodes and edges as columns
+ * so that it can be written and read in a streaming fashion or
+ * memory-mapped (see BinaryGraphView).
  *
  * \author Stephen Plaza (plaza.stephen@gmail.com)
 */ 
@@ -11,6 +14,8 @@
 
 #include <json/value.h>
 #include <Utilities/Glb.h>
+#include <string>
+#include <vector>
 
 namespace NeuroProof {
 
@@ -50,6 +55,223 @@ bool create_jsonfile_from_rag(Rag<Index_t>* rag, const char * file_name);
 */
 bool create_json_from_rag(Rag<Index_t>* rag, Json::Value& json_writer);
 
+//! file extension that selects the binary graph format
+extern const char* BINARY_GRAPH_EXTENSION;
+
+/*!
+ * Determines whether a graph file uses the binary format (based
+ * on the file extension).
+ * \param file_name graph file name
+ * \return true if binary format
+*/
+bool is_binary_graph_file(const char * file_name);
+
+/*!
+ * Writes the rag to a binary graph file.  Each column (node ids, node
+ * sizes, edge endpoints, weights, flags, locations, edge sizes, and
+ * optional edge features) is written in turn by iterating the rag so
+ * that no intermediate copy of the graph is made.
+ * \param rag rag to be exported
+ * \param file_name name of binary file to be written
+ * \param graph_info additional json sections stored with the graph
+ * \param edge_features optional features for each edge in edge iteration order
+ * \param num_edge_features number of features per edge (0 if none)
+ * \return true if successful, false otherwise
+*/
+bool create_binaryfile_from_rag(Rag<Index_t>* rag, const char * file_name,
+        const Json::Value& graph_info, const std::vector<double>& edge_features,
+        unsigned int num_edge_features);
+
+/*!
+ * Writes the rag to a binary graph file without additional information.
+ * \param rag rag to be exported
+ * \param file_name name of binary file to be written
+ * \return true if successful, false otherwise
+*/
+bool create_binaryfile_from_rag(Rag<Index_t>* rag, const char * file_name);
+
+/*!
+ * Generates a rag from a binary graph file.
+ * \param file_name binary file name
+ * \param graph_info additional json sections stored with the graph
+ * \return heap created rag (0 if the file cannot be read)
+*/
+Rag<Index_t>* create_rag_from_binaryfile(const char * file_name,
+        Json::Value& graph_info);
+
+/*!
+ * Generates a rag from a binary graph file ignoring additional information.
+ * \param file_name binary file name
+ * \return heap created rag (0 if the file cannot be read)
+*/
+Rag<Index_t>* create_rag_from_binaryfile(const char * file_name);
+
+/*!
+ * Generates a rag from a graph file choosing the json or binary
+ * format from the file extension.  For json files, the entire json
+ * is returned in json_vals; for binary files, only the additional
+ * sections stored with the graph are returned.
+ * \param file_name graph file name
+ * \param json_vals json values other than the edges
+ * \return heap created rag (0 if the file cannot be read)
+*/
+Rag<Index_t>* create_rag_from_graphfile(const char * file_name,
+        Json::Value& json_vals);
+
+/*!
+ * Generates a rag from a graph file of either format ignoring
+ * additional information.
+ * \param file_name graph file name
+ * \return heap created rag (0 if the file cannot be read)
+*/
+Rag<Index_t>* create_rag_from_graphfile(const char * file_name);
+
+/*!
+ * Writes the rag to a graph file choosing the json or binary format
+ * from the file extension.  The graph_info sections are added to
+ * the json or stored alongside the binary graph.
+ * \param rag rag to be exported
+ * \param file_name graph file name
+ * \param graph_info additional json sections written with the graph
+ * \return true if successful, false otherwise
+*/
+bool create_graphfile_from_rag(Rag<Index_t>* rag, const char * file_name,
+        const Json::Value& graph_info);
+
+/*!
+ * Writes the rag to a graph file of either format.
+ * \param rag rag to be exported
+ * \param file_name graph file name
+ * \return true if successful, false otherwise
+*/
+bool create_graphfile_from_rag(Rag<Index_t>* rag, const char * file_name);
+
+/*!
+ * Read-only view of a binary graph file that is memory-mapped so
+ * that the columns can be used directly without building a rag.
+ * Edges refer to nodes by their position in the node columns.
+*/
+class BinaryGraphView {
+  public:
+    //! edge flag bits
+    static const unsigned char PRESERVE = 1;
+    static const unsigned char FALSE_EDGE = 2;
+    static const unsigned char HAS_LOCATION = 4;
+    static const unsigned char HAS_EDGE_SIZE = 8;
+
+    /*!
+     * Maps the binary graph file into memory.  An exception is thrown
+     * if the file cannot be mapped or is not a binary graph.
+     * \param file_name binary file name
+    */
+    BinaryGraphView(const char * file_name);
+
+    /*!
+     * Unmaps the file.
+    */
+    ~BinaryGraphView();
+
+    unsigned long long get_num_nodes() const
+    {
+        return num_nodes;
+    }
+
+    unsigned long long get_num_edges() const
+    {
+        return num_edges;
+    }
+
+    unsigned int get_num_edge_features() const
+    {
+        return num_edge_features;
+    }
+
+    //! node ids (num_nodes)
+    const unsigned long long* get_node_ids() const
+    {
+        return node_ids;
+    }
+
+    //! node sizes (num_nodes)
+    const unsigned long long* get_node_sizes() const
+    {
+        return node_sizes;
+    }
+
+    //! node position of the first node of each edge (num_edges)
+    const unsigned int* get_edge_node1() const
+    {
+        return edge_node1;
+    }
+
+    //! node position of the second node of each edge (num_edges)
+    const unsigned int* get_edge_node2() const
+    {
+        return edge_node2;
+    }
+
+    //! edge weights (num_edges)
+    const double* get_edge_weights() const
+    {
+        return edge_weights;
+    }
+
+    //! edge flag bits (num_edges)
+    const unsigned char* get_edge_flags() const
+    {
+        return edge_flags;
+    }
+
+    //! x, y, z location of each edge (3 * num_edges)
+    const unsigned int* get_edge_locations() const
+    {
+        return edge_locations;
+    }
+
+    //! edge_size property of each edge (num_edges)
+    const unsigned int* get_edge_sizes() const
+    {
+        return edge_sizes;
+    }
+
+    //! row-major edge features (num_edges * num_edge_features)
+    const double* get_edge_features() const
+    {
+        return edge_features;
+    }
+
+    /*!
+     * Parses the additional json sections stored with the graph.
+     * \param graph_info json values stored with the graph
+    */
+    void get_graph_info(Json::Value& graph_info) const;
+
+  private:
+    // views cannot be copied
+    BinaryGraphView(const BinaryGraphView&);
+    BinaryGraphView& operator=(const BinaryGraphView&);
+
+    //! mapped file
+    char* data;
+    size_t data_size;
+    
+    unsigned long long num_nodes;
+    unsigned long long num_edges;
+    unsigned int num_edge_features;
+
+    const unsigned long long* node_ids;
+    const unsigned long long* node_sizes;
+    const unsigned int* edge_node1;
+    const unsigned int* edge_node2;
+    const double* edge_weights;
+    const unsigned char* edge_flags;
+    const unsigned int* edge_locations;
+    const unsigned int* edge_sizes;
+    const double* edge_features;
+    const char* graph_info_text;
+    unsigned long long graph_info_size;
+};
+
 }
 
 #endif
@@ -148,7 +148,7 @@ VolumeLabelPtr import_h5labels(const char * h5_name,
             vigra::readHDF5(info, transforms);
 
             for (int row = 0; row < transforms.shape(1); ++row) {
-                volumedata->label_mapping[transforms(0,row)] = transforms(1,row);
+                volumedata->set_mapping(transforms(0,row), transforms(1,row));
             }
             // rebase all of the labels so the initial label hash is empty
             volumedata->rebase_labels();
@@ -161,6 +161,117 @@ VolumeLabelPtr import_h5labels(const char * h5_name,
 
 
 
+H5ChunkReader::H5ChunkReader(string label_name_, string label_dset_,
+        string pred_name_, string pred_dset_) : label_name(label_name_),
+        label_dset(label_dset_), pred_name(pred_name_), pred_dset(pred_dset_)
+{
+    vigra::HDF5ImportInfo info(label_name.c_str(), label_dset.c_str());
+    vigra_precondition(info.numDimensions() == 3, "Dataset must be 3-dimensional.");
+    label_shape = vigra::TinyVector<long long unsigned int,3>(info.shape().begin());
+
+    if (pred_name != "") {
+        vigra::HDF5ImportInfo pinfo(pred_name.c_str(), pred_dset.c_str());
+        vigra_precondition(pinfo.numDimensions() == 4, "Dataset must be 4-dimensional.");
+        pred_shape = vigra::TinyVector<long long unsigned int,4>(pinfo.shape().begin());
+
+        if ((pred_shape[3] != label_shape[0]) || (pred_shape[2] != label_shape[1]) ||
+                (pred_shape[1] != label_shape[2])) {
+            throw ErrMsg("Prediction and label volumes have different dimensions");
+        }
+    }
+
+    // the transforms table is small so it is read entirely
+    try {
+        vigra::HDF5ImportInfo tinfo(label_name.c_str(), "transforms");
+        vigra::TinyVector<long long unsigned int,2> tshape(tinfo.shape().begin()); 
+        vigra::MultiArray<2,long long unsigned int> transforms_temp(tshape);
+        vigra::readHDF5(tinfo, transforms_temp);
+
+        for (int row = 0; row < transforms_temp.shape(1); ++row) {
+            transforms[transforms_temp(0,row)] = transforms_temp(1,row);
+        }
+    } catch (std::runtime_error& err) {
+    }
+}
+
+unsigned int H5ChunkReader::get_zsize()
+{
+    return label_shape[2];
+}
+
+unsigned int H5ChunkReader::get_num_channels()
+{
+    return (pred_name != "") ? pred_shape[0] : 0;
+}
+
+VolumeLabelPtr H5ChunkReader::read_labels(unsigned int zstart, unsigned int zend)
+{
+    VolumeLabelPtr labelvol = VolumeLabelData::create_volume(label_shape[0],
+            label_shape[1], zend - zstart);
+
+    vigra::HDF5File h5file(label_name, vigra::HDF5File::OpenReadOnly);
+    h5file.readBlock(label_dset, vigra::Shape3(0, 0, zstart),
+            vigra::Shape3(label_shape[0], label_shape[1], zend - zstart), *labelvol);
+    h5file.close();
+
+    if (!transforms.empty()) {
+        for (VolumeLabelData::iterator iter = labelvol->begin();
+                iter != labelvol->end(); ++iter) {
+            std::unordered_map<Label_t, Label_t>::iterator titer = transforms.find(*iter);
+            if (titer != transforms.end()) {
+                *iter = titer->second;
+            }
+        }
+    }
+    
+    return labelvol;
+}
+
+vector<VolumeProbPtr> H5ChunkReader::read_predictions(unsigned int zstart, unsigned int zend)
+{
+    vector<VolumeProbPtr> prob_list;
+    if (pred_name == "") {
+        return prob_list;
+    }
+
+    // only the requested planes of every channel are selected
+    vigra::MultiArray<4, Prob_t> chunk(vigra::Shape4(pred_shape[0],
+                zend - zstart, pred_shape[2], pred_shape[3]));
+    vigra::HDF5File h5file(pred_name, vigra::HDF5File::OpenReadOnly);
+    h5file.readBlock(pred_dset, vigra::Shape4(0, zstart, 0, 0), chunk.shape(), chunk);
+    h5file.close();
+    
+    // since the X,Y,Z,ch is read in as ch,Z,Y,X transpose
+    vigra::MultiArrayView<4, Prob_t, vigra::StridedArrayTag> chunk_view = chunk.transpose();
+    for (unsigned int i = 0; i < pred_shape[0]; ++i) {
+        VolumeProbPtr volumedata = VolumeProb::create_volume();
+        vigra::TinyVector<vigra::MultiArrayIndex, 1> channel(i);
+        (*volumedata) = chunk_view.bindOuter(channel); 
+        prob_list.push_back(volumedata);
+    }
+
+    return prob_list;
+}
+
+VolumeProbPtr H5ChunkReader::read_channel(unsigned int channel)
+{
+    if (channel >= get_num_channels()) {
+        throw ErrMsg("Prediction channel does not exist");
+    }
+
+    vigra::MultiArray<4, Prob_t> chunk(vigra::Shape4(1, pred_shape[1],
+                pred_shape[2], pred_shape[3]));
+    vigra::HDF5File h5file(pred_name, vigra::HDF5File::OpenReadOnly);
+    h5file.readBlock(pred_dset, vigra::Shape4(channel, 0, 0, 0), chunk.shape(), chunk);
+    h5file.close();
+    
+    VolumeProbPtr volumedata = VolumeProb::create_volume();
+    vigra::TinyVector<vigra::MultiArrayIndex, 1> first_channel(0);
+    (*volumedata) = chunk.transpose().bindOuter(first_channel); 
+
+    return volumedata;
+}
+
 shared_ptr<VolumeData<unsigned char> > import_8bit_images(
         vector<string>& file_names)
 {
@@ -217,7 +328,7 @@ void import_stack_exclusions(Stack* stack, string exclusions_json)
     // all exclusions should be in a json list
     Json::Value exclusions = json_vals["exclusions"];
     for (unsigned int i = 0; i < json_vals["exclusions"].size(); ++i) {
-        exclusion_set.insert(exclusions[i].asUInt());
+        exclusion_set.insert(exclusions[i].asLargestUInt());
     }
 
     VolumeLabelPtr labelvol = stack->get_labelvol();
@@ -263,15 +374,25 @@ void export_stack_graph(Stack* stack, const char* graph_name,
 
     FeatureMgrPtr feature_manager = stack->get_feature_manager();
 
+    // score all edges in one batch before export
+    if (feature_manager && !disable_prob_comp) {
+        vector<RagEdge_t*> edges;
+        for (Rag_t::edges_iterator iter = rag->edges_begin();
+               iter != rag->edges_end(); ++iter) {
+            if (!((*iter)->is_false_edge())) {
+                edges.push_back(*iter);
+            }
+        }
+        vector<double> probs;
+        feature_manager->get_probs(edges, probs);
+        for (unsigned int i = 0; i < edges.size(); ++i) {
+            edges[i]->set_weight(probs[i]);
+        }
+    }
+
     // set edge properties for export 
     for (Rag_t::edges_iterator iter = rag->edges_begin();
            iter != rag->edges_end(); ++iter) {
-        if (!((*iter)->is_false_edge()) && !disable_prob_comp) {
-            if (feature_manager) {
-                double val = feature_manager->get_prob((*iter));
-                (*iter)->set_weight(val);
-            } 
-        }
         Label_t x = 0;
         Label_t y = 0;
         Label_t z = 0;
@@ -288,31 +409,22 @@ void export_stack_graph(Stack* stack, const char* graph_name,
         (*iter)->set_property("location", Location(x,y,z));
     }
 
-    Json::Value json_writer;
-    bool status = create_json_from_rag(rag.get(), json_writer);
-    if (!status) {
-        throw ErrMsg("Error in rag export");
-    }
-
     // biopriors might write specific information -- calls derived function
-    stack->serialize_graph_info(json_writer);
+    Json::Value graph_info;
+    stack->serialize_graph_info(graph_info);
 
     int id = 0;
     for (Rag_t::nodes_iterator iter = rag->nodes_begin(); iter != rag->nodes_end(); ++iter) {
         if (!((*iter)->is_boundary())) {
-            json_writer["orphan_bodies"][id] = (*iter)->get_node_id();
+            graph_info["orphan_bodies"][id] = (*iter)->get_node_id();
             ++id;
         } 
     }
     
-    // write out graph json
-    ofstream fout(graph_name);
-    if (!fout) {
-        throw ErrMsg("Error: output file " + string(graph_name) + " could not be opened");
+    // write out graph json (or binary graph depending on the extension)
+    if (!create_graphfile_from_rag(rag.get(), graph_name, graph_info)) {
+        throw ErrMsg("Error: output file " + string(graph_name) + " could not be written");
     }
-    
-    fout << json_writer;
-    fout.close();
 }
 
 }
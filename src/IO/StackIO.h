@@ -11,6 +11,7 @@
 #include <json/value.h>
 #include <Stack/Stack.h>
 #include <Stack/VolumeLabelData.h>
+#include <unordered_map>
 
 // used for importing h5 files
 #include <vigra/hdf5impex.hxx>
@@ -87,6 +88,49 @@ std::vector<boost::shared_ptr<VolumeData<T> > >
     import_3Dh5vol_array(const char * h5_name, const char * dset, unsigned int dim1size);
 
 
+/*!
+ * Reads z-chunks of a label h5 file (Z,Y,X) and an optional prediction
+ * h5 file (X,Y,Z,ch) using hyperslab selections so that only the
+ * requested planes are loaded.  Like 'import_h5labels', a transforms
+ * dataset in the label file is applied to every chunk read.
+*/
+class H5ChunkReader : public StackChunkReader {
+  public:
+    /*!
+     * Opens the label and prediction files.
+     * \param label_name name of label h5 file
+     * \param label_dset name of label dataset
+     * \param pred_name name of prediction h5 file (empty for none)
+     * \param pred_dset name of prediction dataset
+    */
+    H5ChunkReader(std::string label_name, std::string label_dset,
+            std::string pred_name = "", std::string pred_dset = "");
+
+    unsigned int get_zsize();
+    unsigned int get_num_channels();
+    VolumeLabelPtr read_labels(unsigned int zstart, unsigned int zend);
+    std::vector<VolumeProbPtr> read_predictions(unsigned int zstart, unsigned int zend);
+
+    /*!
+     * Read all z-planes of a single prediction channel.
+     * \param channel prediction channel
+     * \return prediction volume for the channel
+    */
+    VolumeProbPtr read_channel(unsigned int channel);
+
+  private:
+    std::string label_name, label_dset, pred_name, pred_dset;
+
+    //! label volume shape (X,Y,Z)
+    vigra::TinyVector<long long unsigned int,3> label_shape;
+
+    //! prediction shape as stored (ch,Z,Y,X)
+    vigra::TinyVector<long long unsigned int,4> pred_shape;
+
+    //! label to label mapping from the transforms dataset
+    std::unordered_map<Label_t, Label_t> transforms;
+};
+
 /*!
  * Function to create a 3D image volume from a list of
  * 2D image files.  While many 2D image formats are supported
@@ -119,11 +163,12 @@ void export_3Dh5vol(VolumeLabelPtr volume,
 
 /*!
  * Write the stack to disk.  The graph is written to the json
- * file format.  The label volume is rebased and written
+ * file format (or the binary graph format if the graph file name
+ * ends with BINARY_GRAPH_EXTENSION).  The label volume is rebased and written
  * to an h5 file.  There is an option to determine the best location
  * for observing the edge using the information in the probability volumes.
  * \param h5_name name of h5 file
- * \param graph_name name of graph json file
+ * \param graph_name name of graph json or binary file
  * \param optimal_prob_edge_loc determine strategy to select edge location
  * \param disable_prob_comp determines whether saved prob values are used
 */
@@ -0,0 +1,173 @@
+/*!
+ * \file
+ * Implementation of the best-path search used to find node affinities
+*/
+
+#include "AffinityPathSearch.h"
+
+#include <algorithm>
+
+namespace NeuroProof {
+
+unsigned int AffinityPathSearch::get_pos(RagNode_t* rag_node)
+{
+    std::pair<std::unordered_map<RagNode_t*, unsigned int>::iterator, bool> result =
+        node_pos.insert(std::make_pair(rag_node, (unsigned int)(path_nodes.size())));
+    if (result.second) {
+        PathNode path_node;
+        path_node.node = rag_node;
+        path_node.weight = 0.0;
+        path_node.second_node = 0;
+        path_node.path_length = 0;
+        path_node.head_edge = 0;
+        path_node.settled = false;
+        path_nodes.push_back(path_node);
+    }
+    return result.first->second;
+}
+
+void AffinityPathSearch::search(RagNode_t* rag_node_head_, int path_restriction,
+        double connection_threshold, bool preserve, bool extract_path,
+        RagNode_t* rag_node_dest)
+{
+    PathEntryCmp path_cmp;
+    rag_node_head = rag_node_head_;
+    node_pos.clear();
+    path_nodes.clear();
+    reached.clear();
+    path_queue.clear();
+
+    // record the edges to the head node once instead of looking them
+    // up for every path examined
+    get_pos(rag_node_head);
+    for (RagNode_t::edge_iterator edge_iter = rag_node_head->edge_begin();
+            edge_iter != rag_node_head->edge_end(); ++edge_iter) {
+        unsigned int pos = get_pos((*edge_iter)->get_other_node(rag_node_head));
+        path_nodes[pos].head_edge = *edge_iter;
+    }
+
+    PathEntry path_head;
+    path_head.pos = 0;
+    path_head.edge = 0;
+    path_head.weight = 1.0;
+    path_head.path_length = 0;
+    path_head.second_node = 0;
+    path_queue.push_back(path_head);
+
+    // finding the shortest current path (connection strength closest to 1)
+    // and pop this value off the list once its node is expanded
+    while (!path_queue.empty()) {
+        PathEntry path_curr = path_queue.front();
+
+        if (!path_nodes[path_curr.pos].settled) {
+            PathNode& node_curr = path_nodes[path_curr.pos];
+            node_curr.settled = true;
+            node_curr.weight = path_curr.weight;
+            node_curr.path_length = path_curr.path_length;
+            node_curr.second_node = path_curr.second_node;
+            if (path_curr.pos != 0) {
+                reached.push_back(path_curr.pos);
+            }
+
+            // the connection to the destination cannot improve
+            RagNode_t* rag_node_curr = node_curr.node;
+            if (rag_node_curr == rag_node_dest) {
+                break;
+            }
+
+            if (!path_restriction || (path_curr.path_length < path_restriction)) {
+                for (RagNode_t::edge_iterator edge_iter = rag_node_curr->edge_begin();
+                        edge_iter != rag_node_curr->edge_end(); ++edge_iter) {
+                    // avoid simple cycles
+                    if (*edge_iter == path_curr.edge) {
+                        continue;
+                    }
+
+                    // avoid duplicates
+                    RagNode_t* other_node = (*edge_iter)->get_other_node(rag_node_curr);
+                    unsigned int pos = get_pos(other_node);
+                    if (path_nodes[pos].settled) {
+                        continue;
+                    }
+
+                    RagEdge_t* head_edge = path_nodes[pos].head_edge;
+                    if (head_edge && head_edge->get_weight() > 1.00001) {
+                        continue;
+                    }
+
+                    if (preserve) {
+                        if ((head_edge && head_edge->is_preserve()) ||
+                                (!head_edge && ((*edge_iter)->is_preserve()))) {
+                            continue;
+                        }
+                    }
+
+                    if (head_edge && head_edge->is_false_edge()) {
+                        head_edge = 0;
+                    }
+
+                    double edge_prob = 1.0 - (*edge_iter)->get_weight();
+                    if (edge_prob < 0.000001) {
+                        continue;
+                    }
+
+                    edge_prob = path_curr.weight * edge_prob;
+                    if (edge_prob < connection_threshold) {
+                        continue;
+                    }
+
+                    PathEntry path_new;
+                    path_new.pos = pos;
+                    path_new.edge = *edge_iter;
+                    path_new.weight = edge_prob;
+                    path_new.path_length = path_curr.path_length + 1;
+                    if (path_new.path_length > 1) {
+                        if (!extract_path) {
+                            path_new.second_node = path_curr.second_node;
+                        } else {
+                            path_new.second_node = rag_node_curr->get_node_id();
+                        }
+                    } else {
+                        path_new.second_node = other_node->get_node_id();
+                    }
+                    if (head_edge) {
+                        path_new.second_node = other_node->get_node_id();
+                    }
+
+                    path_queue.push_back(path_new);
+                    std::push_heap(path_queue.begin(), path_queue.end(), path_cmp);
+                }
+            }
+        }
+
+        std::pop_heap(path_queue.begin(), path_queue.end(), path_cmp);
+        path_queue.pop_back();
+    }
+}
+
+const AffinityPathSearch::PathNode* AffinityPathSearch::find_reached(RagNode_t* rag_node) const
+{
+    std::unordered_map<RagNode_t*, unsigned int>::const_iterator iter = node_pos.find(rag_node);
+    if ((iter == node_pos.end()) || (iter->second == 0) ||
+            !path_nodes[iter->second].settled) {
+        return 0;
+    }
+    return &path_nodes[iter->second];
+}
+
+void AffinityPathSearch::get_affinity_pairs(AffinityPair::Hash& affinity_pairs) const
+{
+    if (!rag_node_head) {
+        return;
+    }
+    Node_t node_head = rag_node_head->get_node_id();
+    for (size_t i = 0; i < reached.size(); ++i) {
+        const PathNode& path_node = path_nodes[reached[i]];
+        AffinityPair affinity_pair(node_head, path_node.node->get_node_id());
+        affinity_pair.weight = path_node.weight;
+        affinity_pair.size = path_node.second_node;
+        affinity_pairs.insert(affinity_pair);
+    }
+}
+
+}
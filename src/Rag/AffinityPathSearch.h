@@ -0,0 +1,163 @@
+/*!
+ * \file
+ * Reusable best-path search from a node of the Rag to the nodes it is
+ * strongly connected to.  The connection of a path is the product of
+ * (1 - weight) over its edges and the search examines the strongest
+ * paths first (Dijkstra's algorithm with multiplication).  The search
+ * keeps its scratch memory between calls so that repeated queries,
+ * such as those made by the node-centric edge rankers and interactive
+ * proofreading tools, do not reallocate.  The search does not modify
+ * or look up anything in the Rag, so different threads can search the
+ * same Rag with their own AffinityPathSearch.
+*/
+
+#ifndef AFFINITYPATHSEARCH_H
+#define AFFINITYPATHSEARCH_H
+
+#include "Rag.h"
+#include <Utilities/AffinityPair.h>
+
+#include <vector>
+#include <unordered_map>
+
+namespace NeuroProof {
+
+class AffinityPathSearch {
+  public:
+    /*!
+     * Node found by the search.
+    */
+    struct PathNode {
+        //! node reached
+        RagNode_t* node;
+
+        //! connection of the strongest path to the node (1 is connected)
+        double weight;
+
+        /*!
+         * Second node of the strongest path (the first node after the
+         * head node) or, when the path was extracted, the node before
+         * this node.  Nodes with an edge to the head node use themselves.
+        */
+        Node_t second_node;
+
+        //! number of edges in the strongest path
+        int path_length;
+
+        //! edge between the node and the head node (0 if none)
+        RagEdge_t* head_edge;
+
+        //! true once the strongest path to the node is known
+        bool settled;
+    };
+
+    AffinityPathSearch() : rag_node_head(0) {}
+
+    /*!
+     * Finds the strongest path from the head node to every node whose
+     * connection is at least the threshold.
+     * \param rag_node_head starting node for the path search
+     * \param path_restriction the max length of any path (0 = unbounded)
+     * \param connection_threshold the minimum connection between nodes considered
+     * \param preserve if true do not consider paths through preserved edges
+     * \param extract_path if true record the previous node of each path
+     * \param rag_node_dest stop once the path to this node is found (0 = none)
+    */
+    void search(RagNode_t* rag_node_head, int path_restriction,
+            double connection_threshold, bool preserve, bool extract_path = false,
+            RagNode_t* rag_node_dest = 0);
+
+    /*!
+     * Number of nodes found by the last search (the head node is not
+     * included).
+     * \return number of nodes
+    */
+    size_t num_reached() const
+    {
+        return reached.size();
+    }
+
+    /*!
+     * Node found by the last search in the order the nodes were found
+     * (strongest connection first).
+     * \param pos position less than 'num_reached'
+     * \return found node
+    */
+    const PathNode& get_reached(size_t pos) const
+    {
+        return path_nodes[reached[pos]];
+    }
+
+    /*!
+     * Looks up a node found by the last search.
+     * \param rag_node node of the rag
+     * \return found node (0 if the node was not found)
+    */
+    const PathNode* find_reached(RagNode_t* rag_node) const;
+
+    /*!
+     * Connection of the strongest path found to a node.
+     * \param rag_node node of the rag
+     * \return connection weight (0 if the node was not found)
+    */
+    double get_affinity(RagNode_t* rag_node) const
+    {
+        const PathNode* path_node = find_reached(rag_node);
+        return path_node ? path_node->weight : 0.0;
+    }
+
+    /*!
+     * Adds an affinity pair between the head node and each found node
+     * (the pair size holds the second node of the path).
+     * \param affinity_pairs set that the pairs are added to
+    */
+    void get_affinity_pairs(AffinityPair::Hash& affinity_pairs) const;
+
+  private:
+    /*!
+     * Path waiting to be examined.
+    */
+    struct PathEntry {
+        //! position of the last node of the path
+        unsigned int pos;
+
+        //! last edge of the path
+        RagEdge_t* edge;
+
+        double weight;
+        int path_length;
+        Node_t second_node;
+    };
+
+    /*!
+     * Order paths so that the strongest is examined first.
+    */
+    struct PathEntryCmp {
+        bool operator()(const PathEntry& q1, const PathEntry& q2) const
+        {
+            return (q1.weight < q2.weight);
+        }
+    };
+
+    //! position of a node in 'path_nodes' (added on first visit)
+    unsigned int get_pos(RagNode_t* rag_node);
+
+    //! head node of the last search
+    RagNode_t* rag_node_head;
+
+    //! position of each node visited by the last search
+    std::unordered_map<RagNode_t*, unsigned int> node_pos;
+
+    //! nodes visited by the last search
+    std::vector<PathNode> path_nodes;
+
+    //! positions of the settled nodes in the order they were settled
+    std::vector<unsigned int> reached;
+
+    //! heap of paths to be examined
+    std::vector<PathEntry> path_queue;
+};
+
+}
+
+#endif
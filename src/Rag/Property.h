@@ -10,9 +10,99 @@
 
 // all properties will be accessed through smart pointers
 #include <boost/shared_ptr.hpp>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
 
 namespace NeuroProof {
 
+//! small integer id for an interned property name
+typedef unsigned int PropertyKey;
+
+/*!
+ * Global registry that interns property names to small integer ids.
+ * Rag elements store properties by id so that code in hot loops can
+ * resolve a property name once and avoid hashing strings per access.
+ * Looking up a name that is already interned does not take a lock: the
+ * registry publishes an immutable table that is copied when a new name
+ * is added (names are few and added rarely).
+*/
+class PropertyKeys {
+  public:
+    /*!
+     * Get the id for a property name, interning it if necessary.
+     * \param name property name
+     * \return property key
+    */
+    static PropertyKey get_key(const std::string& name)
+    {
+        Registry& registry = get_registry();
+        const Table* table = registry.table.load(std::memory_order_acquire);
+        Table::Keys::const_iterator iter = table->keys.find(name);
+        if (iter != table->keys.end()) {
+            return iter->second;
+        }
+
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        table = registry.table.load(std::memory_order_relaxed);
+        iter = table->keys.find(name);
+        if (iter != table->keys.end()) {
+            return iter->second;
+        }
+
+        // replaced tables are kept since readers may still be using them
+        Table* new_table = new Table(*table);
+        PropertyKey key = PropertyKey(new_table->names.size());
+        new_table->keys[name] = key;
+        new_table->names.push_back(name);
+        registry.tables.push_back(boost::shared_ptr<Table>(new_table));
+        registry.table.store(new_table, std::memory_order_release);
+        return key;
+    }
+
+    /*!
+     * Get the property name for an interned id.
+     * \param key property key
+     * \return property name
+    */
+    static std::string get_name(PropertyKey key)
+    {
+        return get_registry().table.load(std::memory_order_acquire)->names.at(key);
+    }
+
+  private:
+    //! interned names, never modified once published
+    struct Table {
+        typedef std::unordered_map<std::string, PropertyKey> Keys;
+        Keys keys;
+        std::vector<std::string> names;
+    };
+
+    struct Registry {
+        Registry() : tables(1, boost::shared_ptr<Table>(new Table))
+        {
+            table.store(tables.back().get());
+        }
+
+        //! serializes the interning of new names
+        std::mutex mutex;
+
+        //! current table
+        std::atomic<const Table*> table;
+
+        //! all published tables
+        std::vector<boost::shared_ptr<Table> > tables;
+    };
+
+    static Registry& get_registry()
+    {
+        static Registry registry;
+        return registry;
+    }
+};
+
 /*!
  * Defines an abstract class interface that will be used to
  * store property information for each Rag element
@@ -43,6 +43,17 @@ class Rag {
      * \param dup_rag rag to be copied
     */ 
     Rag(const Rag<Region>& dup_rag);
+
+    /*!
+     * Rag copy constructor that can share the properties of the copied
+     * nodes and edges instead of copying them.  Node and edge data are
+     * always copied.  Shared properties are copy-on-write through
+     * 'set_property' (see RagElement), so a snapshot whose properties
+     * are only replaced, never modified in place, leaves 'dup_rag' intact.
+     * \param dup_rag rag to be copied
+     * \param share_properties true to share rather than copy properties
+    */ 
+    Rag(const Rag<Region>& dup_rag, bool share_properties);
     
     /*!
      * Assignment operator for Rag (invokes copy constructor)
@@ -237,20 +248,26 @@ template <typename Region> Rag<Region>::Rag()
     init_probes();    
 } 
 
-template <typename Region> Rag<Region>::Rag(const Rag<Region>& dup_rag)
+template <typename Region> Rag<Region>::Rag(const Rag<Region>& dup_rag) :
+    Rag(dup_rag, false)
+{
+}
+
+template <typename Region> Rag<Region>::Rag(const Rag<Region>& dup_rag,
+        bool share_properties)
 {
     // create new probes on the heap
     init_probes();
     
     // create new nodes on the heap copying the previous node data and their properties 
     for (typename EdgeHash::const_iterator iter = dup_rag.rag_edges.begin(); iter != dup_rag.rag_edges.end(); ++iter) {
-        RagEdge<Region>* rag_edge = RagEdge<Region>::New(**iter);
+        RagEdge<Region>* rag_edge = RagEdge<Region>::New(**iter, share_properties);
         rag_edges.insert(rag_edge);
     }
     
     // create new edges on the heap copying the previous edge data and their properties 
     for (typename NodeHash::const_iterator iter = dup_rag.rag_nodes.begin(); iter != dup_rag.rag_nodes.end(); ++iter) {
-        RagNode<Region>* rag_node = RagNode<Region>::New(**iter);
+        RagNode<Region>* rag_node = RagNode<Region>::New(**iter, share_properties);
         rag_nodes.insert(rag_node);
     }
 
@@ -61,6 +61,18 @@ class RagEdge : public RagElement {
         return new RagEdge(edge);  
     }
 
+    /*!
+     * Static function for copying rag edges that can share the properties
+     * of the copied edge (see RagElement).
+     * \param edge edge to be copied
+     * \param share_properties true to share rather than copy properties
+     * \return pointer to new rag edge
+    */
+    static RagEdge<Region>* New(const RagEdge<Region>& edge, bool share_properties)
+    {
+        return new RagEdge(edge, share_properties);  
+    }
+
     /*!
      * Sets status of edge to true or false.  In NeuroProof, a false edge edge
      * generally exists as a constraint in the graph but does not actually indicate
@@ -206,6 +218,13 @@ class RagEdge : public RagElement {
     */
     RagEdge(const RagEdge<Region>& edge2);
 
+    /*!
+     * Private copy constructor that can share properties
+     * \param edge2 rag edge to be copied
+     * \param share_properties true to share rather than copy properties
+    */
+    RagEdge(const RagEdge<Region>& edge2, bool share_properties);
+
     /*!
      * Support function for overloaded equivalence operator
      * \param rag edge
@@ -355,6 +374,18 @@ template<typename Region> inline RagEdge<Region>::RagEdge(const RagEdge<Region>&
     dirty = edge2.dirty;
 }
 
+template<typename Region> inline RagEdge<Region>::RagEdge(const RagEdge<Region>& edge2,
+        bool share_properties) : RagElement(edge2, share_properties)
+{
+    node1 = edge2.node1; 
+    node2 = edge2.node2;
+    weight = edge2.weight;
+    edge_size = edge2.edge_size;
+    preserve = edge2.preserve;
+    false_edge = edge2.false_edge;
+    dirty = edge2.dirty;
+}
+
 
 
 
@@ -10,8 +10,11 @@
 
 #include "Property.h"
 #include <Utilities/ErrMsg.h>
-#include <unordered_map>
+#include <vector>
 #include <string>
+#include <cassert>
+#include <new>
+#include <type_traits>
 
 namespace NeuroProof {
 
@@ -36,6 +39,18 @@ class RagElement {
      * \param dup_element rag element to duplicate
     */
     RagElement(const RagElement& dup_element);
+
+    /*!
+     * Copy constructor that can share the properties of the duplicated
+     * element instead of copying them.  Shared properties are copy-on-write:
+     * 'set_property' replaces a property that is referenced elsewhere, so
+     * neither element sees the other's updates.  Data of a heap property
+     * modified through the reference returned by 'get_property' is seen
+     * by both elements (inline values are always copied).
+     * \param dup_element rag element to duplicate
+     * \param share_properties true to share rather than copy properties
+    */
+    RagElement(const RagElement& dup_element, bool share_properties);
     
     /*!
      * Assignment operator overload
@@ -49,14 +64,38 @@ class RagElement {
      * \param property data to be save at this element with the given property name
     */ 
     template <typename T>
-    void set_property(std::string key, T val);
+    void set_property(std::string key, T val)
+    {
+        set_property(PropertyKeys::get_key(key), val);
+    }
+
+    /*!
+     * Set any data-type to a rag element with a given property key.  Small
+     * trivially copyable values are stored inline in the element; other
+     * values are kept in a property on the heap that is updated in place
+     * when nothing else references it.
+     * \param key interned property name (see PropertyKeys)
+     * \param property data to be save at this element with the given property key
+    */ 
+    template <typename T>
+    void set_property(PropertyKey key, T val);
 
     /*!
      * Set property ptr directly at the given property name
      * \param key property name to reference given property
      * \param property ptr to be saved at this element with the given property name
     */
-    void set_property_ptr(std::string key, PropertyPtr property);
+    void set_property_ptr(std::string key, PropertyPtr property)
+    {
+        set_property_ptr(PropertyKeys::get_key(key), property);
+    }
+
+    /*!
+     * Set property ptr directly at the given property key
+     * \param key interned property name
+     * \param property ptr to be saved at this element with the given property key
+    */
+    void set_property_ptr(PropertyKey key, PropertyPtr property);
 
     /*!
      * Get property of specified data type at the given property name.
@@ -65,14 +104,38 @@ class RagElement {
      * \return reference to property data
     */
     template <typename T>
-    T& get_property(std::string key);
+    T& get_property(std::string key)
+    {
+        return get_property<T>(PropertyKeys::get_key(key));
+    }
+
+    /*!
+     * Get property of specified data type at the given property key.
+     * The reference to an inline value is only valid until another
+     * property is added to the element.
+     * \param key interned property name
+     * \return reference to property data
+    */
+    template <typename T>
+    T& get_property(PropertyKey key);
 
     /*!
      * Get property pointer for the give property name
      * \param key property name to reference a given property
      * \return shared pointer to property
     */
-    PropertyPtr get_property_ptr(std::string key);
+    PropertyPtr get_property_ptr(std::string key)
+    {
+        return get_property_ptr(PropertyKeys::get_key(key));
+    }
+
+    /*!
+     * Get property pointer for the give property key.  An inline value
+     * is returned as a new property holding a copy of the value.
+     * \param key interned property name
+     * \return shared pointer to property
+    */
+    PropertyPtr get_property_ptr(PropertyKey key);
 
     /*!
      * Determine if property with the given property name exists
@@ -80,13 +143,35 @@ class RagElement {
      * \param key property name to reference a given property
      * \return existence of property
     */
-    bool has_property(std::string key);
+    bool has_property(std::string key)
+    {
+        return has_property(PropertyKeys::get_key(key));
+    }
+
+    /*!
+     * Determine if property with the given property key exists
+     * \param key interned property name
+     * \return existence of property
+    */
+    bool has_property(PropertyKey key)
+    {
+        return find_slot(key) != 0;
+    }
   
     /*!
      * Remove the reference to the property for the given property name
      * \param key property name to reference a given property
     */
-    void rm_property(std::string key);
+    void rm_property(std::string key)
+    {
+        rm_property(PropertyKeys::get_key(key));
+    }
+
+    /*!
+     * Remove the reference to the property for the given property key
+     * \param key interned property name
+    */
+    void rm_property(PropertyKey key);
 
     /*!
      * Copies all properties from one rag element to another
@@ -106,20 +191,137 @@ class RagElement {
     void rm_properties();
   
   private:
-    typedef std::unordered_map<std::string, PropertyPtr> Properties_t;
-    //! Properties stored for rag element (string index)
+    /*!
+     * Small trivially copyable values (e.g., int, double, unsigned long
+     * long) are stored inline in the property slot instead of in a
+     * property on the heap.
+    */
+    template <typename T>
+    struct InlineProperty {
+        static const bool value = std::is_trivially_copyable<T>::value &&
+            (sizeof(T) <= sizeof(unsigned long long)) &&
+            (alignof(T) <= alignof(unsigned long long));
+    };
+
+    /*!
+     * Wraps an inline value into a property.  The address of each
+     * instantiation also identifies the type of the inline value.
+     * \param data inline value
+     * \return new property holding a copy of the value
+    */
+    template <typename T>
+    static PropertyPtr box_inline(const void* data)
+    {
+        return PropertyPtr(new PropertyTemplate<T>(*static_cast<const T*>(data)));
+    }
+
+    //! property stored under an interned key
+    struct PropertySlot {
+        PropertySlot(PropertyKey key_, PropertyPtr property_) :
+            key(key_), box(0), property(property_) {}
+        PropertyKey key;
+
+        //! boxes the inline value (0 if the value is in 'property')
+        PropertyPtr (*box)(const void*);
+
+        //! inline value storage
+        typename std::aligned_storage<sizeof(unsigned long long),
+                 alignof(unsigned long long)>::type inline_data;
+
+        PropertyPtr property;
+    };
+    typedef std::vector<PropertySlot> Properties_t;
+
+    /*!
+     * Find the slot for a given key -- elements hold few properties
+     * so a linear scan over the contiguous slots is fastest.
+     * \param key interned property name
+     * \return pointer to slot or 0 if not found
+    */
+    PropertySlot* find_slot(PropertyKey key)
+    {
+        for (Properties_t::iterator iter = properties.begin();
+                iter != properties.end(); ++iter) {
+            if (iter->key == key) {
+                return &(*iter);
+            }
+        }
+        return 0;
+    }
+
+    /*!
+     * Add the slot or replace the slot with the same key
+     * \param slot property slot
+    */
+    void set_slot(const PropertySlot& slot)
+    {
+        PropertySlot* old_slot = find_slot(slot.key);
+        if (old_slot) {
+            *old_slot = slot;
+        } else {
+            properties.push_back(slot);
+        }
+    }
+
+    /*!
+     * Store a small trivially copyable value inline
+     * \param slot property slot
+     * \param val data to be stored
+    */
+    template <typename T>
+    static void store_property(PropertySlot& slot, const T& val, std::true_type)
+    {
+        slot.property.reset();
+        slot.box = &box_inline<T>;
+        new (&slot.inline_data) T(val);
+    }
+
+    /*!
+     * Store a value in a property on the heap, updating it in place
+     * when nothing else references it.
+     * \param slot property slot
+     * \param val data to be stored
+    */
+    template <typename T>
+    static void store_property(PropertySlot& slot, const T& val, std::false_type)
+    {
+        // avoid reallocating unless the property is shared (e.g., by an undo history)
+        PropertyTemplate<T>* property_tem =
+            dynamic_cast<PropertyTemplate<T>*>(slot.property.get());
+        if (property_tem && slot.property.unique()) {
+            property_tem->set_data(val);
+        } else {
+            slot.property = PropertyPtr(new PropertyTemplate<T>(val));
+        }
+        slot.box = 0;
+    }
+
+    //! Properties stored for rag element (indexed by interned key)
     Properties_t properties;
 };
 
 // inline functions
-inline RagElement::RagElement(const RagElement& dup_element)
+inline RagElement::RagElement(const RagElement& dup_element) :
+    properties(dup_element.properties)
 {
-    for (Properties_t::const_iterator iter = dup_element.properties.begin();
-            iter != dup_element.properties.end(); ++iter) {
-        properties[iter->first] = iter->second->copy();
+    for (Properties_t::iterator iter = properties.begin();
+            iter != properties.end(); ++iter) {
+        if (!(iter->box)) {
+            iter->property = iter->property->copy();
+        }
     }  
 }
 
+inline RagElement::RagElement(const RagElement& dup_element, bool share_properties)
+{
+    if (share_properties) {
+        properties = dup_element.properties;
+    } else {
+        RagElement element_temp(dup_element);
+        std::swap(properties, element_temp.properties);
+    }
+}
+
 inline RagElement& RagElement::operator=(const RagElement& dup_element)
 {
     if (this != &dup_element) {
@@ -130,53 +332,68 @@ inline RagElement& RagElement::operator=(const RagElement& dup_element)
     return *this; 
 }
 
-template <typename T> inline void RagElement::set_property(std::string key, T val)
+template <typename T> inline void RagElement::set_property(PropertyKey key, T val)
 {
-    PropertyPtr property = PropertyPtr(new PropertyTemplate<T>(val)); 
-    properties[key] = property;
+    PropertySlot* slot = find_slot(key);
+    if (!slot) {
+        properties.push_back(PropertySlot(key, PropertyPtr()));
+        slot = &properties.back();
+    }
+    store_property(*slot, val, std::integral_constant<bool, InlineProperty<T>::value>());
 }
 
-inline void RagElement::set_property_ptr(std::string key, PropertyPtr property)
+inline void RagElement::set_property_ptr(PropertyKey key, PropertyPtr property)
 {
-    properties[key] = property;
+    set_slot(PropertySlot(key, property));
 }
 
-template <typename T> inline T& RagElement::get_property(std::string key)
+template <typename T> inline T& RagElement::get_property(PropertyKey key)
 {
-    if (properties.find(key) == properties.end()) {
-        throw ErrMsg("Property Error: " + key + " not found");
+    PropertySlot* slot = find_slot(key);
+    if (!slot) {
+        throw ErrMsg("Property Error: " + PropertyKeys::get_name(key) + " not found");
     }
-    PropertyPtr property = properties[key];
-
-    boost::shared_ptr<PropertyTemplate<T> > property_tem =
-        boost::dynamic_pointer_cast<PropertyTemplate<T> >(property);
+    if (slot->box) {
+        assert(slot->box == &box_inline<T>);
+        return *reinterpret_cast<T*>(&(slot->inline_data));
+    }
+    assert(dynamic_cast<PropertyTemplate<T>*>(slot->property.get()));
 
-    return property_tem->get_data();
+    return static_cast<PropertyTemplate<T>*>(slot->property.get())->get_data();
 }
     
-inline PropertyPtr RagElement::get_property_ptr(std::string key)
+inline PropertyPtr RagElement::get_property_ptr(PropertyKey key)
 {
-    if (properties.find(key) == properties.end()) {
-        throw ErrMsg("Property Error: " + key + " not found");
+    PropertySlot* slot = find_slot(key);
+    if (!slot) {
+        throw ErrMsg("Property Error: " + PropertyKeys::get_name(key) + " not found");
     }
-    return properties[key];
-}
-
-inline bool RagElement::has_property(std::string key)
-{
-    return !(properties.find(key) == properties.end());
+    if (slot->box) {
+        return slot->box(&(slot->inline_data));
+    }
+    return slot->property;
 }
 
-inline void RagElement::rm_property(std::string key)
+inline void RagElement::rm_property(PropertyKey key)
 {
-    properties.erase(key);
+    for (Properties_t::iterator iter = properties.begin();
+            iter != properties.end(); ++iter) {
+        if (iter->key == key) {
+            properties.erase(iter);
+            return;
+        }
+    }
 }
 
 inline void RagElement::cp_properties(RagElement* element2)
 {
     for (Properties_t::iterator iter = properties.begin();
             iter != properties.end(); ++iter) {
-        element2->properties[iter->first] = iter->second->copy();
+        PropertySlot slot = *iter;
+        if (!(slot.box)) {
+            slot.property = slot.property->copy();
+        }
+        element2->set_slot(slot);
     }
 }
 
@@ -184,7 +401,7 @@ inline void RagElement::mv_properties(RagElement* element2)
 {
     for (Properties_t::iterator iter = properties.begin();
             iter != properties.end(); ++iter) {
-        element2->properties[iter->first] = iter->second;
+        element2->set_slot(*iter);
     }
     properties.clear(); 
 }
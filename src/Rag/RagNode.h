@@ -64,6 +64,18 @@ class RagNode : public RagElement {
         return new RagNode(node);  
     }
 
+    /*!
+     * Static function for copying rag nodes that can share the properties
+     * of the copied node (see RagElement).
+     * \param node node to be copied
+     * \param share_properties true to share rather than copy properties
+     * \return pointer to new rag node 
+    */
+    static RagNode<Region>* New(const RagNode<Region>& node, bool share_properties)
+    {
+        return new RagNode(node, share_properties);  
+    }
+
     /*!
      * Retrieve the main Region element/id associated with this node 
      * \return Region associated with this node
@@ -315,6 +327,15 @@ class RagNode : public RagElement {
     bool is_boundary();
 
   private:
+    /*!
+     * Interned key for the boundary size property
+     * \return property key
+    */
+    static PropertyKey boundary_size_key()
+    {
+        static const PropertyKey key = PropertyKeys::get_key(BOUNDARY_SIZE);
+        return key;
+    }
 
     /*!
      * Private constructor to prevent stack allocation
@@ -335,6 +356,13 @@ class RagNode : public RagElement {
     */
     RagNode(const RagNode<Region>& node2);
 
+    /*!
+     * Private copy constructor that can share properties
+     * \param node2 rag node to be copied
+     * \param share_properties true to share rather than copy properties
+    */
+    RagNode(const RagNode<Region>& node2, bool share_properties);
+
     //! vector of edges connected to the node
     RagEdgeList edges;
 
@@ -393,7 +421,7 @@ template<typename Region> inline void RagNode<Region>::set_size(unsigned long lo
 
 template<typename Region> inline void RagNode<Region>::set_boundary_size(unsigned long long size_)
 {
-    set_property(BOUNDARY_SIZE, size_);
+    set_property(boundary_size_key(), size_);
 }
 
 template<typename Region> inline void RagNode<Region>::set_node_id(Region region)
@@ -409,13 +437,13 @@ template<typename Region> inline void RagNode<Region>::incr_size(unsigned long l
 template<typename Region> inline void RagNode<Region>::incr_boundary_size(unsigned long long incr)
 {
     unsigned long long boundary_size = 
-        get_property<unsigned long long>(BOUNDARY_SIZE);
-    set_property(BOUNDARY_SIZE, (boundary_size + incr));
+        get_property<unsigned long long>(boundary_size_key());
+    set_property(boundary_size_key(), (boundary_size + incr));
 }
 
 template<typename Region> inline unsigned long long RagNode<Region>::get_boundary_size()
 {
-    return get_property<unsigned long long>(BOUNDARY_SIZE);
+    return get_property<unsigned long long>(boundary_size_key());
 }
 
 template<typename Region> size_t RagNode<Region>::node_degree() const
@@ -455,14 +483,14 @@ template<typename Region> inline typename RagNode<Region>::node_iterator RagNode
 
 template<typename Region> inline bool RagNode<Region>::is_boundary()
 {
-    return (get_property<unsigned long long>(BOUNDARY_SIZE) != 0);
+    return (get_property<unsigned long long>(boundary_size_key()) != 0);
 }
 
 template<typename Region> inline RagNode<Region>::RagNode(Region node_int_) :
     size(0), node_int(node_int_)
 {
     // sets boundary size property as a convenience
-    set_property(BOUNDARY_SIZE, (unsigned long long)(0));
+    set_property(boundary_size_key(), (unsigned long long)(0));
 }
 
 template<typename Region> inline RagNode<Region>::RagNode(const RagNode<Region>& node2) : 
@@ -473,6 +501,14 @@ template<typename Region> inline RagNode<Region>::RagNode(const RagNode<Region>&
     node_int = node2.node_int;
 }
 
+template<typename Region> inline RagNode<Region>::RagNode(const RagNode<Region>& node2,
+        bool share_properties) : RagElement(node2, share_properties)
+{
+    edges = node2.edges;
+    size = node2.size;
+    node_int = node2.node_int;
+}
+
 // overloaded oeprators
 template<typename Region> inline bool RagNode<Region>::operator<(const RagNode<Region>& node2) const
 {
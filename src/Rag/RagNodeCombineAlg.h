@@ -8,6 +8,7 @@
 #define RAGNODECOMBINEALG_H
 
 #include <Utilities/Glb.h>
+#include <vector>
 
 namespace NeuroProof {
 
@@ -55,6 +56,19 @@ class RagNodeCombineAlg {
     virtual void post_node_join(RagNode<Index_t>* node_keep,
             RagNode<Index_t>* node_remove) = 0;
 
+    /*!
+     * Actions that should be done after a set of nodes is collapsed
+     * onto node_keep in one step (see 'rag_collapse_nodes').  Edges to
+     * nodes outside of the set are handled by 'post_edge_move' and
+     * 'post_edge_join'.  By default nothing is done.
+     * \param node_keep pointer to rag node that will be kept
+     * \param nodes_remove pointers to rag nodes that will be removed
+     * \param internal_edges edges between the nodes that will be removed
+    */
+    virtual void post_node_collapse(RagNode<Index_t>* node_keep,
+            std::vector<RagNode<Index_t>*>& nodes_remove,
+            std::vector<RagEdge<Index_t>*>& internal_edges) {}
+
     /*!
      * Virtual destructor to be reimplemented by derived classes
     */
@@ -4,15 +4,16 @@
 */
 
 #include "RagUtils.h"
+#include "AffinityPathSearch.h"
 #include "RagNodeCombineAlg.h"
 #include "Rag.h"
 
 #include <boost/shared_ptr.hpp>
 #include <unordered_set>
 #include <unordered_map>
+#include <algorithm>
 
 #include <boost/graph/graph_traits.hpp>
-#include <queue>
 
 using std::vector;
 using std::unordered_map;
@@ -20,6 +21,62 @@ using std::unordered_set;
 
 namespace NeuroProof {
 
+/*!
+ * Moves an edge of a node being removed onto node_keep or combines it
+ * with the edge node_keep already has to the other node.
+ * \param rag rag containing merged nodes
+ * \param node_keep pointer to rag node that will be kept
+ * \param edge edge of the node being removed
+ * \param other_node node at the other end of the edge
+ * \param combine_alg algorithm type for performing actions during the join operation
+*/
+static void transfer_edge(Rag_t& rag, RagNode_t* node_keep, RagEdge_t* edge,
+        RagNode_t* other_node, RagNodeCombineAlg* combine_alg)
+{
+    // determine status of edge
+    bool preserve = edge->is_preserve();
+    bool false_edge = edge->is_false_edge();
+
+    RagEdge_t* final_edge = rag.find_rag_edge(node_keep, other_node);
+    
+    if (final_edge) {
+        // merge edges -- does not merge user-defined properties by default
+        preserve = preserve || final_edge->is_preserve(); 
+        false_edge = false_edge && final_edge->is_false_edge(); 
+        final_edge->incr_size(edge->get_size());
+        if (combine_alg) {
+            combine_alg->post_edge_join(final_edge, edge);
+        }
+
+        // specific flag updates for a particular algorithm, will be ignored
+        // if these flags do not exist
+        if (edge->has_property(orig_prob_key()) &&
+                final_edge->has_property(orig_prob_key())) {
+            double prob1 = edge->get_property<double>(orig_prob_key());
+            double prob2 = final_edge->get_property<double>(orig_prob_key());
+            final_edge->set_property(orig_prob_key(), double(std::min(prob1, prob2)));
+            if (edge->has_property(save_prob_key()) &&
+                    final_edge->has_property(save_prob_key())) {
+                prob1 = edge->get_property<double>(save_prob_key());
+                prob2 = final_edge->get_property<double>(save_prob_key());
+                final_edge->set_property(save_prob_key(), double(std::min(prob1, prob2)));
+            }
+        }
+
+    } else {
+        // move old edge to newly created edge
+        final_edge = rag.insert_rag_edge(node_keep, other_node);
+        edge->mv_properties(final_edge); 
+        final_edge->set_size(edge->get_size());
+        if (combine_alg) { 
+            combine_alg->post_edge_move(final_edge, edge);
+        }
+    }
+
+    final_edge->set_preserve(preserve); 
+    final_edge->set_false_edge(false_edge); 
+}
+
 //TODO: create strategy for automatically merging user-defined properties
 void rag_join_nodes(Rag_t& rag, RagNode_t* node_keep, RagNode_t* node_remove, 
         RagNodeCombineAlg* combine_alg)
@@ -32,46 +89,7 @@ void rag_join_nodes(Rag_t& rag, RagNode_t* node_keep, RagNode_t* node_remove,
         if (other_node == node_keep) {
             continue;
         }
-
-        // determine status of edge
-        bool preserve = (*iter)->is_preserve();
-        bool false_edge = (*iter)->is_false_edge();
-
-        RagEdge_t* final_edge = rag.find_rag_edge(node_keep, other_node);
-        
-        if (final_edge) {
-            // merge edges -- does not merge user-defined properties by default
-            preserve = preserve || final_edge->is_preserve(); 
-            false_edge = false_edge && final_edge->is_false_edge(); 
-            final_edge->incr_size((*iter)->get_size());
-            if (combine_alg) {
-                combine_alg->post_edge_join(final_edge, *iter);
-            }
-
-            // specific flag updates for a particular algorithm, will be ignored
-            // if these flags do not exist
-            try {
-                double prob1 = (*iter)->get_property<double>("orig-prob");
-                double prob2 = final_edge->get_property<double>("orig-prob");
-                final_edge->set_property("orig-prob", double(std::min(prob1, prob2)));
-                prob1 = (*iter)->get_property<double>("save-prob");
-                prob2 = final_edge->get_property<double>("save-prob");
-                final_edge->set_property("save-prob", double(std::min(prob1, prob2)));
-            } catch (ErrMsg& msg) {
-            }
-
-        } else {
-            // move old edge to newly created edge
-            final_edge = rag.insert_rag_edge(node_keep, other_node);
-            (*iter)->mv_properties(final_edge); 
-            final_edge->set_size((*iter)->get_size());
-            if (combine_alg) { 
-                combine_alg->post_edge_move(final_edge, *iter);
-            }
-        }
-
-        final_edge->set_preserve(preserve); 
-        final_edge->set_false_edge(false_edge); 
+        transfer_edge(rag, node_keep, *iter, other_node, combine_alg);
     }
 
     node_keep->incr_size(node_remove->get_size());
@@ -85,158 +103,267 @@ void rag_join_nodes(Rag_t& rag, RagNode_t* node_keep, RagNode_t* node_remove,
     rag.remove_rag_node(node_remove);     
 }
 
+void rag_collapse_nodes(Rag_t& rag, RagNode_t* node_keep,
+        vector<RagNode_t*>& nodes_remove, RagNodeCombineAlg* combine_alg)
+{
+    unordered_set<RagNode_t*> remove_set(nodes_remove.begin(), nodes_remove.end());
+    vector<RagEdge_t*> internal_edges;
+
+    unsigned long long size = 0;
+    unsigned long long boundary_size = 0;
+    for (unsigned int i = 0; i < nodes_remove.size(); ++i) {
+        RagNode_t* node_remove = nodes_remove[i];
+        for(RagNode_t::edge_iterator iter = node_remove->edge_begin();
+                iter != node_remove->edge_end(); ++iter) {
+            RagNode_t* other_node = (*iter)->get_other_node(node_remove);
+            if (other_node == node_keep) {
+                internal_edges.push_back(*iter);
+            } else if (remove_set.find(other_node) != remove_set.end()) {
+                // record edges inside of the set once
+                if (node_remove < other_node) {
+                    internal_edges.push_back(*iter);
+                }
+            } else {
+                transfer_edge(rag, node_keep, *iter, other_node, combine_alg);
+            }
+        }
+        size += node_remove->get_size();
+        boundary_size += node_remove->get_boundary_size();
+    }
+
+    node_keep->incr_size(size);
+    node_keep->incr_boundary_size(boundary_size);
+
+    if (combine_alg) { 
+        combine_alg->post_node_collapse(node_keep, nodes_remove, internal_edges);
+    }
+
+    // removes the nodes and all edges connected to them
+    for (unsigned int i = 0; i < nodes_remove.size(); ++i) {
+        rag.remove_rag_node(nodes_remove[i]);     
+    }
+}
+
 /*!
- * Structure used in bi-connected computation
+ * Finds the representative of a node's group, halving the path to it.
+ * \param parents parent index of each node index
+ * \param index node index
+ * \return index of the representative
 */
-struct DFSNode {
-    Node_t previous;
-    RagNode_t* rag_node;  
-    int count;
-    int start_pos;
-};
+static unsigned int find_group(vector<unsigned int>& parents, unsigned int index)
+{
+    while (parents[index] != index) {
+        parents[index] = parents[parents[index]];
+        index = parents[index];
+    }
+    return index;
+}
+
+void rag_merge_low_weight_edges(Rag_t& rag, double threshold,
+        RagNodeCombineAlg* combine_alg,
+        unordered_map<Node_t, unsigned long long>& largest_sizes)
+{
+    vector<RagNode_t*> nodes;
+    nodes.reserve(rag.get_num_regions());
+    unordered_map<RagNode_t*, unsigned int> node_indices;
+    for (Rag_t::nodes_iterator iter = rag.nodes_begin(); iter != rag.nodes_end(); ++iter) {
+        node_indices[*iter] = nodes.size();
+        nodes.push_back(*iter);
+    }
+
+    // union by size over all low weight edges
+    vector<unsigned int> parents(nodes.size());
+    vector<unsigned int> group_sizes(nodes.size(), 1);
+    for (unsigned int i = 0; i < parents.size(); ++i) {
+        parents[i] = i;
+    }
+    for (Rag_t::edges_iterator iter = rag.edges_begin(); iter != rag.edges_end(); ++iter) {
+        if ((*iter)->get_weight() >= threshold) {
+            continue;
+        }
+        unsigned int group1 = find_group(parents, node_indices[(*iter)->get_node1()]);
+        unsigned int group2 = find_group(parents, node_indices[(*iter)->get_node2()]);
+        if (group1 == group2) {
+            continue;
+        }
+        if (group_sizes[group1] < group_sizes[group2]) {
+            std::swap(group1, group2);
+        }
+        parents[group2] = group1;
+        group_sizes[group1] += group_sizes[group2];
+    }
 
-/*! 
- * Contains parameters needed to compute biconnected components
+    // find the largest node of each group
+    vector<unsigned int> largest(nodes.size());
+    for (unsigned int i = 0; i < nodes.size(); ++i) {
+        largest[i] = i;
+    }
+    for (unsigned int i = 0; i < nodes.size(); ++i) {
+        unsigned int group = find_group(parents, i);
+        if (nodes[i]->get_size() > nodes[largest[group]]->get_size()) {
+            largest[group] = i;
+        }
+    }
+
+    unordered_map<unsigned int, vector<RagNode_t*> > groups_remove;
+    for (unsigned int i = 0; i < nodes.size(); ++i) {
+        unsigned int group = find_group(parents, i);
+        if (largest[group] != i) {
+            groups_remove[group].push_back(nodes[i]);
+        }
+    }
+
+    for (unordered_map<unsigned int, vector<RagNode_t*> >::iterator iter =
+            groups_remove.begin(); iter != groups_remove.end(); ++iter) {
+        RagNode_t* node_keep = nodes[largest[iter->first]];
+        largest_sizes[node_keep->get_node_id()] = node_keep->get_size();
+        rag_collapse_nodes(rag, node_keep, iter->second, combine_alg);
+    }
+}
+
+/*!
+ * Compact snapshot of the rag adjacency in compressed sparse row form.
+ * Nodes are given dense indices (in rag iteration order) and the
+ * neighbors of node i are stored in neighbors[offsets[i]] to
+ * neighbors[offsets[i+1]-1] in the order of the node's edge list
+ * with whether the corresponding edge is a false edge alongside.
 */
-struct BiconnectedParams {
-    BiconnectedParams(RagPtr rag_, vector<vector<OrderedPair> >&
-        biconnected_components_, vector<DFSNode>& dfs_stack_) : rag(rag_),
-        biconnected_components(biconnected_components_), dfs_stack(dfs_stack_) {}  
+struct RagAdjacency {
+    RagAdjacency(Rag_t& rag)
+    {
+        nodes.reserve(rag.get_num_regions());
+        unordered_map<RagNode_t*, unsigned int> node_indices;
+        for (Rag_t::nodes_iterator iter = rag.nodes_begin(); iter != rag.nodes_end(); ++iter) {
+            node_indices[*iter] = nodes.size();
+            nodes.push_back(*iter);
+        }
 
-    //! bi-connected components computed for rag
-    RagPtr rag;
+        offsets.resize(nodes.size() + 1);
+        neighbors.reserve(2 * rag.get_num_edges());
+        false_edges.reserve(2 * rag.get_num_edges());
+        for (unsigned int i = 0; i < nodes.size(); ++i) {
+            offsets[i] = neighbors.size();
+            for (RagNode_t::edge_iterator iter = nodes[i]->edge_begin();
+                    iter != nodes[i]->edge_end(); ++iter) {
+                neighbors.push_back(node_indices[(*iter)->get_other_node(nodes[i])]);
+                false_edges.push_back((*iter)->is_false_edge());
+            }
+        }
+        offsets[nodes.size()] = neighbors.size();
+    }
 
-    //! bi-connected component output
-    vector<vector<OrderedPair> >& biconnected_components;
+    vector<RagNode_t*> nodes;
+    vector<unsigned int> offsets;
+    vector<unsigned int> neighbors;
+    vector<unsigned char> false_edges;
+};
 
-    //! dfs_stack that contains initial boundary node as starting point
-    vector<DFSNode>& dfs_stack;
-    
-    //! internal variable to biconnected calculation
-    unordered_set<Node_t> visited;
+/*!
+ * Node being explored in the depth-first search of the
+ * biconnected component computation.
+*/
+struct DFSNode {
+    DFSNode(unsigned int node_, unsigned int previous_, unsigned int pos_) :
+        node(node_), previous(previous_), pos(pos_) {}
 
-    //! internal variable to biconnected calculation
-    unordered_map<Node_t, int> node_depth;
+    //! dense node index
+    unsigned int node;
 
-    //! internal variable to biconnected calculation
-    unordered_map<Node_t, int> low_count;
+    //! dense index of the parent (NO_NODE for the root)
+    unsigned int previous;
 
-    //! internal variable to biconnected calculation
-    unordered_map<Node_t, Node_t> prev_id;
-    
-    //! internal variable to biconnected calculation
-    vector<OrderedPair> stack;
+    //! next adjacency position to examine
+    unsigned int pos;
 };
 
-void biconnected_recurs(BiconnectedParams& params)
+static const unsigned int NO_NODE = ~0U;
+
+void find_biconnected_components(RagPtr rag, vector<vector<OrderedPair> >& biconnected_components)
 {
-    while (!params.dfs_stack.empty()) {
-        DFSNode entry = params.dfs_stack.back();
-        RagNode_t* rag_node = entry.rag_node;
-        Node_t previous = entry.previous;
-        int count = entry.count;
-        params.dfs_stack.pop_back();
-
-        if (params.visited.find(rag_node->get_node_id()) == params.visited.end()) {
-            params.visited.insert(rag_node->get_node_id());
-            params.node_depth[rag_node->get_node_id()] = count;
-            params.low_count[rag_node->get_node_id()] = count;
-            params.prev_id[rag_node->get_node_id()] = previous;
+    RagAdjacency adjacency(*rag);
+    const vector<RagNode_t*>& nodes = adjacency.nodes;
+
+    unsigned int root = NO_NODE;
+    for (unsigned int i = 0; i < nodes.size(); ++i) {
+        if (nodes[i]->is_boundary()) {
+            root = i;
+            break;
         }
+    }
+    assert(root != NO_NODE);
 
-        bool skip = false;
-        int curr_pos = 0;
-        for (RagNode_t::node_iterator iter = rag_node->node_begin();
-                iter != rag_node->node_end(); ++iter) {
-            RagEdge_t* rag_edge = params.rag->find_rag_edge(rag_node, *iter);
-            if (rag_edge->is_false_edge()) {
-                continue;
-            }
+    // depth of 0 indicates the node has not been visited; the virtual
+    // node 0 that connects all boundary nodes has depth 0
+    vector<int> node_depth(nodes.size(), 0);
+    vector<int> low_count(nodes.size(), 0);
+    vector<unsigned int> prev_node(nodes.size(), NO_NODE);
+    vector<OrderedPair> stack;
 
-            if (curr_pos < entry.start_pos) {
-                ++curr_pos;
+    vector<DFSNode> dfs_stack;
+    dfs_stack.push_back(DFSNode(root, NO_NODE, adjacency.offsets[root]));
+    node_depth[root] = low_count[root] = 1;
+
+    while (!dfs_stack.empty()) {
+        size_t top = dfs_stack.size() - 1;
+        unsigned int node = dfs_stack[top].node;
+        unsigned int previous = dfs_stack[top].previous;
+        Node_t node_id = nodes[node]->get_node_id();
+        int count = node_depth[node];
+
+        // resume the neighbor scan where the search last descended
+        bool descended = false;
+        unsigned int pos = dfs_stack[top].pos;
+        for (; pos < adjacency.offsets[node+1]; ++pos) {
+            if (adjacency.false_edges[pos]) {
                 continue;
             }
-            if (params.prev_id[(*iter)->get_node_id()] == rag_node->get_node_id()) {
-                OrderedPair current_edge(rag_node->get_node_id(), (*iter)->get_node_id());
-                int temp_low = params.low_count[(*iter)->get_node_id()];
-                params.low_count[rag_node->get_node_id()] =
-                    std::min(params.low_count[rag_node->get_node_id()], temp_low);
-
-                if (temp_low >= count) {
+            unsigned int other = adjacency.neighbors[pos];
+            Node_t other_id = nodes[other]->get_node_id();
+
+            if (prev_node[other] == node) {
+                // returned from child: close the component if the child
+                // cannot reach above this node
+                low_count[node] = std::min(low_count[node], low_count[other]);
+                if (low_count[other] >= count) {
+                    OrderedPair current_edge(node_id, other_id);
+                    biconnected_components.push_back(std::vector<OrderedPair>());
+                    vector<OrderedPair>& component = biconnected_components.back();
                     OrderedPair popped_edge;
-                    params.biconnected_components.push_back(std::vector<OrderedPair>());
                     do {
-                        popped_edge = params.stack.back();
-                        params.stack.pop_back();
-                        params.biconnected_components[params.biconnected_components.size()-1].push_back(popped_edge);
+                        popped_edge = stack.back();
+                        stack.pop_back();
+                        component.push_back(popped_edge);
                     } while (!(popped_edge == current_edge));
-                    OrderedPair articulation_pair(rag_node->get_node_id(), rag_node->get_node_id());
-                    params.biconnected_components[params.biconnected_components.size()-1].push_back(articulation_pair);
-                } 
-            } else if (params.visited.find((*iter)->get_node_id()) == params.visited.end()) {
-                OrderedPair current_edge(rag_node->get_node_id(), (*iter)->get_node_id());
-                params.stack.push_back(current_edge);
-
-                DFSNode temp;
-                temp.previous = rag_node->get_node_id();
-                temp.rag_node = (*iter);
-                temp.count = count+1;
-                temp.start_pos = 0;
-                entry.start_pos = curr_pos;
-                params.dfs_stack.push_back(entry);
-                params.dfs_stack.push_back(temp);
-                skip = true;
+                    component.push_back(OrderedPair(node_id, node_id));
+                }
+            } else if (!node_depth[other]) {
+                stack.push_back(OrderedPair(node_id, other_id));
+                node_depth[other] = low_count[other] = count + 1;
+                prev_node[other] = node;
+                dfs_stack[top].pos = pos;
+                dfs_stack.push_back(DFSNode(other, node, adjacency.offsets[other]));
+                descended = true;
                 break;
-            } else if ((*iter)->get_node_id() != previous) {
-                params.low_count[rag_node->get_node_id()] = std::min(
-                    params.low_count[rag_node->get_node_id()],
-                    params.node_depth[(*iter)->get_node_id()]);
-                if (count > params.node_depth[(*iter)->get_node_id()]) {
-                    params.stack.push_back(OrderedPair(rag_node->get_node_id(),
-                        (*iter)->get_node_id()));
+            } else if (other != previous) {
+                low_count[node] = std::min(low_count[node], node_depth[other]);
+                if (count > node_depth[other]) {
+                    stack.push_back(OrderedPair(node_id, other_id));
                 }
             }
-            ++curr_pos;
         }
 
-        if (skip) {
+        if (descended) {
             continue;
         }
 
-        bool border = rag_node->is_boundary();
-        if (previous && border) {
-            params.low_count[rag_node->get_node_id()] = 0;
-            params.stack.push_back(OrderedPair(0, rag_node->get_node_id()));
+        if ((previous != NO_NODE) && nodes[node]->is_boundary()) {
+            low_count[node] = 0;
+            stack.push_back(OrderedPair(0, node_id));
         }
+        dfs_stack.pop_back();
     }
 }
 
-void find_biconnected_components(RagPtr rag, vector<vector<OrderedPair> >& biconnected_components)
-{
-    RagNode_t* rag_node = 0;
-    for (Rag_t::nodes_iterator iter = rag->nodes_begin(); iter != rag->nodes_end(); ++iter) {
-        if ((*iter)->is_boundary()) {
-            rag_node = *iter;
-            break;
-        }
-    }
-    assert(rag_node);
-
-    DFSNode temp;
-    temp.previous = 0;
-    temp.rag_node = rag_node;
-    temp.count = 1;
-    temp.start_pos = 0;
-
-    vector<DFSNode> dfs_stack;
-    dfs_stack.push_back(temp);
-
-    BiconnectedParams params(rag, biconnected_components, dfs_stack);
-
-    biconnected_recurs(params);
-}
-
 void compute_graph_coloring(boost::shared_ptr<Rag<Index_t> > rag)
 {
     unordered_set<int> used_ids;
@@ -299,148 +426,23 @@ BoostGraph* create_boost_graph(RagPtr rag)
     return graph;
 }
 
-/*!
- * Structure used in the Dijkstra's algorithm implementation of finding
- * the shortest multiplicative path in the graph.
-*/
-struct BestNode {
-    RagNode_t* rag_node_curr;
-    RagEdge_t* rag_edge_curr;
-    //! weight of the current path (1 is short, 0 is infinite)
-    double weight;
-    //! length of the current path
-    int path;
-    Node_t second_node;
-};
-struct BestNodeCmp {
-    bool operator()(const BestNode& q1, const BestNode& q2) const
-    {
-        return (q1.weight < q2.weight);
-    }
-};
-
 void grab_affinity_pairs(Rag_t& rag, RagNode_t* rag_node_head, int path_restriction,
         double connection_threshold, bool preserve, AffinityPair::Hash& affinity_pairs, bool extract_path)
 {
-    typedef std::priority_queue<BestNode, std::vector<BestNode>, BestNodeCmp> BestNodeQueue;
-    BestNode best_node_head;
-    BestNodeQueue best_node_queue; 
-    
-    best_node_head.rag_node_curr = rag_node_head;
-    best_node_head.rag_edge_curr = 0;
-    best_node_head.weight= 1.0;
-    best_node_head.path = 0;
-    Node_t node_head = rag_node_head->get_node_id();
-
-    best_node_queue.push(best_node_head);
-    AffinityPair affinity_pair_head(node_head, node_head);
-    affinity_pair_head.weight = 1.0;
-    affinity_pair_head.size = 0;
+    AffinityPathSearch path_search;
+    path_search.search(rag_node_head, path_restriction, connection_threshold,
+            preserve, extract_path);
 
     affinity_pairs.clear();
-    
-    // finding the shortest current path (connection strenght closest to 1
-    // and pop this value off the list)
-    while (!best_node_queue.empty()) {
-        BestNode best_node_curr = best_node_queue.top();
-        AffinityPair affinity_pair_curr(node_head, best_node_curr.rag_node_curr->get_node_id());
-
-        if (affinity_pairs.find(affinity_pair_curr) == affinity_pairs.end()) { 
-            for (RagNode_t::edge_iterator edge_iter = best_node_curr.rag_node_curr->edge_begin();
-                    edge_iter != best_node_curr.rag_node_curr->edge_end(); ++edge_iter) {
-                // avoid simple cycles
-                if (*edge_iter == best_node_curr.rag_edge_curr) {
-                    continue;
-                }
-
-                // grab other node 
-                RagNode_t* other_node = (*edge_iter)->get_other_node(best_node_curr.rag_node_curr);
-
-                // avoid duplicates
-                AffinityPair temp_pair(node_head, other_node->get_node_id());
-                if (affinity_pairs.find(temp_pair) != affinity_pairs.end()) {
-                    continue;
-                }
-
-                if (path_restriction && (best_node_curr.path == path_restriction)) {
-                    continue;
-                }
-
-                RagEdge_t* rag_edge_temp = rag.find_rag_edge(rag_node_head, other_node); 
-                if (rag_edge_temp && rag_edge_temp->get_weight() > 1.00001) {
-                    continue;
-                }
-
-                if (preserve) {
-                    if ((rag_edge_temp && rag_edge_temp->is_preserve()) || (!rag_edge_temp && ((*edge_iter)->is_preserve()))) {
-                        continue;
-                    }
-                }
-
-                if (rag_edge_temp && rag_edge_temp->is_false_edge()) {
-                    rag_edge_temp = 0;
-                }
-
-                double edge_prob = 1.0 - (*edge_iter)->get_weight();
-
-                if (edge_prob < 0.000001) {
-                    continue;
-                }
-
-                edge_prob = best_node_curr.weight * edge_prob;
-                if (edge_prob < connection_threshold) {
-                    continue;
-                }
-
-                BestNode best_node_new;
-                best_node_new.rag_node_curr = other_node;
-                best_node_new.rag_edge_curr = *edge_iter;
-                best_node_new.weight = edge_prob;
-                best_node_new.path = best_node_curr.path + 1;
-                if (best_node_new.path > 1) {
-                    if (!extract_path) {
-                        best_node_new.second_node = best_node_curr.second_node;
-                    } else {
-                        best_node_new.second_node = best_node_curr.rag_node_curr->get_node_id();
-                    }
-                } else {
-                    best_node_new.second_node = best_node_new.rag_node_curr->get_node_id();
-                }
-                if (rag_edge_temp) {
-                    best_node_new.second_node = best_node_new.rag_node_curr->get_node_id();
-                }
-
-                best_node_queue.push(best_node_new);
-            }
-            affinity_pair_curr.weight = best_node_curr.weight;
-            if (best_node_curr.path >= 1) {
-                affinity_pair_curr.size = best_node_curr.second_node;
-            }
-            affinity_pairs.insert(affinity_pair_curr);
-        }
-
-        best_node_queue.pop();
-    }
-
-    affinity_pairs.erase(affinity_pair_head);
+    path_search.get_affinity_pairs(affinity_pairs);
 }
 
 double find_affinity_path(Rag_t& rag, RagNode_t* rag_node_head, RagNode_t* rag_node_dest)
 {
-    // TODO restrict path search algorithm so that it terminates after
-    // finding the destination node
-    AffinityPair::Hash affinity_pairs;
-    
     // current ignore preserve nodes 
-    grab_affinity_pairs(rag, rag_node_head, 0, 0.01, false, affinity_pairs); 
-    AffinityPair apair(rag_node_head->get_node_id(), rag_node_dest->get_node_id()); 
-
-    AffinityPair::Hash::iterator iter = affinity_pairs.find(apair);
-    if (iter == affinity_pairs.end()) {
-        return 0.0;
-    } else {
-        return iter->weight;
-    }
+    AffinityPathSearch path_search;
+    path_search.search(rag_node_head, 0, 0.01, false, false, rag_node_dest);
+    return path_search.get_affinity(rag_node_dest);
     //return int(-1*log(iter->weight)/log(2.0)+0.5);
 }
 
@@ -10,8 +10,10 @@
 
 #include <Utilities/AffinityPair.h>
 #include <vector>
+#include <unordered_map>
 #include <boost/graph/adjacency_list.hpp>
 #include <Utilities/Glb.h>
+#include "Property.h"
 
 namespace boost {
 
@@ -32,6 +34,39 @@ class RagNode;
 template <typename Region>
 class RagEdge;
 
+/*!
+ * Interned key of the edge property holding the probability first
+ * computed for an edge in overlap mode (combined by rag_join_nodes)
+ * \return property key
+*/
+inline PropertyKey orig_prob_key()
+{
+    static const PropertyKey key = PropertyKeys::get_key("orig-prob");
+    return key;
+}
+
+/*!
+ * Interned key of the edge property holding the conservative overlap
+ * probability of an edge (combined by rag_join_nodes)
+ * \return property key
+*/
+inline PropertyKey save_prob_key()
+{
+    static const PropertyKey key = PropertyKeys::get_key("save-prob");
+    return key;
+}
+
+/*!
+ * Interned key of the edge property counting the boundary voxels of an
+ * edge that touch label 0
+ * \return property key
+*/
+inline PropertyKey num_zeros_key()
+{
+    static const PropertyKey key = PropertyKeys::get_key("num-zeros");
+    return key;
+}
+
 /*!
  * Function for merging node_remove onto node_keep.  The default merge operations
  * handle the node and edge size properties properly and transfer edges from
@@ -48,6 +83,38 @@ class RagEdge;
 void rag_join_nodes(Rag<Index_t>& rag, RagNode<Index_t>* node_keep,
         RagNode<Index_t>* node_remove, RagNodeCombineAlg* combine_alg);
 
+/*!
+ * Function for merging a set of nodes onto node_keep in one pass.  The
+ * result is the same as joining each node onto node_keep in turn with
+ * 'rag_join_nodes' except that the edges between nodes in the set are
+ * discarded directly and node sizes are summed once.  Edges to nodes
+ * outside of the set are moved or combined with the edges of node_keep
+ * as in 'rag_join_nodes'.
+ * \param rag rag containing merged nodes
+ * \param node_keep pointer to rag node whose unique identifier will be kept
+ * \param nodes_remove pointers to rag nodes that will be removed
+ * \param combine_alg algorithm type for performing actions during the join operation
+*/
+void rag_collapse_nodes(Rag<Index_t>& rag, RagNode<Index_t>* node_keep,
+        std::vector<RagNode<Index_t>*>& nodes_remove, RagNodeCombineAlg* combine_alg);
+
+/*!
+ * Function for merging every group of nodes connected by edges with a
+ * weight below the threshold.  The groups are found in one pass over
+ * the edges with a union-find and each group is collapsed onto its
+ * largest node with 'rag_collapse_nodes'.  This gives the same groups
+ * as repeatedly joining nodes across a low weight edge when combined
+ * edges keep the smaller weight (as with weights between 0 and 1).
+ * \param rag rag containing merged nodes
+ * \param threshold edges with a smaller weight are merged
+ * \param combine_alg algorithm type for performing actions during the join operation
+ * \param largest_sizes size of the largest original node of each kept
+ * node (only nodes that absorbed other nodes are added)
+*/
+void rag_merge_low_weight_edges(Rag<Index_t>& rag, double threshold,
+        RagNodeCombineAlg* combine_alg,
+        std::unordered_map<Index_t, unsigned long long>& largest_sizes);
+
 /*!
  * Computes all of the biconnected components for the given graph
  * \param rag Rag used to compute bi-connected components
@@ -112,7 +179,8 @@ BoostGraph* create_boost_graph(boost::shared_ptr<Rag<Index_t> > rag);
  * For a given node find all of the nodes connected to it and the cost
  * to reach this node using a shortest-path algorithm over the edge
  * weights.  This algorithm will ignore paths that go through edges
- * with the 'preserve' flag if specified.
+ * with the 'preserve' flag if specified.  Repeated searches should use an
+ * AffinityPathSearch directly to reuse its memory.
  * \param rag rag with edge weights set for each edge
  * \param rag_node_head starting node for the path search
  * \param path_restriction the max length of any path (0 = unbounded)
@@ -125,7 +193,8 @@ void grab_affinity_pairs(Rag<Index_t>& rag, RagNode<Index_t>* rag_node_head,
         AffinityPair::Hash& affinity_pairs, bool extract_path=false);
 
 /*!
- * Calls 'grab_affinity_pairs' to find the affinity beetween two nodes.
+ * Finds the affinity beetween two nodes.  The path search stops once
+ * the destination node is reached.
  * \param rag rag with edge weights set for each edge
  * \param rag_node_head start rag node
  * \param rag_node_dest final rag node
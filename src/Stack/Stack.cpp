@@ -4,6 +4,10 @@
 #include <Algorithms/FeatureJoinAlgs.h>
 
 #include <fstream>
+#include <algorithm>
+
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
 
 // needed for erosion/dilation algorithms
 #define WITH_BOOST_GRAPH 1
@@ -35,6 +39,17 @@ void Stack::build_rag_batch()
     }
 
     rag = RagPtr(new Rag_t);
+    build_rag_batch(0, get_zsize());
+}
+
+void Stack::build_rag_batch(unsigned int zstart, unsigned int zend)
+{
+    if (!labelvol) {
+        throw ErrMsg("No label volume defined for stack");
+    }
+    if (!rag) {
+        rag = RagPtr(new Rag_t);
+    }
 
     // 1 pixel border expected
     unsigned int maxx = get_xsize() - 1; 
@@ -43,7 +58,9 @@ void Stack::build_rag_batch()
     vector<double> predictions(prob_list.size(), 0.0);
     unordered_set<Label_t> labels;
  
-    volume_forXYZ(*labelvol, x, y, z) {
+    for (unsigned int z = zstart; z < zend; ++z)
+      for (unsigned int y = 0; y < get_ysize(); ++y)
+        for (unsigned int x = 0; x < get_xsize(); ++x) {
     
         Label_t label = (*labelvol)(x,y,z); 
         
@@ -146,6 +163,16 @@ void Stack::build_rag()
 
     rag = RagPtr(new Rag_t);
 
+    if ((num_threads > 1) && (get_zsize() > 1)) {
+        build_rag_parallel(0, get_zsize());
+    } else {
+        build_rag_slab(*rag, feature_manager.get(), 0, get_zsize());
+    }
+}
+
+void Stack::build_rag_slab(Rag_t& rag_slab, FeatureMgr* feature_mgr_slab,
+        unsigned int zstart, unsigned int zend)
+{
     vector<double> predictions(prob_list.size(), 0.0);
     unordered_set<Label_t> labels;
    
@@ -153,104 +180,224 @@ void Stack::build_rag()
     unsigned int maxy = get_ysize() - 1; 
     unsigned int maxz = get_zsize() - 1; 
  
-//     FILE* fp = fopen("/groups/scheffer/home/paragt/Neuroproof_lean/NeuroProof_toufiq/check_rag_new.txt","wt");
-    
-    
-    volume_forXYZ(*labelvol, x, y, z) {
-        Label_t label = (*labelvol)(x,y,z); 
-        if (!label) {
-            continue;
+    for (unsigned int z = zstart; z < zend; ++z) {
+        for (unsigned int y = 0; y < get_ysize(); ++y) {
+            for (unsigned int x = 0; x < get_xsize(); ++x) {
+                Label_t label = (*labelvol)(x,y,z); 
+                if (!label) {
+                    continue;
+                }
+
+                RagNode_t * node = rag_slab.find_rag_node(label);
+
+                // create node
+                if (!node) {
+                    node =  rag_slab.insert_rag_node(label); 
+                }
+                node->incr_size();
+
+                // load all prediction values for a given x,y,z 
+                for (unsigned int i = 0; i < prob_list.size(); ++i) {
+                    predictions[i] = (*(prob_list[i]))(x,y,z);
+                }
+
+                // add array of features/predictions for a given node
+                if (feature_mgr_slab) {
+                    feature_mgr_slab->add_val(predictions, node);
+                }
+
+                Label_t label2 = 0, label3 = 0, label4 = 0, label5 = 0, label6 = 0, label7 = 0;
+                if (x > 0) label2 = (*labelvol)(x-1,y,z);
+                if (x < maxx) label3 = (*labelvol)(x+1,y,z);
+                if (y > 0) label4 = (*labelvol)(x,y-1,z);
+                if (y < maxy) label5 = (*labelvol)(x,y+1,z);
+                if (z > 0) label6 = (*labelvol)(x,y,z-1);
+                if (z < maxz) label7 = (*labelvol)(x,y,z+1);
+
+                // if it is not a 0 label and is different from the current label, add edge
+                if (label2 && (label != label2)) {
+                    rag_add_edge(rag_slab, feature_mgr_slab, label, label2, predictions);
+                    labels.insert(label2);
+                }
+                if (label3 && (label != label3) && (labels.find(label3) == labels.end())) {
+                    rag_add_edge(rag_slab, feature_mgr_slab, label, label3, predictions);
+                    labels.insert(label3);
+                }
+                if (label4 && (label != label4) && (labels.find(label4) == labels.end())) {
+                    rag_add_edge(rag_slab, feature_mgr_slab, label, label4, predictions);
+                    labels.insert(label4);
+                }
+                if (label5 && (label != label5) && (labels.find(label5) == labels.end())) {
+                    rag_add_edge(rag_slab, feature_mgr_slab, label, label5, predictions);
+                    labels.insert(label5);
+                }
+                if (label6 && (label != label6) && (labels.find(label6) == labels.end())) {
+                    rag_add_edge(rag_slab, feature_mgr_slab, label, label6, predictions);
+                    labels.insert(label6);
+                }
+                if (label7 && (label != label7) && (labels.find(label7) == labels.end())) {
+                    rag_add_edge(rag_slab, feature_mgr_slab, label, label7, predictions);
+                }
+
+                // if it is on the border of the image, increase the boundary size
+                if (!label2 || !label3 || !label4 || !label5 || !label6 || !label7) {
+                    node->incr_boundary_size();
+                }
+                labels.clear();
+            }
         }
+    }
+}
 
-        RagNode_t * node = rag->find_rag_node(label);
+void Stack::build_rag_stream(StackChunkReader& reader, unsigned int chunk_depth)
+{
+    if (!chunk_depth) {
+        throw ErrMsg("Chunk depth must be greater than 0");
+    }
 
-        // create node
-        if (!node) {
-            node =  rag->insert_rag_node(label); 
+    rag = RagPtr(new Rag_t);
+
+    // the chunk volumes temporarily stand in for the stack volumes
+    VolumeLabelPtr full_labelvol = labelvol;
+    vector<VolumeProbPtr> full_prob_list = prob_list;
+    unsigned int zsize = full_labelvol ? full_labelvol->shape(2) : reader.get_zsize();
+
+    try {
+        for (unsigned int zstart = 0; zstart < zsize; zstart += chunk_depth) {
+            unsigned int zend = std::min(zstart + chunk_depth, zsize);
+            
+            // include neighboring planes so edges across chunks are found
+            unsigned int zlow = (zstart > 0) ? (zstart - 1) : 0;
+            unsigned int zhigh = (zend < zsize) ? (zend + 1) : zend;
+
+            if (full_labelvol) {
+                labelvol = VolumeLabelData::create_volume(full_labelvol->shape(0),
+                        full_labelvol->shape(1), zhigh - zlow);
+                volume_forXYZ(*labelvol, x, y, z) {
+                    labelvol->set(x, y, z, (*full_labelvol)(x, y, z + zlow));
+                }
+            } else {
+                labelvol = reader.read_labels(zlow, zhigh);
+            }
+            prob_list = reader.read_predictions(zlow, zhigh);
+
+            build_rag_parallel(zstart - zlow, zend - zlow);
         }
-        node->incr_size();
-	
-//         fprintf(fp,"%u %u %u %u ", x, y, z, node->get_node_id());
+    } catch (...) {
+        labelvol = full_labelvol;
+        prob_list = full_prob_list;
+        throw;
+    }
     
-        // load all prediction values for a given x,y,z 
-        for (unsigned int i = 0; i < prob_list.size(); ++i) {
-            predictions[i] = (*(prob_list[i]))(x,y,z);
-// 	    fprintf(fp,"%lf ", predictions[i]);
-        }
-// 	fprintf(fp,"\n");
+    labelvol = full_labelvol;
+    prob_list = full_prob_list;
+}
 
-        // add array of features/predictions for a given node
+void Stack::build_rag_parallel(unsigned int zbegin, unsigned int zfinish)
+{
+    unsigned int zsize = zfinish - zbegin;
+    unsigned int num_slabs = (num_threads < zsize) ? num_threads : zsize;
+
+    // each slab gets its own rag and feature manager (sharing the feature
+    // definitions of the stack feature manager) so no locking is needed
+    vector<Rag_t*> slab_rags(num_slabs);
+    vector<FeatureMgr*> slab_feature_mgrs(num_slabs, (FeatureMgr*)(0));
+    boost::thread_group threads;
+
+    unsigned int zstart = zbegin;
+    for (unsigned int i = 0; i < num_slabs; ++i) {
+        unsigned int zend = zstart + zsize / num_slabs + ((i < (zsize % num_slabs)) ? 1 : 0);
+        slab_rags[i] = new Rag_t;
         if (feature_manager) {
-            feature_manager->add_val(predictions, node);
-        }
-
-        Label_t label2 = 0, label3 = 0, label4 = 0, label5 = 0, label6 = 0, label7 = 0;
-        if (x > 0) label2 = (*labelvol)(x-1,y,z);
-        if (x < maxx) label3 = (*labelvol)(x+1,y,z);
-        if (y > 0) label4 = (*labelvol)(x,y-1,z);
-        if (y < maxy) label5 = (*labelvol)(x,y+1,z);
-        if (z > 0) label6 = (*labelvol)(x,y,z-1);
-        if (z < maxz) label7 = (*labelvol)(x,y,z+1);
-
-        // if it is not a 0 label and is different from the current label, add edge
-        if (label2 && (label != label2)) {
-            rag_add_edge(label, label2, predictions);
-            labels.insert(label2);
-        }
-        if (label3 && (label != label3) && (labels.find(label3) == labels.end())) {
-            rag_add_edge(label, label3, predictions);
-            labels.insert(label3);
+            slab_feature_mgrs[i] = new FeatureMgr;
+            slab_feature_mgrs[i]->copy_channel_features(feature_manager.get());
         }
-        if (label4 && (label != label4) && (labels.find(label4) == labels.end())) {
-            rag_add_edge(label, label4, predictions);
-            labels.insert(label4);
+        if (num_slabs == 1) {
+            build_rag_slab(*(slab_rags[i]), slab_feature_mgrs[i], zstart, zend);
+        } else {
+            threads.create_thread(boost::bind(&Stack::build_rag_slab, this,
+                        boost::ref(*(slab_rags[i])), slab_feature_mgrs[i], zstart, zend));
         }
-        if (label5 && (label != label5) && (labels.find(label5) == labels.end())) {
-            rag_add_edge(label, label5, predictions);
-            labels.insert(label5);
+        zstart = zend;
+    }
+    threads.join_all();
+
+    // combine slabs in order so that the result does not depend on scheduling
+    for (unsigned int i = 0; i < num_slabs; ++i) {
+        merge_rag_slab(*(slab_rags[i]), slab_feature_mgrs[i]);
+        delete slab_feature_mgrs[i];
+        delete slab_rags[i];
+    }
+}
+
+void Stack::merge_rag_slab(Rag_t& rag_slab, FeatureMgr* feature_mgr_slab)
+{
+    for (Rag_t::nodes_iterator iter = rag_slab.nodes_begin();
+            iter != rag_slab.nodes_end(); ++iter) {
+        RagNode_t* slab_node = *iter;
+        RagNode_t* node = rag->find_rag_node(slab_node->get_node_id());
+        if (!node) {
+            node = rag->insert_rag_node(slab_node->get_node_id());
         }
-        if (label6 && (label != label6) && (labels.find(label6) == labels.end())) {
-            rag_add_edge(label, label6, predictions);
-            labels.insert(label6);
+        merge_slab_node(node, slab_node);
+
+        if (feature_manager && feature_mgr_slab) {
+            feature_manager->merge_features(node, feature_mgr_slab, slab_node);
         }
-        if (label7 && (label != label7) && (labels.find(label7) == labels.end())) {
-            rag_add_edge(label, label7, predictions);
+    }
+
+    for (Rag_t::edges_iterator iter = rag_slab.edges_begin();
+            iter != rag_slab.edges_end(); ++iter) {
+        RagEdge_t* slab_edge = *iter;
+        RagNode_t* node1 = rag->find_rag_node(slab_edge->get_node1()->get_node_id());
+        RagNode_t* node2 = rag->find_rag_node(slab_edge->get_node2()->get_node_id());
+        assert(node1 && node2);
+
+        RagEdge_t* edge = rag->find_rag_edge(node1, node2);
+        if (!edge) {
+            edge = rag->insert_rag_edge(node1, node2);
         }
+        edge->incr_size(slab_edge->get_size());
 
-        // if it is on the border of the image, increase the boundary size
-        if (!label2 || !label3 || !label4 || !label5 || !label6 || !label7) {
-            node->incr_boundary_size();
+        if (feature_manager && feature_mgr_slab) {
+            feature_manager->merge_features(edge, feature_mgr_slab, slab_edge);
         }
-        labels.clear();
     }
- 
-//     fclose(fp);
-
+}
 
+void Stack::merge_slab_node(RagNode_t* node, RagNode_t* slab_node)
+{
+    node->incr_size(slab_node->get_size());
+    node->incr_boundary_size(slab_node->get_boundary_size());
+}
 
+void Stack::rag_add_edge(Label_t id1, Label_t id2, vector<double>& preds, bool increment)
+{
+    rag_add_edge(*rag, feature_manager.get(), id1, id2, preds, increment);
 }
 
-void Stack::rag_add_edge(unsigned int id1, unsigned int id2, vector<double>& preds, bool increment)
+void Stack::rag_add_edge(Rag_t& rag_slab, FeatureMgr* feature_mgr_slab, Label_t id1,
+        Label_t id2, vector<double>& preds, bool increment)
 {
-    RagNode_t * node1 = rag->find_rag_node(id1);
+    RagNode_t * node1 = rag_slab.find_rag_node(id1);
     if (!node1) {
-        node1 = rag->insert_rag_node(id1);
+        node1 = rag_slab.insert_rag_node(id1);
     }
     
-    RagNode_t * node2 = rag->find_rag_node(id2);
+    RagNode_t * node2 = rag_slab.find_rag_node(id2);
     if (!node2) {
-        node2 = rag->insert_rag_node(id2);
+        node2 = rag_slab.insert_rag_node(id2);
     }
    
     assert(node1 != node2);
 
-    RagEdge_t* edge = rag->find_rag_edge(node1, node2);
+    RagEdge_t* edge = rag_slab.find_rag_edge(node1, node2);
     if (!edge) {
-        edge = rag->insert_rag_edge(node1, node2);
+        edge = rag_slab.insert_rag_edge(node1, node2);
     }
 
-    if (feature_manager) {
-        feature_manager->add_val(preds, edge);
+    if (feature_mgr_slab) {
+        feature_mgr_slab->add_val(preds, edge);
     }
 
     if (increment) {
@@ -315,17 +462,15 @@ int Stack::remove_inclusions()
                 continue;
             }
 
-            // reassign labels in component to be removed
+            // fold the component to be removed into the articulation node
+            vector<Label_t> remove_labels;
             for (unordered_set<Label_t>::iterator iter = merge_nodes.begin();
                     iter != merge_nodes.end(); ++iter) {
-                Node_t node2 = *iter;
-                RagNode_t* rag_node = rag->find_rag_node(node2);
-                if (articulation_node != rag_node) {
-                    RagNode_t::node_iterator n_iter = rag_node->node_begin();
-                    Node_t node1 = (*n_iter)->get_node_id();
-                    merge_labels(node2, node1, &node_combine_alg);
+                if (*iter != articulation_label) {
+                    remove_labels.push_back(*iter);
                 }
             }
+            collapse_labels(articulation_label, remove_labels, &node_combine_alg);
         }
     }
     return num_removed;
@@ -391,6 +536,536 @@ int Stack::absorb_small_regions(VolumeProbPtr boundary_pred,
     return num_removed;
 }
 
+static void extend_box(Stack::RegionBox& box, const Stack::RegionBox& box2)
+{
+    box.count += box2.count;
+    box.minx = std::min(box.minx, box2.minx);
+    box.miny = std::min(box.miny, box2.miny);
+    box.minz = std::min(box.minz, box2.minz);
+    box.maxx = std::max(box.maxx, box2.maxx);
+    box.maxy = std::max(box.maxy, box2.maxy);
+    box.maxz = std::max(box.maxz, box2.maxz);
+}
+
+static bool boxes_overlap(const Stack::RegionBox& box1, const Stack::RegionBox& box2)
+{
+    return (box1.minx <= box2.maxx) && (box2.minx <= box1.maxx) &&
+        (box1.miny <= box2.maxy) && (box2.miny <= box1.maxy) &&
+        (box1.minz <= box2.maxz) && (box2.minz <= box1.maxz);
+}
+
+static unsigned long long box_volume(const Stack::RegionBox& box)
+{
+    return (unsigned long long)(box.maxx - box.minx + 1) *
+        (box.maxy - box.miny + 1) * (box.maxz - box.minz + 1);
+}
+
+static bool box_minx_less(const Stack::RegionBox& box1, const Stack::RegionBox& box2)
+{
+    return box1.minx < box2.minx;
+}
+
+static bool box_volume_greater(const Stack::RegionBox& box1, const Stack::RegionBox& box2)
+{
+    return box_volume(box1) > box_volume(box2);
+}
+
+static size_t find_box_group(vector<size_t>& parents, size_t pos)
+{
+    while (parents[pos] != pos) {
+        parents[pos] = parents[parents[pos]];
+        pos = parents[pos];
+    }
+    return pos;
+}
+
+/*!
+ * Replaces each set of overlapping boxes with the box that bounds them.
+ * \param boxes boxes to be merged
+*/
+static void merge_overlapping_boxes(vector<Stack::RegionBox>& boxes)
+{
+    // a merged box can overlap boxes that its parts did not, so
+    // repeat until no boxes are merged
+    size_t num_boxes = 0;
+    while (boxes.size() != num_boxes) {
+        num_boxes = boxes.size();
+        std::sort(boxes.begin(), boxes.end(), box_minx_less);
+
+        vector<size_t> parents(num_boxes);
+        for (size_t i = 0; i < num_boxes; ++i) {
+            parents[i] = i;
+        }
+
+        // sweep along x keeping only the boxes that reach the current box
+        vector<size_t> active;
+        for (size_t i = 0; i < num_boxes; ++i) {
+            size_t num_active = 0;
+            for (size_t j = 0; j < active.size(); ++j) {
+                if (boxes[active[j]].maxx < boxes[i].minx) {
+                    continue;
+                }
+                active[num_active++] = active[j];
+                if (boxes_overlap(boxes[active[j]], boxes[i])) {
+                    parents[find_box_group(parents, i)] = find_box_group(parents, active[j]);
+                }
+            }
+            active.resize(num_active);
+            active.push_back(i);
+        }
+
+        vector<Stack::RegionBox> merged_boxes;
+        vector<size_t> merged_pos(num_boxes, num_boxes);
+        for (size_t i = 0; i < num_boxes; ++i) {
+            size_t root = find_box_group(parents, i);
+            if (merged_pos[root] == num_boxes) {
+                merged_pos[root] = merged_boxes.size();
+                merged_boxes.push_back(boxes[i]);
+            } else {
+                extend_box(merged_boxes[merged_pos[root]], boxes[i]);
+            }
+        }
+        boxes.swap(merged_boxes);
+    }
+}
+
+int Stack::absorb_small_regions_local(VolumeProbPtr boundary_pred,
+            int threshold, unordered_set<Label_t>& exclusions, unsigned int margin)
+{
+    labelvol->rebase_labels();
+
+    // voxels up to two away from a removed voxel are examined when
+    // updating the rag and must fall inside the group box
+    margin = std::max(margin, 2U);
+
+    // count and bound each region in z-slabs
+    unsigned int zsize = get_zsize();
+    unsigned int num_slabs = (num_threads < zsize) ? num_threads : zsize;
+    vector<RegionBoxes> slab_boxes(num_slabs);
+
+    if (num_slabs > 1) {
+        boost::thread_group threads;
+        unsigned int zstart = 0;
+        for (unsigned int i = 0; i < num_slabs; ++i) {
+            unsigned int zend = zstart + zsize / num_slabs + ((i < (zsize % num_slabs)) ? 1 : 0);
+            threads.create_thread(boost::bind(&Stack::find_region_boxes, this,
+                        zstart, zend, boost::ref(slab_boxes[i])));
+            zstart = zend;
+        }
+        threads.join_all();
+    } else if (num_slabs == 1) {
+        find_region_boxes(0, zsize, slab_boxes[0]);
+    }
+
+    RegionBoxes boxes;
+    for (unsigned int i = 0; i < num_slabs; ++i) {
+        if (i == 0) {
+            boxes.swap(slab_boxes[0]);
+            continue;
+        }
+        for (RegionBoxes::iterator iter = slab_boxes[i].begin();
+                iter != slab_boxes[i].end(); ++iter) {
+            RegionBoxes::iterator iter2 = boxes.find(iter->first);
+            if (iter2 == boxes.end()) {
+                boxes.insert(*iter);
+            } else {
+                extend_box(iter2->second, iter->second);
+            }
+        }
+        RegionBoxes().swap(slab_boxes[i]);
+    }
+
+    // dilate the box of each region to be removed
+    unsigned int maxx = get_xsize() - 1; 
+    unsigned int maxy = get_ysize() - 1; 
+    unsigned int maxz = get_zsize() - 1; 
+    unsigned long long min_size = (threshold > 0) ? threshold : 0;
+
+    unordered_set<Label_t> small_regions;
+    vector<RegionBox> groups;
+    for (RegionBoxes::iterator iter = boxes.begin(); iter != boxes.end(); ++iter) {
+        // do not remove small bodies that are in the exclusions set
+        if (!(iter->first) || (iter->second.count >= min_size) ||
+                (exclusions.find(iter->first) != exclusions.end())) {
+            continue;
+        }
+        small_regions.insert(iter->first);
+
+        RegionBox box = iter->second;
+        box.minx = (box.minx > margin) ? (box.minx - margin) : 0;
+        box.miny = (box.miny > margin) ? (box.miny - margin) : 0;
+        box.minz = (box.minz > margin) ? (box.minz - margin) : 0;
+        box.maxx = std::min(box.maxx + margin, maxx);
+        box.maxy = std::min(box.maxy + margin, maxy);
+        box.maxz = std::min(box.maxz + margin, maxz);
+        groups.push_back(box);
+    }
+    int num_removed = small_regions.size();
+    
+    // regions whose boxes overlap are grown together and the largest
+    // groups are started first
+    merge_overlapping_boxes(groups);
+    std::sort(groups.begin(), groups.end(), box_volume_greater);
+
+    // features can only be updated with the predictions they were
+    // computed from; otherwise the rag is discarded
+    bool update_features = feature_manager &&
+        (prob_list.size() == feature_manager->get_num_channels());
+    if (rag && feature_manager && !update_features) {
+        rag = RagPtr();
+    }
+
+    unsigned int num_workers = std::min(size_t(num_threads), groups.size());
+    vector<RagDelta> deltas(rag ? num_workers : 0);
+    for (unsigned int i = 0; i < deltas.size(); ++i) {
+        deltas[i].track_features = update_features;
+    }
+
+    if (num_workers > 1) {
+        boost::thread_group threads;
+        for (unsigned int i = 0; i < num_workers; ++i) {
+            threads.create_thread(boost::bind(&Stack::absorb_region_groups, this,
+                        boundary_pred, boost::cref(groups), boost::cref(small_regions),
+                        i, num_workers, rag ? &deltas[i] : 0));
+        }
+        threads.join_all();
+    } else if (num_workers == 1) {
+        absorb_region_groups(boundary_pred, groups, small_regions,
+                0, 1, rag ? &deltas[0] : 0);
+    }
+
+    if (rag) {
+        for (unsigned int i = 0; i < deltas.size(); ++i) {
+            apply_rag_delta(deltas[i]);
+        }
+
+        // remove the nodes of absorbed regions
+        for (unordered_set<Label_t>::iterator iter = small_regions.begin();
+                iter != small_regions.end(); ++iter) {
+            RagNode_t* node = rag->find_rag_node(*iter);
+            if (!node || node->get_size()) {
+                continue;
+            }
+            if (feature_manager) {
+                for (RagNode_t::edge_iterator edge_iter = node->edge_begin();
+                        edge_iter != node->edge_end(); ++edge_iter) {
+                    feature_manager->remove_edge(*edge_iter);
+                }
+                feature_manager->remove_node(node);
+            }
+            rag->remove_rag_node(node);
+        }
+    }
+
+    return num_removed;
+}
+
+void Stack::find_region_boxes(unsigned int zstart, unsigned int zend,
+        RegionBoxes& boxes)
+{
+    RegionBox* box = 0;
+    Label_t last_label = 0;
+
+    for (unsigned int z = zstart; z < zend; ++z) {
+        for (unsigned int y = 0; y < get_ysize(); ++y) {
+            for (unsigned int x = 0; x < get_xsize(); ++x) {
+                Label_t label = (*labelvol)(x,y,z); 
+                
+                // consecutive voxels usually share a label
+                if (!box || (label != last_label)) {
+                    RegionBoxes::iterator iter = boxes.find(label);
+                    if (iter == boxes.end()) {
+                        RegionBox new_box = {0, x, y, z, x, y, z};
+                        iter = boxes.insert(std::make_pair(label, new_box)).first;
+                    }
+                    box = &(iter->second);
+                    last_label = label;
+                }
+
+                ++(box->count);
+                box->minx = std::min(box->minx, x);
+                box->miny = std::min(box->miny, y);
+                box->minz = std::min(box->minz, z);
+                box->maxx = std::max(box->maxx, x);
+                box->maxy = std::max(box->maxy, y);
+                box->maxz = std::max(box->maxz, z);
+            }
+        }
+    }
+}
+
+void Stack::absorb_region_groups(VolumeProbPtr boundary_pred,
+        const vector<RegionBox>& groups, const unordered_set<Label_t>& small_regions,
+        unsigned int start, unsigned int stride, RagDelta* delta)
+{
+    unsigned int maxx = get_xsize() - 1; 
+    unsigned int maxy = get_ysize() - 1; 
+    unsigned int maxz = get_zsize() - 1; 
+
+    for (size_t g = start; g < groups.size(); g += stride) {
+        const RegionBox& box = groups[g];
+        vigra::MultiArrayShape<3>::type shape(box.maxx - box.minx + 1,
+                box.maxy - box.miny + 1, box.maxz - box.minz + 1);
+
+        // copy the box with labels renumbered from 1 so that the watershed
+        // only keeps statistics for the labels in the box
+        vigra::MultiArray<3, Label_t> old_labels(shape);
+        vector<Label_t> box_labels(1, 0);
+        vector<bool> small_ids(1, false);
+        unordered_map<Label_t, Label_t> box_ids;
+        vector<Location> removed;
+
+        Label_t last_label = 0;
+        Label_t last_id = 0;
+        for (unsigned int z = 0; z < shape[2]; ++z) {
+            for (unsigned int y = 0; y < shape[1]; ++y) {
+                for (unsigned int x = 0; x < shape[0]; ++x) {
+                    Label_t label = (*labelvol)(box.minx + x, box.miny + y, box.minz + z);
+                    if (label != last_label) {
+                        Label_t& id = box_ids[label];
+                        if (!id && label) {
+                            id = box_labels.size();
+                            box_labels.push_back(label);
+                            small_ids.push_back(small_regions.find(label) != small_regions.end());
+                        }
+                        last_label = label;
+                        last_id = id;
+                    }
+                    old_labels(x,y,z) = last_id;
+                    if (small_ids[last_id]) {
+                        removed.push_back(Location(x,y,z));
+                    }
+                }
+            }
+        }
+
+        vigra::MultiArray<3, Label_t> new_labels(old_labels);
+        for (size_t i = 0; i < removed.size(); ++i) {
+            new_labels(boost::get<0>(removed[i]), boost::get<1>(removed[i]),
+                    boost::get<2>(removed[i])) = 0;
+        }
+
+        // if a boundary volume is provided, perform a seeded watershed
+        if (boundary_pred) {
+            vigra::MultiArray<3, Prob_t> box_pred(shape);
+            for (unsigned int z = 0; z < shape[2]; ++z) {
+                for (unsigned int y = 0; y < shape[1]; ++y) {
+                    for (unsigned int x = 0; x < shape[0]; ++x) {
+                        box_pred(x,y,z) = (*boundary_pred)(box.minx + x,
+                                box.miny + y, box.minz + z);
+                    }
+                }
+            }
+
+            vigra::ArrayOfRegionStatistics<vigra::SeedRgDirectValueFunctor<double> > stats;
+            vigra::seededRegionGrowing3D(srcMultiArrayRange(box_pred), destMultiArray(new_labels),
+                    destMultiArray(new_labels), stats);
+           
+            // only the removed regions are filled in
+            vigra::MultiArray<3, Label_t>::iterator old_iter = old_labels.begin();
+            vigra::MultiArray<3, Label_t>::iterator new_iter = new_labels.begin();
+            for (; old_iter != old_labels.end(); ++old_iter, ++new_iter) {
+                if (!(*old_iter)) {
+                    *new_iter = 0;
+                }
+            }
+        }
+
+        // the box does not overlap other groups so it can be written directly
+        for (size_t i = 0; i < removed.size(); ++i) {
+            unsigned int x = boost::get<0>(removed[i]);
+            unsigned int y = boost::get<1>(removed[i]);
+            unsigned int z = boost::get<2>(removed[i]);
+            labelvol->set(box.minx + x, box.miny + y, box.minz + z,
+                    box_labels[new_labels(x,y,z)]);
+        }
+
+        if (!delta) {
+            continue;
+        }
+
+        // the rag contribution of a voxel (see 'build_rag_slab') depends on
+        // its label and its neighbors' labels so only voxels next to a
+        // relabeled voxel change; the margin keeps them inside the box
+        vigra::MultiArray<3, unsigned char> affected(shape);
+        for (size_t i = 0; i < removed.size(); ++i) {
+            for (int n = 0; n < 7; ++n) {
+                int x = int(boost::get<0>(removed[i])) + ((n == 1) ? -1 : ((n == 2) ? 1 : 0));
+                int y = int(boost::get<1>(removed[i])) + ((n == 3) ? -1 : ((n == 4) ? 1 : 0));
+                int z = int(boost::get<2>(removed[i])) + ((n == 5) ? -1 : ((n == 6) ? 1 : 0));
+                if ((x < 0) || (y < 0) || (z < 0) || (x >= shape[0]) ||
+                        (y >= shape[1]) || (z >= shape[2]) || affected(x,y,z)) {
+                    continue;
+                }
+                affected(x,y,z) = 1;
+
+                // remove the old contribution and add the new one
+                Label_t pass_labels[2];
+                Label_t pass_neighbors[2][6];
+                int pass_num_neighbors[2];
+                for (int pass = 0; pass < 2; ++pass) {
+                    const vigra::MultiArray<3, Label_t>& labels = pass ? new_labels : old_labels;
+                    long long sign = pass ? 1 : -1;
+
+                    Label_t id = labels(x,y,z);
+                    pass_labels[pass] = id ? box_labels[id] : 0;
+                    pass_num_neighbors[pass] = 0;
+                    if (!id) {
+                        continue;
+                    }
+                    Label_t label = box_labels[id];
+                    delta->node_sizes[label] += sign;
+
+                    Label_t neighbors[6];
+                    neighbors[0] = (box.minx + x > 0) ? labels(x-1,y,z) : 0;
+                    neighbors[1] = (box.minx + x < maxx) ? labels(x+1,y,z) : 0;
+                    neighbors[2] = (box.miny + y > 0) ? labels(x,y-1,z) : 0;
+                    neighbors[3] = (box.miny + y < maxy) ? labels(x,y+1,z) : 0;
+                    neighbors[4] = (box.minz + z > 0) ? labels(x,y,z-1) : 0;
+                    neighbors[5] = (box.minz + z < maxz) ? labels(x,y,z+1) : 0;
+
+                    bool on_boundary = false;
+                    for (int j = 0; j < 6; ++j) {
+                        if (!neighbors[j]) {
+                            on_boundary = true;
+                            continue;
+                        }
+                        if (neighbors[j] == id) {
+                            continue;
+                        }
+
+                        // each distinct neighboring label counts once
+                        bool found = false;
+                        for (int k = 0; k < j; ++k) {
+                            if (neighbors[k] == neighbors[j]) {
+                                found = true;
+                            }
+                        }
+                        if (!found) {
+                            delta->edge_sizes[OrderedPair(label,
+                                    box_labels[neighbors[j]])] += sign;
+                            pass_neighbors[pass][pass_num_neighbors[pass]++] =
+                                box_labels[neighbors[j]];
+                        }
+                    }
+                    if (on_boundary) {
+                        delta->boundary_sizes[label] += sign;
+                    }
+                }
+
+                // features only accumulate, so the voxel is added to the
+                // node and edges it newly contributes to; contributions
+                // that are lost only involve removed regions, whose nodes
+                // and edges are deleted
+                if (!(delta->track_features) || !pass_labels[1]) {
+                    continue;
+                }
+                Location location(box.minx + x, box.miny + y, box.minz + z);
+                bool same_label = (pass_labels[0] == pass_labels[1]);
+                if (!same_label) {
+                    delta->node_voxels.push_back(std::make_pair(pass_labels[1], location));
+                }
+                for (int j = 0; j < pass_num_neighbors[1]; ++j) {
+                    bool found = false;
+                    for (int k = 0; same_label && (k < pass_num_neighbors[0]); ++k) {
+                        if (pass_neighbors[0][k] == pass_neighbors[1][j]) {
+                            found = true;
+                        }
+                    }
+                    if (!found) {
+                        delta->edge_voxels.push_back(std::make_pair(
+                                OrderedPair(pass_labels[1], pass_neighbors[1][j]), location));
+                    }
+                }
+            }
+        }
+    }
+}
+
+void Stack::apply_rag_delta(RagDelta& delta)
+{
+    for (unordered_map<OrderedPair, long long, OrderedPair>::iterator iter =
+            delta.edge_sizes.begin(); iter != delta.edge_sizes.end(); ++iter) {
+        if (!(iter->second)) {
+            continue;
+        }
+        RagNode_t* node1 = rag->find_rag_node(iter->first.region1);
+        RagNode_t* node2 = rag->find_rag_node(iter->first.region2);
+        RagEdge_t* edge = (node1 && node2) ? rag->find_rag_edge(node1, node2) : 0;
+        
+        long long size = iter->second + (edge ? (long long)(edge->get_size()) : 0);
+        if (size > 0) {
+            if (!node1) {
+                node1 = rag->insert_rag_node(iter->first.region1);
+            }
+            if (!node2) {
+                node2 = rag->insert_rag_node(iter->first.region2);
+            }
+            if (!edge) {
+                edge = rag->insert_rag_edge(node1, node2);
+            }
+            edge->set_size(size);
+        } else if (edge) {
+            if (feature_manager) {
+                feature_manager->remove_edge(edge);
+            }
+            rag->remove_rag_edge(edge);
+        }
+    }
+
+    for (unordered_map<Label_t, long long>::iterator iter = delta.node_sizes.begin();
+            iter != delta.node_sizes.end(); ++iter) {
+        RagNode_t* node = rag->find_rag_node(iter->first);
+        if (!node) {
+            node = rag->insert_rag_node(iter->first);
+        }
+        long long size = (long long)(node->get_size()) + iter->second;
+        node->set_size((size > 0) ? size : 0);
+    }
+
+    for (unordered_map<Label_t, long long>::iterator iter = delta.boundary_sizes.begin();
+            iter != delta.boundary_sizes.end(); ++iter) {
+        RagNode_t* node = rag->find_rag_node(iter->first);
+        if (!node) {
+            continue;
+        }
+        long long size = (long long)(node->get_boundary_size()) + iter->second;
+        node->set_boundary_size((size > 0) ? size : 0);
+    }
+
+    if (!feature_manager || !delta.track_features) {
+        return;
+    }
+
+    // add the predictions as 'build_rag_slab' does for each voxel
+    vector<double> predictions(prob_list.size(), 0.0);
+    for (size_t i = 0; i < delta.node_voxels.size(); ++i) {
+        RagNode_t* node = rag->find_rag_node(delta.node_voxels[i].first);
+        if (!node) {
+            continue;
+        }
+        const Location& location = delta.node_voxels[i].second;
+        for (unsigned int j = 0; j < prob_list.size(); ++j) {
+            predictions[j] = (*(prob_list[j]))(boost::get<0>(location),
+                    boost::get<1>(location), boost::get<2>(location));
+        }
+        feature_manager->add_val(predictions, node);
+    }
+    for (size_t i = 0; i < delta.edge_voxels.size(); ++i) {
+        const OrderedPair& pair = delta.edge_voxels[i].first;
+        RagEdge_t* edge = rag->find_rag_edge(pair.region1, pair.region2);
+        if (!edge) {
+            continue;
+        }
+        const Location& location = delta.edge_voxels[i].second;
+        for (unsigned int j = 0; j < prob_list.size(); ++j) {
+            predictions[j] = (*(prob_list[j]))(boost::get<0>(location),
+                    boost::get<1>(location), boost::get<2>(location));
+        }
+        feature_manager->add_val(predictions, edge);
+    }
+}
+
 void Stack::get_gt2segs_map(RagPtr gt_rag, unordered_map<Label_t, vector<Label_t> >& gt2segs)
 {
     gt2segs.clear();
@@ -477,6 +1152,15 @@ void Stack::compute_groundtruth_assignment()
     printf("gt label determined for %d nodes\n", assignment.size());
 }
 
+Label_t Stack::get_groundtruth_assignment(Label_t label) const
+{
+    std::unordered_map<Label_t, Label_t>::const_iterator iter = assignment.find(label);
+    if (iter == assignment.end()) {
+        return 0;
+    }
+    return iter->second;
+}
+
 int Stack::find_edge_label(Label_t label1, Label_t label2)
 {
     int edge_label = 0;
@@ -531,6 +1215,70 @@ void Stack::compute_vi(double& merge, double& split)
     compute_vi(merge, split, label_ranked, gt_ranked);
 }
 
+/*!
+ * Sorts (label, gt label) counts and combines the counts of identical pairs.
+ * \param pair_counts list of pair counts
+*/
+static void reduce_pair_counts(vector<Stack::LabelPairCount>& pair_counts)
+{
+    std::sort(pair_counts.begin(), pair_counts.end());
+    size_t pos = 0;
+    for (size_t i = 0; i < pair_counts.size(); ++i) {
+        if (pos && (pair_counts[pos-1].first == pair_counts[i].first)) {
+            pair_counts[pos-1].second += pair_counts[i].second;
+        } else {
+            pair_counts[pos++] = pair_counts[i];
+        }
+    }
+    pair_counts.resize(pos);
+}
+
+void Stack::count_label_pairs(unsigned int zstart, unsigned int zend,
+        vector<LabelPairCount>& pair_counts)
+{
+    // bound the number of unreduced runs kept before sorting them 
+    const size_t MAX_RUNS = 1 << 20;
+    size_t reduced_size = 0;
+
+    for (unsigned int z = zstart; z < zend; ++z) {
+        for (unsigned int y = 0; y < get_ysize(); ++y) {
+            // voxels along x usually repeat the same pair so count runs
+            Label_t run_label = 0, run_gtlabel = 0;
+            unsigned long long run_length = 0;
+
+            for (unsigned int x = 0; x < get_xsize(); ++x) {
+                Label_t wlabel = (*labelvol)(x,y,z);
+                Label_t glabel = (*gt_labelvol)(x,y,z);
+
+                if (!wlabel || !glabel) {
+                    continue;
+                }
+                if (run_length && (wlabel == run_label) && (glabel == run_gtlabel)) {
+                    ++run_length;
+                    continue;
+                }
+                if (run_length) {
+                    pair_counts.push_back(LabelPairCount(
+                                std::make_pair(run_label, run_gtlabel), run_length));
+                }
+                run_label = wlabel;
+                run_gtlabel = glabel;
+                run_length = 1;
+            }
+            if (run_length) {
+                pair_counts.push_back(LabelPairCount(
+                            std::make_pair(run_label, run_gtlabel), run_length));
+            }
+        }
+
+        if ((pair_counts.size() - reduced_size) > MAX_RUNS) {
+            reduce_pair_counts(pair_counts);
+            reduced_size = pair_counts.size();
+        }
+    }
+    reduce_pair_counts(pair_counts);
+}
+
 void Stack::compute_contingency_table()
 {
     if (!labelvol) {
@@ -542,49 +1290,115 @@ void Stack::compute_contingency_table()
 
     contingency.clear();	
    
-    volume_forXYZ(*labelvol,x,y,z) {
-        Label_t wlabel = (*labelvol)(x,y,z);
-        Label_t glabel = (*gt_labelvol)(x,y,z);
-
-        if (!wlabel || !glabel) {
-            continue;
+    // each slab of z-planes collects its own sorted pair counts
+    unsigned int zsize = get_zsize();
+    unsigned int num_slabs = (num_threads < zsize) ? num_threads : zsize;
+    vector<vector<LabelPairCount> > slab_counts(num_slabs);
+    
+    if (num_slabs > 1) {
+        boost::thread_group threads;
+        unsigned int zstart = 0;
+        for (unsigned int i = 0; i < num_slabs; ++i) {
+            unsigned int zend = zstart + zsize / num_slabs + ((i < (zsize % num_slabs)) ? 1 : 0);
+            threads.create_thread(boost::bind(&Stack::count_label_pairs, this,
+                        zstart, zend, boost::ref(slab_counts[i])));
+            zstart = zend;
         }
-        unordered_map<Label_t, vector<LabelCount> >::iterator mit = 
-                contingency.find(wlabel);
-        if (mit != contingency.end()){
-            vector<LabelCount>& gt_vec = mit->second;
-            int j;
-            for (j=0; j< gt_vec.size(); ++j) {
-                if (gt_vec[j].lbl == glabel){
-                    (gt_vec[j].count)++;
-                    break;
-                }
-            }
-            if (j==gt_vec.size()){
-                LabelCount lc(glabel,1);
-                gt_vec.push_back(lc);	
-            }
-        } else{
-            vector<LabelCount> gt_vec;	
-            gt_vec.push_back(LabelCount(glabel,1));	
-            contingency.insert(make_pair(wlabel, gt_vec));	
+        threads.join_all();
+    } else if (num_slabs == 1) {
+        count_label_pairs(0, zsize, slab_counts[0]);
+    }
+
+    // combine the slabs into one sorted list of unique pairs
+    vector<LabelPairCount> pair_counts;
+    for (unsigned int i = 0; i < num_slabs; ++i) {
+        pair_counts.insert(pair_counts.end(), slab_counts[i].begin(), slab_counts[i].end());
+        vector<LabelPairCount>().swap(slab_counts[i]);
+    }
+    if (num_slabs > 1) {
+        reduce_pair_counts(pair_counts);
+    }
+
+    // pairs are grouped by label so each gt list is built in one pass
+    vector<LabelCount>* gt_vec = 0;
+    Label_t current_label = 0;
+    for (size_t i = 0; i < pair_counts.size(); ++i) {
+        Label_t wlabel = pair_counts[i].first.first;
+        if (!gt_vec || (wlabel != current_label)) {
+            gt_vec = &(contingency[wlabel]);
+            current_label = wlabel;
         }
-    }		
+        gt_vec->push_back(LabelCount(pair_counts[i].first.second, pair_counts[i].second));
+    }
 }
 
 
 void Stack::determine_edge_locations(EdgeCount& best_edge_z,
         EdgeLoc& best_edge_loc, bool use_probs)
+{
+    // give every edge a dense index so per-plane counts can be kept in arrays
+    vector<RagEdge_t*> edges;
+    EdgeIndex edge_index;
+    for (Rag_t::edges_iterator iter = rag->edges_begin(); iter != rag->edges_end(); ++iter) {
+        edge_index[OrderedPair((*iter)->get_node1()->get_node_id(),
+                (*iter)->get_node2()->get_node_id())] = edges.size();
+        edges.push_back(*iter);
+    }
+
+    // z-slabs are examined concurrently and fold the counts of each
+    // plane into the best counts shared by all slabs
+    unsigned int zsize = get_zsize();
+    unsigned int num_slabs = (num_threads < zsize) ? num_threads : zsize;
+    vector<double> best_counts(edges.size(), 0.0);
+    vector<Location> best_locs(edges.size(), Location(0,0,0));
+    boost::mutex best_mutex;
+
+    if (num_slabs > 1) {
+        boost::thread_group threads;
+        unsigned int zstart = 0;
+        for (unsigned int i = 0; i < num_slabs; ++i) {
+            unsigned int zend = zstart + zsize / num_slabs + ((i < (zsize % num_slabs)) ? 1 : 0);
+            threads.create_thread(boost::bind(&Stack::find_edge_locations_slab, this,
+                        zstart, zend, use_probs, boost::cref(edge_index),
+                        boost::ref(best_counts), boost::ref(best_locs),
+                        boost::ref(best_mutex)));
+            zstart = zend;
+        }
+        threads.join_all();
+    } else if (num_slabs == 1) {
+        find_edge_locations_slab(0, zsize, use_probs, edge_index,
+                best_counts, best_locs, best_mutex);
+    }
+
+    for (unsigned int id = 0; id < edges.size(); ++id) {
+        if (best_counts[id] > 0.0) {
+            best_edge_z[edges[id]] = best_counts[id];
+            best_edge_loc[edges[id]] = best_locs[id];
+        }
+    }
+}
+
+void Stack::find_edge_locations_slab(unsigned int zstart, unsigned int zend,
+        bool use_probs, const EdgeIndex& edge_index, vector<double>& best_counts,
+        vector<Location>& best_locs, boost::mutex& best_mutex)
 {
     unsigned int maxx = get_xsize() - 1; 
     unsigned int maxy = get_ysize() - 1; 
     unsigned int maxz = get_zsize() - 1; 
 
+    // counts of the current plane, reset through the touched list
+    size_t num_edges = edge_index.size();
+    vector<double> curr_counts(num_edges, 0.0);
+    vector<Location> curr_locs(num_edges);
+    vector<char> touched(num_edges, 0);
+    vector<unsigned int> touched_edges;
+
+    // neighboring voxels usually see the same edge so remember the last one
+    Label_t last_label1 = 0, last_label2 = 0;
+    int last_id = -1;
+
     // find z plane with the most edge points or edge probability points
-    for (unsigned int z = 0; z < get_zsize(); ++z) {
-        EdgeCount curr_edge_z;
-        EdgeLoc curr_edge_loc;
-        
+    for (unsigned int z = zstart; z < zend; ++z) {
         for (unsigned int y = 0; y < get_ysize(); ++y) {
             for (unsigned int x = 0; x < get_xsize(); ++x) {
                 Label_t label = (*labelvol)(x,y,z); 
@@ -592,14 +1406,13 @@ void Stack::determine_edge_locations(EdgeCount& best_edge_z,
                     continue;
                 }
 
-                Label_t label2 = 0, label3 = 0, label4 = 0, label5 = 0, label6 = 0, label7 = 0;
-                if (x > 0) label2 = (*labelvol)(x-1,y,z);
-                if (x < maxx) label3 = (*labelvol)(x+1,y,z);
-                if (y > 0) label4 = (*labelvol)(x,y-1,z);
-                if (y < maxy) label5 = (*labelvol)(x,y+1,z);
-                if (z > 0) label6 = (*labelvol)(x,y,z-1);
-                if (z < maxz) label7 = (*labelvol)(x,y,z+1);
-
+                Label_t neighbors[6] = {0, 0, 0, 0, 0, 0};
+                if (x > 0) neighbors[0] = (*labelvol)(x-1,y,z);
+                if (x < maxx) neighbors[1] = (*labelvol)(x+1,y,z);
+                if (y > 0) neighbors[2] = (*labelvol)(x,y-1,z);
+                if (y < maxy) neighbors[3] = (*labelvol)(x,y+1,z);
+                if (z > 0) neighbors[4] = (*labelvol)(x,y,z-1);
+                if (z < maxz) neighbors[5] = (*labelvol)(x,y,z+1);
 
                 double incr = 1.0;
                 if (use_probs) {
@@ -607,49 +1420,55 @@ void Stack::determine_edge_locations(EdgeCount& best_edge_z,
                     incr = 1.0 - (*(prob_list[0]))(x,y,z);;
                 }
 
-                if (label2 && (label != label2)) {
-                    RagEdge_t* edge = rag->find_rag_edge(label, label2);
-                    curr_edge_z[edge] += incr;  
-                    curr_edge_loc[edge] = Location(x,y,z);  
-                }
-                if (label3 && (label != label3)) {
-                    RagEdge_t* edge = rag->find_rag_edge(label, label3);
-                    curr_edge_z[edge] += incr;  
-                    curr_edge_loc[edge] = Location(x,y,z);  
-                }
-                if (label4 && (label != label4)) {
-                    RagEdge_t* edge = rag->find_rag_edge(label, label4);
-                    curr_edge_z[edge] += incr;  
-                    curr_edge_loc[edge] = Location(x,y,z);  
-                }
-                if (label5 && (label != label5)) {
-                    RagEdge_t* edge = rag->find_rag_edge(label, label5);
-                    curr_edge_z[edge] += incr;  
-                    curr_edge_loc[edge] = Location(x,y,z);  
-                }
-                if (label6 && (label != label6)) {
-                    RagEdge_t* edge = rag->find_rag_edge(label, label6);
-                    curr_edge_z[edge] += incr;  
-                    curr_edge_loc[edge] = Location(x,y,z);  
-                }
-                if (label7 && (label != label7)) {
-                    RagEdge_t* edge = rag->find_rag_edge(label, label7);
-                    curr_edge_z[edge] += incr; 
-                    curr_edge_loc[edge] = Location(x,y,z);  
+                for (int n = 0; n < 6; ++n) {
+                    Label_t label2 = neighbors[n];
+                    if (!label2 || (label == label2)) {
+                        continue;
+                    }
+
+                    if ((label != last_label1) || (label2 != last_label2)) {
+                        EdgeIndex::const_iterator iter =
+                            edge_index.find(OrderedPair(label, label2));
+                        last_id = (iter != edge_index.end()) ? int(iter->second) : -1;
+                        last_label1 = label;
+                        last_label2 = label2;
+                    }
+                    if (last_id < 0) {
+                        continue;
+                    }
+
+                    if (!touched[last_id]) {
+                        touched[last_id] = 1;
+                        touched_edges.push_back(last_id);
+                    }
+                    curr_counts[last_id] += incr;  
+                    curr_locs[last_id] = Location(x,y,z);  
                 }
-
             }
         }
-    
-        for (EdgeCount::iterator iter = curr_edge_z.begin(); iter != curr_edge_z.end(); ++iter) {
-            if (iter->second > best_edge_z[iter->first]) {
-                best_edge_z[iter->first] = iter->second;
-                best_edge_loc[iter->first] = curr_edge_loc[iter->first];
+   
+        // keep the plane if it is better than the planes seen by all
+        // slabs; lower planes win ties as in a single pass over z
+        {
+            boost::mutex::scoped_lock scoped_lock(best_mutex);
+            for (unsigned int i = 0; i < touched_edges.size(); ++i) {
+                unsigned int id = touched_edges[i];
+                double count = curr_counts[id];
+                if ((count > best_counts[id]) || ((count > 0.0) &&
+                            (count == best_counts[id]) &&
+                            (z < boost::get<2>(best_locs[id])))) {
+                    best_counts[id] = count;
+                    best_locs[id] = curr_locs[id];
+                }
             }
         }
+        for (unsigned int i = 0; i < touched_edges.size(); ++i) {
+            unsigned int id = touched_edges[i];
+            curr_counts[id] = 0.0;
+            touched[id] = 0;
+        }
+        touched_edges.clear();
     }
-
-    return;
 }
 
 void Stack::compute_vi(double& merge, double& split, 
@@ -796,6 +1615,28 @@ void Stack::merge_labels(Label_t label_remove, Label_t label_keep,
     labelvol->reassign_label(label_remove, label_keep); 
 }
 
+void Stack::collapse_labels(Label_t label_keep, vector<Label_t>& labels_remove,
+        RagNodeCombineAlg* combine_alg)
+{
+    // might be unnecessary, does nothing without ground truth
+    for (unsigned int i = 0; i < labels_remove.size(); ++i) {
+        update_assignment(labels_remove[i], label_keep);
+    }
+
+    if (rag) {
+        vector<RagNode_t*> nodes_remove;
+        for (unsigned int i = 0; i < labels_remove.size(); ++i) {
+            nodes_remove.push_back(rag->find_rag_node(labels_remove[i]));
+        }
+        rag_collapse_nodes(*rag, rag->find_rag_node(label_keep),
+                nodes_remove, combine_alg);
+    }
+
+    for (unsigned int i = 0; i < labels_remove.size(); ++i) {
+        labelvol->reassign_label(labels_remove[i], label_keep); 
+    }
+}
+
 VolumeLabelPtr Stack::generate_boundary(VolumeLabelPtr labelvolh)
 {
     VolumeLabelPtr labelvol_new = VolumeLabelData::create_volume();
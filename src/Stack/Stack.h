@@ -17,9 +17,11 @@
 #define STACK_H
 
 #include "StackBase.h"
+#include <Utilities/AffinityPair.h>
 
 // used to represent x,y,z locations
 #include <boost/tuple/tuple.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include <unordered_set>
 #include <unordered_map>
@@ -35,6 +37,47 @@ namespace NeuroProof {
 // forward declare algorithm class for combining rag nodes
 class RagNodeCombineAlg;
 
+/*!
+ * Interface for reading a label volume and its prediction channels
+ * one range of z-planes at a time.  Used by 'Stack::build_rag_stream'
+ * to build a RAG without holding the entire volume in memory.  This
+ * only covers the RAG build; it does not make stacks larger than
+ * memory usable since the other stack operations need whole volumes.
+*/
+class StackChunkReader {
+  public:
+    virtual ~StackChunkReader() {}
+
+    /*!
+     * Number of z-planes in the volume.
+     * \return z size
+    */
+    virtual unsigned int get_zsize() = 0;
+
+    /*!
+     * Number of prediction channels available.
+     * \return number of channels
+    */
+    virtual unsigned int get_num_channels() = 0;
+
+    /*!
+     * Read the labels in z-planes [zstart, zend).
+     * \param zstart first z-plane
+     * \param zend one past the last z-plane
+     * \return label volume for the chunk
+    */
+    virtual VolumeLabelPtr read_labels(unsigned int zstart, unsigned int zend) = 0;
+
+    /*!
+     * Read every prediction channel in z-planes [zstart, zend).
+     * \param zstart first z-plane
+     * \param zend one past the last z-plane
+     * \return prediction volume for each channel
+    */
+    virtual std::vector<VolumeProbPtr> read_predictions(unsigned int zstart,
+            unsigned int zend) = 0;
+};
+
 /*!
  * Class that contains functionality for manipulating and analyzing
  * the Stack model. 
@@ -45,15 +88,52 @@ class Stack : public StackBase {
      * Constructor that keeps a pointer to the main segmentation stack
      * \param stack_ Stack
     */
-    Stack(VolumeLabelPtr labels_) : StackBase(labels_) {}
+    Stack(VolumeLabelPtr labels_) : StackBase(labels_), num_threads(1) {}
 
     /*!
      * Constructs a RAG by interating through the 3D label volume and looking
      * at voxels 6 neighbors.  While building a RAG, features are constructed
-     * from the probability volumes in the stack.
+     * from the probability volumes in the stack.  If more than one thread
+     * is specified, the volume is split into z-slabs that are processed
+     * concurrently and then combined into a single RAG.
     */
     virtual void build_rag();
 
+    /*!
+     * Constructs a RAG like 'build_rag' but reads the volume in chunks of
+     * z-planes so that only one chunk (and the planes bordering it) is in
+     * memory at a time.  Nodes, edges, and features are accumulated chunk
+     * by chunk; each chunk is split into z-slabs that are processed
+     * concurrently (see 'set_num_threads').  Labels are taken from the
+     * stack label volume if one is set; otherwise they are read from the
+     * reader too.  The prediction list of the stack is not modified.
+     * Only the peak memory of the RAG build is reduced: operations that
+     * use the stack volumes afterwards (merging, small body removal, edge
+     * locations, and writing the labels) still need them in memory, so
+     * the label volume must fit in memory.
+     * \param reader source of label and prediction chunks
+     * \param chunk_depth number of z-planes processed at a time
+    */
+    virtual void build_rag_stream(StackChunkReader& reader, unsigned int chunk_depth);
+
+    /*!
+     * Set the number of threads used when building the RAG.
+     * \param num_threads_ number of threads (1 is single-threaded)
+    */
+    void set_num_threads(unsigned int num_threads_)
+    {
+        num_threads = num_threads_ ? num_threads_ : 1;
+    }
+
+    /*!
+     * Retrieve the number of threads used when building the RAG.
+     * \return number of threads
+    */
+    unsigned int get_num_threads() const
+    {
+        return num_threads;
+    }
+
     /*!
      * Constructs a RAG by interating through the 3D label volume and looking
      * at voxels 6 neighbors.  This command is expected to operate on only a subset
@@ -61,6 +141,16 @@ class Stack : public StackBase {
     */
     void build_rag_batch();
 
+    /*!
+     * Adds the voxels in z-planes [zstart, zend) to the RAG like
+     * 'build_rag_batch' (a RAG is created if there is none).  Only
+     * planes up to and including zend are read, so the RAG can be built
+     * while later planes of the label volume are still being filled.
+     * \param zstart first z-plane
+     * \param zend one past the last z-plane
+    */
+    void build_rag_batch(unsigned int zstart, unsigned int zend);
+
     /*!
      * Finds bi-connected components in the RAG (that are not connected to the
      * boundary of the volume) and removes them.  This function modifies the
@@ -80,6 +170,17 @@ class Stack : public StackBase {
     void merge_labels(Label_t label_remove, Label_t label_keep,
             RagNodeCombineAlg* combine_alg, bool ignore_rag = false);
 
+    /*!
+     * Moves a set of labels to label_keep in one step.  The rag nodes
+     * are collapsed together so that sizes and features are combined
+     * once rather than after each intermediate merge.
+     * \param label_keep label to be kept
+     * \param labels_remove labels to be removed
+     * \param combine_alg rag merging algorithm
+    */
+    void collapse_labels(Label_t label_keep, std::vector<Label_t>& labels_remove,
+            RagNodeCombineAlg* combine_alg);
+
     /*!
      * Algorithms to absorb small regions by first removing them and then
      * calling a seeded watershed to fill in this empty regions.  The size
@@ -92,6 +193,32 @@ class Stack : public StackBase {
     */
     int absorb_small_regions(VolumeProbPtr boundary_pred, int threshold,
                     std::unordered_set<Label_t>& exclusions);
+
+    /*!
+     * Localized version of 'absorb_small_regions'.  The seeded watershed
+     * is only run inside the bounding box of each removed region dilated
+     * by a margin.  Removed regions whose boxes overlap are grown
+     * together and groups that do not overlap are grown concurrently
+     * (see 'set_num_threads').  Unlike 'absorb_small_regions', voxels
+     * with label 0 that are not part of a removed region are left
+     * unchanged, so both give the same labels only for volumes without
+     * 0 voxels.  If a rag exists, it is updated in place: the nodes of
+     * removed regions are deleted and the contributions of the relabeled
+     * voxels to the sizes and features of the other nodes and edges are
+     * updated.  The result only matches a rag rebuilt from the new labels
+     * if the rag matched the labels before, i.e., it was built and not
+     * agglomerated since (merged nodes and edges keep sizes, features,
+     * and properties combined by 'rag_join_nodes').  Features are updated
+     * from the stack prediction list; if it does not match the feature
+     * manager channels, the rag is discarded as in 'absorb_small_regions'.
+     * \param boundary_pred probability volume corresponding to boundary
+     * \param threshold size below which labels are removed
+     * \param exclusions hash of of labels to not be removed
+     * \param margin number of voxels around each removed region examined
+     * \return number of regions absorbed
+    */
+    int absorb_small_regions_local(VolumeProbPtr boundary_pred, int threshold,
+                    std::unordered_set<Label_t>& exclusions, unsigned int margin = 2);
     
     /*!
      * Similar to absorb_small_regions except removed regions are assigned a 0
@@ -226,6 +353,15 @@ class Stack : public StackBase {
      * \return -1 if no edge and 1 if edge
     */
     int find_edge_label(Label_t label1, Label_t label2);
+
+    /*!
+     * Retrieves the ground truth label assigned to a label by
+     * 'compute_groundtruth_assignment'.  Labels can be grouped by this
+     * value instead of comparing every pair with 'find_edge_label'.
+     * \param label volume label
+     * \return ground truth label (0 if none)
+    */
+    Label_t get_groundtruth_assignment(Label_t label) const;
     
     /*!
      * Generates an assignment of labels to ground truth using overlap.
@@ -247,9 +383,47 @@ class Stack : public StackBase {
      * \param preds array of features
      * \param increment increment edge count
     */
-    void rag_add_edge(unsigned int id1, unsigned int id2, std::vector<double>& preds,
+    void rag_add_edge(Label_t id1, Label_t id2, std::vector<double>& preds,
             bool increment=true);
 
+    /*!
+     * Add edge to the given rag and update the given feature manager.
+     * \param rag_slab rag to be modified
+     * \param feature_mgr_slab feature manager for rag (can be 0)
+     * \param id1 region1 label id
+     * \param id2 region2 label id
+     * \param preds array of features
+     * \param increment increment edge count
+    */
+    void rag_add_edge(Rag_t& rag_slab, FeatureMgr* feature_mgr_slab,
+            Label_t id1, Label_t id2, std::vector<double>& preds,
+            bool increment=true);
+
+    /*!
+     * Adds the nodes, edges, and features found in z-planes [zstart, zend)
+     * to the given rag and feature manager.  Voxels outside of this range
+     * are still examined as neighbors so that the rags built for adjacent
+     * slabs can be combined without losing any edges.
+     * \param rag_slab rag to be built
+     * \param feature_mgr_slab feature manager for rag (can be 0)
+     * \param zstart first z-plane examined
+     * \param zend one past the last z-plane examined
+    */
+    virtual void build_rag_slab(Rag_t& rag_slab, FeatureMgr* feature_mgr_slab,
+            unsigned int zstart, unsigned int zend);
+
+    /*!
+     * Combines a node from a rag built for a slab with the corresponding
+     * node in the stack rag.  Derived stacks can extend this to combine
+     * any node properties they accumulate in 'build_rag_slab'.
+     * \param node node in the stack rag
+     * \param slab_node node in the slab rag
+    */
+    virtual void merge_slab_node(RagNode_t* node, RagNode_t* slab_node);
+
+    //! number of threads used for building the rag
+    unsigned int num_threads;
+
     //! declaration of typedef for x,y,z location representation
     typedef boost::tuple<unsigned int, unsigned int, unsigned int> Location;
     
@@ -272,6 +446,15 @@ class Stack : public StackBase {
     };
 
   public:
+    //! overlap count of a (label, gt label) pair
+    typedef std::pair<std::pair<Label_t, Label_t>, unsigned long long> LabelPairCount;
+
+    //! voxel count and bounding box (inclusive) of a region
+    struct RegionBox {
+        unsigned long long count;
+        unsigned int minx, miny, minz, maxx, maxy, maxz;
+    };
+
     /*!
      * Support function called by 'serialize_graph_info' to find the
      * ideal point on the edge between two labels for examination.
@@ -285,6 +468,104 @@ class Stack : public StackBase {
         EdgeLoc& best_edge_loc, bool use_probs);
 
   private:
+    /*!
+     * Builds the rag for a range of z-planes by assigning z-slabs of the
+     * range to different threads and combining the resulting partial rags
+     * and features into the stack rag.
+     * \param zstart first z-plane of the range
+     * \param zend z-plane after the last plane of the range
+    */
+    void build_rag_parallel(unsigned int zstart, unsigned int zend);
+
+    /*!
+     * Adds the nodes, edges, and features of a rag built for a slab to
+     * the stack rag.  The feature caches in the slab feature manager
+     * are consumed.
+     * \param rag_slab rag built for a slab
+     * \param feature_mgr_slab feature manager for the slab (can be 0)
+    */
+    void merge_rag_slab(Rag_t& rag_slab, FeatureMgr* feature_mgr_slab);
+
+    //! dense index of each rag edge keyed by the labels it connects
+    typedef std::unordered_map<OrderedPair, unsigned int, OrderedPair> EdgeIndex;
+
+    /*!
+     * Counts the edge voxels of each z-plane in [zstart, zend) and keeps
+     * the count and a location of a plane for each edge if it is larger
+     * than the best count found so far (or equal and in a lower plane).
+     * The best counts and locations are shared by all slabs.
+     * \param zstart first z-plane examined
+     * \param zend one past the last z-plane examined
+     * \param use_probs weight edge voxels by the boundary prediction
+     * \param edge_index dense index of each edge
+     * \param best_counts count for the best plane of each edge (0 if not found)
+     * \param best_locs location in the best plane of each edge
+     * \param best_mutex protects the best counts and locations
+    */
+    void find_edge_locations_slab(unsigned int zstart, unsigned int zend,
+            bool use_probs, const EdgeIndex& edge_index,
+            std::vector<double>& best_counts, std::vector<Location>& best_locs,
+            boost::mutex& best_mutex);
+
+    //! bounding box of each label keyed by label
+    typedef std::unordered_map<Label_t, RegionBox> RegionBoxes;
+
+    /*!
+     * Change in the size of rag nodes and edges caused by relabeling
+     * voxels.  The sizes follow the conventions of 'build_rag_slab'.
+    */
+    struct RagDelta {
+        RagDelta() : track_features(false) {}
+
+        std::unordered_map<Label_t, long long> node_sizes;
+        std::unordered_map<Label_t, long long> boundary_sizes;
+        std::unordered_map<OrderedPair, long long, OrderedPair> edge_sizes;
+
+        //! true if the voxels added to features are recorded
+        bool track_features;
+
+        //! voxels whose predictions are added to the features of a node
+        std::vector<std::pair<Label_t, Location> > node_voxels;
+
+        //! voxels whose predictions are added to the features of an edge
+        std::vector<std::pair<OrderedPair, Location> > edge_voxels;
+    };
+
+    /*!
+     * Finds the voxel count and bounding box of each label in
+     * z-planes [zstart, zend).
+     * \param zstart first z-plane examined
+     * \param zend one past the last z-plane examined
+     * \param boxes bounding box for each label found
+    */
+    void find_region_boxes(unsigned int zstart, unsigned int zend,
+            RegionBoxes& boxes);
+
+    /*!
+     * Removes the small regions inside each group box and fills them
+     * with a seeded watershed over the box.  Groups start, start+stride,
+     * ... are processed.  The group boxes must not overlap.
+     * \param boundary_pred boundary prediction (no watershed if empty)
+     * \param groups boxes of the region groups
+     * \param small_regions labels to be removed
+     * \param start first group processed
+     * \param stride distance between groups processed
+     * \param delta change to the rag (not computed if 0)
+    */
+    void absorb_region_groups(VolumeProbPtr boundary_pred,
+            const std::vector<RegionBox>& groups,
+            const std::unordered_set<Label_t>& small_regions,
+            unsigned int start, unsigned int stride, RagDelta* delta);
+
+    /*!
+     * Updates the rag with node and edge size changes.  Edges whose
+     * size drops to 0 are removed along with their features.  If the
+     * delta tracks features, the predictions of the recorded voxels are
+     * added to the features of their nodes and edges.
+     * \param delta change to the rag
+    */
+    void apply_rag_delta(RagDelta& delta);
+
     /*!
      * Updates the assignment of labels to ground truth labels when
      * two labels have been merged together.  This update should be
@@ -315,9 +596,22 @@ class Stack : public StackBase {
      * Support function called by 'compute_vi' and
      * 'compute_groundtruth_assignment' to produce the contingency table
      * of correspondence between the label volume and the ground truth.
+     * The volume is split into z-slabs that are counted concurrently
+     * (see 'set_num_threads').
     */
     void compute_contingency_table();
 
+    /*!
+     * Counts the overlap of each (label, gt label) pair in z-planes
+     * [zstart, zend).  The result is sorted by pair with one entry
+     * per pair.
+     * \param zstart first z-plane examined
+     * \param zend one past the last z-plane examined
+     * \param pair_counts overlap count for each pair found
+    */
+    void count_label_pairs(unsigned int zstart, unsigned int zend,
+            std::vector<LabelPairCount>& pair_counts);
+
     /*!
      * Contains information on the correspondence between the gt label
      * volume and the original label volume.  This could probably be
@@ -18,6 +18,8 @@
 #include <boost/shared_ptr.hpp>
 #include <vector>
 #include <string>
+#include <memory>
+#include <new>
 #include <Utilities/ErrMsg.h>
 #include <Utilities/Glb.h>
 
@@ -34,6 +36,95 @@ typedef VolumeData<uint8> VolumeGray;
 typedef boost::shared_ptr<VolumeProb> VolumeProbPtr;
 typedef boost::shared_ptr<VolumeGray> VolumeGrayPtr;
 
+/*!
+ * Allocator used by volume data.  It behaves like std::allocator except
+ * that it can be given an existing buffer that is handed out, without
+ * being initialized, for the first allocation of the matching size.
+ * This lets a volume wrap memory owned elsewhere (such as a numpy
+ * array) without a copy.  The owner of the buffer is released when the
+ * volume frees or reshapes its data.  Copies of an allocator whose
+ * buffer is in use allocate normally so that copied volumes get their
+ * own memory.
+*/
+template <typename T>
+class VolumeAllocator : public std::allocator<T> {
+  public:
+    template <typename U>
+    struct rebind {
+        typedef VolumeAllocator<U> other;
+    };
+
+    VolumeAllocator() : buffer(0), buffer_size(0), in_use(false) {}
+
+    /*!
+     * Constructor for an allocator that hands out an existing buffer.
+     * \param buffer_ memory used for the first allocation
+     * \param buffer_size_ number of elements in the buffer
+     * \param owner_ keeps the buffer valid until it is deallocated
+    */
+    VolumeAllocator(T* buffer_, size_t buffer_size_, boost::shared_ptr<void> owner_) :
+        buffer(buffer_), buffer_size(buffer_size_), owner(owner_), in_use(false) {}
+
+    VolumeAllocator(const VolumeAllocator& alloc) : std::allocator<T>(alloc),
+        buffer(alloc.in_use ? 0 : alloc.buffer), buffer_size(alloc.in_use ? 0 : alloc.buffer_size),
+        owner(alloc.in_use ? boost::shared_ptr<void>() : alloc.owner), in_use(false) {}
+
+    template <typename U>
+    VolumeAllocator(const VolumeAllocator<U>& alloc) :
+        buffer(0), buffer_size(0), in_use(false) {}
+
+    VolumeAllocator& operator=(const VolumeAllocator& alloc)
+    {
+        if (!in_use && (this != &alloc)) {
+            buffer = alloc.in_use ? 0 : alloc.buffer;
+            buffer_size = alloc.in_use ? 0 : alloc.buffer_size;
+            owner = alloc.in_use ? boost::shared_ptr<void>() : alloc.owner;
+        }
+        return *this;
+    }
+
+    T* allocate(size_t num, const void* hint = 0)
+    {
+        if (buffer && !in_use && (num == buffer_size)) {
+            in_use = true;
+            return buffer;
+        }
+        return std::allocator<T>::allocate(num);
+    }
+
+    void deallocate(T* ptr, size_t num)
+    {
+        if (in_use && (ptr == buffer)) {
+            buffer = 0;
+            buffer_size = 0;
+            owner.reset();
+            in_use = false;
+            return;
+        }
+        std::allocator<T>::deallocate(ptr, num);
+    }
+
+    void construct(T* ptr, const T& val)
+    {
+        // the contents of a wrapped buffer are kept
+        if (in_use && (ptr >= buffer) && (ptr < (buffer + buffer_size))) {
+            return;
+        }
+        new ((void*) ptr) T(val);
+    }
+
+    void destroy(T* ptr)
+    {
+        ptr->~T();
+    }
+
+  private:
+    T* buffer;
+    size_t buffer_size;
+    boost::shared_ptr<void> owner;
+    bool in_use;
+};
+
 /*!
  * This class defines a 3D volume of any type.  In particular,
  * it inherits properties of multiarray and provides functionality
@@ -43,27 +134,50 @@ typedef boost::shared_ptr<VolumeGray> VolumeGrayPtr;
  * encapsulated in shared pointers.
 */
 template <typename T>
-class VolumeData : public vigra::MultiArray<3, T> {
+class VolumeData : public vigra::MultiArray<3, T, VolumeAllocator<T> > {
   public:
+    typedef vigra::MultiArray<3, T, VolumeAllocator<T> > MultiArray_t;
+
     /*!
      * Static function to create an empty volume data object.
      * \return shared pointer to volume data
     */
     static boost::shared_ptr<VolumeData<T> > create_volume();
     
+    /*!
+     * Static function to create a volume that uses existing memory
+     * instead of a copy.  The memory must hold the volume with x
+     * varying fastest followed by y and then z.
+     * \param data memory holding the volume
+     * \param xsize is x dimension
+     * \param ysize is y dimension
+     * \param zsize is z dimension
+     * \param owner keeps the memory valid for the life of the volume
+     * \return shared pointer to volume data
+    */
+    static boost::shared_ptr<VolumeData<T> > create_volume(T* data,
+            unsigned int xsize, unsigned int ysize, unsigned int zsize,
+            boost::shared_ptr<void> owner);
+    
     /*!
      * Copy constructor to create VolumeData from a multiarray view.  It
      * just needs to call the multiarray constructor with the view.
      * \param view_ view to a multiarray
     */
-    VolumeData(const vigra::MultiArrayView<3, T>& view_) : vigra::MultiArray<3,T>(view_) {}
+    VolumeData(const vigra::MultiArrayView<3, T>& view_) : MultiArray_t(view_) {}
 
   protected:
     /*!
      * Private definition of constructor to prevent stack allocation.
     */
-    VolumeData() : vigra::MultiArray<3,T>() {}
+    VolumeData() : MultiArray_t() {}
     
+    /*!
+     * Private constructor for a volume of the given shape whose memory
+     * comes from the given allocator.
+    */
+    VolumeData(const typename MultiArray_t::difference_type& shape,
+            const VolumeAllocator<T>& alloc) : MultiArray_t(shape, alloc) {}
 };
 
 
@@ -73,6 +187,16 @@ boost::shared_ptr<VolumeData<T> > VolumeData<T>::create_volume()
     return boost::shared_ptr<VolumeData<T> >(new VolumeData<T>); 
 }
 
+template <typename T>
+boost::shared_ptr<VolumeData<T> > VolumeData<T>::create_volume(T* data,
+        unsigned int xsize, unsigned int ysize, unsigned int zsize,
+        boost::shared_ptr<void> owner)
+{
+    VolumeAllocator<T> alloc(data, size_t(xsize) * ysize * zsize, owner);
+    return boost::shared_ptr<VolumeData<T> >(new VolumeData<T>(
+                typename MultiArray_t::difference_type(xsize, ysize, zsize), alloc)); 
+}
+
 // convenience macro for iterating a multiarray and derived classes
 #define volume_forXYZ(volume,x,y,z) \
     for (int z = 0; z < (int)(volume).shape(2); ++z) \
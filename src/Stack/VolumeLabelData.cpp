@@ -1,5 +1,6 @@
 #include "VolumeLabelData.h"
 #include <unordered_set>
+#include <algorithm>
 
 using namespace NeuroProof;
 using std::vector;
@@ -25,17 +26,49 @@ void VolumeLabelData::get_label_history(Label_t label, std::vector<Label_t>& mem
     member_labels = label_remapping_history[label];
 }
 
+void VolumeLabelData::set_mapping(Label_t old_label, Label_t new_label)
+{
+    if (old_label < MAX_TABLE_LABEL) {
+        if (old_label >= label_table.size()) {
+            // grow geometrically, filling new entries with the identity
+            size_t old_size = label_table.size();
+            size_t new_size = std::max(size_t(old_label) + 1, old_size * 2);
+            new_size = std::min(new_size, size_t(MAX_TABLE_LABEL));
+            label_table.resize(new_size);
+            for (size_t i = old_size; i < new_size; ++i) {
+                label_table[i] = Label_t(i);
+            }
+        }
+        label_table[old_label] = new_label;
+    } else if (label_mapping.find(old_label) == label_mapping.end()) {
+        ++num_sparse_mappings;
+    }
+    label_mapping[old_label] = new_label;
+}
+
+void VolumeLabelData::erase_mapping(Label_t label)
+{
+    if (label_mapping.erase(label) == 0) {
+        return;
+    }
+    if (label < label_table.size()) {
+        label_table[label] = label;
+    } else if (label >= MAX_TABLE_LABEL) {
+        --num_sparse_mappings;
+    }
+}
+
 void VolumeLabelData::reassign_label(Label_t old_label, Label_t new_label)
 {
     // do not allow label reassignment unless the stack was originally rebased
     // all stacks are read in rebased anyway so this should never execute
     assert(label_mapping.find(old_label) == label_mapping.end());
 
-    label_mapping[old_label] = new_label;
+    set_mapping(old_label, new_label);
 
     for (std::vector<Label_t>::iterator iter = label_remapping_history[old_label].begin();
             iter != label_remapping_history[old_label].end(); ++iter) {
-        label_mapping[*iter] = new_label;
+        set_mapping(*iter, new_label);
     }
 
     // update the mappings of all labels previously mapped to the
@@ -51,10 +84,10 @@ void VolumeLabelData::split_labels(Label_t curr_label, vector<Label_t>& split_la
 {
     vector<Label_t>::iterator split_iter = split_labels.begin();
     ++split_iter;
-    label_mapping.erase(split_labels[0]);
+    erase_mapping(split_labels[0]);
 
     for (; split_iter != split_labels.end(); ++split_iter) {
-        label_mapping[*split_iter] = split_labels[0];
+        set_mapping(*split_iter, split_labels[0]);
         label_remapping_history[(split_labels[0])].push_back(*split_iter);
     }
 
@@ -78,13 +111,13 @@ void VolumeLabelData::rebase_labels()
     if (!label_mapping.empty()) {
         // linear pass throw entire volume if remappings have occured
         for (VolumeLabelData::iterator iter = this->begin(); iter != this->end(); ++iter) {
-            if (label_mapping.find(*iter) != label_mapping.end()) {
-                *iter = label_mapping[*iter];
-            }
+            *iter = map_label(*iter);
         }
     }
     label_remapping_history.clear();
     label_mapping.clear();
+    label_table.clear();
+    num_sparse_mappings = 0;
 }
 
 
@@ -65,6 +65,14 @@ class VolumeLabelData : public VolumeData<Label_t> {
     {
         return label_mapping.find(label) != label_mapping.end();        
     }
+
+    /*!
+     * Directly set the label that a given label maps to without
+     * updating the label history (used for loading transform tables).
+     * \param old_label label to be replaced
+     * \param new_label new label id to replace old label
+    */
+    void set_mapping(Label_t old_label, Label_t new_label);
  
     /*!
      * Split a given label into two partitons.  This command will not work
@@ -92,7 +100,9 @@ class VolumeLabelData : public VolumeData<Label_t> {
 
     /*!
      * Overrides the () operator defined in multiarray to return a label
-     * taking into account the current label hash.
+     * taking into account the current label mappings.  Mapped labels are
+     * resolved through a flat table indexed by label id; the hash is only
+     * consulted for the rare label ids too large for the table.
      * \param x x location
      * \param y y location
      * \param z z location
@@ -101,8 +111,25 @@ class VolumeLabelData : public VolumeData<Label_t> {
     Label_t operator()(unsigned int x, unsigned int y, unsigned int z)
     {
         Label_t label = VolumeData<Label_t>::operator()(x,y,z);
-        if (label_mapping.find(label) != label_mapping.end()) {
-            label = label_mapping[label];
+        return map_label(label);
+    }
+
+    /*!
+     * Returns the label that the given label currently maps to.
+     * \param label volume label
+     * \return mapped label (label itself if not mapped)
+    */
+    Label_t map_label(Label_t label) const
+    {
+        if (label < label_table.size()) {
+            return label_table[label];
+        }
+        if (num_sparse_mappings > 0) {
+            std::unordered_map<Label_t, Label_t>::const_iterator iter =
+                label_mapping.find(label);
+            if (iter != label_mapping.end()) {
+                return iter->second;
+            }
         }
         return label;
     }
@@ -128,13 +155,33 @@ class VolumeLabelData : public VolumeData<Label_t> {
         return label_mapping;
     }
 
-    //! TODO: Factor out (DANGER) hash table that keeps track of label mappings
-    std::unordered_map<Label_t, Label_t> label_mapping;
   private:
     /*!
      * Private definition of constructor to prevent stack allocation.
     */
-    VolumeLabelData() : VolumeData<Label_t>() {}
+    VolumeLabelData() : VolumeData<Label_t>(), num_sparse_mappings(0) {}
+
+    /*!
+     * Removes the mapping for a given label (if it exists).
+     * \param label volume label
+    */
+    void erase_mapping(Label_t label);
+
+    //! largest label id that will be stored in the flat mapping table
+    static const Label_t MAX_TABLE_LABEL = (1 << 24);
+
+    //! hash table that keeps track of label mappings
+    std::unordered_map<Label_t, Label_t> label_mapping;
+
+    /*!
+     * Flat mapping table mirroring label_mapping for label ids up to
+     * MAX_TABLE_LABEL; unmapped entries map to themselves.  The table
+     * only grows as large as the largest mapped label.
+    */
+    std::vector<Label_t> label_table;
+
+    //! number of mappings whose labels are too large for the flat table
+    size_t num_sparse_mappings;
 
 
     /*!
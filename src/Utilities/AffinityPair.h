@@ -1,6 +1,7 @@
 #ifndef AFFINITYPAIR
 #define AFFINITYPAIR
 
+#include <Utilities/Glb.h>
 #include <boost/functional/hash.hpp>
 #include <unordered_set>
 
@@ -10,7 +11,7 @@ namespace NeuroProof {
 
 struct OrderedPair {
         OrderedPair() {}
-        OrderedPair(unsigned int region1_, unsigned int region2_)
+        OrderedPair(Index_t region1_, Index_t region2_)
         {
             if (region1_ < region2_) {
                 region1 = region1_;
@@ -60,14 +61,14 @@ struct OrderedPair {
             return seed;    
         }
         
-        unsigned int region1;
-        unsigned int region2;
+        Index_t region1;
+        Index_t region2;
 };
 
 
 struct AffinityPair : public OrderedPair {
         AffinityPair() : OrderedPair() {}
-        AffinityPair(unsigned int region1_, unsigned int region2_) : OrderedPair(region1_, region2_) { }
+        AffinityPair(Index_t region1_, Index_t region2_) : OrderedPair(region1_, region2_) { }
 
         bool operator<(const AffinityPair& affinity_pair2) const
         {
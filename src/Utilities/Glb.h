@@ -20,8 +20,13 @@ typedef boost::uint32_t uint32;
 typedef boost::int32_t int32;
 typedef boost::uint64_t uint64;
 
-//! Defines the default size of node indexing used in NeuroProof 
+//! Defines the size of labels and node indexing used in NeuroProof
+//! (64-bit when built with NEUROPROOF_64BIT_LABELS)
+#ifdef NEUROPROOF_64BIT_LABELS
+typedef uint64 Index_t;
+#else
 typedef uint32 Index_t;
+#endif
 
 //! Defines location type used for 3 dimensional datasets
 typedef boost::tuple<uint32, uint32, uint32> Location;
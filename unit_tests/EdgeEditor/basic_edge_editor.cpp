@@ -0,0 +1,143 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE edge_editor_capabilities
+
+#include <boost/test/unit_test.hpp>
+
+#include <EdgeEditor/EdgeEditor.h>
+#include <Rag/Rag.h>
+#include <json/value.h>
+#include <random>
+
+using namespace NeuroProof;
+
+// grid of large bodies with pseudo-random sizes and edge weights
+static Rag_t* create_grid_rag(unsigned int seed)
+{
+    const unsigned int dim = 6;
+    std::mt19937 generator(seed);
+    Rag_t* rag = new Rag_t();
+    for (unsigned int i = 0; i < dim * dim; ++i) {
+        RagNode_t* node = rag->insert_rag_node(i + 1);
+        node->set_size(10000 + generator() % 90000);
+    }
+    for (unsigned int y = 0; y < dim; ++y) {
+        for (unsigned int x = 0; x < dim; ++x) {
+            for (int n = 0; n < 2; ++n) {
+                unsigned int x2 = x + n, y2 = y + 1 - n;
+                if ((x2 >= dim) || (y2 >= dim)) {
+                    continue;
+                }
+                RagEdge_t* edge = rag->insert_rag_edge(
+                        rag->find_rag_node(y * dim + x + 1),
+                        rag->find_rag_node(y2 * dim + x2 + 1));
+                edge->set_weight((generator() % 90 + 5) / 100.0);
+                edge->set_property("location", Location(x, y, n));
+                edge->set_property("edge_size", (unsigned int)(5));
+            }
+        }
+    }
+    return rag;
+}
+
+BOOST_AUTO_TEST_SUITE (edge_editor_simple)
+
+BOOST_AUTO_TEST_CASE (edge_editor_estimate_threads)
+{
+    Rag_t* rag = create_grid_rag(3);
+    Json::Value json_vals;
+    EdgeEditor* editor = new EdgeEditor(*rag, 0.1, 0.9, 0.1, json_vals);
+
+    // body mode and edge mode trials do not depend on the thread count
+    for (int mode = 0; mode < 2; ++mode) {
+        if (mode) {
+            editor->set_edge_mode(0.1, 0.9, 0.1);
+        } else {
+            editor->set_body_mode(25000, 0);
+        }
+
+        editor->estimateWork(24, 1, 11);
+        double mean = editor->get_est_mean();
+        double conf_interval = editor->get_est_conf_interval();
+        BOOST_CHECK(mean > 0.0);
+
+        for (unsigned int num_threads = 2; num_threads <= 4; num_threads += 2) {
+            editor->estimateWork(24, num_threads, 11);
+            BOOST_CHECK(mean == editor->get_est_mean());
+            BOOST_CHECK(conf_interval == editor->get_est_conf_interval());
+        }
+    }
+    delete editor;
+
+    // the trials do not modify the rag
+    Rag_t* rag_orig = create_grid_rag(3);
+    BOOST_CHECK(rag->get_num_regions() == rag_orig->get_num_regions());
+    BOOST_CHECK(rag->get_num_edges() == rag_orig->get_num_edges());
+    for (Rag_t::edges_iterator iter = rag_orig->edges_begin();
+            iter != rag_orig->edges_end(); ++iter) {
+        RagEdge_t* edge = rag->find_rag_edge((*iter)->get_node1()->get_node_id(),
+                (*iter)->get_node2()->get_node_id());
+        BOOST_CHECK(edge && (edge->get_weight() == (*iter)->get_weight()));
+    }
+
+    delete rag_orig;
+    delete rag;
+}
+
+BOOST_AUTO_TEST_CASE (edge_editor_incremental)
+{
+    // randomized sessions of merges, splits, and undos visit the same
+    // edges with and without the incremental mode
+    for (unsigned int seed = 1; seed <= 8; ++seed) {
+        Rag_t* rag = create_grid_rag(seed);
+        Rag_t* rag_incr = create_grid_rag(seed);
+        Json::Value json_vals;
+        EdgeEditor* editor = new EdgeEditor(*rag, 0.1, 0.9, 0.1, json_vals);
+        EdgeEditor* editor_incr = new EdgeEditor(*rag_incr, 0.1, 0.9, 0.1, json_vals);
+        editor_incr->set_incremental_mode(true);
+
+        unsigned int depth = seed % 3;
+        editor->set_body_mode(25000, depth);
+        editor_incr->set_body_mode(25000, depth);
+
+        editor->estimateWork(8, 2, seed);
+        editor_incr->estimateWork(8, 2, seed);
+        BOOST_CHECK(editor->get_est_mean() == editor_incr->get_est_mean());
+
+        std::mt19937 generator(seed);
+        unsigned int num_decisions = 0;
+        unsigned int num_examined = 0;
+        while (!(editor->isFinished())) {
+            BOOST_REQUIRE(!(editor_incr->isFinished()));
+            EdgeEditor::Location location, location_incr;
+            NodePair pair = editor->getTopEdge(location);
+            NodePair pair_incr = editor_incr->getTopEdge(location_incr);
+            BOOST_REQUIRE(boost::get<0>(pair) == boost::get<0>(pair_incr));
+            BOOST_REQUIRE(boost::get<1>(pair) == boost::get<1>(pair_incr));
+            ++num_examined;
+
+            if (num_decisions && ((generator() % 100) < 15)) {
+                BOOST_CHECK(editor->undo());
+                BOOST_CHECK(editor_incr->undo());
+                --num_decisions;
+                continue;
+            }
+
+            RagEdge_t* edge = rag->find_rag_edge(boost::get<0>(pair), boost::get<1>(pair));
+            bool remove = (int(generator() % 100) > int(100 * edge->get_weight()));
+            editor->removeEdge(pair, remove);
+            editor_incr->removeEdge(pair, remove);
+            ++num_decisions;
+        }
+        BOOST_CHECK(editor_incr->isFinished());
+        BOOST_CHECK(num_examined > 0);
+        BOOST_CHECK(rag->get_num_regions() == rag_incr->get_num_regions());
+
+        delete editor_incr;
+        delete editor;
+        delete rag_incr;
+        delete rag;
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
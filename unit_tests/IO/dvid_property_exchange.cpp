@@ -0,0 +1,247 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE dvid_property_exchange
+
+#include <boost/test/unit_test.hpp>
+
+#include <IO/DVIDPropertyExchange.h>
+#include <boost/thread/condition_variable.hpp>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstring>
+
+using namespace NeuroProof;
+using std::vector;
+using std::string;
+
+// properties shared by the mock services as if stored in DVID
+struct MockStore {
+    MockStore() : num_gets(0), num_sets(0), hold_for_failure(false),
+        failure_seen(false) {}
+
+    std::unordered_map<libdvid::VertexID, string> properties;
+    std::unordered_map<libdvid::VertexID, libdvid::VertexID> versions;
+
+    // vertices written by another client before their next write
+    std::unordered_set<libdvid::VertexID> conflicts;
+
+    vector<size_t> batch_sizes;
+    unsigned int num_gets;
+    unsigned int num_sets;
+
+    // reads wait until a service has failed so that the failing worker
+    // gets a batch before the others finish
+    bool hold_for_failure;
+    bool failure_seen;
+    boost::condition_variable failure_cond;
+
+    boost::mutex mutex;
+};
+
+// node service that keeps properties in a store and fails transactions
+// of vertices that were written since they were read
+class MockService {
+  public:
+    MockService(MockStore* store_, int fail_get_ = -1) :
+        store(store_), fail_get(fail_get_), num_gets(0) {}
+
+    void get_properties(string graph_name, vector<libdvid::Vertex> vertices,
+            string key, vector<libdvid::BinaryDataPtr>& properties,
+            libdvid::VertexTransactions& transactions)
+    {
+        BOOST_CHECK(graph_name == "graph");
+        BOOST_CHECK(key == "prop");
+        boost::mutex::scoped_lock lock(store->mutex);
+        if (int(num_gets++) == fail_get) {
+            store->failure_seen = true;
+            store->failure_cond.notify_all();
+            throw ErrMsg("mock service failed");
+        }
+        while (store->hold_for_failure && !(store->failure_seen)) {
+            store->failure_cond.wait(lock);
+        }
+        ++(store->num_gets);
+        store->batch_sizes.push_back(vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            const string& data = store->properties[vertices[i].id];
+            properties.push_back(libdvid::BinaryData::create_binary_data(
+                        data.c_str(), data.length()));
+            transactions[vertices[i].id] = store->versions[vertices[i].id];
+        }
+    }
+
+    void set_properties(string graph_name, vector<libdvid::Vertex>& vertices,
+            string key, vector<libdvid::BinaryDataPtr>& properties,
+            libdvid::VertexTransactions& transactions,
+            vector<libdvid::Vertex>& leftover)
+    {
+        BOOST_REQUIRE(properties.size() == vertices.size());
+
+        boost::mutex::scoped_lock lock(store->mutex);
+        ++(store->num_sets);
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            libdvid::VertexID id = vertices[i].id;
+            if (store->conflicts.erase(id)) {
+                store->properties[id] = encode(decode(store->properties[id]) + 100);
+                ++(store->versions[id]);
+            }
+            if (transactions[id] != store->versions[id]) {
+                leftover.push_back(vertices[i]);
+                continue;
+            }
+            store->properties[id] = properties[i]->get_data();
+            ++(store->versions[id]);
+        }
+    }
+
+    static string encode(double val)
+    {
+        return string((const char*)(&val), sizeof(double));
+    }
+
+    static double decode(const string& data)
+    {
+        double val = 0;
+        if (data.length() == sizeof(double)) {
+            std::memcpy(&val, data.c_str(), sizeof(double));
+        }
+        return val;
+    }
+
+  private:
+    MockStore* store;
+    int fail_get;
+    unsigned int num_gets;
+};
+
+// adds the weight of the vertex to its stored value
+static void add_weight(const libdvid::Vertex& vertex, char* current_property,
+        string& buffer)
+{
+    double val = 0;
+    if (current_property) {
+        std::memcpy(&val, current_property, sizeof(double));
+    }
+    buffer = MockService::encode(val + vertex.weight);
+}
+
+static vector<libdvid::Vertex> create_vertices(unsigned int num_vertices)
+{
+    vector<libdvid::Vertex> vertices;
+    for (unsigned int i = 1; i <= num_vertices; ++i) {
+        vertices.push_back(libdvid::Vertex(i, i));
+    }
+    return vertices;
+}
+
+BOOST_AUTO_TEST_SUITE (dvid_exchange)
+
+BOOST_AUTO_TEST_CASE (dvid_exchange_batches)
+{
+    MockStore store;
+    vector<boost::shared_ptr<MockService> > services;
+    services.push_back(boost::shared_ptr<MockService>(new MockService(&store)));
+    vector<libdvid::Vertex> vertices = create_vertices(25);
+
+    exchange_dvid_properties(services, "graph", "prop", vertices,
+            DVIDPropertyMerge<libdvid::Vertex>::type(&add_weight), 10);
+
+    BOOST_CHECK(store.num_gets == 3);
+    BOOST_CHECK(store.num_sets == 3);
+    BOOST_REQUIRE(store.batch_sizes.size() == 3);
+    BOOST_CHECK(store.batch_sizes[0] == 10);
+    BOOST_CHECK(store.batch_sizes[1] == 10);
+    BOOST_CHECK(store.batch_sizes[2] == 5);
+    for (unsigned int i = 1; i <= 25; ++i) {
+        BOOST_CHECK(MockService::decode(store.properties[i]) == i);
+    }
+
+    // the second exchange merges with the stored values using several workers
+    for (int i = 0; i < 3; ++i) {
+        services.push_back(boost::shared_ptr<MockService>(new MockService(&store)));
+    }
+    store.batch_sizes.clear();
+    exchange_dvid_properties(services, "graph", "prop", vertices,
+            DVIDPropertyMerge<libdvid::Vertex>::type(&add_weight), 4);
+
+    BOOST_CHECK(store.batch_sizes.size() == 7);
+    size_t num_read = 0;
+    for (size_t i = 0; i < store.batch_sizes.size(); ++i) {
+        BOOST_CHECK(store.batch_sizes[i] <= 4);
+        num_read += store.batch_sizes[i];
+    }
+    BOOST_CHECK(num_read == 25);
+    for (unsigned int i = 1; i <= 25; ++i) {
+        BOOST_CHECK(MockService::decode(store.properties[i]) == 2 * i);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (dvid_exchange_leftover)
+{
+    MockStore store;
+    vector<boost::shared_ptr<MockService> > services;
+    for (int i = 0; i < 2; ++i) {
+        services.push_back(boost::shared_ptr<MockService>(new MockService(&store)));
+    }
+    vector<libdvid::Vertex> vertices = create_vertices(20);
+    store.conflicts.insert(3);
+    store.conflicts.insert(4);
+    store.conflicts.insert(17);
+
+    exchange_dvid_properties(services, "graph", "prop", vertices,
+            DVIDPropertyMerge<libdvid::Vertex>::type(&add_weight), 5);
+
+    // only the vertices whose transaction failed are read again
+    BOOST_CHECK(store.num_gets == 6);
+    BOOST_CHECK(store.num_sets == 6);
+    size_t num_read = 0;
+    for (size_t i = 0; i < store.batch_sizes.size(); ++i) {
+        num_read += store.batch_sizes[i];
+    }
+    BOOST_CHECK(num_read == 23);
+
+    // the values written by the other client are merged, not overwritten
+    for (unsigned int i = 1; i <= 20; ++i) {
+        double expected = i;
+        if ((i == 3) || (i == 4) || (i == 17)) {
+            expected += 100;
+        }
+        BOOST_CHECK(MockService::decode(store.properties[i]) == expected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (dvid_exchange_failure)
+{
+    MockStore store;
+    vector<boost::shared_ptr<MockService> > services;
+    services.push_back(boost::shared_ptr<MockService>(new MockService(&store)));
+    services.push_back(boost::shared_ptr<MockService>(new MockService(&store, 0)));
+    services.push_back(boost::shared_ptr<MockService>(new MockService(&store)));
+    vector<libdvid::Vertex> vertices = create_vertices(200);
+    store.hold_for_failure = true;
+
+    bool failed = false;
+    try {
+        exchange_dvid_properties(services, "graph", "prop", vertices,
+                DVIDPropertyMerge<libdvid::Vertex>::type(&add_weight), 2);
+    } catch (ErrMsg& err) {
+        failed = true;
+        BOOST_CHECK(err.str.find("mock service failed") != string::npos);
+    }
+    BOOST_CHECK(failed);
+    store.hold_for_failure = false;
+
+    // nothing is written when the only worker fails on its first batch
+    services.clear();
+    services.push_back(boost::shared_ptr<MockService>(new MockService(&store, 0)));
+    store.batch_sizes.clear();
+    BOOST_CHECK_THROW(exchange_dvid_properties(services, "graph", "prop", vertices,
+                DVIDPropertyMerge<libdvid::Vertex>::type(&add_weight), 2), ErrMsg);
+    BOOST_CHECK(store.batch_sizes.empty());
+
+    services.clear();
+    BOOST_CHECK_THROW(exchange_dvid_properties(services, "graph", "prop", vertices,
+                DVIDPropertyMerge<libdvid::Vertex>::type(&add_weight), 2), ErrMsg);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,231 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_MODULE label_stream
+
+#include <boost/test/unit_test.hpp>
+
+#include <IO/LabelStreamIO.h>
+#include <Stack/Stack.h>
+#include <Utilities/ErrMsg.h>
+
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <sstream>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+using namespace NeuroProof;
+using std::vector;
+using std::string;
+
+// added to the labels in the stream so that they need 64 bits
+static const unsigned long long LABEL_OFFSET = 1ULL << 33;
+
+// blocks of labels inside a border of 0s (the border is skipped by
+// build_rag_batch, so it is 0 to match build_rag)
+static VolumeLabelPtr create_stream_volume()
+{
+    VolumeLabelPtr labels = VolumeLabelData::create_volume(12, 10, 9);
+    volume_forXYZ(*labels,x,y,z) {
+        Label_t label = 0;
+        if ((x > 0) && (y > 0) && (z > 0) && (x < 11) && (y < 9) && (z < 8)) {
+            label = 1 + (x / 4) + 3 * (y / 4) + 9 * (z / 3);
+        }
+        labels->set(x, y, z, label);
+    }
+    labels->set(5, 5, 4, 30);
+    labels->set(6, 5, 4, 30);
+    return labels;
+}
+
+// labels of the volume in stream order (x varying fastest)
+static vector<unsigned long long> get_stream_labels(VolumeLabelPtr labels)
+{
+    vector<unsigned long long> stream_labels;
+    volume_forXYZ(*labels,x,y,z) {
+        Label_t label = (*labels)(x,y,z);
+        stream_labels.push_back(label ? (label + LABEL_OFFSET) : 0);
+    }
+    return stream_labels;
+}
+
+static void write_word(std::ostream& out, unsigned long long word)
+{
+    out.write((const char*) &word, sizeof(unsigned long long));
+}
+
+static void write_header(std::ostream& out, VolumeLabelPtr labels)
+{
+    write_word(out, labels->shape(0));
+    write_word(out, labels->shape(1));
+    write_word(out, labels->shape(2));
+}
+
+static void write_raw_frame(std::ostream& out, const vector<unsigned long long>& stream_labels,
+        size_t start, size_t end)
+{
+    write_word(out, LABEL_STREAM_RAW);
+    write_word(out, end - start);
+    write_word(out, (end - start) * sizeof(unsigned long long));
+    for (size_t i = start; i < end; ++i) {
+        write_word(out, stream_labels[i]);
+    }
+}
+
+static void write_rle_frame(std::ostream& out, const vector<unsigned long long>& stream_labels,
+        size_t start, size_t end)
+{
+    vector<unsigned long long> runs;
+    for (size_t i = start; i < end; ) {
+        size_t run_end = i;
+        while ((run_end < end) && (stream_labels[run_end] == stream_labels[i])) {
+            ++run_end;
+        }
+        runs.push_back(run_end - i);
+        runs.push_back(stream_labels[i]);
+        i = run_end;
+    }
+
+    write_word(out, LABEL_STREAM_RLE);
+    write_word(out, end - start);
+    write_word(out, runs.size() * sizeof(unsigned long long));
+    for (size_t i = 0; i < runs.size(); ++i) {
+        write_word(out, runs[i]);
+    }
+}
+
+// reads the stream in another thread while adding the planes read to
+// the rag as neuroproof_graph_build_stream does
+static RagPtr build_stream_rag(LabelStreamReader& reader, Stack& stack)
+{
+    unsigned int zsize = reader.get_labelvol()->shape(2);
+    boost::thread read_thread(boost::bind(&LabelStreamReader::read_volume, &reader));
+    try {
+        unsigned int zdone = 0;
+        while (zdone < zsize) {
+            unsigned int planes_read = reader.wait_for_planes(std::min(zdone + 2, zsize));
+            unsigned int zend = (planes_read == zsize) ? zsize : (planes_read - 1);
+            stack.build_rag_batch(zdone, zend);
+            zdone = zend;
+        }
+    } catch (...) {
+        read_thread.join();
+        throw;
+    }
+    read_thread.join();
+    return stack.get_rag();
+}
+
+// compares the streamed labels and rag with a rag built from the volume
+static void check_stream(std::istream& stream, bool chunked)
+{
+    VolumeLabelPtr labels = create_stream_volume();
+    Stack stack(labels);
+    stack.build_rag();
+    RagPtr rag = stack.get_rag();
+
+    LabelStreamReader reader(stream);
+    BOOST_CHECK(reader.is_chunked() == chunked);
+    VolumeLabelPtr stream_labelvol = reader.get_labelvol();
+    BOOST_REQUIRE(stream_labelvol->shape(0) == labels->shape(0));
+    BOOST_REQUIRE(stream_labelvol->shape(1) == labels->shape(1));
+    BOOST_REQUIRE(stream_labelvol->shape(2) == labels->shape(2));
+
+    Stack stream_stack(stream_labelvol);
+    RagPtr stream_rag = build_stream_rag(reader, stream_stack);
+    BOOST_REQUIRE(stream_rag.get() != 0);
+
+    // each label has a single id that maps back to the stream label
+    std::unordered_map<Label_t, Label_t> label_ids;
+    volume_forXYZ(*labels,x,y,z) {
+        Label_t label = (*labels)(x,y,z);
+        Label_t id = (*stream_labelvol)(x,y,z);
+        unsigned long long stream_label = label ? (label + LABEL_OFFSET) : 0;
+        BOOST_REQUIRE(reader.get_label(id) == stream_label);
+        if (label_ids.find(label) == label_ids.end()) {
+            label_ids[label] = id;
+        }
+        BOOST_REQUIRE(label_ids[label] == id);
+    }
+
+    BOOST_CHECK(rag->get_num_regions() == stream_rag->get_num_regions());
+    BOOST_CHECK(rag->get_num_edges() == stream_rag->get_num_edges());
+    for (Rag_t::nodes_iterator iter = rag->nodes_begin(); iter != rag->nodes_end(); ++iter) {
+        RagNode_t* node = stream_rag->find_rag_node(label_ids[(*iter)->get_node_id()]);
+        BOOST_CHECK(node && (node->get_size() == (*iter)->get_size()));
+    }
+    for (Rag_t::edges_iterator iter = rag->edges_begin(); iter != rag->edges_end(); ++iter) {
+        RagEdge_t* edge = stream_rag->find_rag_edge(label_ids[(*iter)->get_node1()->get_node_id()],
+                label_ids[(*iter)->get_node2()->get_node_id()]);
+        BOOST_CHECK(edge && (edge->get_size() == (*iter)->get_size()));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE (label_stream_simple)
+
+BOOST_AUTO_TEST_CASE (label_stream_legacy)
+{
+    VolumeLabelPtr labels = create_stream_volume();
+    vector<unsigned long long> stream_labels = get_stream_labels(labels);
+
+    std::ostringstream out;
+    write_header(out, labels);
+    for (size_t i = 0; i < stream_labels.size(); ++i) {
+        write_word(out, stream_labels[i]);
+    }
+
+    std::istringstream stream(out.str());
+    check_stream(stream, false);
+}
+
+BOOST_AUTO_TEST_CASE (label_stream_chunked)
+{
+    VolumeLabelPtr labels = create_stream_volume();
+    vector<unsigned long long> stream_labels = get_stream_labels(labels);
+    size_t plane_size = labels->shape(0) * labels->shape(1);
+
+    // frames end in the middle of planes and runs
+    std::ostringstream out;
+    write_word(out, LABEL_STREAM_MAGIC);
+    write_header(out, labels);
+    write_raw_frame(out, stream_labels, 0, plane_size + 17);
+    write_rle_frame(out, stream_labels, plane_size + 17, 4 * plane_size + 5);
+    write_raw_frame(out, stream_labels, 4 * plane_size + 5, 4 * plane_size + 30);
+    write_rle_frame(out, stream_labels, 4 * plane_size + 30, stream_labels.size());
+
+    std::istringstream stream(out.str());
+    check_stream(stream, true);
+}
+
+BOOST_AUTO_TEST_CASE (label_stream_errors)
+{
+    VolumeLabelPtr labels = create_stream_volume();
+    vector<unsigned long long> stream_labels = get_stream_labels(labels);
+
+    // the error is reported to the thread waiting for planes
+    std::ostringstream out;
+    write_word(out, LABEL_STREAM_MAGIC);
+    write_header(out, labels);
+    write_rle_frame(out, stream_labels, 0, stream_labels.size() / 2);
+    std::istringstream truncated_stream(out.str());
+    LabelStreamReader reader(truncated_stream);
+    Stack stack(reader.get_labelvol());
+    BOOST_CHECK_THROW(build_stream_rag(reader, stack), ErrMsg);
+
+    // a frame whose runs do not add up to its voxels
+    std::ostringstream out_rle;
+    write_word(out_rle, LABEL_STREAM_MAGIC);
+    write_header(out_rle, labels);
+    write_word(out_rle, LABEL_STREAM_RLE);
+    write_word(out_rle, 10);
+    write_word(out_rle, 2 * sizeof(unsigned long long));
+    write_word(out_rle, 11);
+    write_word(out_rle, LABEL_OFFSET);
+    std::istringstream rle_stream(out_rle.str());
+    LabelStreamReader rle_reader(rle_stream);
+    rle_reader.read_volume();
+    BOOST_CHECK_THROW(rle_reader.wait_for_planes(1), ErrMsg);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -3,11 +3,13 @@
 #define BOOST_TEST_MODULE rag_capabilities
 
 #include <iostream>
+#include <algorithm>
 
 #include <boost/test/unit_test.hpp>
 #include <boost/test/floating_point_comparison.hpp>
 
 #include <Rag/RagUtils.h>
+#include <Rag/AffinityPathSearch.h>
 #include <Rag/Rag.h>
 #include <IO/RagIO.h>
 
@@ -60,6 +62,69 @@ BOOST_AUTO_TEST_CASE (rag_general)
     delete test_rag2;
 }
 
+BOOST_AUTO_TEST_CASE (rag_property_keys)
+{
+    Rag_t* test_rag = new Rag_t();
+    RagNode_t* node = test_rag->insert_rag_node(5);
+    PropertyKey temp_key = PropertyKeys::get_key("temp");
+
+    BOOST_CHECK(temp_key == PropertyKeys::get_key("temp"));
+    BOOST_CHECK(PropertyKeys::get_name(temp_key) == "temp");
+
+    // string and key interfaces refer to the same property
+    node->set_property("temp", int(9));
+    BOOST_CHECK(node->has_property(temp_key));
+    BOOST_CHECK(9 == node->get_property<int>(temp_key));
+
+    // properties held elsewhere are not modified by later updates
+    PropertyPtr saved_property = node->get_property_ptr(temp_key);
+    node->set_property(temp_key, int(10));
+    BOOST_CHECK(10 == node->get_property<int>("temp"));
+    node->set_property_ptr("temp", saved_property);
+    BOOST_CHECK(9 == node->get_property<int>(temp_key));
+
+    node->rm_property(temp_key);
+    BOOST_CHECK(!node->has_property("temp"));
+    BOOST_CHECK(node->get_boundary_size() == 0);
+
+    delete test_rag;
+}
+
+BOOST_AUTO_TEST_CASE (rag_shared_snapshot)
+{
+    Rag_t* test_rag = new Rag_t();
+    RagNode_t* node = test_rag->insert_rag_node(5);
+    RagNode_t* node2 = test_rag->insert_rag_node(6);
+    node->set_property("temp", int(9));
+    node->set_property("name", std::string("body"));
+    test_rag->insert_rag_edge(node, node2)->set_property("temp", int(3));
+
+    // snapshot shares the heap properties instead of copying them
+    Rag_t* snapshot = new Rag_t(*test_rag, true);
+    RagNode_t* snap_node = snapshot->find_rag_node(5);
+    BOOST_CHECK(snap_node != node);
+    BOOST_CHECK(snap_node->get_property_ptr("name") == node->get_property_ptr("name"));
+    BOOST_CHECK(9 == snap_node->get_property<int>("temp"));
+
+    // updates through set_property are not seen by the original rag
+    snap_node->set_property("temp", int(10));
+    snap_node->set_property("name", std::string("trial"));
+    snapshot->find_rag_edge(5, 6)->set_property("temp", int(4));
+    BOOST_CHECK(9 == node->get_property<int>("temp"));
+    BOOST_CHECK("body" == node->get_property<std::string>("name"));
+    BOOST_CHECK(3 == test_rag->find_rag_edge(5, 6)->get_property<int>("temp"));
+    BOOST_CHECK(10 == snap_node->get_property<int>("temp"));
+
+    rag_join_nodes(*snapshot, snap_node, snapshot->find_rag_node(6), 0);
+    BOOST_CHECK(snapshot->get_num_regions() == 1);
+    BOOST_CHECK(test_rag->get_num_regions() == 2);
+    BOOST_CHECK(test_rag->get_num_edges() == 1);
+
+    delete snapshot;
+    BOOST_CHECK(9 == node->get_property<int>("temp"));
+    delete test_rag;
+}
+
 
 BOOST_AUTO_TEST_CASE (rag_node_combine)
 {
@@ -94,6 +159,172 @@ BOOST_AUTO_TEST_CASE (rag_node_combine)
     delete test_rag;
 }
 
+BOOST_AUTO_TEST_CASE (rag_node_collapse)
+{
+    Rag_t* test_rag = new Rag_t();
+    RagNode_t* node = test_rag->insert_rag_node(5);
+    RagNode_t* node2 = test_rag->insert_rag_node(6);
+    RagNode_t* node3 = test_rag->insert_rag_node(7);
+    RagNode_t* node4 = test_rag->insert_rag_node(8);
+
+    node->set_size(1);
+    node2->set_size(10);
+    node3->set_size(100);
+    node4->set_size(1000);
+
+    test_rag->insert_rag_edge(node, node2);
+    test_rag->insert_rag_edge(node2, node3);
+    test_rag->insert_rag_edge(node3, node)->set_size(2);
+    test_rag->insert_rag_edge(node2, node4)->set_size(3);
+    RagEdge_t* edge = test_rag->insert_rag_edge(node3, node4);
+    edge->set_size(1);
+    edge->set_preserve(true);
+
+    std::vector<RagNode_t*> nodes_remove;
+    nodes_remove.push_back(node2);
+    nodes_remove.push_back(node3);
+    rag_collapse_nodes(*test_rag, node, nodes_remove, 0);
+
+    BOOST_CHECK(111 == node->get_size());
+    BOOST_CHECK(test_rag->get_num_regions() == 2);
+    BOOST_CHECK(test_rag->get_num_edges() == 1);
+
+    edge = test_rag->find_rag_edge(node, node4);
+    BOOST_CHECK(edge != 0);
+    BOOST_CHECK(edge->get_size() == 4);
+    BOOST_CHECK(edge->is_preserve());
+
+    delete test_rag;
+}
+
+BOOST_AUTO_TEST_CASE (rag_merge_low_weight)
+{
+    Rag_t* test_rag = new Rag_t();
+    RagNode_t* node = test_rag->insert_rag_node(1);
+    RagNode_t* node2 = test_rag->insert_rag_node(2);
+    RagNode_t* node3 = test_rag->insert_rag_node(3);
+    RagNode_t* node4 = test_rag->insert_rag_node(4);
+    RagNode_t* node5 = test_rag->insert_rag_node(5);
+    node->set_size(10);
+    node2->set_size(30);
+    node3->set_size(20);
+    node4->set_size(5);
+    node5->set_size(7);
+
+    // 1-2-3 form a group through low weight edges
+    test_rag->insert_rag_edge(node, node2)->set_weight(0.0);
+    test_rag->insert_rag_edge(node2, node3)->set_weight(0.0);
+    test_rag->insert_rag_edge(node, node3)->set_weight(1.0);
+    test_rag->insert_rag_edge(node3, node4)->set_weight(1.0);
+    test_rag->insert_rag_edge(node, node4)->set_weight(0.0);
+
+    std::unordered_map<Node_t, unsigned long long> largest_sizes;
+    rag_merge_low_weight_edges(*test_rag, 0.0001, 0, largest_sizes);
+
+    // 1-2-3-4 are merged onto the largest node
+    BOOST_CHECK(test_rag->get_num_regions() == 2);
+    BOOST_CHECK(test_rag->get_num_edges() == 0);
+    BOOST_CHECK(largest_sizes.size() == 1);
+    BOOST_CHECK(largest_sizes[2] == 30);
+    BOOST_CHECK(test_rag->find_rag_node(2)->get_size() == 65);
+    BOOST_CHECK(test_rag->find_rag_node(5) != 0);
+
+    delete test_rag;
+}
+
+BOOST_AUTO_TEST_CASE (rag_affinity_path)
+{
+    Rag_t* test_rag = new Rag_t();
+    RagNode_t* node = test_rag->insert_rag_node(1);
+    RagNode_t* node2 = test_rag->insert_rag_node(2);
+    RagNode_t* node3 = test_rag->insert_rag_node(3);
+    RagNode_t* node4 = test_rag->insert_rag_node(4);
+
+    test_rag->insert_rag_edge(node, node2)->set_weight(0.5);
+    test_rag->insert_rag_edge(node2, node3)->set_weight(0.5);
+    test_rag->insert_rag_edge(node, node4)->set_weight(0.9);
+
+    BOOST_CHECK_CLOSE(0.25, find_affinity_path(*test_rag, node, node3), 0.0001);
+
+    AffinityPathSearch path_search;
+    path_search.search(node, 0, 0.01, false);
+    BOOST_CHECK(path_search.num_reached() == 3);
+    BOOST_CHECK(path_search.get_reached(0).node == node2);
+    BOOST_CHECK(path_search.get_reached(1).node == node3);
+    BOOST_CHECK(path_search.get_reached(1).second_node == 2);
+    BOOST_CHECK_CLOSE(0.1, path_search.get_affinity(node4), 0.0001);
+
+    // restrict the path length and the connection
+    path_search.search(node, 1, 0.01, false);
+    BOOST_CHECK(path_search.num_reached() == 2);
+    BOOST_CHECK(path_search.find_reached(node3) == 0);
+    path_search.search(node, 0, 0.3, false);
+    BOOST_CHECK(path_search.num_reached() == 1);
+
+    delete test_rag;
+}
+
+// components of the rag as (articulation node, sorted edges) in order
+static std::vector<std::pair<Node_t, std::vector<OrderedPair> > > find_sorted_components(RagPtr rag)
+{
+    std::vector<std::vector<OrderedPair> > biconnected_components;
+    find_biconnected_components(rag, biconnected_components);
+
+    std::vector<std::pair<Node_t, std::vector<OrderedPair> > > components;
+    for (unsigned int i = 0; i < biconnected_components.size(); ++i) {
+        std::vector<OrderedPair> edges(biconnected_components[i].begin(),
+                biconnected_components[i].end() - 1);
+        std::sort(edges.begin(), edges.end());
+        components.push_back(std::make_pair(biconnected_components[i].back().region1, edges));
+    }
+    std::sort(components.begin(), components.end());
+    return components;
+}
+
+BOOST_AUTO_TEST_CASE (rag_biconnected)
+{
+    // boundary nodes 1, 2, and 8; 3 and 4 are articulation points of
+    // an inclusion that is only attached to the boundary by a false edge
+    RagPtr rag(new Rag_t);
+    for (Node_t id = 1; id <= 9; ++id) {
+        rag->insert_rag_node(id);
+    }
+    rag->find_rag_node(1)->set_boundary_size(10);
+    rag->find_rag_node(2)->set_boundary_size(10);
+    rag->find_rag_node(8)->set_boundary_size(10);
+
+    const Node_t edges[][2] = {{1,2}, {1,3}, {2,3}, {3,4}, {4,5}, {5,6}, {6,4},
+        {5,7}, {6,2}, {8,1}, {8,9}, {9,2}};
+    for (unsigned int i = 0; i < sizeof(edges) / sizeof(edges[0]); ++i) {
+        rag->insert_rag_edge(rag->find_rag_node(edges[i][0]), rag->find_rag_node(edges[i][1]));
+    }
+    rag->find_rag_edge(6, 2)->set_false_edge(true);
+
+    // the components found by the recursive search this replaced
+    std::vector<std::pair<Node_t, std::vector<OrderedPair> > > components =
+        find_sorted_components(rag);
+    BOOST_REQUIRE(components.size() == 3);
+    BOOST_CHECK(components[0].first == 3);
+    BOOST_REQUIRE(components[0].second.size() == 1);
+    BOOST_CHECK(components[0].second[0] == OrderedPair(3, 4));
+    BOOST_CHECK(components[1].first == 4);
+    BOOST_REQUIRE(components[1].second.size() == 3);
+    BOOST_CHECK(components[1].second[0] == OrderedPair(4, 5));
+    BOOST_CHECK(components[1].second[1] == OrderedPair(4, 6));
+    BOOST_CHECK(components[1].second[2] == OrderedPair(5, 6));
+    BOOST_CHECK(components[2].first == 5);
+    BOOST_REQUIRE(components[2].second.size() == 1);
+    BOOST_CHECK(components[2].second[0] == OrderedPair(5, 7));
+
+    // the inclusion is attached to the boundary by a real edge
+    rag->find_rag_edge(6, 2)->set_false_edge(false);
+    components = find_sorted_components(rag);
+    BOOST_REQUIRE(components.size() == 1);
+    BOOST_CHECK(components[0].first == 5);
+    BOOST_REQUIRE(components[0].second.size() == 1);
+    BOOST_CHECK(components[0].second[0] == OrderedPair(5, 7));
+}
+
 BOOST_AUTO_TEST_CASE (rag_json_create)
 {
     Json::Value json_vals;
@@ -126,6 +357,89 @@ BOOST_AUTO_TEST_CASE (rag_json_create)
     delete rag;
 }
 
+BOOST_AUTO_TEST_CASE (rag_binary_file)
+{
+    Rag_t* rag = new Rag_t();
+    RagNode_t* node = rag->insert_rag_node(5);
+    RagNode_t* node2 = rag->insert_rag_node(9);
+    RagNode_t* node3 = rag->insert_rag_node(19);
+    node->set_size(2000);
+    node2->set_size(1500);
+    node3->set_size(3500);
+
+    RagEdge_t* edge = rag->insert_rag_edge(node, node2);
+    edge->set_weight(0.3);
+    edge->set_property("location", Location(1,2,3));
+    edge = rag->insert_rag_edge(node, node3);
+    edge->set_weight(0.5);
+    edge->set_preserve(true);
+
+    Json::Value graph_info;
+    graph_info["orphan_bodies"][(unsigned int) 0] = 19;
+    BOOST_CHECK(create_binaryfile_from_rag(rag, "temp_rag.npgraph", graph_info,
+                std::vector<double>(), 0));
+    delete rag;
+
+    Json::Value graph_info2;
+    rag = create_rag_from_graphfile("temp_rag.npgraph", graph_info2);
+    BOOST_CHECK(rag != 0);
+    BOOST_CHECK(rag->get_num_regions() == 3);
+    BOOST_CHECK(rag->get_num_edges() == 2);
+    BOOST_CHECK(rag->get_rag_size() == 7000);
+    BOOST_CHECK(graph_info2["orphan_bodies"][(unsigned int) 0].asUInt() == 19);
+
+    edge = rag->find_rag_edge(5, 9);
+    BOOST_CHECK_CLOSE(edge->get_weight(), 0.3, 0.000001);
+    Location location = edge->get_property<Location>("location");
+    BOOST_CHECK(boost::get<2>(location) == 3);
+    BOOST_CHECK(rag->find_rag_edge(5, 19)->is_preserve());
+    BOOST_CHECK(!(rag->find_rag_edge(5, 19)->has_property("location")));
+
+    delete rag;
+    remove("temp_rag.npgraph");
+}
+
+BOOST_AUTO_TEST_CASE (rag_label_width)
+{
+#ifdef NEUROPROOF_64BIT_LABELS
+    BOOST_CHECK(sizeof(Node_t) == 8);
+
+    // ids beyond 32 bits survive the rag and its json and binary files
+    Node_t id1 = (Node_t(1) << 32) + 5;
+    Node_t id2 = (Node_t(1) << 33) + 9;
+    Rag_t* rag = new Rag_t();
+    RagNode_t* node = rag->insert_rag_node(id1);
+    RagNode_t* node2 = rag->insert_rag_node(id2);
+    node->set_size(20);
+    node2->set_size(15);
+    rag->insert_rag_edge(node, node2)->set_weight(0.3);
+    BOOST_CHECK(rag->find_rag_node(5) == 0);
+
+    Json::Value json_vals;
+    BOOST_CHECK(create_json_from_rag(rag, json_vals));
+    Rag_t* rag_json = create_rag_from_json(json_vals);
+    BOOST_CHECK(rag_json != 0);
+    BOOST_CHECK(rag_json && rag_json->find_rag_edge(id1, id2));
+    delete rag_json;
+
+    Json::Value graph_info;
+    BOOST_CHECK(create_binaryfile_from_rag(rag, "temp_rag64.npgraph", graph_info,
+                std::vector<double>(), 0));
+    delete rag;
+
+    Json::Value graph_info2;
+    rag = create_rag_from_graphfile("temp_rag64.npgraph", graph_info2);
+    BOOST_CHECK(rag != 0);
+    BOOST_CHECK(rag && (rag->get_num_regions() == 2));
+    BOOST_CHECK(rag && rag->find_rag_edge(id1, id2));
+    BOOST_CHECK(rag && (rag->find_rag_node(id2)->get_size() == 15));
+    delete rag;
+    remove("temp_rag64.npgraph");
+#else
+    BOOST_CHECK(sizeof(Node_t) == 4);
+#endif
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -6,6 +6,7 @@
 
 #include <Stack/VolumeLabelData.h>
 #include <Stack/VolumeData.h>
+#include <Stack/Stack.h>
 #include <IO/StackIO.h>
 #include <iostream>
 #include <vector>
@@ -36,3 +37,113 @@ BOOST_AUTO_TEST_CASE (stack_simple)
     }
     BOOST_CHECK(label_set.size() == 8180);
 }
+
+// three bodies split along x with small bodies inside of them and
+// on their borders (no 0 voxels, which only the full mode fills)
+static void create_absorb_volume(VolumeLabelPtr& labels,
+        VolumeLabelPtr& labels_local, VolumeProbPtr& boundary)
+{
+    vigra::MultiArrayShape<3>::type shape(20, 12, 10);
+    labels = VolumeLabelData::create_volume(20, 12, 10);
+    labels_local = VolumeLabelData::create_volume(20, 12, 10);
+    boundary = VolumeProb::create_volume();
+    boundary->reshape(shape);
+    volume_forXYZ(*labels,x,y,z) {
+        labels->set(x, y, z, (x < 7) ? 1 : ((x < 14) ? 2 : 3));
+        (*boundary)(x,y,z) = ((x * 7 + y * 3 + z * 5) % 11) / 11.0;
+    }
+    labels->set(3, 3, 3, 4);
+    labels->set(3, 4, 3, 4);
+    labels->set(6, 6, 5, 5);
+    labels->set(7, 6, 5, 5);
+    labels->set(13, 2, 8, 6);
+    labels->set(14, 2, 8, 6);
+    labels->set(14, 3, 8, 6);
+    labels->set(17, 11, 9, 7);
+    volume_forXYZ(*labels,x,y,z) {
+        labels_local->set(x, y, z, (*labels)(x,y,z));
+    }
+}
+
+static bool same_labels(VolumeLabelPtr labels, VolumeLabelPtr labels_local)
+{
+    volume_forXYZ(*labels,x,y,z) {
+        if ((*labels)(x,y,z) != (*labels_local)(x,y,z)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void check_same_rag(RagPtr rag, RagPtr rag_local)
+{
+    BOOST_REQUIRE(rag.get() != 0);
+    BOOST_REQUIRE(rag_local.get() != 0);
+    BOOST_CHECK(rag->get_num_regions() == rag_local->get_num_regions());
+    BOOST_CHECK(rag->get_num_edges() == rag_local->get_num_edges());
+    for (Rag_t::nodes_iterator iter = rag->nodes_begin(); iter != rag->nodes_end(); ++iter) {
+        RagNode_t* node = rag_local->find_rag_node((*iter)->get_node_id());
+        BOOST_CHECK(node);
+        BOOST_CHECK(node && (node->get_size() == (*iter)->get_size()));
+        BOOST_CHECK(node && (node->get_boundary_size() == (*iter)->get_boundary_size()));
+    }
+    for (Rag_t::edges_iterator iter = rag->edges_begin(); iter != rag->edges_end(); ++iter) {
+        RagEdge_t* edge = rag_local->find_rag_edge((*iter)->get_node1()->get_node_id(),
+                (*iter)->get_node2()->get_node_id());
+        BOOST_CHECK(edge);
+        BOOST_CHECK(edge && (edge->get_size() == (*iter)->get_size()));
+    }
+}
+
+BOOST_AUTO_TEST_CASE (stack_absorb_local)
+{
+    VolumeLabelPtr labels, labels_local;
+    VolumeProbPtr boundary;
+    create_absorb_volume(labels, labels_local, boundary);
+
+    unordered_set<Label_t> exclusions;
+    exclusions.insert(7);
+
+    Stack stack(labels);
+    BOOST_CHECK(3 == stack.absorb_small_regions(boundary, 4, exclusions));
+
+    // the rag is updated in place by the local mode
+    Stack stack_local(labels_local);
+    stack_local.set_num_threads(2);
+    stack_local.build_rag();
+    BOOST_CHECK(3 == stack_local.absorb_small_regions_local(boundary, 4, exclusions, 2));
+    BOOST_CHECK(same_labels(labels, labels_local));
+
+    // compare with a rag built from the absorbed labels
+    stack.build_rag();
+    check_same_rag(stack.get_rag(), stack_local.get_rag());
+}
+
+BOOST_AUTO_TEST_CASE (stack_absorb_local_agglomerated)
+{
+    VolumeLabelPtr labels, labels_local;
+    VolumeProbPtr boundary;
+    create_absorb_volume(labels, labels_local, boundary);
+
+    unordered_set<Label_t> exclusions;
+    exclusions.insert(7);
+
+    // merge bodies before absorbing as graph_predict does
+    Stack stack(labels);
+    stack.build_rag();
+    stack.merge_labels(2, 1, 0);
+    BOOST_CHECK(3 == stack.absorb_small_regions(boundary, 4, exclusions));
+
+    Stack stack_local(labels_local);
+    stack_local.set_num_threads(2);
+    stack_local.build_rag();
+    stack_local.merge_labels(2, 1, 0);
+    BOOST_CHECK(3 == stack_local.absorb_small_regions_local(boundary, 4, exclusions, 2));
+    BOOST_CHECK(same_labels(labels, labels_local));
+
+    // the rags exported after the absorb are rebuilt from the labels
+    stack.build_rag();
+    stack_local.build_rag();
+    check_same_rag(stack.get_rag(), stack_local.get_rag());
+    BOOST_CHECK(3 == stack_local.get_rag()->get_num_regions());
+}